@@ -28,6 +28,7 @@ extern "C" {
   */
 
   static EVMod *addModule(EVRoot *root, char *name);
+  static void graceReclaim(EVRoot *root);
 
   EVMod *EVInit(void *data) {
     EVRoot *root = (EVRoot *)my_calloc(sizeof(EVRoot));
@@ -35,6 +36,7 @@ extern "C" {
     root->sockets = UTHASH_NEW(EVSocket, fd, UTHASH_DFLT);
     root->modules = UTHASH_NEW(EVMod, name, UTHASH_SKEY);
     root->moduleList = UTArrayNew(UTARRAY_DFLT);
+    root->retired = UTArrayNew(UTARRAY_DFLT);
     root->rootModule = addModule(root, EVMOD_ROOT);
     root->rootModule->data = data;
     root->sync = (pthread_mutex_t *)my_calloc(sizeof(pthread_mutex_t));
@@ -319,11 +321,42 @@ extern "C" {
     assert(sock->fd <= 0);
     if(sock->iobuf)
       UTStrBuf_free(sock->iobuf);
-    if(sock->ioline)
-      UTStrBuf_free(sock->ioline);
     my_free(sock);
   }
 
+  /*_________________---------------------------__________________
+    _________________     instrumentation       __________________
+    -----------------___________________________------------------
+    CLOCK_MONOTONIC is answered from the vDSO, so timing every
+    callback costs a few tens of nanoseconds.  (EVClockMono()
+    uses the COARSE clock, which is too coarse for this.)
+  */
+
+  static uint64_t statsClock_uS(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+  }
+
+  static void statsAccumulate(EVStats *stats, uint64_t start_uS) {
+    uint64_t uS = statsClock_uS() - start_uS;
+    stats->calls++;
+    stats->total_uS += uS;
+    if(uS > stats->max_uS)
+      stats->max_uS = uS;
+  }
+
+  static void statsLoop(EVBus *bus) {
+    uint64_t uS = statsClock_uS() - bus->stats.loopStart_uS;
+    int bucket = uS ? (64 - __builtin_clzll(uS)) : 0;
+    if(bucket >= EVBUS_LATENCY_BUCKETS)
+      bucket = EVBUS_LATENCY_BUCKETS - 1;
+    bus->stats.latency[bucket]++;
+    bus->stats.loops++;
+    if(uS > bus->stats.maxLoop_uS)
+      bus->stats.maxLoop_uS = uS;
+  }
+
   int EVEventTx(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
     int sent = 0;
     if(evt->bus == EVCurrentBus()) {
@@ -337,7 +370,9 @@ extern "C" {
 	}
       }
       UTARRAY_WALK(evt->actions_run, act) {
+	uint64_t start_uS = statsClock_uS();
 	(*act->actionCB)(act->module, evt, data, dataLen);
+	statsAccumulate(&act->stats, start_uS);
 	sent++;
       }
     }
@@ -411,14 +446,19 @@ extern "C" {
     // update clock - monotonic so that it is
     // safe to set timeouts in the future...
     EVClockMono(&bus->now);
+    bus->stats.loopStart_uS = statsClock_uS();
 
     // see if we got anything
     if(nfds > 0) {
       if(FD_ISSET(bus->pipe[0], &readfds))
 	busRxPipe(bus, bus->pipe[0]);
       UTARRAY_WALK(bus->sockets_run, sock) {
-	if(FD_ISSET(sock->fd, &readfds))
+	if(FD_ISSET(sock->fd, &readfds)) {
+	  // sock is not freed until the next busRead(), even if closed here
+	  uint64_t start_uS = statsClock_uS();
 	  (*sock->readCB)(sock->module, sock, sock->magic);
+	  statsAccumulate(&sock->stats, start_uS);
+	}
       }
     }
     else if(nfds < 0) {
@@ -479,14 +519,39 @@ extern "C" {
       // We can do that more safely now that we are using a
       // monotonic clock.
       if(EVTimeDiff_nS(&bus->now_deci, &bus->now) > 100000000) {
+	// count the ones we skipped (only meaningful if the select
+	// timeout was shortened to deliver them)
+	if(bus->now_deci.tv_sec
+	   && bus->select_mS == EVBUS_SELECT_MS_DECI) {
+	  int missed = (EVTimeDiff_mS(&bus->now_deci, &bus->now) / 100) - 1;
+	  if(missed > 0)
+	    bus->stats.missedDecis += missed;
+	}
 	bus->now_deci = bus->now;
 	EVEventTx(mod, deci, NULL, 0);
 	if(EVTimeDiff_nS(&bus->now_tick, &bus->now) > 1000000000) {
+	  if(bus->now_tick.tv_sec) {
+	    int missed = (EVTimeDiff_mS(&bus->now_tick, &bus->now) / 1000) - 1;
+	    if(missed > 0)
+	      bus->stats.missedTicks += missed;
+	  }
 	  bus->now_tick = bus->now;
 	  EVEventTx(mod, tick, NULL, 0);
 	  EVEventTx(mod, tock, NULL, 0);
+	  graceReclaim(bus->root);
+	  if(bus->stats.lastLog == 0)
+	    bus->stats.lastLog = bus->now.tv_sec;
+	  if(getDebug()
+	     && (bus->now.tv_sec - bus->stats.lastLog) >= EVBUS_STATS_LOG_SECS) {
+	    bus->stats.lastLog = bus->now.tv_sec;
+	    EVBusStatsLog(bus);
+	  }
 	}
       }
+
+      statsLoop(bus);
+      // quiescent point: nothing looked up during this loop is still held
+      __atomic_store_n(&bus->epoch, bus->epoch + 1, __ATOMIC_RELEASE);
     }
     return NULL;
   }
@@ -513,46 +578,75 @@ extern "C" {
     -----------------___________________________------------------
     like popen(), but more secure coz the shell doesn't get
     to "reimagine" the args.  This should eventually take over
-    from myExec() in util.c.  Newline sequences LF, CR and CRLF
-    are all replaced with "\n".
+    from myExec() in util.c.  Lines are reported without their
+    line-end (LF, CR, CRLF or NUL).
   */
 
-  static bool socketLine(EVSocket *sock, size_t start) {
-
+  // Lines are returned as views into
+  // sock->iobuf, NUL-terminated in place, and are only valid until the
+  // callback returns. sock->ioscan remembers how far we have already
+  // looked so that each byte is only scanned once. strcspn() is
+  // vectorized in glibc and stops at NUL too, which is just what we want
+  // because iobuf is always NUL-terminated at iobuf->len.
+  static bool socketLine(EVSocket *sock, bool atEOF) {
     char *iobuf = UTSTRBUF_STR(sock->iobuf);
     size_t iolen = UTSTRBUF_LEN(sock->iobuf);
-
-    for(int ii = start; ii < iolen; ii++) {
-      char ch = iobuf[ii];
-      if(ch == 10 || ch == 13 || ch == 0) {
-	if(ch == 10 || ch == 13) ii++; // CR or LF
-	if(ch == 13 && iobuf[ii] == 10) ii++; // CRLF
-	UTStrBuf_append_n(sock->ioline, iobuf, ii);
-	UTStrBuf_snip_prefix(sock->iobuf, ii);
-	return YES;
+    size_t eol = sock->ioscan + strcspn(iobuf + sock->ioscan, "\r\n");
+    if(eol >= iolen) {
+      sock->ioscan = iolen;
+      return NO; // line-end not found
+    }
+    size_t next = eol + 1;
+    if(iobuf[eol] == '\r') {
+      if(next == iolen && !atEOF) {
+	// might be the first half of a CRLF
+	sock->ioscan = eol;
+	return NO;
       }
+      if(iobuf[next] == '\n') next++; // CRLF
+    }
+    iobuf[eol] = '\0';
+    sock->ioline = iobuf + sock->iooff;
+    sock->ioline_len = eol - sock->iooff;
+    sock->iooff = sock->ioscan = next;
+    return YES;
+  }
+
+  // Drop the lines that have already been consumed. Only pay for
+  // the memmove() when the dead space is at least half the buffer,
+  // so that a long line arriving in many small reads is not copied
+  // over and over.
+  static void socketCompact(EVSocket *sock) {
+    size_t iolen = UTSTRBUF_LEN(sock->iobuf);
+    if(sock->iooff == 0)
+      return;
+    if(sock->iooff == iolen
+       || sock->iooff >= (iolen >> 1)) {
+      UTStrBuf_snip_prefix(sock->iobuf, sock->iooff);
+      sock->ioscan -= sock->iooff;
+      sock->iooff = 0;
     }
-    return NO; // line-end not found
   }
 
   void EVSocketReadLines(EVMod *mod, EVSocket *sock, EVSocketReadLineCB lineCB, void *magic) {
     // When reading lines, use a per-line callback so we can easily handle the case where
     // a single read() call resulted in 0, 1 or >1 lines found,  or hit EOF with a trailing
-    // line in the buffer.
+    // line in the buffer. The line is in sock->ioline (length sock->ioline_len, without
+    // the line-end) and must be copied if it is needed after the callback returns.
     // insist this is only called from the same thread that opened the socket
     assert(sock->bus == EVCurrentBus());
-    if(sock->fd <= 0)
+    if(sock->fd <= 0) {
       (*lineCB)(mod, sock, EVSOCKETREAD_BADF, magic);
+      return;
+    }
 
     // allocate buffer so socket can accumulate data while looking for line-ends
     if(sock->iobuf == NULL)
       sock->iobuf = UTStrBuf_new();
-    // and another to report lines (or accumulate them if required)
-    if(sock->ioline == NULL)
-      sock->ioline = UTStrBuf_new();
 
     // try to read more
-    UTStrBuf_need(sock->iobuf, UTSTRBUF_LEN(sock->iobuf) + EVSOCKETREADLINE_INCBYTES);
+    socketCompact(sock);
+    UTStrBuf_need(sock->iobuf, EVSOCKETREADLINE_INCBYTES);
     char *readStart = UTSTRBUF_STR(sock->iobuf) + UTSTRBUF_LEN(sock->iobuf);
     int cc;
   try_again:
@@ -566,24 +660,27 @@ extern "C" {
     else if(cc == 0) {
       // EOF
       EVSocketClose(mod, sock);
-      // may have trailing line
-      if(UTSTRBUF_LEN(sock->iobuf)) {
-	UTStrBuf_append_n(sock->ioline, UTSTRBUF_STR(sock->iobuf), UTSTRBUF_LEN(sock->iobuf));
+      // may have complete lines held back by a trailing CR, then a trailing line
+      while(socketLine(sock, YES))
+	(*lineCB)(mod, sock, EVSOCKETREAD_STR, magic);
+      if(sock->iooff < UTSTRBUF_LEN(sock->iobuf)) {
+	sock->ioline = UTSTRBUF_STR(sock->iobuf) + sock->iooff;
+	sock->ioline_len = UTSTRBUF_LEN(sock->iobuf) - sock->iooff;
+	sock->iooff = sock->ioscan = UTSTRBUF_LEN(sock->iobuf);
 	(*lineCB)(mod, sock, EVSOCKETREAD_STR, magic);
       }
+      sock->ioline = NULL;
+      sock->ioline_len = 0;
       (*lineCB)(mod, sock, EVSOCKETREAD_EOF, magic);
     }
     else {
       // got more, see if it completed a line - or more than one
-      size_t start = UTSTRBUF_LEN(sock->iobuf);
       UTSTRBUF_LEN(sock->iobuf) += cc;
-      for(;;) {
-	if(socketLine(sock, start)) {
-	  (*lineCB)(mod, sock, EVSOCKETREAD_STR, magic);
-	  start = 0;
-	}
-	else break;
-      }
+      UTSTRBUF_STR(sock->iobuf)[UTSTRBUF_LEN(sock->iobuf)] = '\0';
+      while(socketLine(sock, NO))
+	(*lineCB)(mod, sock, EVSOCKETREAD_STR, magic);
+      sock->ioline = NULL;
+      sock->ioline_len = 0;
       // please call again (when socket has data)
       (*lineCB)(mod, sock, EVSOCKETREAD_AGAIN, magic);
     }
@@ -593,45 +690,28 @@ extern "C" {
   {
     int outPipe[2];
     int errPipe[2];
-    if(pipe(outPipe) == -1
-       || pipe(errPipe) == -1) {
+    // O_CLOEXEC so that only the dup2'd write-ends survive in the child
+    if(pipe2(outPipe, O_CLOEXEC) == -1
+       || pipe2(errPipe, O_CLOEXEC) == -1) {
       myLog(LOG_ERR, "pipe() failed : %s", strerror(errno));
       exit(EXIT_FAILURE);
     }
-    pid_t cpid;
-    if((cpid = fork()) == -1) {
-      myLog(LOG_ERR, "fork() failed : %s", strerror(errno));
-      exit(EXIT_FAILURE);
-    }
-    if(cpid == 0) {
-      // in child
-      // close read-ends
+    // stdout > write-end 1 and stderr > write-end 2
+    pid_t cpid = UTSpawn(cmd, outPipe[1], errPipe[1]);
+    // close write-ends
+    while(close(outPipe[1]) == -1 && errno == EINTR);
+    while(close(errPipe[1]) == -1 && errno == EINTR);
+    if(cpid == -1) {
       while(close(outPipe[0]) == -1 && errno == EINTR);
       while(close(errPipe[0]) == -1 && errno == EINTR);
-      // stdout > write-end 1 and stderr > write-end 2
-      while(dup2(outPipe[1], 1) == -1 && errno == EINTR);
-      while(dup2(errPipe[1], 2) == -1 && errno == EINTR);
-      // clean up
-      while(close(outPipe[1]) == -1 && errno == EINTR);
-      while(close(errPipe[1]) == -1 && errno == EINTR);
-      // and exec
-      if(execv(cmd[0], cmd) == -1) {
-	myLog(LOG_ERR, "execv() failed : errno=%d (%s)", errno, strerror(errno));
-	exit(EXIT_FAILURE);
-      }
-    }
-    else {
-      // in parent
-      bus->childCount++; // TODO: limit childCount. How?
-      // close write-ends
-      while(close(outPipe[1]) == -1 && errno == EINTR);
-      while(close(errPipe[1]) == -1 && errno == EINTR);
-      // read from read-ends
-      EVSocket *errSock = EVBusAddSocket(mod, bus, errPipe[0], readCB, magic);
-      errSock->errOut = YES; // mark this so we know it's stderr
-      EVSocket *outSock = EVBusAddSocket(mod, bus, outPipe[0], readCB, magic);
-      outSock->child_pid = cpid; // only give this one the cpid
-    }
+      return cpid;
+    }
+    bus->childCount++; // TODO: limit childCount. How?
+    // read from read-ends
+    EVSocket *errSock = EVBusAddSocket(mod, bus, errPipe[0], readCB, magic);
+    errSock->errOut = YES; // mark this so we know it's stderr
+    EVSocket *outSock = EVBusAddSocket(mod, bus, outPipe[0], readCB, magic);
+    outSock->child_pid = cpid; // only give this one the cpid
     return cpid;
   }
 
@@ -674,6 +754,215 @@ extern "C" {
     }
   }
 
+  /*_________________---------------------------__________________
+    _________________    deferred free          __________________
+    -----------------___________________________------------------
+    Quiescent-state reclaim: every bus bumps its epoch at the end
+    of each loop, so once each bus that was running when an object
+    was retired has moved on from the epoch we saw then, no reader
+    can still hold it. Reclaim is checked on the 1-second tick of
+    every bus, so the delay is about one select timeout.
+  */
+
+  typedef struct _EVGrace {
+    EVBus *bus;
+    uint64_t epoch;
+  } EVGrace;
+
+  typedef struct _EVRetired {
+    void *obj;
+    EVFreeCB freeCB;
+    uint32_t n_grace;
+    EVGrace *grace;
+  } EVRetired;
+
+  void EVDeferFree(EVMod *mod, void *obj, EVFreeCB freeCB) {
+    if(obj == NULL)
+      return;
+    if(mod == NULL) {
+      // no event buses yet, so there can be no readers
+      (*freeCB)(obj);
+      return;
+    }
+    EVRoot *root = mod->root;
+    EVRetired *ret = (EVRetired *)my_calloc(sizeof(EVRetired));
+    ret->obj = obj;
+    ret->freeCB = freeCB;
+    // the caller's unpublish must be visible before we sample epochs
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    SEMLOCK_DO(root->sync) {
+      ret->grace = (EVGrace *)my_calloc(UTHashN(root->buses) * sizeof(EVGrace));
+      EVBus *bus;
+      UTHASH_WALK(root->buses, bus) {
+	if(bus->running) {
+	  EVGrace *gr = &ret->grace[ret->n_grace++];
+	  gr->bus = bus;
+	  gr->epoch = __atomic_load_n(&bus->epoch, __ATOMIC_ACQUIRE);
+	}
+      }
+      UTArrayAdd(root->retired, ret);
+      __atomic_store_n(&root->n_retired, UTArrayN(root->retired), __ATOMIC_RELAXED);
+    }
+  }
+
+  uint32_t EVDeferredN(EVMod *mod) {
+    return __atomic_load_n(&mod->root->n_retired, __ATOMIC_RELAXED);
+  }
+
+  static bool graceElapsed(EVRetired *ret) {
+    for(uint32_t ii = 0; ii < ret->n_grace; ii++) {
+      EVGrace *gr = &ret->grace[ii];
+      if(gr->bus->running
+	 && __atomic_load_n(&gr->bus->epoch, __ATOMIC_ACQUIRE) == gr->epoch)
+	return NO;
+    }
+    return YES;
+  }
+
+  static void graceReclaim(EVRoot *root) {
+    if(__atomic_load_n(&root->n_retired, __ATOMIC_RELAXED) == 0)
+      return;
+    UTArray *ready = UTArrayNew(UTARRAY_DFLT);
+    SEMLOCK_DO(root->sync) {
+      EVRetired *ret;
+      UTARRAY_WALK(root->retired, ret) {
+	if(graceElapsed(ret)) {
+	  UTArrayDelAt(root->retired, _ii);
+	  UTArrayAdd(ready, ret);
+	}
+      }
+      UTArrayPack(root->retired);
+      __atomic_store_n(&root->n_retired, UTArrayN(root->retired), __ATOMIC_RELAXED);
+    }
+    // run the free callbacks outside the lock
+    EVRetired *ret;
+    UTARRAY_WALK(ready, ret) {
+      (*ret->freeCB)(ret->obj);
+      my_free(ret->grace);
+      my_free(ret);
+    }
+    UTArrayFree(ready);
+  }
+
+  /*_________________---------------------------__________________
+    _________________    published hash         __________________
+    -----------------___________________________------------------
+    Copy-on-publish: the writer keeps a private master table and
+    swaps in a fresh read-only copy when it has finished a batch
+    of changes. The objects themselves are shared, so their
+    lifetime must be managed with EVDeferFree() too.
+  */
+
+  EVHashRCU *EVHashRCUNew(UTHash *master) {
+    EVHashRCU *rh = (EVHashRCU *)my_calloc(sizeof(EVHashRCU));
+    rh->master = master;
+    rh->current = UTHashCopy(master);
+    return rh;
+  }
+
+  void *EVHashRCUGet(EVHashRCU *rh, void *obj) {
+    UTHash *current = __atomic_load_n(&rh->current, __ATOMIC_ACQUIRE);
+    return UTHashGet(current, obj);
+  }
+
+  void *EVHashRCUAdd(EVHashRCU *rh, void *obj) {
+    rh->dirty = YES;
+    return UTHashAdd(rh->master, obj);
+  }
+
+  void *EVHashRCUDel(EVHashRCU *rh, void *obj) {
+    void *found = UTHashDel(rh->master, obj);
+    if(found)
+      rh->dirty = YES;
+    return found;
+  }
+
+  void *EVHashRCUDelKey(EVHashRCU *rh, void *obj) {
+    void *found = UTHashDelKey(rh->master, obj);
+    if(found)
+      rh->dirty = YES;
+    return found;
+  }
+
+  void EVHashRCUReset(EVHashRCU *rh) {
+    if(UTHashN(rh->master))
+      rh->dirty = YES;
+    UTHashReset(rh->master);
+  }
+
+  static void hashRCUFreeCB(void *obj) {
+    UTHashFree((UTHash *)obj);
+  }
+
+  void EVHashRCUPublish(EVMod *mod, EVHashRCU *rh) {
+    if(!rh->dirty)
+      return;
+    rh->dirty = NO;
+    UTHash *old = __atomic_exchange_n(&rh->current, UTHashCopy(rh->master), __ATOMIC_ACQ_REL);
+    EVDeferFree(mod, old, hashRCUFreeCB);
+  }
+
+  void EVHashRCUFree(EVHashRCU *rh) {
+    // only safe once the readers are gone
+    if(rh == NULL)
+      return;
+    UTHashFree(rh->master);
+    UTHashFree(rh->current);
+    my_free(rh);
+  }
+
+  /*_________________---------------------------__________________
+    _________________    bus stats              __________________
+    -----------------___________________________------------------
+    May be called from any thread. The counters are read without
+    a lock, so an individual reading may be slightly stale.
+  */
+
+  void EVBusStatsWalk(EVBus *bus, EVStatsCB statsCB, void *magic) {
+    SEMLOCK_DO(bus->root->sync) {
+      EVEvent *evt;
+      UTARRAY_WALK(bus->eventList, evt) {
+	EVAction *act;
+	UTARRAY_WALK(evt->actions, act) {
+	  (*statsCB)(bus, act->module, evt->name, &act->stats, magic);
+	}
+      }
+      EVSocket *sock;
+      UTARRAY_WALK(bus->sockets, sock) {
+	char name[32];
+	snprintf(name, 32, "socket:%d", sock->fd);
+	(*statsCB)(bus, sock->module, name, &sock->stats, magic);
+      }
+    }
+  }
+
+  static void statsLogCB(EVBus *bus, EVMod *mod, char *name, EVStats *stats, void *magic) {
+    if(stats->calls)
+      myLog(LOG_INFO, "bus %s: %s %s calls=%"PRIu64" total_uS=%"PRIu64" avg_uS=%"PRIu64" max_uS=%"PRIu64,
+	    bus->name,
+	    mod->name,
+	    name,
+	    stats->calls,
+	    stats->total_uS,
+	    stats->total_uS / stats->calls,
+	    stats->max_uS);
+  }
+
+  void EVBusStatsLog(EVBus *bus) {
+    char hist[EVBUS_LATENCY_BUCKETS * 21];
+    int len = 0;
+    for(int ii = 0; ii < EVBUS_LATENCY_BUCKETS; ii++)
+      len += snprintf(hist + len, sizeof(hist) - len, "%s%"PRIu64, ii ? "," : "", bus->stats.latency[ii]);
+    myLog(LOG_INFO, "bus %s: loops=%"PRIu64" maxLoop_uS=%"PRIu64" missedTicks=%"PRIu64" missedDecis=%"PRIu64" latency_log2uS=[%s]",
+	  bus->name,
+	  bus->stats.loops,
+	  bus->stats.maxLoop_uS,
+	  bus->stats.missedTicks,
+	  bus->stats.missedDecis,
+	  hist);
+    EVBusStatsWalk(bus, statsLogCB, NULL);
+  }
+
   void EVLog(uint32_t rl_secs, int syslogType, char *fmt, ...) {
     EVBus *bus = EVCurrentBus();
     EVLogMsg search = { .msg = fmt };
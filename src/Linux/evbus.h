@@ -37,6 +37,8 @@ extern "C" {
     UTHash *sockets;
     struct _EVMod *rootModule;
     pthread_mutex_t *sync;
+    UTArray *retired;    // EVRetired objects waiting out a grace period
+    uint32_t n_retired;
   } EVRoot;
 
 #define EVMOD_ROOT "_root"
@@ -60,6 +62,26 @@ extern "C" {
     uint32_t count;
   } EVLogMsg;
 
+  // instrumentation - cheap enough to leave on
+  typedef struct _EVStats {
+    uint64_t calls;
+    uint64_t total_uS;
+    uint64_t max_uS;
+  } EVStats;
+
+#define EVBUS_LATENCY_BUCKETS 16 // log2(uS): 0, 1, 2-3, 4-7 ... >=16mS
+#define EVBUS_STATS_LOG_SECS 60
+
+  typedef struct _EVBusStats {
+    uint64_t loops;
+    uint64_t latency[EVBUS_LATENCY_BUCKETS];
+    uint64_t maxLoop_uS;
+    uint64_t missedTicks;
+    uint64_t missedDecis;
+    uint64_t loopStart_uS;
+    time_t lastLog;
+  } EVBusStats;
+
   typedef struct _EVBus {
     EVRoot *root;
     char *name;
@@ -78,6 +100,8 @@ extern "C" {
     pthread_t *thread;
     int childCount;
     UTHash *msgs;
+    EVBusStats stats;
+    uint64_t epoch; // bumped after every loop - see EVDeferFree()
     bool socketsChanged:1;
     bool running:1;
     bool stop:1;
@@ -94,7 +118,11 @@ extern "C" {
     pid_t child_pid;
     int child_status;
     UTStrBuf *iobuf;
-    UTStrBuf *ioline;
+    size_t iooff;  // start of unconsumed data in iobuf
+    size_t ioscan; // line-end search resumes here
+    char *ioline;  // current line (see EVSocketReadLines)
+    size_t ioline_len;
+    EVStats stats;
     bool errOut;
   } EVSocket;
 
@@ -114,6 +142,7 @@ extern "C" {
   typedef struct _EVAction {
     EVMod *module;
     EVActionCB actionCB;
+    EVStats stats;
   } EVAction;
 
 #define EVEVENT_START "_start"
@@ -173,12 +202,46 @@ extern "C" {
   void EVBusRunThread(EVBus *bus, size_t stacksize);
   void EVBusRun(EVBus *bus);
   void EVBusStop(EVBus *bus);
+
+  // callback stats are inclusive of any nested events
+  typedef void (*EVStatsCB)(EVBus *bus, EVMod *mod, char *name, EVStats *stats, void *magic);
+  void EVBusStatsWalk(EVBus *bus, EVStatsCB statsCB, void *magic);
+  void EVBusStatsLog(EVBus *bus);
   EVBus *EVCurrentBus(void);
   void EVCurrentBusSet(EVBus *bus);
   void EVRun(EVBus *mainBus);
   void EVStop(EVMod *mod);
   void EVLog(uint32_t rl_secs, int syslogType, char *fmt, ...);
 
+  // Deferred free. An object that has been unpublished (no longer
+  // reachable from shared state) may still be in use by a reader on
+  // another bus. EVDeferFree() holds it until every bus that was running
+  // at the time has completed a loop, then calls freeCB. Readers must be
+  // bus threads, and must not hold on to the pointer beyond the callback
+  // that looked it up.
+  typedef void (*EVFreeCB)(void *obj);
+  void EVDeferFree(EVMod *mod, void *obj, EVFreeCB freeCB);
+  uint32_t EVDeferredN(EVMod *mod);
+
+  // Published hash table. The writer (one bus only) changes "master" and
+  // then calls EVHashRCUPublish() to swap in a read-only copy. Readers on
+  // any bus use EVHashRCUGet() without taking a lock.
+  typedef struct _EVHashRCU {
+    UTHash *master;
+    UTHash *current;
+    bool dirty;
+  } EVHashRCU;
+
+  EVHashRCU *EVHashRCUNew(UTHash *master);
+  void *EVHashRCUGet(EVHashRCU *rh, void *obj);
+  void *EVHashRCUAdd(EVHashRCU *rh, void *obj);
+  void *EVHashRCUDel(EVHashRCU *rh, void *obj);
+  void *EVHashRCUDelKey(EVHashRCU *rh, void *obj);
+  void EVHashRCUReset(EVHashRCU *rh);
+  void EVHashRCUPublish(EVMod *mod, EVHashRCU *rh);
+  void EVHashRCUFree(EVHashRCU *rh);
+#define EVHASHRCU_WALK(rh, obj) UTHASH_WALK((rh)->master, obj)
+
 #if defined(__cplusplus)
 } /* extern "C" */
 #endif
@@ -70,7 +70,11 @@ extern "C" {
     HSPOBJ_DBUS,
     HSPOBJ_SYSTEMD,
     HSPOBJ_EAPI,
-    HSPOBJ_PORT
+    HSPOBJ_PORT,
+    HSPOBJ_REPLAY,
+    HSPOBJ_PSAMPLE,
+    HSPOBJ_DROPMON,
+    HSPOBJ_THREAD
   } EnumHSPObject;
 
   static const char *HSPObjectNames[] = {
@@ -91,8 +95,14 @@ extern "C" {
     "ovs",
     "os10",
     "opx",
+    "dbus",
+    "systemd",
     "eapi",
-    "port"
+    "port",
+    "replay",
+    "psample",
+    "dropmon",
+    "thread"
   };
 
   static void copyApplicationSettings(HSPSFlowSettings *from, HSPSFlowSettings *to);
@@ -388,6 +398,62 @@ extern "C" {
     return NULL;
   }
 
+  // expectNice
+
+  static HSPToken *expectNice(HSP *sp, HSPToken *tok, int32_t *arg)
+  {
+    HSPToken *t = tok;
+    t = t->nxt;
+    char *end = NULL;
+    if(t && t->str)
+      *arg = strtol(t->str, &end, 10);
+    if(end == NULL
+       || end == t->str
+       || *end != '\0') {
+      parseError(sp, tok, "expected integer", "");
+      return NULL;
+    }
+    if(*arg < -20 || *arg > 19) {
+      parseError(sp, tok, "range error", "");
+      return NULL;
+    }
+    return t;
+  }
+
+  // expectSchedPolicy
+
+  static HSPToken *expectSchedPolicy(HSP *sp, HSPToken *tok, int *arg)
+  {
+    HSPToken *t = tok;
+    t = t->nxt;
+    if(t && t->str) {
+      if(!strcasecmp(t->str, "other")) { *arg = SCHED_OTHER; return t; }
+      if(!strcasecmp(t->str, "batch")) { *arg = SCHED_BATCH; return t; }
+      if(!strcasecmp(t->str, "fifo")) { *arg = SCHED_FIFO; return t; }
+      if(!strcasecmp(t->str, "rr")) { *arg = SCHED_RR; return t; }
+    }
+    parseError(sp, tok, "expected other|batch|fifo|rr", "");
+    return NULL;
+  }
+
+  // expectCpuList
+
+  static HSPToken *expectCpuList(HSP *sp, HSPToken *tok, cpu_set_t **p_cpus)
+  {
+    HSPToken *t = tok;
+    t = t->nxt;
+    cpu_set_t cpus;
+    if(t && t->str
+       && parseCpuList(t->str, &cpus)) {
+      if(*p_cpus == NULL)
+	*p_cpus = (cpu_set_t *)my_calloc(sizeof(cpu_set_t));
+      **p_cpus = cpus;
+      return t;
+    }
+    parseError(sp, tok, "expected cpu list (e.g. 0-3,8)", "");
+    return NULL;
+  }
+
   // expectUUID
 
   static HSPToken *expectUUID(HSP *sp, HSPToken *tok, char *uuid)
@@ -420,6 +486,20 @@ extern "C" {
     return NULL;
   }
 
+  // expectOutputFile - may not exist yet
+
+  static HSPToken *expectOutputFile(HSP *sp, HSPToken *tok, char **p_fileName)
+  {
+    HSPToken *t = tok;
+    t = t->nxt;
+    if(t && t->str) {
+      *p_fileName = my_strdup(t->str);
+      return t;
+    }
+    parseError(sp, tok, "expected file name", "");
+    return NULL;
+  }
+
   // expectFormat
 
   static HSPToken *expectFormat(HSP *sp, HSPToken *tok, char **p_format)
@@ -487,11 +567,11 @@ extern "C" {
 	// side effects.
 	myLog(LOG_ERR, "clearCollectors: socket still open");
       }
-      my_free(coll);
       if(coll->namespace)
 	my_free(coll->namespace);
       if(coll->deviceName)
 	my_free(coll->deviceName);
+      my_free(coll);
       coll = nextColl;
     }
     settings->collectors = NULL;
@@ -518,6 +598,13 @@ extern "C" {
     return col;
   }
 
+  static HSPThread *newThread(HSP *sp) {
+    HSPThread *th = (HSPThread *)my_calloc(sizeof(HSPThread));
+    ADD_TO_LIST(sp->threads.threads, th);
+    sp->threads.numThreads++;
+    return th;
+  }
+
   static HSPPort *newOPXPort(HSP *sp) {
     HSPPort *prt = (HSPPort *)my_calloc(sizeof(HSPPort));
     ADD_TO_LIST(sp->opx.ports, prt);
@@ -559,6 +646,7 @@ extern "C" {
       to->collectors = NULL;
       copyCollectors(from, to);
       to->applicationSettings = NULL;
+      to->appTrie = NULL;
       copyApplicationSettings(from, to);
       to->agentCIDRs = NULL;
       copyAgentCIDRs(from, to);
@@ -569,6 +657,122 @@ extern "C" {
     return to;
   }
 
+  /*_________________---------------------------__________________
+    _________________  sFlowSettingsChanges     __________________
+    -----------------___________________________------------------
+    Compare two settings objects field by field and return a mask of
+    HSP_SETTINGS_CHANGED_* bits.  Lists are compared in order,  so a
+    reordering counts as a change (collectors are compared as a set
+    because DNS-SD tends to shuffle them).
+  */
+
+  static bool collectorEqual(HSPCollector *c1, HSPCollector *c2) {
+    return (SFLAddress_equal(&c1->ipAddr, &c2->ipAddr)
+	    && c1->udpPort == c2->udpPort
+	    && my_strequal(c1->namespace, c2->namespace)
+	    && my_strequal(c1->deviceName, c2->deviceName));
+  }
+
+  HSPCollector *findCollector(HSPSFlowSettings *settings, HSPCollector *coll) {
+    for(HSPCollector *cc = settings->collectors; cc; cc = cc->nxt)
+      if(collectorEqual(coll, cc))
+	return cc;
+    return NULL;
+  }
+
+  static bool collectorsEqual(HSPSFlowSettings *st1, HSPSFlowSettings *st2) {
+    if(st1->numCollectors != st2->numCollectors)
+      return NO;
+    for(HSPCollector *coll = st1->collectors; coll; coll = coll->nxt)
+      if(!findCollector(st2, coll))
+	return NO;
+    for(HSPCollector *coll = st2->collectors; coll; coll = coll->nxt)
+      if(!findCollector(st1, coll))
+	return NO;
+    return YES;
+  }
+
+  static bool applicationSettingsEqual(HSPSFlowSettings *st1, HSPSFlowSettings *st2) {
+    HSPApplicationSettings *a1 = st1->applicationSettings;
+    HSPApplicationSettings *a2 = st2->applicationSettings;
+    for(; a1 && a2; a1 = a1->nxt, a2 = a2->nxt) {
+      if(!my_strequal(a1->application, a2->application)
+	 || a1->got_sampling_n != a2->got_sampling_n
+	 || a1->sampling_n != a2->sampling_n
+	 || a1->got_polling_secs != a2->got_polling_secs
+	 || a1->polling_secs != a2->polling_secs)
+	return NO;
+    }
+    return (a1 == NULL && a2 == NULL);
+  }
+
+  // Per-application and per-speed sampling (sampling.<app>=N, sampling.10G=N)
+  // feed lookupPacketSamplingRate(), so a change there is a sampling change
+  // too. Compared as a set, since only the values matter here.
+  static bool applicationSamplingSubset(HSPSFlowSettings *st1, HSPSFlowSettings *st2) {
+    for(HSPApplicationSettings *a1 = st1->applicationSettings; a1; a1 = a1->nxt) {
+      if(!a1->got_sampling_n)
+	continue;
+      HSPApplicationSettings *a2 = st2->applicationSettings;
+      for(; a2; a2 = a2->nxt)
+	if(my_strequal(a1->application, a2->application))
+	  break;
+      if(a2 == NULL
+	 || !a2->got_sampling_n
+	 || a2->sampling_n != a1->sampling_n)
+	return NO;
+    }
+    return YES;
+  }
+
+  static bool applicationSamplingEqual(HSPSFlowSettings *st1, HSPSFlowSettings *st2) {
+    return (applicationSamplingSubset(st1, st2)
+	    && applicationSamplingSubset(st2, st1));
+  }
+
+  static bool agentCIDRsEqual(HSPSFlowSettings *st1, HSPSFlowSettings *st2) {
+    HSPCIDR *c1 = st1->agentCIDRs;
+    HSPCIDR *c2 = st2->agentCIDRs;
+    for(; c1 && c2; c1 = c1->nxt, c2 = c2->nxt) {
+      if(!SFLAddress_equal(&c1->ipAddr, &c2->ipAddr)
+	 || c1->maskBits != c2->maskBits)
+	return NO;
+    }
+    return (c1 == NULL && c2 == NULL);
+  }
+
+  uint32_t sFlowSettingsChanges(HSPSFlowSettings *prev, HSPSFlowSettings *next) {
+    if(prev == NULL || next == NULL)
+      return (prev == next) ? 0 : HSP_SETTINGS_CHANGED_ALL;
+    uint32_t changes = 0;
+    if(prev->samplingRate != next->samplingRate
+       || prev->samplingDirection != next->samplingDirection
+       || !applicationSamplingEqual(prev, next))
+      changes |= HSP_SETTINGS_CHANGED_SAMPLING;
+    if(prev->pollingInterval != next->pollingInterval)
+      changes |= HSP_SETTINGS_CHANGED_POLLING;
+    if(prev->headerBytes != next->headerBytes)
+      changes |= HSP_SETTINGS_CHANGED_HEADER;
+    if(prev->datagramBytes != next->datagramBytes)
+      changes |= HSP_SETTINGS_CHANGED_DATAGRAM;
+    if(!collectorsEqual(prev, next))
+      changes |= HSP_SETTINGS_CHANGED_COLLECTORS;
+    if(!SFLAddress_equal(&prev->agentIP, &next->agentIP)
+       || !my_strequal(prev->agentDevice, next->agentDevice)
+       || !agentCIDRsEqual(prev, next))
+      changes |= HSP_SETTINGS_CHANGED_AGENT;
+    if(!applicationSettingsEqual(prev, next))
+      changes |= HSP_SETTINGS_CHANGED_APPS;
+    return changes;
+  }
+
+  // decode the data passed with HSPEVENT_CONFIG_CHANGED
+  uint32_t sFlowSettingsChangeMask(void *data, size_t dataLen) {
+    if(data && dataLen == sizeof(uint32_t))
+      return *(uint32_t *)data;
+    return HSP_SETTINGS_CHANGED_ALL;
+  }
+
 
   /*_________________---------------------------__________________
     _________________   sFlowSettingsString     __________________
@@ -675,11 +879,131 @@ extern "C" {
     -----------------___________________________------------------
   */
 
+  /*_________________----------------------------__________________
+    _________________   application trie         __________________
+    -----------------____________________________------------------
+    The applicationSettings list is indexed by a trie of dotted name
+    components,  with the children of each node kept in a sorted
+    array so that a lookup is a binary search per component and
+    allocates nothing.  It is built just before a settings object is
+    installed (after which the settings are never modified),  and any
+    edit to the list before that discards it again.
+  */
+
+  typedef struct _HSPAppTrie {
+    char *label;
+    uint32_t label_len;
+    HSPApplicationSettings *appSettings;
+    struct _HSPAppTrie **children;
+    uint32_t n_children;
+  } HSPAppTrie;
+
+  static int appTrieCompare(char *s1, uint32_t len1, char *s2, uint32_t len2) {
+    int cmp = memcmp(s1, s2, (len1 < len2) ? len1 : len2);
+    if(cmp)
+      return cmp;
+    return (len1 < len2) ? -1 : ((len1 > len2) ? 1 : 0);
+  }
+
+  // binary search - returns the child,  or NULL with the insert point in *p_idx
+  static HSPAppTrie *appTrieChild(HSPAppTrie *node, char *label, uint32_t len, uint32_t *p_idx) {
+    uint32_t lo = 0, hi = node->n_children;
+    while(lo < hi) {
+      uint32_t mid = (lo + hi) / 2;
+      HSPAppTrie *child = node->children[mid];
+      int cmp = appTrieCompare(label, len, child->label, child->label_len);
+      if(cmp == 0)
+	return child;
+      if(cmp < 0)
+	hi = mid;
+      else
+	lo = mid + 1;
+    }
+    if(p_idx)
+      *p_idx = lo;
+    return NULL;
+  }
+
+  static void appTrieInsert(HSPAppTrie *root, HSPApplicationSettings *appSettings) {
+    HSPAppTrie *node = root;
+    char *p = appSettings->application;
+    for(;;) {
+      char *dot = strchr(p, '.');
+      uint32_t len = dot ? (dot - p) : my_strlen(p);
+      uint32_t idx = 0;
+      HSPAppTrie *child = appTrieChild(node, p, len, &idx);
+      if(child == NULL) {
+	child = (HSPAppTrie *)my_calloc(sizeof(HSPAppTrie));
+	child->label = p;  // points into appSettings->application
+	child->label_len = len;
+	node->children = (HSPAppTrie **)my_realloc(node->children, (node->n_children + 1) * sizeof(HSPAppTrie *));
+	memmove(&node->children[idx + 1], &node->children[idx], (node->n_children - idx) * sizeof(HSPAppTrie *));
+	node->children[idx] = child;
+	node->n_children++;
+      }
+      node = child;
+      if(dot == NULL)
+	break;
+      p = dot + 1;
+    }
+    node->appSettings = appSettings;
+  }
+
+  // walk the dotted components of str from node,  remembering the
+  // deepest settings seen.  Returns NULL if we fell off the trie.
+  static HSPAppTrie *appTrieDescend(HSPAppTrie *node, char *str, HSPApplicationSettings **p_deepest) {
+    char *p = str ?: "";
+    for(;;) {
+      char *dot = strchr(p, '.');
+      uint32_t len = dot ? (dot - p) : my_strlen(p);
+      node = appTrieChild(node, p, len, NULL);
+      if(node == NULL)
+	return NULL;
+      if(node->appSettings)
+	*p_deepest = node->appSettings;
+      if(dot == NULL)
+	return node;
+      p = dot + 1;
+    }
+  }
+
+  static void appTrieFree(HSPAppTrie *node) {
+    for(uint32_t ii = 0; ii < node->n_children; ii++)
+      appTrieFree(node->children[ii]);
+    if(node->children)
+      my_free(node->children);
+    my_free(node);
+  }
+
+  static void clearApplicationTrie(HSPSFlowSettings *settings) {
+    if(settings->appTrie) {
+      appTrieFree(settings->appTrie);
+      settings->appTrie = NULL;
+    }
+  }
+
+  void buildApplicationTrie(HSPSFlowSettings *settings) {
+    clearApplicationTrie(settings);
+    HSPAppTrie *root = (HSPAppTrie *)my_calloc(sizeof(HSPAppTrie));
+    for(HSPApplicationSettings *appSettings = settings->applicationSettings; appSettings; appSettings = appSettings->nxt) {
+      // an empty name never matched anything in the linear search either
+      if(my_strlen(appSettings->application))
+	appTrieInsert(root, appSettings);
+    }
+    settings->appTrie = root;
+  }
+
+  /*_________________----------------------------__________________
+    _________________   getApplicationSettings   __________________
+    -----------------____________________________------------------
+  */
+
   static HSPApplicationSettings *getApplicationSettings(HSPSFlowSettings *settings, char *app, bool create)
   {
     HSPApplicationSettings *appSettings = settings->applicationSettings;
     for(; appSettings; appSettings = appSettings->nxt) if(my_strequal(app, appSettings->application)) break;
     if(appSettings == NULL && create) {
+      clearApplicationTrie(settings);
       appSettings = (HSPApplicationSettings *)my_calloc(sizeof(HSPApplicationSettings));
       appSettings->application = my_strdup(app);
       appSettings->nxt = settings->applicationSettings;
@@ -695,6 +1019,7 @@ extern "C" {
 
   void clearApplicationSettings(HSPSFlowSettings *settings)
   {
+    clearApplicationTrie(settings);
     for(HSPApplicationSettings *appSettings = settings->applicationSettings; appSettings; ) {
       HSPApplicationSettings *nextAppSettings = appSettings->nxt;
       my_free(appSettings->application);
@@ -755,40 +1080,51 @@ extern "C" {
 
   int lookupApplicationSettings(HSPSFlowSettings *settings, char *prefix, char *app, uint32_t *p_sampling, uint32_t *p_polling)
   {
-    // in the config, the sFlow-APPLICATION settings should always start with sampling.app.<name> or polling.app.<name>
-    // so add the .app prefix here before we start searching...
-    char *search = app;
-    int search_len = my_strlen(app);
-    if(prefix) {
-      search_len = my_strlen(app) + my_strlen(prefix) + 1;
-      search = my_calloc(search_len + 1);
-      snprintf(search, search_len + 1, "%s.%s", prefix, app);
-    }
     // the top level settings are the defaults
     if(p_polling) *p_polling = settings->pollingInterval;
     if(p_sampling) *p_sampling = settings->samplingRate;
-    // now search for the deepest match
     HSPApplicationSettings *deepest = NULL;
-    uint32_t deepest_len = 0;
-    for(HSPApplicationSettings *appSettings = settings->applicationSettings; appSettings; appSettings = appSettings->nxt) {
-      int len = my_strlen(appSettings->application);
-      if(len > deepest_len
-	 && len <= search_len
-	 && my_strnequal(search, appSettings->application, len)) {
-	// has to be an exact match, or one that matches up to a '.'
-	if(len == search_len || search[len] == '.') {
-	  deepest = appSettings;
-	  deepest_len = len;
+
+    if(settings->appTrie) {
+      // in the config, the sFlow-APPLICATION settings should always start with
+      // sampling.app.<name> or polling.app.<name>,  so walk the prefix first.
+      HSPAppTrie *node = settings->appTrie;
+      if(prefix)
+	node = appTrieDescend(node, prefix, &deepest);
+      if(node)
+	appTrieDescend(node, app, &deepest);
+    }
+    else {
+      // not installed yet - search the list.
+      // Add the .app prefix here before we start searching...
+      char *search = app;
+      int search_len = my_strlen(app);
+      if(prefix) {
+	search_len = my_strlen(app) + my_strlen(prefix) + 1;
+	search = my_calloc(search_len + 1);
+	snprintf(search, search_len + 1, "%s.%s", prefix, app);
+      }
+      // now search for the deepest match
+      uint32_t deepest_len = 0;
+      for(HSPApplicationSettings *appSettings = settings->applicationSettings; appSettings; appSettings = appSettings->nxt) {
+	int len = my_strlen(appSettings->application);
+	if(len > deepest_len
+	   && len <= search_len
+	   && my_strnequal(search, appSettings->application, len)) {
+	  // has to be an exact match, or one that matches up to a '.'
+	  if(len == search_len || search[len] == '.') {
+	    deepest = appSettings;
+	    deepest_len = len;
+	  }
 	}
       }
-    }
-
-    if(prefix) {
-      my_free(search);
+      if(prefix) {
+	my_free(search);
+      }
     }
 
     if(deepest) {
-      if(p_polling && deepest->got_polling_secs) *p_sampling = deepest->polling_secs;
+      if(p_polling && deepest->got_polling_secs) *p_polling = deepest->polling_secs;
       if(p_sampling && deepest->got_sampling_n) *p_sampling = deepest->sampling_n;
       return YES;
     }
@@ -1260,6 +1596,18 @@ extern "C" {
 	    sp->nflog.nflog = YES;
 	    level[++depth] = HSPOBJ_NFLOG;
 	    break;
+	  case HSPTOKEN_PSAMPLE:
+	    if((tok = expectToken(sp, tok, HSPTOKEN_STARTOBJ)) == NULL) return NO;
+	    sp->psample.psample = YES;
+	    level[++depth] = HSPOBJ_PSAMPLE;
+	    break;
+	  case HSPTOKEN_DROPMON:
+	    if((tok = expectToken(sp, tok, HSPTOKEN_STARTOBJ)) == NULL) return NO;
+	    sp->dropmon.dropmon = YES;
+	    sp->dropmon.sw = YES;
+	    sp->dropmon.hw = YES;
+	    level[++depth] = HSPOBJ_DROPMON;
+	    break;
 	  case HSPTOKEN_PCAP:
 	    if((tok = expectToken(sp, tok, HSPTOKEN_STARTOBJ)) == NULL) return NO;
 	    sp->pcap.pcap = YES;
@@ -1316,6 +1664,17 @@ extern "C" {
 	    sp->eapi.eapi = YES;
 	    level[++depth] = HSPOBJ_EAPI;
 	    break;
+	  case HSPTOKEN_REPLAY:
+	    if((tok = expectToken(sp, tok, HSPTOKEN_STARTOBJ)) == NULL) return NO;
+	    sp->replay.replay = YES;
+	    sp->replay.loops = 1;
+	    level[++depth] = HSPOBJ_REPLAY;
+	    break;
+	  case HSPTOKEN_THREAD:
+	    if((tok = expectToken(sp, tok, HSPTOKEN_STARTOBJ)) == NULL) return NO;
+	    newThread(sp);
+	    level[++depth] = HSPOBJ_THREAD;
+	    break;
 	  case HSPTOKEN_SAMPLING:
 	  case HSPTOKEN_PACKETSAMPLINGRATE:
 	    if((tok = expectInteger32(sp, tok, &sp->sFlowSettings_file->samplingRate, 0, HSP_MAX_SAMPLING_N)) == NULL) return NO;
@@ -1377,6 +1736,12 @@ extern "C" {
 	  case HSPTOKEN_SAMPLINGDIRECTION:
 	    if((tok = expectDirection(sp, tok, &sp->sFlowSettings_file->samplingDirection)) == NULL) return NO;
 	    break;
+	  case HSPTOKEN_MAXSAMPLES:
+	    if((tok = expectInteger32(sp, tok, &sp->overload.maxSamples, 0, 0xFFFFFFFF)) == NULL) return NO;
+	    break;
+	  case HSPTOKEN_MAXPACKETCPU:
+	    if((tok = expectInteger32(sp, tok, &sp->overload.maxCPU, 0, 100)) == NULL) return NO;
+	    break;
 	  default:
 	    // handle wildcards here - allow sampling.<app>=<n> and polling.<app>=<secs>
 	    if(tok->str && strncasecmp(tok->str, "sampling.", 9) == 0) {
@@ -1569,9 +1934,87 @@ extern "C" {
 	  }
 	  break;
 
+	case HSPOBJ_THREAD:
+	  {
+	    HSPThread *th = sp->threads.threads;
+	    switch(tok->stok) {
+	    case HSPTOKEN_BUS:
+	      if((tok = expectDevice(sp, tok, &th->bus)) == NULL) return NO;
+	      break;
+	    case HSPTOKEN_CPUS:
+	      if((tok = expectCpuList(sp, tok, &th->cpus)) == NULL) return NO;
+	      break;
+	    case HSPTOKEN_NICE:
+	      if((tok = expectNice(sp, tok, &th->nice)) == NULL) return NO;
+	      th->nice_set = YES;
+	      break;
+	    case HSPTOKEN_SCHED:
+	      if((tok = expectSchedPolicy(sp, tok, &th->sched_policy)) == NULL) return NO;
+	      break;
+	    case HSPTOKEN_PRIORITY:
+	      if((tok = expectInteger32(sp, tok, &th->sched_priority, 1, 99)) == NULL) return NO;
+	      break;
+	    case HSPTOKEN_NUMA:
+	      if((tok = expectDevice(sp, tok, &th->numa)) == NULL) return NO;
+	      break;
+	    default:
+	      unexpectedToken(sp, tok, level[depth]);
+	      return NO;
+	      break;
+	    }
+	  }
+	  break;
+
+	case HSPOBJ_PSAMPLE:
+	  {
+	    switch(tok->stok) {
+	    case HSPTOKEN_GROUP:
+	      if((tok = expectInteger32(sp, tok, &sp->psample.group, 1, 0xFFFFFFFF)) == NULL) return NO;
+	      break;
+	    case HSPTOKEN_EGRESS:
+	      if((tok = expectONOFF(sp, tok, &sp->psample.egress)) == NULL) return NO;
+	      sp->psample.egress_set = YES;
+	      break;
+	    default:
+	      unexpectedToken(sp, tok, level[depth]);
+	      return NO;
+	      break;
+	    }
+	  }
+	  break;
+
+	case HSPOBJ_DROPMON:
+	  {
+	    switch(tok->stok) {
+	    case HSPTOKEN_LIMIT:
+	      if((tok = expectInteger32(sp, tok, &sp->dropmon.limit, 1, 10000)) == NULL) return NO;
+	      break;
+	    case HSPTOKEN_QUEUE:
+	      if((tok = expectInteger32(sp, tok, &sp->dropmon.queue, 1, 100000)) == NULL) return NO;
+	      break;
+	    case HSPTOKEN_SW:
+	      if((tok = expectONOFF(sp, tok, &sp->dropmon.sw)) == NULL) return NO;
+	      break;
+	    case HSPTOKEN_HW:
+	      if((tok = expectONOFF(sp, tok, &sp->dropmon.hw)) == NULL) return NO;
+	      break;
+	    default:
+	      unexpectedToken(sp, tok, level[depth]);
+	      return NO;
+	      break;
+	    }
+	  }
+	  break;
+
 	case HSPOBJ_TCP:
 	  {
 	    switch(tok->stok) {
+	    case HSPTOKEN_CACHESECS:
+	      if((tok = expectInteger32(sp, tok, &sp->tcp.cacheSecs, 0, 60)) == NULL) return NO;
+	      break;
+	    case HSPTOKEN_DUMPRATE:
+	      if((tok = expectInteger32(sp, tok, &sp->tcp.dumpRate, 0, 1000000)) == NULL) return NO;
+	      break;
 	    default:
 	      unexpectedToken(sp, tok, level[depth]);
 	      return NO;
@@ -1715,6 +2158,9 @@ extern "C" {
 	    case HSPTOKEN_CGROUP_TRAFFIC:
 	      if((tok = expectONOFF(sp, tok, &sp->systemd.markTraffic)) == NULL) return NO;
 	      break;
+	    case HSPTOKEN_COUNT_FDS:
+	      if((tok = expectInteger32(sp, tok, &sp->systemd.countFDs, 0, 3600)) == NULL) return NO;
+	      break;
 	    default:
 	      unexpectedToken(sp, tok, level[depth]);
 	      return NO;
@@ -1734,6 +2180,41 @@ extern "C" {
 	  }
 	  break;
 
+	case HSPOBJ_REPLAY:
+	  {
+	    switch(tok->stok) {
+	    case HSPTOKEN_FILE:
+	      if((tok = expectFile(sp, tok, &sp->replay.file)) == NULL) return NO;
+	      break;
+	    case HSPTOKEN_DEV:
+	      if((tok = expectDevice(sp, tok, &sp->replay.dev)) == NULL) return NO;
+	      break;
+	    case HSPTOKEN_INIFINDEX:
+	      if((tok = expectInteger32(sp, tok, &sp->replay.inIfIndex, 1, 0x3FFFFFFF)) == NULL) return NO;
+	      break;
+	    case HSPTOKEN_OUTIFINDEX:
+	      if((tok = expectInteger32(sp, tok, &sp->replay.outIfIndex, 1, 0x3FFFFFFF)) == NULL) return NO;
+	      break;
+	    case HSPTOKEN_SAMPLING:
+	      if((tok = expectInteger32(sp, tok, &sp->replay.samplingRate, 0, HSP_MAX_SAMPLING_N)) == NULL) return NO;
+	      break;
+	    case HSPTOKEN_PACE:
+	      if((tok = expectONOFF(sp, tok, &sp->replay.pace)) == NULL) return NO;
+	      break;
+	    case HSPTOKEN_LOOPS:
+	      if((tok = expectInteger32(sp, tok, &sp->replay.loops, 0, 0xFFFFFFFF)) == NULL) return NO;
+	      break;
+	    case HSPTOKEN_OUTPUT:
+	      if((tok = expectOutputFile(sp, tok, &sp->replay.output)) == NULL) return NO;
+	      break;
+	    default:
+	      unexpectedToken(sp, tok, level[depth]);
+	      return NO;
+	      break;
+	    }
+	  }
+	  break;
+
 	default:
 	  parseError(sp, tok, "unexpected state", "");
 	}
@@ -1765,6 +2246,12 @@ extern "C" {
       }
     }
 
+    if(sp->replay.replay
+       && sp->replay.file == NULL) {
+      myLog(LOG_ERR, "parse error in %s : replay {} needs file=", sp->configFile);
+      parseOK = NO;
+    }
+
     if(sp->ulog.probability > 0) {
       sp->ulog.samplingRate = (uint32_t)(1.0 / sp->ulog.probability);
     }
@@ -39,18 +39,106 @@ extern "C" {
     myLog(LOG_ERR, "sflow agent error: %s", msg);
   }
 
+  /*_________________---------------------------__________________
+    _________________     datagram sink         __________________
+    -----------------___________________________------------------
+    With replay { output=file } the datagrams are written to a pcap
+    file as UDP/IPv4 from 127.0.0.1 to port 6343 instead of going to
+    the collectors,  so a replay run needs no network and the result
+    can be read back with "sflowtool -r file".  Writes happen under
+    sync_receiver,  like the sendto() calls they replace.
+  */
+
+#define HSP_SINK_HDR_BYTES (16 + 14 + 20 + 8)
+
+  bool datagramSinkOpen(HSP *sp, char *path)
+  {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd < 0) {
+      myLog(LOG_ERR, "cannot open datagram sink %s : %s", path, strerror(errno));
+      return NO;
+    }
+    // pcap file header (native byte order, uS timestamps, ethernet)
+    uint32_t hdr[6] = { 0xa1b2c3d4, 0x00040002, 0, 0, 65535, 1 };
+    if(write(fd, hdr, sizeof(hdr)) != sizeof(hdr)) {
+      myLog(LOG_ERR, "datagram sink %s write failed : %s", path, strerror(errno));
+      close(fd);
+      return NO;
+    }
+    sp->datagramSinkFd = fd;
+    return YES;
+  }
+
+  static void datagramSink(HSP *sp, u_char *pkt, uint32_t pktLen)
+  {
+    u_char hdr[HSP_SINK_HDR_BYTES] = { 0 };
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    uint32_t frameLen = pktLen + HSP_SINK_HDR_BYTES - 16;
+    uint32_t rec[4] = { tv.tv_sec, tv.tv_usec, frameLen, frameLen };
+    memcpy(hdr, rec, 16);
+    u_char *eth = hdr + 16;
+    eth[12] = 0x08; // ethertype IPv4, MACs left as zero
+    u_char *ip = eth + 14;
+    uint16_t ipLen = pktLen + 28;
+    ip[0] = 0x45;
+    ip[2] = ipLen >> 8;
+    ip[3] = ipLen & 0xFF;
+    ip[8] = 64; // ttl
+    ip[9] = IPPROTO_UDP;
+    ip[12] = ip[16] = 127;
+    ip[15] = ip[19] = 1;
+    uint32_t csum = 0;
+    for(int ii = 0; ii < 20; ii += 2)
+      csum += (ip[ii] << 8) | ip[ii + 1];
+    while(csum >> 16)
+      csum = (csum & 0xFFFF) + (csum >> 16);
+    csum = ~csum & 0xFFFF;
+    ip[10] = csum >> 8;
+    ip[11] = csum & 0xFF;
+    u_char *udp = ip + 20;
+    uint16_t udpLen = pktLen + 8;
+    udp[0] = udp[2] = (SFL_DEFAULT_COLLECTOR_PORT >> 8);
+    udp[1] = udp[3] = (SFL_DEFAULT_COLLECTOR_PORT & 0xFF);
+    udp[4] = udpLen >> 8;
+    udp[5] = udpLen & 0xFF;
+    // udp checksum left as 0 (none)
+    struct iovec iov[2] = {
+      { .iov_base = hdr, .iov_len = HSP_SINK_HDR_BYTES },
+      { .iov_base = pkt, .iov_len = pktLen }
+    };
+    if(writev(sp->datagramSinkFd, iov, 2) != (HSP_SINK_HDR_BYTES + pktLen))
+      EVLog(60, LOG_ERR, "datagram sink write error: %s", strerror(errno));
+  }
+
   static void agentCB_sendPkt(void *magic, SFLAgent *agent, SFLReceiver *receiver, u_char *pkt, uint32_t pktLen)
   {
     HSP *sp = (HSP *)magic;
     // note that we are relying on any new settings being installed atomically from the DNS-SD
     // thread (it's just a pointer move,  so it should be atomic).  Otherwise we would want to
-    // grab sp->sync whenever we call sfl_sampler_writeFlowSample(),  because that can
+    // grab sp->sync_receiver whenever we call sfl_sampler_writeFlowSample(),  because that can
     // bring us here where we read the list of collectors.
 
     if(sp->sFlowSettings == NULL)
       return;
 
-    sp->telemetry[HSP_TELEMETRY_DATAGRAMS]++;
+    HSP_TELEMETRY_INC(HSP_TELEMETRY_DATAGRAMS);
+
+    if(__builtin_expect(!sp->firstSampleSent, 0)
+       && !__atomic_exchange_n(&sp->firstSampleSent, YES, __ATOMIC_RELAXED)) {
+      // report time-to-first-sample (mostly interface discovery)
+      struct timespec now;
+      EVClockMono(&now);
+      int64_t first_mS = ((now.tv_sec - sp->startTime.tv_sec) * 1000)
+	+ ((now.tv_nsec - sp->startTime.tv_nsec) / 1000000);
+      telemetrySet(sp->t_first_sample_mS, first_mS);
+      myLog(LOG_INFO, "first sFlow datagram sent %"PRId64" mS after startup", first_mS);
+    }
+
+    if(sp->datagramSinkFd > 0) {
+      datagramSink(sp, pkt, pktLen);
+      return;
+    }
 
     for(HSPCollector *coll = sp->sFlowSettings->collectors; coll; coll=coll->nxt) {
       if(coll->socklen && coll->socket > 0) {
@@ -88,6 +176,49 @@ extern "C" {
     return adaptor;
   }
 
+  HSPNIOEthtool *nioEthtool(HSPAdaptorNIO *nio) {
+    if(nio->et == NULL)
+      nio->et = (HSPNIOEthtool *)my_calloc(sizeof(HSPNIOEthtool));
+    return nio->et;
+  }
+
+  HSPNIOOptics *nioOptics(HSPAdaptorNIO *nio) {
+    if(nio->optics == NULL)
+      nio->optics = (HSPNIOOptics *)my_calloc(sizeof(HSPNIOOptics));
+    return nio->optics;
+  }
+
+  SFLLACP_counters *nioLACP(HSPAdaptorNIO *nio) {
+    if(nio->lacp == NULL)
+      nio->lacp = (SFLLACP_counters *)my_calloc(sizeof(SFLLACP_counters));
+    return nio->lacp;
+  }
+
+  HSPCountersCache *nioCountersCache(HSPAdaptorNIO *nio) {
+    if(nio->pn_cache == NULL)
+      nio->pn_cache = (HSPCountersCache *)my_calloc(sizeof(HSPCountersCache));
+    return nio->pn_cache;
+  }
+
+  // installed with adaptorSetFreeHook()
+  static void nioAdaptorFreeHook(SFLAdaptor *adaptor) {
+    HSPAdaptorNIO *nio = ADAPTOR_NIO(adaptor);
+    if(nio->et)
+      my_free(nio->et);
+    if(nio->optics) {
+      if(nio->optics->sfp.lanes)
+	my_free(nio->optics->sfp.lanes);
+      my_free(nio->optics);
+    }
+    if(nio->lacp)
+      my_free(nio->lacp);
+    if(nio->pn_cache) {
+      if(nio->pn_cache->xdr)
+	my_free(nio->pn_cache->xdr);
+      my_free(nio->pn_cache);
+    }
+  }
+
   void adaptorAddOrReplace(UTHash *ht, SFLAdaptor *ad) {
     SFLAdaptor *replaced = UTHashAdd(ht, ad);
     if(replaced && replaced != ad) {
@@ -119,7 +250,7 @@ extern "C" {
 
   SFLAdaptor *adaptorByPeerIndex(HSP *sp, uint32_t ifIndex) {
     SFLAdaptor ad = { .peer_ifIndex = ifIndex };
-    return UTHashGet(sp->adaptorsByPeerIndex, &ad);
+    return EVHashRCUGet(sp->adaptorsByPeerIndex, &ad);
   }
 
   SFLAdaptor *adaptorByIP(HSP *sp, SFLAddress *ip) {
@@ -132,6 +263,10 @@ extern "C" {
     return NULL;
   }
 
+  static void adaptorFreeCB(void *obj) {
+    adaptorFree((SFLAdaptor *)obj);
+  }
+
   static void deleteAdaptorFromHT(UTHash *ht, SFLAdaptor *ad, char *htname) {
     char buf[256];
     if(UTHashDel(ht, ad) != ad) {
@@ -145,10 +280,16 @@ extern "C" {
     deleteAdaptorFromHT(sp->adaptorsByName, ad, "byName");
     deleteAdaptorFromHT(sp->adaptorsByIndex, ad, "byIndex");
     deleteAdaptorFromHT(sp->adaptorsByMac, ad, "byMac");
-    if(ad->peer_ifIndex)
-      deleteAdaptorFromHT(sp->adaptorsByPeerIndex, ad, "byPeerIndex");
-    if(freeFlag)
-      adaptorFree(ad);
+    if(ad->peer_ifIndex) {
+      deleteAdaptorFromHT(sp->adaptorsByPeerIndex->master, ad, "byPeerIndex");
+      sp->adaptorsByPeerIndex->dirty = YES;
+      // must be unpublished before the free is scheduled
+      EVHashRCUPublish(sp->rootModule, sp->adaptorsByPeerIndex);
+    }
+    if(freeFlag) {
+      // another bus may have just looked it up
+      EVDeferFree(sp->rootModule, ad, adaptorFreeCB);
+    }
   }
 
   int deleteMarkedAdaptors(HSP *sp, UTHash *adaptorHT, int freeFlag) {
@@ -231,6 +372,69 @@ extern "C" {
     }
   }
 
+  /*_________________---------------------------__________________
+    _________________  encodeCountersCached     __________________
+    -----------------___________________________------------------
+    Swap a slow-changing counters block for its pre-encoded XDR.  The
+    encoding is redone when the caller's content hash differs,  or when
+    an interface or config event has bumped the cache generation.  Must
+    be called under sync_receiver, and only from the poll thread.
+    Blocks with no cheap content key (host-id, adaptor list) pass a
+    zero hash and use countersCacheHit() first to skip the read.
+  */
+
+  static bool countersCacheHit(HSP *sp, HSPCountersCache *cache, SFLCounters_sample_element *elem)
+  {
+    if(cache->len == 0
+       || cache->generation != sp->countersCacheGeneration)
+      return NO;
+    HSP_TELEMETRY_INC(sp->t_ctr_cache_hits);
+    elem->tag = SFLCOUNTERS_ENCODED;
+    elem->counterBlock.encoded.xdr = cache->xdr;
+    elem->counterBlock.encoded.len = cache->len;
+    return YES;
+  }
+
+  bool encodeCountersCached(HSP *sp, SFLPoller *poller, HSPCountersCache *cache, uint32_t hash, SFLCounters_sample_element *elem)
+  {
+    SFLReceiver *receiver = poller->myReceiver;
+    if(receiver == NULL)
+      return NO;
+    if(cache->hash == hash
+       && countersCacheHit(sp, cache, elem))
+      return YES;
+    HSP_TELEMETRY_INC(sp->t_ctr_cache_misses);
+    cache->len = 0;
+    for(;;) {
+      if(cache->capacity) {
+	int len = sfl_receiver_encodeCountersElement(receiver, elem, cache->xdr, cache->capacity);
+	if(len > 0) {
+	  cache->len = len;
+	  break;
+	}
+      }
+      if(cache->capacity >= HSP_COUNTERS_CACHE_MAX)
+	return NO; // too big (or unknown tag) - just send it as usual
+      // grow and try again
+      if(cache->xdr)
+	my_free(cache->xdr);
+      cache->capacity = cache->capacity ? (cache->capacity * 2) : HSP_COUNTERS_CACHE_MIN;
+      cache->xdr = (uint32_t *)my_calloc(cache->capacity);
+    }
+    cache->hash = hash;
+    cache->generation = sp->countersCacheGeneration;
+    elem->tag = SFLCOUNTERS_ENCODED;
+    elem->counterBlock.encoded.xdr = cache->xdr;
+    elem->counterBlock.encoded.len = cache->len;
+    return YES;
+  }
+
+  // interface or config change: re-encode everything on next use
+  static void evt_ctr_cache_flush(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    sp->countersCacheGeneration++;
+  }
+
   /*_________________---------------------------__________________
     _________________   agentCB_getCounters     __________________
     -----------------___________________________------------------
@@ -241,15 +445,20 @@ extern "C" {
     assert(poller->magic);
     HSP *sp = (HSP *)poller->magic;
 
-    // host ID
+    // host ID - only read again after the cache generation has
+    // moved on (see evt_ctr_cache_flush)
     SFLCounters_sample_element hidElem = { 0 };
-    hidElem.tag = SFLCOUNTERS_HOST_HID;
-    if(readHidCounters(sp,
-		       &hidElem.counterBlock.host_hid,
-		       sp->hostname,
-		       SFL_MAX_HOSTNAME_CHARS,
-		       sp->os_release,
-		       SFL_MAX_OSRELEASE_CHARS)) {
+    bool hidOK = countersCacheHit(sp, &sp->hidCache, &hidElem);
+    if(!hidOK) {
+      hidElem.tag = SFLCOUNTERS_HOST_HID;
+      hidOK = readHidCounters(sp,
+			      &hidElem.counterBlock.host_hid,
+			      sp->hostname,
+			      SFL_MAX_HOSTNAME_CHARS,
+			      sp->os_release,
+			      SFL_MAX_OSRELEASE_CHARS);
+    }
+    if(hidOK) {
       SFLADD_ELEMENT(cs, &hidElem);
     }
 
@@ -310,26 +519,36 @@ extern "C" {
     }
 
     SFLCounters_sample_element adaptorsElem = { 0 };
-    adaptorsElem.tag = SFLCOUNTERS_ADAPTORS;
     // collect list of host adaptors that are up, and have non-zero MACs, and
-    // have not been claimed by xen, kvm or docker.
+    // have not been claimed by xen, kvm or docker.  Again, only when the
+    // cache generation has moved on.
     SFLAdaptorList myAdaptors;
     SFLAdaptor *adaptors[HSP_MAX_PHYSICAL_ADAPTORS];
-    myAdaptors.adaptors = adaptors;
-    myAdaptors.capacity = HSP_MAX_PHYSICAL_ADAPTORS;
-    myAdaptors.num_adaptors = 0;
-    adaptorsElem.counterBlock.adaptors = host_adaptors(sp, &myAdaptors, HSP_MAX_PHYSICAL_ADAPTORS);
+    if(!countersCacheHit(sp, &sp->adaptorsCache, &adaptorsElem)) {
+      adaptorsElem.tag = SFLCOUNTERS_ADAPTORS;
+      myAdaptors.adaptors = adaptors;
+      myAdaptors.capacity = HSP_MAX_PHYSICAL_ADAPTORS;
+      myAdaptors.num_adaptors = 0;
+      adaptorsElem.counterBlock.adaptors = host_adaptors(sp, &myAdaptors, HSP_MAX_PHYSICAL_ADAPTORS);
+    }
     SFLADD_ELEMENT(cs, &adaptorsElem);
 
     // send the cs out to be annotated by other modules such as docker, xen, vrt and NVML
     EVEvent *evt_host_cs = EVGetEvent(sp->pollBus, HSPEVENT_HOST_COUNTER_SAMPLE);
     EVEventTx(sp->rootModule, evt_host_cs, &cs, sizeof(cs));
 
-    SEMLOCK_DO(sp->sync_agent) {
+    TIMEDLOCK_DO(sp->sync_receiver) {
+      // host-id and adaptor list rarely change - if they were read
+      // fresh above then encode them for the next poll to reuse
+      if(hidOK
+	 && hidElem.tag != SFLCOUNTERS_ENCODED)
+	encodeCountersCached(sp, poller, &sp->hidCache, 0, &hidElem);
+      if(adaptorsElem.tag != SFLCOUNTERS_ENCODED)
+	encodeCountersCached(sp, poller, &sp->adaptorsCache, 0, &adaptorsElem);
       sfl_poller_writeCountersSample(poller, cs);
       sp->counterSampleQueued = YES;
-      sp->telemetry[HSP_TELEMETRY_COUNTER_SAMPLES]++;
     }
+    HSP_TELEMETRY_INC(HSP_TELEMETRY_COUNTER_SAMPLES);
   }
 
   static void agentCB_getCounters_request(void *magic, SFLPoller *poller, SFL_COUNTERS_SAMPLE_TYPE *cs)
@@ -421,7 +640,7 @@ extern "C" {
 	SFLDataSource_instance dsi;
 	// ds_class = <virtualEntity>, ds_index = offset + <assigned>, ds_instance = 0
 	SFL_DS_SET(dsi, SFL_DSCLASS_LOGICAL_ENTITY, state->dsIndex, 0);
-	SEMLOCK_DO(sp->sync_agent) {
+	TIMEDLOCK_DO(sp->sync_pollers) {
 	  state->poller = sfl_agent_addPoller(sp->agent, &dsi, mod, getCountersFn);
 	  state->poller->userData = state;
 	  sfl_poller_set_sFlowCpInterval(state->poller, sp->actualPollingInterval);
@@ -449,7 +668,7 @@ extern "C" {
     }
     if(state->poller) {
       state->poller->userData = NULL;
-      SEMLOCK_DO(sp->sync_agent) {
+      TIMEDLOCK_DO(sp->sync_pollers) {
 	sfl_agent_removePoller(sp->agent, &state->poller->dsi);
       }
     }
@@ -478,11 +697,41 @@ extern "C" {
     UTTruncateOpenFile(sp->f_out);
   }
 
+  /*_________________---------------------------__________________
+    _________________    syncTelemetryFile      __________________
+    -----------------___________________________------------------
+    Telemetry has its own file under /var/run, refreshed every
+    HSP_TELEMETRY_OUTPUT_SECS,  so that the output file above is only
+    rewritten when the config revision changes.
+  */
+
+  static void outputTelemetryCB(void *magic, const char *name, uint64_t val) {
+    fprintf((FILE *)magic, "%s=%"PRIu64"\n", name, val);
+  }
+
+  static void syncTelemetryFile(HSP *sp) {
+    if(sp->f_telemetry == NULL)
+      return;
+    myDebug(2, "syncTelemetryFile");
+    rewind(sp->f_telemetry);
+    fprintf(sp->f_telemetry, "# WARNING: Do not edit this file. It is generated automatically by hsflowd.\n");
+    telemetryWalk(outputTelemetryCB, sp->f_telemetry);
+    fflush(sp->f_telemetry);
+    UTTruncateOpenFile(sp->f_telemetry);
+  }
+
   /*_________________---------------------------__________________
     _________________       tick                __________________
     -----------------___________________________------------------
   */
 
+  // EVClockMono() is too coarse for timing individual pollers
+  static uint64_t pollClock_uS(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+  }
+
   static void evt_poll_tick(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
     HSP *sp = (HSP *)EVROOTDATA(mod);
     time_t clk = evt->bus->now.tv_sec;
@@ -494,14 +743,16 @@ extern "C" {
     // to the samplers, pollers and receiver.  If the poller is
     // ready to poll counters it will pull it's callback, but
     // we are using that just to populate the poll actions list.
-    // That way we can relinquish the sync semaphore quickly.
-    // It is up to the poller's getCounters Fn to grab it again
-    // if and when it is required.  Same goes for the
-    // sync_receiver lock,  which is needed when the final
-    // counter sample is submitted for XDR serialization.
-    SEMLOCK_DO(sp->sync_agent) {
+    // That way we can relinquish the sync_pollers lock quickly.
+    // The poller's getCounters Fn only needs the sync_receiver
+    // lock,  when the final counter sample is submitted for XDR
+    // serialization,  so it does not hold up changes to the
+    // poller or sampler lists.
+    TIMEDLOCK_DO(sp->sync_receiver) {
       // update agent 'now' (also updated by packet samples):
       sfl_agent_set_now(sp->agent, clk, evt->bus->now.tv_nsec);
+    }
+    TIMEDLOCK_DO(sp->sync_pollers) {
       // only run the poller_tick()s here,  not the full agent_tick()
       // we'll call receiver_flush at the end of this tick/tock cycle,
       // and skip the sampler_tick() altogether.
@@ -514,13 +765,32 @@ extern "C" {
     // So we don't need to worry about them being freed under
     // our feet below.
 
-    // now we can execute them without holding on to the semaphore
+    // now we can execute them without holding on to the semaphore.
+    // Time each one so that levelPolling() can spread the load.
+    uint64_t tick_uS = 0;
     for(uint32_t ii = 0; ii < UTArrayN(sp->pollActions); ii += 2) {
       SFLPoller *poller = (SFLPoller *)UTArrayAt(sp->pollActions, ii);
       getCountersFn_t cb = (getCountersFn_t)UTArrayAt(sp->pollActions, ii+1);
       SFL_COUNTERS_SAMPLE_TYPE cs;
       memset(&cs, 0, sizeof(cs));
+      uint64_t start_uS = pollClock_uS();
       (cb)((void *)sp, poller, &cs);
+      uint32_t cost_uS = (uint32_t)(pollClock_uS() - start_uS) + 1; // never 0 once measured
+      // smooth it,  but let a sudden increase show up quickly
+      poller->cost_uS = (poller->cost_uS == 0 || cost_uS > poller->cost_uS)
+	? cost_uS
+	: ((poller->cost_uS * 3) + cost_uS) / 4;
+      tick_uS += cost_uS;
+    }
+    if(tick_uS)
+      telemetryObserve(sp->t_poll_tick_uS, tick_uS);
+
+    // rebalance the polling schedule now and then
+    if(clk >= sp->next_poll_level) {
+      if(sp->next_poll_level)
+	levelPolling(sp);
+      // give every poller a chance to be measured first
+      sp->next_poll_level = clk + HSP_POLL_LEVEL_SECS + sp->actualPollingInterval;
     }
 
     // possibly poll the nio counters to avoid 32-bit rollover
@@ -559,7 +829,7 @@ extern "C" {
       }
       myDebug(1, "agentAddressChanged=%s", agentAddressChanged ? "YES" : "NO");
       if(agentAddressChanged) {
-	SEMLOCK_DO(sp->sync_agent) {
+	TIMEDLOCK_DO(sp->sync_receiver) {
 	  sfl_agent_set_address(sp->agent, &sp->agentIP);
 	}
 	// this incs the revision No so it causes the
@@ -581,6 +851,11 @@ extern "C" {
       sp->outputRevisionNo = sp->revisionNo;
     }
 
+    if(clk >= sp->next_telemetry_output) {
+      syncTelemetryFile(sp);
+      sp->next_telemetry_output = clk + HSP_TELEMETRY_OUTPUT_SECS;
+    }
+
   }
 
   /*_________________---------------------------__________________
@@ -598,7 +873,7 @@ extern "C" {
   void flushCounters(EVMod *mod) {
     HSP *sp = (HSP *)EVROOTDATA(mod);
     if(sp->counterSampleQueued) {
-      SEMLOCK_DO(sp->sync_agent) {
+      TIMEDLOCK_DO(sp->sync_receiver) {
 	if(sp->counterSampleQueued) {
 	  sfl_receiver_flush(sp->agent->receivers);
 	  sp->counterSampleQueued = NO;
@@ -620,7 +895,7 @@ extern "C" {
     // cycle in evbus.c if we really need to be sure).  Delaying the flush to
     // here makes it more likely that counters will be flushed out promptly
     // when they are freshly read.
-    SEMLOCK_DO(sp->sync_agent) {
+    TIMEDLOCK_DO(sp->sync_receiver) {
       // note - this used to happen inside sfl_agent_tick(), but we
       // disaggregated that call so the pollers get their ticks first
       // and the receiver flush happens at the end.
@@ -629,17 +904,160 @@ extern "C" {
     }
   }
 
+  /*_________________---------------------------__________________
+    _________________     overload tock         __________________
+    -----------------___________________________------------------
+  */
+
+  static void evt_overload_tock(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    samplingOverloadTick(sp);
+  }
+
+  /*_________________---------------------------__________________
+    _________________     thread placement      __________________
+    -----------------___________________________------------------
+    thread { bus=<name> cpus=... nice=... sched=... priority=... numa=... }
+    is applied by the bus thread itself on EVEVENT_START.  That always
+    happens before evt_config_done() can drop root privileges, because
+    the config handshake waits for every bus to answer. numa=<node> or
+    numa=<device> sets a preferred memory node for the thread,  so the
+    buffers it allocates and touches (sample pools, socket buffers)
+    are local,  and also pins it to that node's cpus unless cpus= is
+    given too.
+  */
+
+#include <sys/syscall.h>
+#include <linux/mempolicy.h> // for MPOL_PREFERRED
+
+  static HSPThread *threadConfig(HSP *sp, char *busName) {
+    for(HSPThread *th = sp->threads.threads; th; th = th->nxt) {
+      if(my_strequal(th->bus, busName))
+	return th;
+    }
+    return NULL;
+  }
+
+  static int numaNode(char *numa) {
+    if(isdigit(numa[0]))
+      return strtol(numa, NULL, 10);
+    // follow the NIC
+    int node = -1;
+    char path[PATH_MAX];
+    snprintf(path, PATH_MAX, "/sys/class/net/%s/device/numa_node", numa);
+    FILE *f = fopen(path, "r");
+    if(f) {
+      if(fscanf(f, "%d", &node) != 1)
+	node = -1;
+      fclose(f);
+    }
+    return node;
+  }
+
+  static bool numaNodeCpus(int node, cpu_set_t *cpus) {
+    bool ok = NO;
+    char path[PATH_MAX];
+    snprintf(path, PATH_MAX, "/sys/devices/system/node/node%d/cpulist", node);
+    FILE *f = fopen(path, "r");
+    if(f) {
+      char line[1024]; // may be a long list on a big box
+      if(fgets(line, sizeof(line), f))
+	ok = parseCpuList(line, cpus);
+      fclose(f);
+    }
+    return ok;
+  }
+
+  static void evt_thread_start(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    EVBus *bus = EVCurrentBus();
+    HSPThread *th = threadConfig(sp, bus->name);
+    if(th == NULL)
+      return;
+
+    cpu_set_t *cpus = th->cpus;
+    cpu_set_t nodeCpus;
+    if(th->numa) {
+      int node = numaNode(th->numa);
+      unsigned long nodeMask = (node >= 0 && node < (8 * sizeof(nodeMask))) ? (1UL << node) : 0;
+      if(nodeMask == 0)
+	myLog(LOG_ERR, "thread %s: no NUMA node for numa=%s", bus->name, th->numa);
+      else {
+	if(syscall(SYS_set_mempolicy, MPOL_PREFERRED, &nodeMask, (8 * sizeof(nodeMask)) + 1) != 0)
+	  myLog(LOG_ERR, "thread %s: set_mempolicy(node=%d) failed : %s", bus->name, node, strerror(errno));
+	if(cpus == NULL
+	   && numaNodeCpus(node, &nodeCpus))
+	  cpus = &nodeCpus;
+	myDebug(1, "thread %s: memory on NUMA node %d", bus->name, node);
+      }
+    }
+
+    if(cpus) {
+      int err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), cpus);
+      if(err)
+	myLog(LOG_ERR, "thread %s: pthread_setaffinity_np() failed : %s", bus->name, strerror(err));
+      else
+	myDebug(1, "thread %s: pinned to %d cpu(s)", bus->name, CPU_COUNT(cpus));
+    }
+
+    if(th->sched_policy != SCHED_OTHER) {
+      struct sched_param param = { 0 };
+      if(th->sched_policy == SCHED_FIFO
+	 || th->sched_policy == SCHED_RR)
+	param.sched_priority = th->sched_priority ?: 1;
+      int err = pthread_setschedparam(pthread_self(), th->sched_policy, &param);
+      if(err)
+	myLog(LOG_ERR, "thread %s: pthread_setschedparam() failed : %s", bus->name, strerror(err));
+    }
+
+    if(th->nice_set) {
+      // on Linux the nice value is per-thread when given a tid
+      if(setpriority(PRIO_PROCESS, syscall(SYS_gettid), th->nice) != 0)
+	myLog(LOG_ERR, "thread %s: setpriority(%d) failed : %s", bus->name, th->nice, strerror(errno));
+    }
+  }
+
+  static void threadPlacementInit(HSP *sp) {
+    for(HSPThread *th = sp->threads.threads; th; th = th->nxt) {
+      EVBus *bus = th->bus ? EVGetBus(sp->rootModule, th->bus, NO) : NULL;
+      if(bus == NULL) {
+	myLog(LOG_ERR, "thread: no such bus \"%s\"", th->bus ?: "");
+	continue;
+      }
+      EVEventRx(sp->rootModule, EVGetEvent(bus, EVEVENT_START), evt_thread_start);
+    }
+  }
+
   /*_________________---------------------------__________________
     _________________     tock - all buses      __________________
     -----------------___________________________------------------
     this fn called on tock by all buses (all threads) so be careful!
   */
 
+  static __thread bool threadCPURegistered;
+  static __thread uint32_t t_thread_cpu_uS;
+  static __thread uint64_t threadCPULast_uS;
+
   static void evt_all_tock(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
 #ifdef UTHEAP
     // check for heap cleanup
     UTHeapGC();
 #endif
+    // CPU used by this thread, e.g. telemetry.thread_packet_cpu_uS
+    if(!threadCPURegistered) {
+      char name[64];
+      snprintf(name, sizeof(name), "thread_%s_cpu_uS", evt->bus->name);
+      t_thread_cpu_uS = telemetryRegister(name, HSPTELEMETRY_COUNTER);
+      threadCPURegistered = YES;
+    }
+    struct rusage ru;
+    if(getrusage(RUSAGE_THREAD, &ru) == 0) {
+      uint64_t cpu_uS = ((ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000LL)
+	+ ru.ru_utime.tv_usec
+	+ ru.ru_stime.tv_usec;
+      telemetryAdd(t_thread_cpu_uS, cpu_uS - threadCPULast_uS);
+      threadCPULast_uS = cpu_uS;
+    }
     // TODO: this would be a good place to test the memory footprint and
     // bail out if it looks like we are leaking memory(?)
   }
@@ -658,7 +1076,7 @@ extern "C" {
     // the point where the settings are about to go into effect
     // (installSFlowSettings()).
 
-    SEMLOCK_DO(sp->sync_agent) {
+    TIMEDLOCK_DO(sp->sync_receiver) {
       struct timespec ts;
       EVClockMono(&ts);
       time_t mono_now = ts.tv_sec;
@@ -698,6 +1116,7 @@ extern "C" {
   {
     sp->configFile = HSP_DEFAULT_CONFIGFILE;
     sp->outputFile = HSP_DEFAULT_OUTPUTFILE;
+    sp->telemetryFile = HSP_DEFAULT_TELEMETRYFILE;
     sp->pidFile = HSP_DEFAULT_PIDFILE;
     sp->crashFile = NULL;
     sp->daemonize = YES;
@@ -706,6 +1125,9 @@ extern "C" {
     sp->checkAdaptorListSecs = HSP_CHECK_ADAPTORS;
     sp->refreshVMListSecs = HSP_REFRESH_VMS;
     sp->forgetVMSecs = HSP_FORGET_VMS;
+    sp->tcp.cacheSecs = HSP_TCP_CACHE_SECS;
+    sp->tcp.dumpRate = HSP_TCP_DUMP_RATE;
+    sp->systemd.countFDs = HSP_SYSTEMD_COUNT_FDS;
     sp->modulesPath = STRINGIFY_DEF(HSP_MOD_DIR);
   }
 
@@ -723,7 +1145,8 @@ extern "C" {
              -P:  do not drop privileges (run as root)\n\
      -p PIDFile:  specify PID file (default is " HSP_DEFAULT_PIDFILE ")\n\
         -u UUID:  specify UUID as unique ID for this host\n\
-  -f CONFIGFile:  specify config file (default is " HSP_DEFAULT_CONFIGFILE ")\n\n\
+  -f CONFIGFile:  specify config file (default is " HSP_DEFAULT_CONFIGFILE ")\n\
+-t TELEMETRYFile:  specify telemetry file (default is " HSP_DEFAULT_TELEMETRYFILE ")\n\n\
    -c CRASHFile:  specify file to write crash info to (default is stderr)\n");
   fprintf(stderr, "=============== More Information ============================================\n");
   fprintf(stderr, "| sFlow standard        - http://www.sflow.org                              |\n");
@@ -741,7 +1164,7 @@ extern "C" {
   static void processCommandLine(HSP *sp, int argc, char *argv[])
   {
     int in;
-    while ((in = getopt(argc, argv, "dDvPp:f:o:u:m:?hc:")) != -1) {
+    while ((in = getopt(argc, argv, "dDvPp:f:o:t:u:m:?hc:")) != -1) {
       switch(in) {
       case 'v':
 	printf("%s version %s\n", argv[0], STRINGIFY_DEF(HSP_VERSION));
@@ -757,6 +1180,7 @@ extern "C" {
       case 'p': sp->pidFile = optarg; break;
       case 'f': sp->configFile = optarg; break;
       case 'o': sp->outputFile = optarg; break;
+      case 't': sp->telemetryFile = optarg; break;
       case 'c': sp->crashFile = optarg; break;
       case 'u':
 	if(parseUUID(optarg, sp->uuid) == NO) {
@@ -1061,11 +1485,64 @@ extern "C" {
     }
   }
 
+  // Take over any socket that the previous settings already have open
+  // to the same collector,  so that an unrelated change does not cost
+  // a close/reopen (or a namespace-switching thread) per collector.
+  static void adoptCollectorSockets(HSPSFlowSettings *prev, HSPSFlowSettings *settings) {
+    for(HSPCollector *coll = settings->collectors; coll; coll=coll->nxt) {
+      HSPCollector *prevColl = findCollector(prev, coll);
+      if(coll->socket <= 0
+	 && prevColl
+	 && prevColl->socket > 0) {
+	coll->socket = prevColl->socket;
+	coll->sendSocketAddr = prevColl->sendSocketAddr;
+	coll->socklen = prevColl->socklen;
+	coll->deviceIfIndex = prevColl->deviceIfIndex;
+      }
+    }
+  }
+
+  // Called after the switch,  so that a thread still sending with the
+  // old settings either uses the (still open) socket or skips it.
+  static void disownCollectorSockets(HSPSFlowSettings *prev, HSPSFlowSettings *settings) {
+    for(HSPCollector *coll = settings->collectors; coll; coll=coll->nxt) {
+      HSPCollector *prevColl = findCollector(prev, coll);
+      if(prevColl
+	 && prevColl->socket == coll->socket)
+	__atomic_store_n(&prevColl->socket, 0, __ATOMIC_RELAXED);
+    }
+  }
+
+  /*_________________---------------------------__________________
+    _________________   retired sFlowSettings   __________________
+    -----------------___________________________------------------
+    Other threads read sp->sFlowSettings without a lock (e.g. to send
+    a datagram),  so replaced settings are only freed after every bus
+    has answered the config handshake that was sent after the switch.
+    A bus only answers between events,  so by then no thread can still
+    be looking at them.  The file settings are never freed.
+  */
+
+  static void retireSFlowSettings(HSP *sp, HSPSFlowSettings *settings) {
+    UTArrayAdd(sp->sFlowSettings_retired, settings);
+  }
+
+  static void reclaimSFlowSettings(HSP *sp) {
+    HSPSFlowSettings *settings;
+    UTARRAY_WALK(sp->sFlowSettings_retired, settings) {
+      closeCollectorSockets(sp, settings);
+      if(settings != sp->sFlowSettings_file)
+	freeSFlowSettings(settings);
+    }
+    UTArrayReset(sp->sFlowSettings_retired);
+  }
+
   /*_________________---------------------------__________________
     _________________   installSFlowSettings    __________________
     -----------------___________________________------------------
 
-    Always increment the revision number whenever we change the sFlowSettings pointer
+    Always increment the revision number whenever we change the sFlowSettings pointer.
+    The HSPEVENT_CONFIG_CHANGED event carries the HSP_SETTINGS_CHANGED_* mask.
   */
 
   static bool installSFlowSettings(HSP *sp, HSPSFlowSettings *settings)
@@ -1086,16 +1563,42 @@ extern "C" {
     char *prev_settings_str = sp->sFlowSettings_str;
     HSPSFlowSettings *prev_settings = sp->sFlowSettings;
 
+    // what changed? If it is the same object then only our choice of
+    // agent address/device (which goes into the string) can have changed.
+    uint32_t changes = (prev_settings == settings)
+      ? HSP_SETTINGS_CHANGED_AGENT
+      : sFlowSettingsChanges(prev_settings, settings);
+    myDebug(1, "installSFlowSettings: changes=0x%x", changes);
+    if(changes & (HSP_SETTINGS_CHANGED_APPS
+		  | HSP_SETTINGS_CHANGED_SAMPLING
+		  | HSP_SETTINGS_CHANGED_POLLING))
+      sp->appSettingsRevisionNo++;
+    HSP_TELEMETRY_INC(sp->t_config_changes);
+    if(sp->config_shake_countdown == 0)
+      EVClockMono(&sp->sFlowSettings_changeStart);
+
     // install new settings
     sp->sFlowSettings_str = settingsStr;
     sp->revisionNo++;
     if(settings) {
+      // index the application settings for lookupApplicationSettings()
+      if(settings->appTrie == NULL)
+	buildApplicationTrie(settings);
       // open collector sockets before this goes live
+      if(prev_settings
+	 && prev_settings != settings)
+	adoptCollectorSockets(prev_settings, settings);
       openCollectorSockets(sp, settings);
     }
-    // atomic pointer-switch.  No need for lock.  At least
-    // not on the  platforms we expect to run on.
-    sp->sFlowSettings = settings;
+    // pointer-switch.  No need for lock.  Readers that still
+    // have the old pointer are protected by the deferred free.
+    __atomic_store_n(&sp->sFlowSettings, settings, __ATOMIC_RELEASE);
+    if(prev_settings
+       && prev_settings != settings) {
+      if(settings)
+	disownCollectorSockets(prev_settings, settings);
+      retireSFlowSettings(sp, prev_settings);
+    }
 
     // announce the change
     if(prev_settings_str == NULL) {
@@ -1109,26 +1612,23 @@ extern "C" {
     }
 
     myDebug(3, "installSFlowSettings: announcing config change");
-    EVEventTxAll(sp->rootModule, HSPEVENT_CONFIG_CHANGED, NULL, 0);
+    EVEventTxAll(sp->rootModule, HSPEVENT_CONFIG_CHANGED, &changes, sizeof(changes));
     // delay the config-done event until every thread has processed the
     // config change.  This is especially important the first time because
     // we are about to drop priviledges.  If we plow on and do that here
     // we will drop them before another module on another bus gets to
     // complete a privileged action, such as opening a pcap socket.
     // Use the handshake mechanism to get every bus to reply.
-    // Then we know we can proceed.
-    sp->config_shake_countdown = EVBusCount(sp->rootModule);
+    // Then we know we can proceed.  If another change comes in
+    // before that we wait for both.
+    sp->config_shake_countdown += EVBusCount(sp->rootModule);
     EVEventTxAll(sp->rootModule, EVEVENT_HANDSHAKE, HSPEVENT_CONFIG_SHAKE, strlen(HSPEVENT_CONFIG_SHAKE));
     // this now happens in evt_config_shake below...
     // EVEventTxAll(sp->rootModule, HSPEVENT_CONFIG_DONE, NULL, 0);
 
-    // cleanup
+    // cleanup (prev_settings are reclaimed in evt_config_shake)
     if(prev_settings_str)
       my_free(prev_settings_str);
-    if(prev_settings) {
-      closeCollectorSockets(sp, prev_settings);
-      freeSFlowSettings(prev_settings);
-    }
     return YES;
   }
 
@@ -1142,6 +1642,14 @@ extern "C" {
     myDebug(1, "evt_config_shake: reply from %s", (char *)data);
     if(--sp->config_shake_countdown == 0) {
       myDebug(1, "evt_config_shake: sync complete");
+      // time from the (first) change to every bus having seen it
+      struct timespec now;
+      EVClockMono(&now);
+      uint64_t change_uS = ((now.tv_sec - sp->sFlowSettings_changeStart.tv_sec) * 1000000)
+	+ ((now.tv_nsec - sp->sFlowSettings_changeStart.tv_nsec) / 1000);
+      telemetryObserve(sp->t_config_change_uS, change_uS);
+      // no thread can still be looking at the settings we replaced
+      reclaimSFlowSettings(sp);
       EVEventTxAll(sp->rootModule, HSPEVENT_CONFIG_DONE, NULL, 0);
     }
   }
@@ -1256,17 +1764,19 @@ extern "C" {
     myDebug(1, "main: evt_config_changed()");
 
     HSP *sp = (HSP *)EVROOTDATA(mod);
+    uint32_t changes = sFlowSettingsChangeMask(data, dataLen);
     if(sp->sFlowSettings
        && sp->sFlowSettings != sp->sFlowSettings_file) {
       // check for changes that we need to react to here:
 
       // agent address might have been overridden (e.g. by mod_eapi)
-      if(sp->sFlowSettings->agentIP.type
+      if((changes & HSP_SETTINGS_CHANGED_AGENT)
+	 && sp->sFlowSettings->agentIP.type
 	 && !SFLAddress_equal(&sp->sFlowSettings->agentIP, &sp->agentIP)) {
 	myDebug(1, "evt_config_changed:  change sFlow agent address");
 	sp->agentIP = sp->sFlowSettings->agentIP;
 	if(sp->agent) {
-	  SEMLOCK_DO(sp->sync_agent) {
+	  TIMEDLOCK_DO(sp->sync_receiver) {
 	    sfl_agent_set_address(sp->agent, &sp->agentIP);
 	  }
 	}
@@ -1458,7 +1968,7 @@ extern "C" {
 
     // did the polling interval change?
     if(updatePollingInterval(sp)) {
-      SEMLOCK_DO(sp->sync_agent) {
+      TIMEDLOCK_DO(sp->sync_pollers) {
 	for(SFLPoller *pl = sp->agent->pollers; pl; pl = pl->nxt) {
 	  sfl_poller_set_sFlowCpInterval(pl, sp->actualPollingInterval);
 	}
@@ -1665,6 +2175,10 @@ extern "C" {
       exit(EXIT_FAILURE);
     }
 
+    // telemetry is only informational,  so carry on without it
+    if((sp->f_telemetry = fopen(sp->telemetryFile, "w+")) == NULL)
+      myLog(LOG_ERR, "cannot open telemetry file %s : %s", sp->telemetryFile, strerror(errno));
+
     // open a file we can use to write a crash dump (if necessary)
     if(sp->crashFile) {
       // the file pointer needs to be a global so it is accessible
@@ -1686,18 +2200,43 @@ extern "C" {
 
     myLog(LOG_INFO, "started");
 
-    // semaphore to protect structure of sFlow agent (sampler and poller lists
-    // and XDR datagram encoding)
-    sp->sync_agent = (pthread_mutex_t *)my_calloc(sizeof(pthread_mutex_t));
-    pthread_mutex_init(sp->sync_agent, NULL);
+    // locks to protect the sFlow agent: poller list, sampler list and
+    // XDR datagram encoding are separate domains so that the packet
+    // thread writing flow samples does not wait for the poll thread's
+    // poller ticks (and vice-versa).
+    sp->sync_pollers = timedLockNew("pollers");
+    sp->sync_samplers = timedLockNew("samplers");
+    sp->sync_receiver = timedLockNew("receiver");
+
+    // config change telemetry,  and settings waiting to be freed
+    sp->t_config_changes = telemetryRegister("config_changes", HSPTELEMETRY_COUNTER);
+    sp->t_config_change_uS = telemetryRegister("config_change_uS", HSPTELEMETRY_HISTOGRAM);
+    sp->sFlowSettings_retired = UTArrayNew(UTARRAY_DFLT);
+
+    // startup and interface discovery telemetry
+    EVClockMono(&sp->startTime);
+    sp->t_first_sample_mS = telemetryRegister("first_sample_mS", HSPTELEMETRY_GAUGE);
+    sp->t_discovery_mS = telemetryRegister("discovery_mS", HSPTELEMETRY_GAUGE);
+    sp->t_ethtool_sset_hits = telemetryRegister("ethtool_sset_hits", HSPTELEMETRY_COUNTER);
+    sp->t_ethtool_sset_misses = telemetryRegister("ethtool_sset_misses", HSPTELEMETRY_COUNTER);
+    sp->t_ctr_cache_hits = telemetryRegister("ctr_cache_hits", HSPTELEMETRY_COUNTER);
+    sp->t_ctr_cache_misses = telemetryRegister("ctr_cache_misses", HSPTELEMETRY_COUNTER);
+
+    // poll-bus work per tick,  and polling schedule changes
+    sp->t_poll_tick_uS = telemetryRegister("poll_tick_uS", HSPTELEMETRY_HISTOGRAM);
+    sp->t_poll_level_moves = telemetryRegister("poll_level_moves", HSPTELEMETRY_COUNTER);
 
     // poll actions array
     sp->pollActions = UTArrayNew(UTARRAY_DFLT);
 
+    // every adaptor is an NIO adaptor,  so free the cold extensions too
+    adaptorSetFreeHook(nioAdaptorFreeHook);
+
     // allocate device tables - these ones need sync
     sp->adaptorsByName = UTHASH_NEW(SFLAdaptor, deviceName, UTHASH_SYNC | UTHASH_SKEY);
     sp->adaptorsByIndex = UTHASH_NEW(SFLAdaptor, ifIndex, UTHASH_SYNC);
-    sp->adaptorsByPeerIndex = UTHASH_NEW(SFLAdaptor, peer_ifIndex, UTHASH_SYNC);
+    // peer lookups come from the packet bus, so they get a published copy
+    sp->adaptorsByPeerIndex = EVHashRCUNew(UTHASH_NEW(SFLAdaptor, peer_ifIndex, UTHASH_DFLT));
     sp->adaptorsByMac = UTHASH_NEW(SFLAdaptor, macs[0], UTHASH_SYNC);
 
     // these ones do not need sync - always accessed from same thread
@@ -1864,6 +2403,10 @@ extern "C" {
       EVLoadModule(sp->rootModule, "mod_ulog", sp->modulesPath);
     if(sp->nflog.nflog)
       EVLoadModule(sp->rootModule, "mod_nflog", sp->modulesPath);
+    if(sp->psample.psample)
+      EVLoadModule(sp->rootModule, "mod_psample", sp->modulesPath);
+    if(sp->dropmon.dropmon)
+      EVLoadModule(sp->rootModule, "mod_dropmon", sp->modulesPath);
     if(sp->nvml.nvml)
       EVLoadModule(sp->rootModule, "mod_nvml", sp->modulesPath);
     if(sp->ovs.ovs)
@@ -1878,10 +2421,26 @@ extern "C" {
       EVLoadModule(sp->rootModule, "mod_systemd", sp->modulesPath);
     if(sp->eapi.eapi)
       EVLoadModule(sp->rootModule, "mod_eapi", sp->modulesPath);
+    if(sp->replay.replay)
+      EVLoadModule(sp->rootModule, "mod_replay", sp->modulesPath);
 
     EVEventRx(sp->rootModule, EVGetEvent(sp->pollBus, EVEVENT_TICK), evt_poll_tick);
     EVEventRx(sp->rootModule, EVGetEvent(sp->pollBus, EVEVENT_TOCK), evt_poll_tock);
 
+    // invalidate pre-encoded counter blocks (see encodeCountersCached())
+    EVEventRx(sp->rootModule, EVGetEvent(sp->pollBus, HSPEVENT_INTF_READ), evt_ctr_cache_flush);
+    EVEventRx(sp->rootModule, EVGetEvent(sp->pollBus, HSPEVENT_INTFS_CHANGED), evt_ctr_cache_flush);
+    EVEventRx(sp->rootModule, EVGetEvent(sp->pollBus, HSPEVENT_CONFIG_CHANGED), evt_ctr_cache_flush);
+
+    // module EEPROM reads get their own thread so I2C latency never
+    // holds up the pollBus
+    opticsInit(sp);
+
+    // overload control runs in the poll thread, which owns adaptorsByIndex,
+    // and measures the packet thread from there
+    if(sp->overload.maxSamples || sp->overload.maxCPU)
+      EVEventRx(sp->rootModule, EVGetEvent(sp->pollBus, EVEVENT_TOCK), evt_overload_tock);
+
     if(sp->DNSSD.DNSSD) {
       EVLoadModule(sp->rootModule, "mod_dnssd", sp->modulesPath);
       // DNS-SD will run in HSPBUS_CONFIG thread.  It will be responsible for
@@ -1907,6 +2466,9 @@ extern "C" {
     // have every thread call in every second
     EVEventRxAll(sp->rootModule, EVEVENT_TOCK, evt_all_tock);
 
+    // pin/prioritize bus threads as they start
+    threadPlacementInit(sp);
+
     // start all buses, with pollBus in this thread
     EVRun(sp->pollBus);
 
@@ -1920,6 +2482,8 @@ extern "C" {
       // shouldn't need to be root again to remove the pidFile
       // (i.e. we should still have execute permission on /var/run)
       remove(sp->pidFile);
+      if(sp->f_telemetry)
+	remove(sp->telemetryFile);
     }
 
     exit(exitStatus);
@@ -85,6 +85,7 @@ extern "C" {
 #define HSP_DEFAULT_PIDFILE "/var/run/hsflowd.pid"
 #define HSP_DEFAULT_CONFIGFILE "/etc/hsflowd.conf"
 #define HSP_DEFAULT_OUTPUTFILE "/etc/hsflowd.auto"
+#define HSP_DEFAULT_TELEMETRYFILE "/var/run/hsflowd.telemetry"
 #ifndef HSP_MOD_DIR
 #define HSP_MOD_DIR /etc/hsflowd/modules
 #endif
@@ -102,6 +103,15 @@ extern "C" {
 #define HSP_REFRESH_ADAPTORS 180
 #define HSP_CHECK_ADAPTORS 10
 
+// mod_tcp: reuse tcp_info answers for this long, and switch to
+// periodic bulk dumps above this many netlink queries per second
+#define HSP_TCP_CACHE_SECS 2
+#define HSP_TCP_DUMP_RATE 200
+
+// mod_systemd: secs between /proc/<pid>/fd counts.  1 means every
+// counter poll,  as it always was.  0 turns the count off.
+#define HSP_SYSTEMD_COUNT_FDS 1
+
 // set to 1 to allow agent.cidr setting in DNSSD TXT record.
 // This is currently considered out-of-scope for the DNSSD config,
 // so for now the agent.cidr setting is only allowed in hsflowd.conf.
@@ -138,6 +148,19 @@ extern "C" {
 #define HSP_SPEED_SAMPLING_RATIO 1000000
 #define HSP_SPEED_SAMPLING_MIN 100
 
+  // Overload control: when a flow-sample or CPU budget is exceeded
+  // the busiest samplers back off by powers of 2, and recover again
+  // after this many seconds below half the budget.
+#define HSP_OVERLOAD_MAX_BACKOFF 1024
+#define HSP_OVERLOAD_CALM_SECS 10
+#define HSP_OVERLOAD_MAX_DROP_PC 1
+
+  // Interface discovery: the ethtool GSTRINGS lookups are farmed out to
+  // this many threads when at least HSP_ETHTOOL_PARALLEL_MIN interfaces
+  // need them (e.g. at startup on a big switch or a host with many veths).
+#define HSP_ETHTOOL_THREADS 4
+#define HSP_ETHTOOL_PARALLEL_MIN 32
+
   typedef struct _HSPCollector {
     struct _HSPCollector *nxt;
     SFLAddress ipAddr;
@@ -161,6 +184,18 @@ extern "C" {
     bool speed_set;
   } HSPPcap;
 
+  // thread { bus=packet cpus=2-3 ... } placement for an event bus thread
+  typedef struct _HSPThread {
+    struct _HSPThread *nxt;
+    char *bus;
+    cpu_set_t *cpus; // NULL == leave it to the scheduler
+    int32_t nice;
+    bool nice_set;
+    int sched_policy; // SCHED_OTHER == leave it
+    uint32_t sched_priority;
+    char *numa; // node number, or device to follow
+  } HSPThread;
+
   typedef struct _HSPPort {
     struct _HSPPort *nxt;
     char *dev;
@@ -202,11 +237,26 @@ extern "C" {
 
 #define HSP_MAX_HEADER_BYTES 256
     HSPApplicationSettings *applicationSettings;
+    struct _HSPAppTrie *appTrie; // index of applicationSettings, see buildApplicationTrie()
     HSPCIDR *agentCIDRs;
     SFLAddress agentIP;
     char *agentDevice;
   } HSPSFlowSettings;
 
+  // Once installed, an HSPSFlowSettings object is never modified (other than
+  // handing its open collector sockets over to its successor) and is only
+  // freed after every bus has answered the config handshake that follows
+  // its replacement.  The HSPEVENT_CONFIG_CHANGED event carries a uint32_t
+  // mask of what changed, so handlers can skip work that is not affected.
+#define HSP_SETTINGS_CHANGED_SAMPLING   0x01
+#define HSP_SETTINGS_CHANGED_POLLING    0x02
+#define HSP_SETTINGS_CHANGED_HEADER     0x04
+#define HSP_SETTINGS_CHANGED_DATAGRAM   0x08
+#define HSP_SETTINGS_CHANGED_COLLECTORS 0x10
+#define HSP_SETTINGS_CHANGED_AGENT      0x20
+#define HSP_SETTINGS_CHANGED_APPS       0x40
+#define HSP_SETTINGS_CHANGED_ALL        0xFFFFFFFF
+
   // userData structure to store state for VM data-sources
   typedef enum {
     VMTYPE_UNDEFINED=0,
@@ -266,37 +316,12 @@ extern "C" {
 		 HSPDEV_OVS,
 		 HSPDEV_BRIDGE } EnumHSPDevType;
 
-  // cache nio counters per adaptor
-  typedef struct _HSPAdaptorNIO {
-    SFLAddress ipAddr;
-    uint32_t /*EnumIPSelectionPriority*/ ipPriority;
-    EnumHSPDevType devType;
-    bool up:1;
-    bool loopback:1;
-    bool bond_master:1;
-    bool bond_slave:1;
-    bool switchPort:1;
-    bool opxPort:1;
-    bool vm_or_container:1;
-    bool modinfo_tested:1;
-    bool ethtool_GDRVINFO:1;
-    bool ethtool_GMODULEINFO:1;
-    bool ethtool_GLINKSETTINGS:1;
-    bool ethtool_GSET:1;
-    bool ethtool_GSTATS:1;
-    bool procNetDev:1;
-    bool changed_speed:1;
-    int32_t vlan;
-#define HSP_VLAN_ALL -1
-    SFLHost_nio_counters nio;
-    SFLHost_nio_counters last_nio;
-    uint32_t last_bytes_in32;
-    uint32_t last_bytes_out32;
-#define HSP_MAX_NIO_DELTA32 0x7FFFFFFF
-#define HSP_MAX_NIO_DELTA64 (uint64_t)(1.0e13)
-    time_t last_update;
+  // Cold extensions of HSPAdaptorNIO.  Most interfaces on a container
+  // host (veth, tap...) never need these,  so they are only allocated
+  // on first use (see nioEthtool(), nioOptics() and nioLACP()) and are
+  // freed with the adaptor.
+  typedef struct _HSPNIOEthtool {
     uint32_t et_nctrs; // how many in total
-    ETCTRFlags et_found; // bitmask of the ones we wanted
     // offsets within the ethtool stats block
     uint8_t et_idx_mcasts_in;
     uint8_t et_idx_mcasts_out;
@@ -305,9 +330,11 @@ extern "C" {
     // latched counter for delta calculation
     HSP_ethtool_counters et_last;
     HSP_ethtool_counters et_total;
-    // SFP (optical) stats
-    // #define HSP_TEST_QSFP 1
-    // These definitions should eventually be in ethtool.h
+  } HSPNIOEthtool;
+
+  // SFP (optical) stats
+  // #define HSP_TEST_QSFP 1
+  // These definitions should eventually be in ethtool.h
 #ifndef ETH_MODULE_SFF_8472
 #define ETH_MODULE_SFF_8472 0x02
 #define ETH_MODULE_SFF_8472_LEN 512
@@ -316,11 +343,63 @@ extern "C" {
 #define ETH_MODULE_SFF_8436 0x03
 #define ETH_MODULE_SFF_8436_LEN 640
 #endif
+  typedef struct _HSPNIOOptics {
     uint32_t modinfo_type;
     uint32_t modinfo_len;
+    time_t next_read; // see requestOpticsRead()
     SFLSFP_counters sfp;
-    // LACP/bonding data
-    SFLLACP_counters lacp;
+  } HSPNIOOptics;
+  // EEPROM reads happen in their own thread (see readNioCounters.c)
+#define HSP_OPTICS_POLL_SECS 60
+#define HSP_OPTICS_ID_SECS 3600
+  typedef struct _HSPOpticsWorker HSPOpticsWorker;
+
+  // Pre-encoded XDR for a counters block that rarely changes (host-id,
+  // adaptor list, port name).  Reused while the content hash matches
+  // (always 0 for host-id and adaptor list) and no interface or config
+  // event has bumped the generation.
+  typedef struct _HSPCountersCache {
+    uint32_t hash;
+    uint32_t generation;
+    uint32_t len;       // bytes of XDR, including tag and length
+    uint32_t capacity;  // bytes allocated
+    uint32_t *xdr;
+  } HSPCountersCache;
+#define HSP_COUNTERS_CACHE_MIN 128
+#define HSP_COUNTERS_CACHE_MAX 4096
+
+  // cache nio counters per adaptor.  The fields used on every
+  // counter sweep come first so they share the leading cache lines.
+  typedef struct _HSPAdaptorNIO {
+    // hot: touched by every updateNioCounters() sweep
+    SFLHost_nio_counters nio;
+    SFLHost_nio_counters last_nio;
+    uint32_t last_bytes_in32;
+    uint32_t last_bytes_out32;
+#define HSP_MAX_NIO_DELTA32 0x7FFFFFFF
+#define HSP_MAX_NIO_DELTA64 (uint64_t)(1.0e13)
+    time_t last_update;
+    ETCTRFlags et_found; // bitmask of the ones we wanted
+    bool up:1;
+    bool loopback:1;
+    bool bond_master:1;
+    bool bond_slave:1;
+    bool switchPort:1;
+    bool opxPort:1;
+    bool vm_or_container:1;
+    bool modinfo_tested:1;
+    bool ethtool_GDRVINFO:1;
+    bool ethtool_GMODULEINFO:1;
+    bool ethtool_GLINKSETTINGS:1;
+    bool ethtool_GSET:1;
+    bool ethtool_GSTATS:1;
+    bool procNetDev:1;
+    bool changed_speed:1;
+    EnumHSPDevType devType;
+    int32_t vlan;
+#define HSP_VLAN_ALL -1
+    SFLAddress ipAddr;
+    uint32_t /*EnumIPSelectionPriority*/ ipPriority;
     // switch ports that are sending individual interface
     // counters will keep a pointer to their sflow poller.
     SFLPoller *poller;
@@ -329,11 +408,22 @@ extern "C" {
     uint32_t sampling_n;
     uint32_t sampling_n_set;
     uint32_t netlink_drops;
+    // overload control - see samplingOverloadTick()
+    uint32_t sampling_backoff; // factor requested (0 or 1 == none)
+    uint32_t sampling_backoff_upstream; // part applied by the source itself
+    uint32_t overload_samples; // samples offered (packet bus only)
+    uint32_t overload_samples_last; // overload_samples at start of interval
+    uint32_t overload_drops; // netlink_drops at start of interval
     // allow mod_xen to write regex-extracted fields here
     int xen_domid;
     int xen_netid;
     // allow mod_opx to write CPS entry ids here
     int opx_id;
+    // cold: allocated on demand
+    HSPNIOEthtool *et;        // ethtool stats mapping (when et_found)
+    HSPNIOOptics *optics;     // SFP module info and lane stats
+    SFLLACP_counters *lacp;   // LACP/bonding data
+    HSPCountersCache *pn_cache; // encoded port name
   } HSPAdaptorNIO;
 
   typedef struct _HSPDiskIO {
@@ -346,6 +436,7 @@ extern "C" {
 #define HSPBUS_POLL "poll" // main thread
 #define HSPBUS_CONFIG "config" // DNS-SD
 #define HSPBUS_PACKET "packet" // pcap,ulog,nflog,json,tcp packet processing
+#define HSPBUS_OPTICS "optics" // SFP/QSFP module EEPROM reads
 
 // The generic start,tick,tock,final,end events are defined in evbus.h
 #define HSPEVENT_HOST_COUNTER_SAMPLE "csample"   // (csample *) building counter-sample
@@ -361,6 +452,8 @@ extern "C" {
 #define HSPEVENT_INTF_SPEED "intf_speed"         // (adaptor *) interface speed change
 #define HSPEVENT_INTFS_CHANGED "intfs_changed"   // some interface(s) changed
 #define HSPEVENT_UPDATE_NIO "update_nio"         // (adaptor *) nio counter refresh
+#define HSPEVENT_OPTICS_READ "optics_read"       // (request) read module EEPROM
+#define HSPEVENT_OPTICS_READING "optics_reading" // (reading) module diagnostics
 
   typedef struct _HSPPendingSample {
     SFL_FLOW_SAMPLE_TYPE *fs;
@@ -392,16 +485,47 @@ extern "C" {
     HSP_TELEMETRY_NUM_COUNTERS
   } EnumHSPTelemetry;
 
-#ifdef HSP_TELEMETRY_NAMES
-  static const char *HSPTelemetryNames[] = {
-    "flow_samples",
-    "counter_samples",
-    "rtmetric_samples",
-    "rtflow_samples",
-    "datagrams",
-    "dropped_samples"
-  };
-#endif
+  // telemetry.c
+  // The counters above are pre-registered.  Modules can register
+  // more by name.  Updates never take a lock (see telemetry.c).
+#define HSP_TELEMETRY_MAX 128
+#define HSP_TELEMETRY_MAX_HISTOGRAMS 16
+#define HSP_TELEMETRY_HIST_BUCKETS 32
+#define HSP_TELEMETRY_NONE 0xFFFFFFFF
+#define HSP_TELEMETRY_OUTPUT_SECS 60
+
+  typedef enum {
+    HSPTELEMETRY_COUNTER=0,
+    HSPTELEMETRY_GAUGE,
+    HSPTELEMETRY_HISTOGRAM
+  } EnumHSPTelemetryType;
+
+  typedef void (*HSPTelemetryCB)(void *magic, const char *name, uint64_t val);
+
+  uint32_t telemetryRegister(const char *name, EnumHSPTelemetryType type);
+  void telemetryAdd(uint32_t id, uint64_t delta);
+  void telemetrySet(uint32_t id, int64_t val);
+  void telemetryObserve(uint32_t id, uint64_t val);
+  uint64_t telemetryGet(uint32_t id);
+  void telemetryWalk(HSPTelemetryCB cb, void *magic);
+  bool telemetryGetByName(const char *name, uint64_t *val);
+#define HSP_TELEMETRY_INC(id) telemetryAdd((id), 1)
+
+  // mutex that reports acquisitions, contention, wait time and
+  // hold time (nS) as telemetry "lock_<name>_..."
+  typedef struct _HSPTimedLock {
+    pthread_mutex_t mutex;
+    uint64_t acquired_nS; // only touched by the holder
+    uint32_t t_acquired;
+    uint32_t t_contended;
+    uint32_t t_wait;
+    uint32_t t_hold;
+  } HSPTimedLock;
+
+  HSPTimedLock *timedLockNew(const char *name);
+  int timedLockAcquire(HSPTimedLock *lk);
+  int timedLockRelease(HSPTimedLock *lk);
+#define TIMEDLOCK_DO(_lk) for(int DYNAMIC_LOCAL(_ctrl)=1; DYNAMIC_LOCAL(_ctrl) && timedLockAcquire(_lk); DYNAMIC_LOCAL(_ctrl)=0, timedLockRelease(_lk))
 
   typedef enum {
     HSP_VNODE_PRIORITY_SYSTEMD=1,
@@ -418,7 +542,11 @@ extern "C" {
 
     // agent
     SFLAgent *agent;
-    pthread_mutex_t *sync_agent;
+    // The agent is locked by domain.  If more than one is
+    // needed, take them in this order:
+    HSPTimedLock *sync_pollers;  // poller list and poller settings
+    HSPTimedLock *sync_samplers; // sampler list and sampler settings
+    HSPTimedLock *sync_receiver; // datagram encoding and flush, agent now/address
     // main host poller
     SFLPoller *poller;
     bool counterSampleQueued;
@@ -428,14 +556,30 @@ extern "C" {
     HSPSFlowSettings *sFlowSettings_dyn;
     HSPSFlowSettings *sFlowSettings;
     char *sFlowSettings_str;
+    UTArray *sFlowSettings_retired; // waiting for the config handshake
+    struct timespec sFlowSettings_changeStart;
+    uint32_t t_config_changes;
+    uint32_t t_config_change_uS;
 
     // resolve actual polling interval
     uint32_t syncPollingInterval;
     uint32_t minPollingInterval;
     uint32_t actualPollingInterval;
 
+    // spread measured poller cost evenly across the polling
+    // interval (see levelPolling() in readNioCounters.c)
+    time_t next_poll_level;
+#define HSP_POLL_LEVEL_SECS 300
+    uint32_t t_poll_tick_uS;
+    uint32_t t_poll_level_moves;
+
+    // SFP/QSFP EEPROM reads run in HSPBUS_OPTICS (see opticsInit())
+    EVEvent *opticsReadEvent;
+    HSPOpticsWorker *opticsWorker;
+
     // agent/agentIP config results
     uint32_t revisionNo;
+    uint32_t appSettingsRevisionNo; // only bumped when app settings may differ
     uint32_t subAgentId;
     char *agentDevice;
     SFLAddress agentIP;
@@ -478,6 +622,17 @@ extern "C" {
     struct {
       bool ovs;
     } ovs;
+    struct {
+      uint32_t maxSamples; // flow samples/sec budget (0=off)
+      uint32_t maxCPU; // packet thread CPU% budget (0=off)
+      uint64_t last_cpu_uS;
+      uint64_t last_wall_uS;
+      uint32_t calmSecs;
+    } overload;
+    struct {
+      HSPThread *threads;
+      uint32_t numThreads;
+    } threads;
     struct {
       bool opx;
       uint32_t port; // UDP port for hw samples
@@ -503,6 +658,20 @@ extern "C" {
       uint32_t samplingRate;
       uint32_t ds_options;
     } nflog;
+    struct {
+      bool psample;
+      uint32_t group;
+      bool egress;      // every sample is egress (or ingress if off)
+      bool egress_set;  // otherwise decided per-sample by out_ifindex
+      uint32_t ds_options;
+    } psample;
+    struct {
+      bool dropmon;
+      uint32_t limit; // discard events/sec
+      uint32_t queue; // kernel alert queue length
+      bool sw;
+      bool hw;
+    } dropmon;
     struct {
       bool pcap;
       HSPPcap *pcaps;
@@ -510,6 +679,8 @@ extern "C" {
     } pcap;
     struct {
       bool tcp;
+      uint32_t cacheSecs; // 0 = no cache
+      uint32_t dumpRate; // queries/sec before bulk dump (0 = never)
     } tcp;
     struct {
       bool dbus;
@@ -521,10 +692,23 @@ extern "C" {
       char *cgroup_procs;
       char *cgroup_acct;
       bool markTraffic;
+      uint32_t countFDs; // secs between fd counts (0 = off, default HSP_SYSTEMD_COUNT_FDS)
     } systemd;
     struct {
       bool eapi;
     } eapi;
+    struct {
+      bool replay;
+      char *file;
+      char *dev;
+      uint32_t inIfIndex;
+      uint32_t outIfIndex;
+      uint32_t samplingRate;
+      bool pace;
+      uint32_t loops; // 0 == forever
+      char *output;   // write datagrams here instead of to collectors
+    } replay;
+    int datagramSinkFd;
 
     // hardware sampling flag
     bool hardwareSampling;
@@ -537,7 +721,10 @@ extern "C" {
     bool daemonize;
     bool dropPriv;
     uint32_t outputRevisionNo;
+    char *telemetryFile;
+    time_t next_telemetry_output;
     FILE *f_out;
+    FILE *f_telemetry;
     char *crashFile;
     UTStringArray *retainRootReasons;
 
@@ -552,9 +739,24 @@ extern "C" {
     // interfaces and MACs
     UTHash *adaptorsByName; // global namespace only
     UTHash *adaptorsByIndex;
-    UTHash *adaptorsByPeerIndex;
+    EVHashRCU *adaptorsByPeerIndex; // looked up from packet bus
     UTHash *adaptorsByMac;
 
+    // interface discovery telemetry
+    struct timespec startTime;
+    bool firstSampleSent;
+    uint32_t t_first_sample_mS;
+    uint32_t t_discovery_mS;
+    uint32_t t_ethtool_sset_hits;
+    uint32_t t_ethtool_sset_misses;
+
+    // pre-encoded static counter blocks (see encodeCountersCached())
+    HSPCountersCache hidCache;
+    HSPCountersCache adaptorsCache;
+    uint32_t countersCacheGeneration;
+    uint32_t t_ctr_cache_hits;
+    uint32_t t_ctr_cache_misses;
+
     // poll actions for tick-tock cycle
     UTArray *pollActions;
 
@@ -598,15 +800,13 @@ extern "C" {
     UTHash *vmsByUUID;
     UTHash *vmsByDsIndex;
 
-    // local IP addresses
+    // local IP addresses - swapped whole and retired with EVDeferFree()
     UTHash *localIP;
     UTHash *localIP6;
 
     // handshake countdown
     int config_shake_countdown;
 
-    uint64_t telemetry[HSP_TELEMETRY_NUM_COUNTERS];
-
   } HSP;
 
   // expose some config parser fns
@@ -614,11 +814,13 @@ extern "C" {
   HSPSFlowSettings *newSFlowSettings(void);
   char *sFlowSettingsString(HSP *sp, HSPSFlowSettings *settings);
   HSPCollector *newCollector(HSPSFlowSettings *sFlowSettings);
+  HSPCollector *findCollector(HSPSFlowSettings *settings, HSPCollector *coll);
   void clearCollectors(HSPSFlowSettings *settings);
   void freeSFlowSettings(HSPSFlowSettings *sFlowSettings);
   void setApplicationSampling(HSPSFlowSettings *settings, char *app, uint32_t n);
   void setApplicationPolling(HSPSFlowSettings *settings, char *app, uint32_t secs);
   void clearApplicationSettings(HSPSFlowSettings *settings);
+  void buildApplicationTrie(HSPSFlowSettings *settings);
   int lookupApplicationSettings(HSPSFlowSettings *settings, char *prefix, char *app, uint32_t *p_sampling, uint32_t *p_polling);
   uint32_t lookupPacketSamplingRate(SFLAdaptor *adaptor, HSPSFlowSettings *settings);
   uint32_t agentAddressPriority(HSP *sp, SFLAddress *addr, int vlan, int loopback);
@@ -626,6 +828,8 @@ extern "C" {
   void addAgentCIDR(HSPSFlowSettings *settings, HSPCIDR *cidr, bool atEnd);
   void clearAgentCIDRs(HSPSFlowSettings *settings);
   void dynamic_config_line(HSPSFlowSettings *st, char *line);
+  uint32_t sFlowSettingsChanges(HSPSFlowSettings *prev, HSPSFlowSettings *next);
+  uint32_t sFlowSettingsChangeMask(void *data, size_t dataLen);
 
   // read functions
   bool detectInterfaceChange(HSP *sp);
@@ -641,6 +845,8 @@ extern "C" {
   void readBondState(HSP *sp);
   void syncPolling(HSP *sp);
   void syncBondPolling(HSP *sp);
+  void levelPolling(HSP *sp);
+  void opticsInit(HSP *sp);
   bool accumulateNioCounters(HSP *sp, SFLAdaptor *adaptor, SFLHost_nio_counters *ctrs, HSP_ethtool_counters *et_ctrs);
   void updateNioCounters(HSP *sp, SFLAdaptor *adaptor);
   int readHidCounters(HSP *sp, SFLHost_hid_counters *hid, char *hbuf, int hbufLen, char *rbuf, int rbufLen);
@@ -661,6 +867,11 @@ extern "C" {
   // adaptors
   SFLAdaptor *nioAdaptorNew(char *dev, u_char *macBytes, uint32_t ifIndex);
 #define ADAPTOR_NIO(ad) ((HSPAdaptorNIO *)(ad)->userData)
+  HSPNIOEthtool *nioEthtool(HSPAdaptorNIO *nio);
+  HSPNIOOptics *nioOptics(HSPAdaptorNIO *nio);
+  SFLLACP_counters *nioLACP(HSPAdaptorNIO *nio);
+  HSPCountersCache *nioCountersCache(HSPAdaptorNIO *nio);
+  bool encodeCountersCached(HSP *sp, SFLPoller *poller, HSPCountersCache *cache, uint32_t hash, SFLCounters_sample_element *elem);
   void adaptorAddOrReplace(UTHash *ht, SFLAdaptor *ad);
   SFLAdaptor *adaptorByName(HSP *sp, char *dev);
   SFLAdaptor *adaptorByMac(HSP *sp, SFLMacAddress *mac);
@@ -689,13 +900,16 @@ extern "C" {
 #define HSP_SAMPLEOPT_DIRN_HOOK   0x1000
 #define HSP_SAMPLEOPT_ASIC        0x2000
 #define HSP_SAMPLEOPT_OPX         0x4000
+#define HSP_SAMPLEOPT_PSAMPLE     0x8000
 
+  bool datagramSinkOpen(HSP *sp, char *path);
   void takeSample(HSP *sp, SFLAdaptor *ad_in, SFLAdaptor *ad_out, SFLAdaptor *ad_tap, uint32_t options, uint32_t hook, const u_char *mac_hdr, uint32_t mac_len, const u_char *cap_hdr, uint32_t cap_len, uint32_t pkt_len, uint32_t drops, uint32_t sampling_n);
   void *pendingSample_calloc(HSPPendingSample *ps, size_t len);
   void holdPendingSample(HSPPendingSample *ps);
   void releasePendingSample(HSP *sp, HSPPendingSample *ps);
   int decodePendingSample(HSPPendingSample *ps);
   SFLPoller *forceCounterPolling(HSP *sp, SFLAdaptor *adaptor);
+  void samplingOverloadTick(HSP *sp);
 
   // VM lifecycle
   HSPVMState *getVM(EVMod *mod, char *uuid, bool create, size_t objSize, EnumVMType vmType, getCountersFn_t getCountersFn);
@@ -0,0 +1,750 @@
+/* This software is distributed under the following license:
+ * http://sflow.net/license.html
+ */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+  // Microbenchmarks for the util.c primitives, EVSocketReadLines, UTSpawn
+  // and the sFlow encoder.
+  // Built with "make bench",  not installed.
+  //
+  //   ./hsflowd_bench [-r runs] [-t target_mS] [filter]
+  //
+  // Each benchmark is calibrated (which doubles as the warm-up) until
+  // one run of N ops takes at least target_mS,  then timed for the
+  // given number of runs.  The output is one JSON object per line:
+  // a header line describing the run,  then one line per benchmark
+  // with nS/op percentiles across the runs and,  where the kernel
+  // lets us open a cycle counter (perf_event_paranoid), cycles/op.
+  // Lines sort and diff cleanly between releases.
+
+#include "util.h"
+#include "evbus.h"
+#include "sflow_api.h"
+
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <sys/mman.h>
+#include <linux/perf_event.h>
+
+#define HSP_BENCH_RUNS 15
+#define HSP_BENCH_TARGET_MS 20
+#define HSP_BENCH_MAX_RUNS 1000
+#define HSP_BENCH_KEYS 1024
+#define HSP_BENCH_READLINES_BYTES (8 * 1024 * 1024)
+#define HSP_BENCH_SPAWN_CMD "/bin/true"
+#define HSP_BENCH_SPAWN_RSS (512 * 1024 * 1024)
+
+  typedef struct _HSPBench {
+    char *name;
+    void (*setup)(void);
+    void (*run)(uint64_t n);
+    void (*teardown)(void);
+  } HSPBench;
+
+  // results land here so the compiler cannot discard the work
+  static volatile uint64_t bench_sink;
+  static int perf_fd = -1;
+
+  /*_________________---------------------------__________________
+    _________________      timing               __________________
+    -----------------___________________________------------------
+  */
+
+  static uint64_t bench_nS(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+  }
+
+  static void cyclesOpen(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    perf_fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+
+  static void cyclesStart(void) {
+    if(perf_fd >= 0) {
+      ioctl(perf_fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  static uint64_t cyclesStop(void) {
+    uint64_t cycles = 0;
+    if(perf_fd >= 0) {
+      ioctl(perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+      if(read(perf_fd, &cycles, sizeof(cycles)) != sizeof(cycles))
+	cycles = 0;
+    }
+    return cycles;
+  }
+
+  static int cmp_double(const void *a, const void *b) {
+    double da = *(double *)a;
+    double db = *(double *)b;
+    return (da < db) ? -1 : (da > db) ? 1 : 0;
+  }
+
+  // nearest-rank percentile of a sorted array
+  static double percentile(double *sorted, int n, int pc) {
+    int rank = ((pc * n) + 99) / 100;
+    if(rank < 1) rank = 1;
+    return sorted[rank - 1];
+  }
+
+  /*_________________---------------------------__________________
+    _________________      UTHash               __________________
+    -----------------___________________________------------------
+  */
+
+  typedef struct _BenchObj {
+    uint32_t id;
+    char *name;
+    char mac[6];
+  } BenchObj;
+
+  static BenchObj bench_objs[HSP_BENCH_KEYS];
+  static UTHash *bench_hash;
+
+  static void objs_setup(void) {
+    for(int ii = 0; ii < HSP_BENCH_KEYS; ii++) {
+      char buf[32];
+      snprintf(buf, sizeof(buf), "eth%u.%u", ii / 16, ii % 16);
+      bench_objs[ii].id = (ii * 7919) + 1;
+      bench_objs[ii].name = my_strdup(buf);
+      memcpy(bench_objs[ii].mac, "\x02\x00\x00\x00", 4);
+      bench_objs[ii].mac[4] = ii >> 8;
+      bench_objs[ii].mac[5] = ii & 0xFF;
+    }
+  }
+
+  static void objs_teardown(void) {
+    if(bench_hash) {
+      UTHashFree(bench_hash);
+      bench_hash = NULL;
+    }
+    for(int ii = 0; ii < HSP_BENCH_KEYS; ii++)
+      my_free(bench_objs[ii].name);
+  }
+
+  static void hash_fill(void) {
+    for(int ii = 0; ii < HSP_BENCH_KEYS; ii++)
+      UTHashAdd(bench_hash, &bench_objs[ii]);
+  }
+
+  static void hash_int_setup(void) {
+    objs_setup();
+    bench_hash = UTHASH_NEW(BenchObj, id, UTHASH_DFLT);
+    hash_fill();
+  }
+
+  static void hash_str_setup(void) {
+    objs_setup();
+    bench_hash = UTHASH_NEW(BenchObj, name, UTHASH_SKEY);
+    hash_fill();
+  }
+
+  static void hash_mac_setup(void) {
+    objs_setup();
+    bench_hash = UTHASH_NEW(BenchObj, mac, UTHASH_DFLT);
+    hash_fill();
+  }
+
+  static void hash_get_run(uint64_t n) {
+    uint64_t found = 0;
+    for(uint64_t ii = 0; ii < n; ii++)
+      if(UTHashGet(bench_hash, &bench_objs[ii & (HSP_BENCH_KEYS - 1)]))
+	found++;
+    bench_sink += found;
+  }
+
+  static void hash_miss_run(uint64_t n) {
+    uint64_t found = 0;
+    BenchObj search = { 0 };
+    for(uint64_t ii = 0; ii < n; ii++) {
+      search.id = (ii * 7919) + 2;
+      if(UTHashGet(bench_hash, &search))
+	found++;
+    }
+    bench_sink += found;
+  }
+
+  static void hash_add_del_run(uint64_t n) {
+    for(uint64_t ii = 0; ii < n; ii++) {
+      BenchObj *obj = &bench_objs[ii & (HSP_BENCH_KEYS - 1)];
+      UTHashDel(bench_hash, obj);
+      UTHashAdd(bench_hash, obj);
+    }
+  }
+
+  /*_________________---------------------------__________________
+    _________________      UTArray              __________________
+    -----------------___________________________------------------
+  */
+
+  static UTArray *bench_array;
+
+  static void array_setup(void) {
+    objs_setup();
+    bench_array = UTArrayNew(UTARRAY_DFLT);
+  }
+
+  static void array_teardown(void) {
+    UTArrayFree(bench_array);
+    bench_array = NULL;
+    objs_teardown();
+  }
+
+  // one op = add 64 objects, walk them, reset
+  static void array_add_walk_run(uint64_t n) {
+    uint64_t sum = 0;
+    for(uint64_t ii = 0; ii < n; ii++) {
+      for(int jj = 0; jj < 64; jj++)
+	UTArrayAdd(bench_array, &bench_objs[jj]);
+      BenchObj *obj;
+      UTARRAY_WALK(bench_array, obj)
+	sum += obj->id;
+      UTArrayReset(bench_array);
+    }
+    bench_sink += sum;
+  }
+
+  /*_________________---------------------------__________________
+    _________________      UTStrBuf             __________________
+    -----------------___________________________------------------
+  */
+
+  static UTStrBuf *bench_strbuf;
+
+  static void strbuf_setup(void) {
+    bench_strbuf = UTStrBuf_new();
+  }
+
+  static void strbuf_teardown(void) {
+    UTStrBuf_free(bench_strbuf);
+    bench_strbuf = NULL;
+  }
+
+  static void strbuf_printf_run(uint64_t n) {
+    for(uint64_t ii = 0; ii < n; ii++) {
+      if((ii & 63) == 0)
+	UTStrBuf_reset(bench_strbuf);
+      UTStrBuf_printf(bench_strbuf, "{\"ifIndex\":%u,\"name\":\"%s\",\"octets\":%"PRIu64"}\n",
+		      (uint32_t)ii,
+		      "eth0",
+		      ii * 1500);
+    }
+    bench_sink += UTSTRBUF_LEN(bench_strbuf);
+  }
+
+  static void strbuf_append_run(uint64_t n) {
+    for(uint64_t ii = 0; ii < n; ii++) {
+      if((ii & 1023) == 0)
+	UTStrBuf_reset(bench_strbuf);
+      UTStrBuf_append(bench_strbuf, "Content-Type: application/json\r\n");
+    }
+    bench_sink += UTSTRBUF_LEN(bench_strbuf);
+  }
+
+  /*_________________---------------------------__________________
+    _________________      UTHeap               __________________
+    -----------------___________________________------------------
+  */
+
+  static void heap_fixed_run(uint64_t n) {
+    for(uint64_t ii = 0; ii < n; ii++) {
+      void *obj = my_calloc(64);
+      bench_sink += (uintptr_t)obj;
+      my_free(obj);
+    }
+  }
+
+  // sizes spread over the realms, with up to 64 live at a time
+  static void heap_mixed_run(uint64_t n) {
+    void *live[64] = { NULL };
+    uint32_t rnd = 12345;
+    for(uint64_t ii = 0; ii < n; ii++) {
+      rnd = (rnd * 1103515245) + 12345;
+      int slot = (rnd >> 8) & 63;
+      if(live[slot])
+	my_free(live[slot]);
+      live[slot] = my_calloc(16 << ((rnd >> 16) & 7));
+    }
+    for(int slot = 0; slot < 64; slot++)
+      if(live[slot])
+	my_free(live[slot]);
+  }
+
+  /*_________________---------------------------__________________
+    _________________      parseNextTok         __________________
+    -----------------___________________________------------------
+  */
+
+  static void parse_tok_run(uint64_t n) {
+    char buf[64];
+    uint64_t toks = 0;
+    for(uint64_t ii = 0; ii < n; ii++) {
+      char *p = "  collector { ip=10.0.0.1 udpport=6343 } \"quoted string\"";
+      while(parseNextTok(&p, " \t=", YES, '"', YES, buf, sizeof(buf)))
+	toks++;
+    }
+    bench_sink += toks;
+  }
+
+  /*_________________---------------------------__________________
+    _________________      SFLAddress           __________________
+    -----------------___________________________------------------
+  */
+
+  static void addr_cidr_run(uint64_t n) {
+    // writable: SFLAddress_parseCIDR() pokes a '\0' in temporarily
+    static char cidrs[4][20] = { "10.1.2.0/24", "192.168.0.0/16", "fe80::/10", "2001:db8::/32" };
+    uint64_t bits = 0;
+    for(uint64_t ii = 0; ii < n; ii++) {
+      SFLAddress addr, mask;
+      uint32_t maskBits;
+      if(SFLAddress_parseCIDR(cidrs[ii & 3], &addr, &mask, &maskBits))
+	bits += maskBits;
+    }
+    bench_sink += bits;
+  }
+
+  static void addr_maskequal_run(uint64_t n) {
+    SFLAddress addr, mask, test;
+    uint32_t maskBits;
+    char cidr[] = "10.1.2.0/24";
+    SFLAddress_parseCIDR(cidr, &addr, &mask, &maskBits);
+    test.type = SFLADDRESSTYPE_IP_V4;
+    uint64_t hits = 0;
+    for(uint64_t ii = 0; ii < n; ii++) {
+      test.address.ip_v4.addr = htonl(0x0A010000 + (ii & 0x3FF));
+      if(SFLAddress_maskEqual(&addr, &mask, &test))
+	hits++;
+      hits += SFLAddress_isLoopback(&test);
+    }
+    bench_sink += hits;
+  }
+
+  /*_________________---------------------------__________________
+    _________________   EVSocketReadLines       __________________
+    -----------------___________________________------------------
+    One op reads 8MB of lines through EVSocketReadLines(),  from an
+    in-memory file so that the disk does not come into it.  The
+    "_memmove" variants run the same input through the reader that
+    EVSocketReadLines() used to have (copy each line out,  then
+    memmove the rest of the buffer down) for comparison.
+  */
+
+  static EVMod *bench_evmod;
+  static EVBus *bench_evbus;
+  static int bench_memfd = -1;
+
+  static void readlines_setup(size_t lineLen) {
+    if(bench_evmod == NULL) {
+      bench_evmod = EVInit(NULL);
+      bench_evbus = EVGetBus(bench_evmod, "bench", YES);
+      EVCurrentBusSet(bench_evbus);
+    }
+    bench_memfd = memfd_create("hsflowd_bench", 0);
+    char *line = my_calloc(lineLen + 1);
+    memset(line, 'x', lineLen - 1);
+    line[lineLen - 1] = '\n';
+    for(size_t off = 0; off < HSP_BENCH_READLINES_BYTES; off += lineLen) {
+      if(write(bench_memfd, line, lineLen) != lineLen)
+	break;
+    }
+    my_free(line);
+  }
+
+  static void readlines_80_setup(void) {
+    readlines_setup(80);
+  }
+
+  static void readlines_1m_setup(void) {
+    readlines_setup(1024 * 1024);
+  }
+
+  static void readlines_teardown(void) {
+    close(bench_memfd);
+    bench_memfd = -1;
+  }
+
+  static void readlines_lineCB(EVMod *mod, EVSocket *sock, EnumEVSocketReadStatus status, void *magic) {
+    if(status == EVSOCKETREAD_STR)
+      bench_sink += sock->ioline_len;
+    else if(status != EVSOCKETREAD_AGAIN)
+      *(bool *)magic = YES;
+  }
+
+  static void readlines_run(uint64_t n) {
+    for(uint64_t ii = 0; ii < n; ii++) {
+      lseek(bench_memfd, 0, SEEK_SET);
+      EVSocket *sock = EVBusAddSocket(bench_evmod, bench_evbus, dup(bench_memfd), NULL, NULL);
+      bool done = NO;
+      while(!done)
+	EVSocketReadLines(bench_evmod, sock, readlines_lineCB, &done);
+      // closed at EOF - the bus loop would free it,  but it isn't running
+      UTStrBuf_free(sock->iobuf);
+      my_free(sock);
+      UTArrayReset(bench_evbus->sockets_del);
+    }
+  }
+
+  // the line reader as it was,  less the socket bookkeeping
+  static bool memmove_line(UTStrBuf *iobuf, UTStrBuf *ioline, size_t start) {
+    char *buf = UTSTRBUF_STR(iobuf);
+    size_t len = UTSTRBUF_LEN(iobuf);
+    for(int ii = start; ii < len; ii++) {
+      char ch = buf[ii];
+      if(ch == 10 || ch == 13 || ch == 0) {
+	if(ch == 10 || ch == 13) ii++; // CR or LF
+	if(ch == 13 && buf[ii] == 10) ii++; // CRLF
+	UTStrBuf_append_n(ioline, buf, ii);
+	UTStrBuf_snip_prefix(iobuf, ii);
+	return YES;
+      }
+    }
+    return NO;
+  }
+
+  static void readlines_memmove_run(uint64_t n) {
+    for(uint64_t ii = 0; ii < n; ii++) {
+      lseek(bench_memfd, 0, SEEK_SET);
+      UTStrBuf *iobuf = UTStrBuf_new();
+      UTStrBuf *ioline = UTStrBuf_new();
+      for(;;) {
+	UTStrBuf_need(iobuf, UTSTRBUF_LEN(iobuf) + EVSOCKETREADLINE_INCBYTES);
+	int cc = read(bench_memfd, UTSTRBUF_STR(iobuf) + UTSTRBUF_LEN(iobuf), EVSOCKETREADLINE_INCBYTES);
+	if(cc <= 0)
+	  break;
+	size_t start = UTSTRBUF_LEN(iobuf);
+	UTSTRBUF_LEN(iobuf) += cc;
+	while(memmove_line(iobuf, ioline, start)) {
+	  bench_sink += UTSTRBUF_LEN(ioline);
+	  UTStrBuf_reset(ioline); // as the callers did
+	  start = 0;
+	}
+      }
+      UTStrBuf_free(iobuf);
+      UTStrBuf_free(ioline);
+    }
+  }
+
+  /*_________________---------------------------__________________
+    _________________      UTSpawn              __________________
+    -----------------___________________________------------------
+    One op starts HSP_BENCH_SPAWN_CMD and waits for it,  the way
+    myExec() does.  The "_rss512m" variants first fault in 512MB so
+    that the parent looks like an hsflowd with mlockall() and a lot
+    of state,  and the "_fork" variants use the fork()+execv() that
+    UTSpawn() replaced for comparison:  fork() latency grows with the
+    size of the page tables it has to copy,  posix_spawn() does not.
+  */
+
+  static char *bench_rss;
+
+  static void spawn_rss_setup(void) {
+    bench_rss = mmap(NULL, HSP_BENCH_SPAWN_RSS, PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(bench_rss == MAP_FAILED) {
+      fprintf(stderr, "mmap(%u) failed : %s\n", HSP_BENCH_SPAWN_RSS, strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+    memset(bench_rss, 1, HSP_BENCH_SPAWN_RSS);
+  }
+
+  static void spawn_rss_teardown(void) {
+    munmap(bench_rss, HSP_BENCH_SPAWN_RSS);
+    bench_rss = NULL;
+  }
+
+  static void spawn_run(uint64_t n) {
+    char *cmd[] = { HSP_BENCH_SPAWN_CMD, NULL };
+    int devNull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    for(uint64_t ii = 0; ii < n; ii++) {
+      int status;
+      pid_t cpid = UTSpawn(cmd, devNull, devNull);
+      if(cpid > 0
+	 && waitpid(cpid, &status, 0) == cpid)
+	bench_sink += status;
+    }
+    close(devNull);
+  }
+
+  static void spawn_fork_run(uint64_t n) {
+    char *cmd[] = { HSP_BENCH_SPAWN_CMD, NULL };
+    int devNull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    for(uint64_t ii = 0; ii < n; ii++) {
+      int status;
+      pid_t cpid = fork();
+      if(cpid == 0) {
+	dup2(devNull, 1);
+	dup2(devNull, 2);
+	execv(cmd[0], cmd);
+	_exit(127);
+      }
+      if(cpid > 0
+	 && waitpid(cpid, &status, 0) == cpid)
+	bench_sink += status;
+    }
+    close(devNull);
+  }
+
+  /*_________________---------------------------__________________
+    _________________      sFlow encoder        __________________
+    -----------------___________________________------------------
+    The agent is set up as hsflowd does it,  but the send callback
+    only counts the datagrams.
+  */
+
+  static SFLAgent *bench_agent;
+  static SFLSampler *bench_sampler;
+  static SFLPoller *bench_poller;
+  static u_char bench_hdr[128];
+
+  static void *bench_agentCB_alloc(void *magic, SFLAgent *agent, size_t bytes) {
+    return my_calloc(bytes);
+  }
+
+  static int bench_agentCB_free(void *magic, SFLAgent *agent, void *obj) {
+    my_free(obj);
+    return 0;
+  }
+
+  static void bench_agentCB_error(void *magic, SFLAgent *agent, char *msg) {
+    fprintf(stderr, "sflow agent error: %s\n", msg);
+  }
+
+  static void bench_agentCB_sendPkt(void *magic, SFLAgent *agent, SFLReceiver *receiver, u_char *pkt, uint32_t pktLen) {
+    bench_sink += pktLen;
+  }
+
+  static void sflow_setup(void) {
+    SFLAddress agentIP = { .type = SFLADDRESSTYPE_IP_V4 };
+    agentIP.address.ip_v4.addr = htonl(0xC0000202);
+    bench_agent = (SFLAgent *)my_calloc(sizeof(SFLAgent));
+    sfl_agent_init(bench_agent,
+		   &agentIP,
+		   0,
+		   time(NULL),
+		   time(NULL),
+		   NULL,
+		   bench_agentCB_alloc,
+		   bench_agentCB_free,
+		   bench_agentCB_error,
+		   bench_agentCB_sendPkt);
+    SFLReceiver *receiver = sfl_agent_addReceiver(bench_agent);
+    sfl_receiver_set_sFlowRcvrOwner(receiver, "bench");
+    sfl_receiver_set_sFlowRcvrTimeout(receiver, 0xFFFFFFFF);
+    SFLDataSource_instance dsi;
+    SFL_DS_SET(dsi, 0, 2, 0);
+    bench_sampler = sfl_agent_addSampler(bench_agent, &dsi);
+    sfl_sampler_set_sFlowFsReceiver(bench_sampler, 1);
+    sfl_sampler_set_sFlowFsPacketSamplingRate(bench_sampler, 400);
+    bench_poller = sfl_agent_addPoller(bench_agent, &dsi, NULL, NULL);
+    sfl_poller_set_sFlowCpReceiver(bench_poller, 1);
+    for(int ii = 0; ii < sizeof(bench_hdr); ii++)
+      bench_hdr[ii] = ii;
+  }
+
+  static void sflow_teardown(void) {
+    sfl_agent_release(bench_agent);
+    my_free(bench_agent);
+    bench_agent = NULL;
+  }
+
+  static void sflow_flow_run(uint64_t n) {
+    for(uint64_t ii = 0; ii < n; ii++) {
+      SFL_FLOW_SAMPLE_TYPE fs = { 0 };
+      fs.input = 2;
+      fs.output = SFL_INTERNAL_INTERFACE;
+      SFLFlow_sample_element hdrElem = { 0 };
+      hdrElem.tag = SFLFLOW_HEADER;
+      hdrElem.flowType.header.header_protocol = SFLHEADER_ETHERNET_ISO8023;
+      hdrElem.flowType.header.frame_length = 1518;
+      hdrElem.flowType.header.stripped = 4;
+      hdrElem.flowType.header.header_length = sizeof(bench_hdr);
+      hdrElem.flowType.header.header_bytes = bench_hdr;
+      SFLADD_ELEMENT(&fs, &hdrElem);
+      sfl_sampler_writeFlowSample(bench_sampler, &fs);
+    }
+  }
+
+  static void sflow_counters_run(uint64_t n) {
+    for(uint64_t ii = 0; ii < n; ii++) {
+      SFL_COUNTERS_SAMPLE_TYPE cs = { 0 };
+      SFLCounters_sample_element ifElem = { 0 };
+      ifElem.tag = SFLCOUNTERS_GENERIC;
+      ifElem.counterBlock.generic.ifIndex = 2;
+      ifElem.counterBlock.generic.ifSpeed = 10000000000LL;
+      ifElem.counterBlock.generic.ifInOctets = ii * 1500;
+      ifElem.counterBlock.generic.ifOutOctets = ii * 1500;
+      SFLADD_ELEMENT(&cs, &ifElem);
+      SFLCounters_sample_element ethElem = { 0 };
+      ethElem.tag = SFLCOUNTERS_ETHERNET;
+      SFLADD_ELEMENT(&cs, &ethElem);
+      SFLCounters_sample_element cpuElem = { 0 };
+      cpuElem.tag = SFLCOUNTERS_HOST_CPU;
+      cpuElem.counterBlock.host_cpu.cpu_num = 8;
+      cpuElem.counterBlock.host_cpu.load_one = 0.5;
+      SFLADD_ELEMENT(&cs, &cpuElem);
+      sfl_poller_writeCountersSample(bench_poller, &cs);
+    }
+  }
+
+  /*_________________---------------------------__________________
+    _________________      bench table          __________________
+    -----------------___________________________------------------
+  */
+
+  static HSPBench benches[] = {
+    { "uthash_get_int", hash_int_setup, hash_get_run, objs_teardown },
+    { "uthash_miss_int", hash_int_setup, hash_miss_run, objs_teardown },
+    { "uthash_get_str", hash_str_setup, hash_get_run, objs_teardown },
+    { "uthash_get_mac", hash_mac_setup, hash_get_run, objs_teardown },
+    { "uthash_del_add_int", hash_int_setup, hash_add_del_run, objs_teardown },
+    { "utarray_add64_walk", array_setup, array_add_walk_run, array_teardown },
+    { "utstrbuf_printf", strbuf_setup, strbuf_printf_run, strbuf_teardown },
+    { "utstrbuf_append", strbuf_setup, strbuf_append_run, strbuf_teardown },
+    { "utheap_calloc_free_64", NULL, heap_fixed_run, NULL },
+    { "utheap_calloc_free_mixed", NULL, heap_mixed_run, NULL },
+    { "parsenexttok_line", NULL, parse_tok_run, NULL },
+    { "sfladdress_parsecidr", NULL, addr_cidr_run, NULL },
+    { "sfladdress_maskequal", NULL, addr_maskequal_run, NULL },
+    { "sfl_write_flow_sample", sflow_setup, sflow_flow_run, sflow_teardown },
+    { "sfl_write_counters_sample", sflow_setup, sflow_counters_run, sflow_teardown },
+    { "evsocket_readlines_8mb_80b", readlines_80_setup, readlines_run, readlines_teardown },
+    { "evsocket_readlines_8mb_80b_memmove", readlines_80_setup, readlines_memmove_run, readlines_teardown },
+    { "evsocket_readlines_8mb_1mb", readlines_1m_setup, readlines_run, readlines_teardown },
+    { "evsocket_readlines_8mb_1mb_memmove", readlines_1m_setup, readlines_memmove_run, readlines_teardown },
+    { "utspawn", NULL, spawn_run, NULL },
+    { "utspawn_fork", NULL, spawn_fork_run, NULL },
+    { "utspawn_rss512m", spawn_rss_setup, spawn_run, spawn_rss_teardown },
+    { "utspawn_rss512m_fork", spawn_rss_setup, spawn_fork_run, spawn_rss_teardown },
+  };
+
+  /*_________________---------------------------__________________
+    _________________      runBench             __________________
+    -----------------___________________________------------------
+  */
+
+  static void runBench(HSPBench *bench, int runs, uint64_t target_nS) {
+    if(bench->setup)
+      (*bench->setup)();
+
+    // calibrate: double the op count until one run meets the target.
+    // This also warms the caches, the branch predictors and the heap.
+    uint64_t n = 1;
+    for(;;) {
+      uint64_t t0 = bench_nS();
+      (*bench->run)(n);
+      uint64_t took = bench_nS() - t0;
+      if(took >= target_nS
+	 || n >= (1ULL << 40))
+	break;
+      n *= 2;
+    }
+
+    double nsop[HSP_BENCH_MAX_RUNS];
+    double cyop[HSP_BENCH_MAX_RUNS];
+    for(int rr = 0; rr < runs; rr++) {
+      cyclesStart();
+      uint64_t t0 = bench_nS();
+      (*bench->run)(n);
+      uint64_t took = bench_nS() - t0;
+      uint64_t cycles = cyclesStop();
+      nsop[rr] = (double)took / n;
+      cyop[rr] = (double)cycles / n;
+    }
+    qsort(nsop, runs, sizeof(double), cmp_double);
+    qsort(cyop, runs, sizeof(double), cmp_double);
+
+    printf("{\"bench\":\"%s\",\"ops\":%"PRIu64",\"runs\":%d,"
+	   "\"ns_min\":%.3f,\"ns_p50\":%.3f,\"ns_p90\":%.3f,\"ns_max\":%.3f",
+	   bench->name,
+	   n,
+	   runs,
+	   nsop[0],
+	   percentile(nsop, runs, 50),
+	   percentile(nsop, runs, 90),
+	   nsop[runs - 1]);
+    if(perf_fd >= 0)
+      printf(",\"cycles_p50\":%.2f", percentile(cyop, runs, 50));
+    printf("}\n");
+    fflush(stdout);
+
+    if(bench->teardown)
+      (*bench->teardown)();
+  }
+
+  /*_________________---------------------------__________________
+    _________________      main                 __________________
+    -----------------___________________________------------------
+  */
+
+  static void usage(char *cmd) {
+    fprintf(stderr, "usage: %s [-r runs] [-t target_mS] [filter]\n", cmd);
+    exit(EXIT_FAILURE);
+  }
+
+  int main(int argc, char *argv[]) {
+    int runs = HSP_BENCH_RUNS;
+    uint32_t target_mS = HSP_BENCH_TARGET_MS;
+    char *filter = NULL;
+    int opt;
+    while((opt = getopt(argc, argv, "r:t:h")) != -1) {
+      switch(opt) {
+      case 'r':
+	runs = atoi(optarg);
+	if(runs < 1 || runs > HSP_BENCH_MAX_RUNS)
+	  usage(argv[0]);
+	break;
+      case 't':
+	target_mS = atoi(optarg);
+	if(target_mS < 1)
+	  usage(argv[0]);
+	break;
+      default:
+	usage(argv[0]);
+      }
+    }
+    if(optind < argc)
+      filter = argv[optind];
+
+#ifdef UTHEAP
+    UTHeapInit();
+#endif
+    cyclesOpen();
+
+    struct utsname uts;
+    uname(&uts);
+    printf("{\"suite\":\"hsflowd\",\"version\":\"%s\",\"kernel\":\"%s\",\"machine\":\"%s\","
+	   "\"runs\":%d,\"target_ms\":%u,\"cycles\":%s}\n",
+	   STRINGIFY_DEF(HSP_VERSION),
+	   uts.release,
+	   uts.machine,
+	   runs,
+	   target_mS,
+	   perf_fd >= 0 ? "true" : "false");
+
+    for(int ii = 0; ii < (sizeof(benches) / sizeof(benches[0])); ii++) {
+      if(filter == NULL
+	 || strstr(benches[ii].name, filter))
+	runBench(&benches[ii], runs, (uint64_t)target_mS * 1000000);
+    }
+    return EXIT_SUCCESS;
+  }
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
@@ -0,0 +1,647 @@
+/* This software is distributed under the following license:
+ * http://sflow.net/license.html
+ */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+  // Tests for the helpers that talk to local services.  Built and run
+  // with "make test",  not installed.  Each test runs a stand-in
+  // server on a unix-domain socket in a thread of its own and drives
+  // the client from an event bus in the main thread,  the way the
+  // modules do.  Exits non-zero on failure.
+  //
+  //   ./hsflowd_test [filter]
+
+#include "hsflowd.h"
+#include "util_http.h"
+#include "cJSON.h"
+
+#include <sys/un.h>
+#include <poll.h>
+
+#define HSP_TEST_TIMEOUT_SECS 10
+#define HSP_TEST_MAX_CONNS 8
+
+  static int failures = 0;
+
+  static void check(bool ok, const char *what) {
+    printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+    if(!ok) failures++;
+  }
+
+  /*_________________---------------------------__________________
+    _________________    stand-in server        __________________
+    -----------------___________________________------------------
+    A poll() loop on a unix-domain socket.  Whenever a read completes
+    one or more requests,  as delimited by frameFn,  serveFn is called
+    for each of them in turn and whatever it appends to the output is
+    written in one go,  so pipelined requests get pipelined answers.
+    serveFn returns NO to have the connection closed once that output
+    has been written.
+  */
+
+  typedef struct _HSPTestConn {
+    int fd;
+    UTStrBuf *rx;
+    uint32_t requests;
+  } HSPTestConn;
+
+  typedef bool (*HSPTestServeFn)(HSPTestConn *conn, char *req, UTStrBuf *out);
+  // returns the bytes to consume for the first request in rx (0 if
+  // it is not complete yet),  and how many of them to pass to serveFn
+  typedef size_t (*HSPTestFrameFn)(UTStrBuf *rx, size_t *reqLen);
+
+  typedef struct _HSPTestServer {
+    char path[100];
+    int listenFd;
+    int stopFd[2];
+    pthread_t thread;
+    HSPTestFrameFn frameFn;
+    HSPTestServeFn serveFn;
+    // read by the test once the server has stopped
+    uint32_t accepts;
+    uint32_t hangups;
+    uint32_t maxRequestsPerConn;
+  } HSPTestServer;
+
+  static void serverClose(HSPTestConn *conn) {
+    close(conn->fd);
+    conn->fd = -1;
+    UTStrBuf_free(conn->rx);
+    conn->rx = NULL;
+  }
+
+  static bool serverRead(HSPTestServer *srv, HSPTestConn *conn) {
+    char buf[4096];
+    ssize_t cc = read(conn->fd, buf, sizeof(buf));
+    if(cc <= 0) {
+      srv->hangups++;
+      return NO;
+    }
+    UTStrBuf_append_n(conn->rx, buf, cc);
+    UTStrBuf *out = UTStrBuf_new();
+    bool keep = YES;
+    size_t frameLen, reqLen;
+    while(keep
+	  && (frameLen = (*srv->frameFn)(conn->rx, &reqLen)) != 0) {
+      char *req = my_calloc(reqLen + 1);
+      memcpy(req, UTSTRBUF_STR(conn->rx), reqLen);
+      UTStrBuf_snip_prefix(conn->rx, frameLen);
+      conn->requests++;
+      if(conn->requests > srv->maxRequestsPerConn)
+	srv->maxRequestsPerConn = conn->requests;
+      keep = (*srv->serveFn)(conn, req, out);
+      my_free(req);
+    }
+    if(UTSTRBUF_LEN(out)
+       && write(conn->fd, UTSTRBUF_STR(out), UTSTRBUF_LEN(out)) != UTSTRBUF_LEN(out))
+      keep = NO;
+    UTStrBuf_free(out);
+    return keep;
+  }
+
+  static void *serverRun(void *magic) {
+    HSPTestServer *srv = (HSPTestServer *)magic;
+    HSPTestConn conns[HSP_TEST_MAX_CONNS];
+    memset(conns, 0, sizeof(conns));
+    for(int cc = 0; cc < HSP_TEST_MAX_CONNS; cc++)
+      conns[cc].fd = -1;
+    for(;;) {
+      struct pollfd pfds[HSP_TEST_MAX_CONNS + 2];
+      pfds[0] = (struct pollfd){ .fd = srv->stopFd[0], .events = POLLIN };
+      pfds[1] = (struct pollfd){ .fd = srv->listenFd, .events = POLLIN };
+      for(int cc = 0; cc < HSP_TEST_MAX_CONNS; cc++)
+	pfds[cc + 2] = (struct pollfd){ .fd = conns[cc].fd, .events = POLLIN };
+      if(poll(pfds, HSP_TEST_MAX_CONNS + 2, 1000) < 0
+	 && errno != EINTR)
+	break;
+      if(pfds[0].revents)
+	break;
+      if(pfds[1].revents & POLLIN) {
+	int fd = accept(srv->listenFd, NULL, NULL);
+	for(int cc = 0; fd >= 0 && cc < HSP_TEST_MAX_CONNS; cc++) {
+	  if(conns[cc].fd == -1) {
+	    conns[cc].fd = fd;
+	    conns[cc].rx = UTStrBuf_new();
+	    conns[cc].requests = 0;
+	    srv->accepts++;
+	    fd = -1;
+	  }
+	}
+	if(fd >= 0)
+	  close(fd); // too many
+      }
+      for(int cc = 0; cc < HSP_TEST_MAX_CONNS; cc++) {
+	if(conns[cc].fd >= 0
+	   && pfds[cc + 2].revents
+	   && !serverRead(srv, &conns[cc]))
+	  serverClose(&conns[cc]);
+      }
+    }
+    for(int cc = 0; cc < HSP_TEST_MAX_CONNS; cc++) {
+      if(conns[cc].fd >= 0)
+	serverClose(&conns[cc]);
+    }
+    return NULL;
+  }
+
+  static void testPath(char *buf, size_t len, char *name) {
+    snprintf(buf, len, "/tmp/hsflowd_test_%s.%u", name, getpid());
+  }
+
+  static HSPTestServer *serverStart(char *path, HSPTestFrameFn frameFn, HSPTestServeFn serveFn) {
+    HSPTestServer *srv = (HSPTestServer *)my_calloc(sizeof(HSPTestServer));
+    snprintf(srv->path, sizeof(srv->path), "%s", path);
+    unlink(srv->path);
+    srv->frameFn = frameFn;
+    srv->serveFn = serveFn;
+    srv->listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    strncpy(addr.sun_path, srv->path, sizeof(addr.sun_path) - 1);
+    if(bind(srv->listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0
+       || listen(srv->listenFd, 16) != 0
+       || pipe(srv->stopFd) != 0) {
+      fprintf(stderr, "cannot start server on %s : %s\n", srv->path, strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+    pthread_create(&srv->thread, NULL, serverRun, srv);
+    return srv;
+  }
+
+  // the server's counters can be read after this,  then my_free(srv)
+  static void serverStop(HSPTestServer *srv) {
+    if(write(srv->stopFd[1], "x", 1) != 1)
+      fprintf(stderr, "server stop write failed : %s\n", strerror(errno));
+    pthread_join(srv->thread, NULL);
+    close(srv->stopFd[0]);
+    close(srv->stopFd[1]);
+    close(srv->listenFd);
+    unlink(srv->path);
+  }
+
+  /*_________________---------------------------__________________
+    _________________    test bus               __________________
+    -----------------___________________________------------------
+    Each test gets a fresh root and bus.  It starts its work on
+    EVEVENT_START and calls testDone() when it has seen everything
+    it was waiting for.  A test that hangs is stopped by the tick.
+    The bus is the poll bus,  so that modules loaded by a test find
+    it,  and rootData stands in for the HSP they expect at the root.
+  */
+
+  typedef struct _HSPTest {
+    char *name;
+    EVActionCB start;
+    void *rootData;
+  } HSPTest;
+
+  static EVBus *testBus;
+  static uint32_t testTicks;
+  static bool testFinished;
+
+  static void testDone(EVMod *mod) {
+    testFinished = YES;
+    EVBusStop(testBus);
+  }
+
+  static void evt_test_tick(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    if(++testTicks >= HSP_TEST_TIMEOUT_SECS)
+      EVBusStop(testBus);
+  }
+
+  static void runTest(HSPTest *test) {
+    EVMod *mod = EVInit(test->rootData);
+    testBus = EVGetBus(mod, HSPBUS_POLL, YES);
+    testTicks = 0;
+    testFinished = NO;
+    EVEventRx(mod, EVGetEvent(testBus, EVEVENT_START), test->start);
+    EVEventRx(mod, EVGetEvent(testBus, EVEVENT_TICK), evt_test_tick);
+    EVBusRun(testBus);
+    char what[128];
+    snprintf(what, sizeof(what), "%s finished within %u secs", test->name, HSP_TEST_TIMEOUT_SECS);
+    check(testFinished, what);
+  }
+
+  /*_________________---------------------------__________________
+    _________________    util_http              __________________
+    -----------------___________________________------------------
+    The server answers by path:
+      /chunked   - chunked body,  written a few bytes at a time
+      /len/TEXT  - Content-Length body TEXT
+      /drop      - close without answering the first time it is seen
+      /cut       - promise 100 bytes,  send 5,  then close
+  */
+
+#define HSP_TEST_CHUNKED_BODY "hello, chunked world"
+
+  static size_t httpFrame(UTStrBuf *rx, size_t *reqLen) {
+    char *end = strstr(UTSTRBUF_STR(rx), "\r\n\r\n");
+    if(end == NULL)
+      return 0;
+    *reqLen = end - UTSTRBUF_STR(rx);
+    return *reqLen + 4;
+  }
+
+  static bool httpDropped;
+
+  static bool httpServe(HSPTestConn *conn, char *head, UTStrBuf *out) {
+    char path[256] = "";
+    sscanf(head, "GET %255s HTTP/1.1", path);
+    if(!strcmp(path, "/chunked")) {
+      // chunk extension, two chunks, a trailer.  Sent in pieces so
+      // that the parser sees partial lines and partial chunks.
+      char *rsp = "HTTP/1.1 200 OK\r\n"
+	"Transfer-Encoding: chunked\r\n"
+	"\r\n"
+	"7;ext=1\r\nhello, \r\n"
+	"d\r\nchunked world\r\n"
+	"0\r\n"
+	"X-Trailer: yes\r\n"
+	"\r\n";
+      for(size_t off = 0, len = strlen(rsp); off < len; off += 3) {
+	size_t n = (len - off) < 3 ? (len - off) : 3;
+	if(write(conn->fd, rsp + off, n) != n)
+	  return NO;
+	usleep(1000);
+      }
+      return YES;
+    }
+    if(!strncmp(path, "/len/", 5)) {
+      char *body = path + 5;
+      UTStrBuf_printf(out, "HTTP/1.1 200 OK\r\nContent-Length: %u\r\n\r\n%s", (uint32_t)strlen(body), body);
+      return YES;
+    }
+    if(!strcmp(path, "/drop")) {
+      if(!httpDropped) {
+	httpDropped = YES;
+	return NO;
+      }
+      UTStrBuf_printf(out, "HTTP/1.1 200 OK\r\nContent-Length: 7\r\n\r\nretried");
+      return YES;
+    }
+    if(!strcmp(path, "/cut")) {
+      UTStrBuf_printf(out, "HTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\nshort");
+      return NO;
+    }
+    UTStrBuf_printf(out, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+    return YES;
+  }
+
+  typedef struct _HSPHttpResult {
+    EnumUTHTTPStatus status;
+    int httpStatus;
+    uint32_t retries;
+    char *body;
+    uint32_t order;
+  } HSPHttpResult;
+
+  static HSPTestServer *httpServer;
+  static UTHTTPClient *httpClient;
+  static HSPHttpResult httpResults[8];
+  static uint32_t httpExpect;
+  static uint32_t httpSeen;
+
+  static void httpCB(EVMod *mod, UTHTTPRequest *req, EnumUTHTTPStatus status) {
+    HSPHttpResult *res = &httpResults[(intptr_t)req->magic];
+    res->status = status;
+    res->httpStatus = req->httpStatus;
+    res->retries = req->retries;
+    res->body = my_strdup(UTSTRBUF_STR(req->body));
+    res->order = httpSeen++;
+    if(httpSeen == httpExpect)
+      testDone(mod);
+  }
+
+  static void httpSend(char *path, intptr_t id) {
+    UTHTTPSend(httpClient, UTHTTPRequestNew("GET", path, httpCB, (void *)id));
+  }
+
+  static void httpReset(uint32_t expect) {
+    for(int ii = 0; ii < 8; ii++) {
+      if(httpResults[ii].body)
+	my_free(httpResults[ii].body);
+    }
+    memset(httpResults, 0, sizeof(httpResults));
+    httpExpect = expect;
+    httpSeen = 0;
+    httpDropped = NO;
+  }
+
+  static void http_chunked_start(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    httpReset(1);
+    httpClient = UTHTTPClientNew(mod, testBus, httpServer->path, "test", 1, 4);
+    httpSend("/chunked", 0);
+  }
+
+  static void http_pipeline_start(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    httpReset(3);
+    httpClient = UTHTTPClientNew(mod, testBus, httpServer->path, "test", 1, 4);
+    httpSend("/len/a", 0);
+    httpSend("/len/bb", 1);
+    httpSend("/len/ccc", 2);
+  }
+
+  static void http_retry_start(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    httpReset(2);
+    httpClient = UTHTTPClientNew(mod, testBus, httpServer->path, "test", 1, 4);
+    httpSend("/drop", 0);
+    httpSend("/len/after", 1);
+  }
+
+  static void http_cut_start(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    httpReset(2);
+    httpClient = UTHTTPClientNew(mod, testBus, httpServer->path, "test", 1, 4);
+    httpSend("/cut", 0);
+    httpSend("/len/next", 1);
+  }
+
+  static void test_http(char *filter) {
+    HSPTest tests[] = {
+      { "http_chunked", http_chunked_start },
+      { "http_pipeline", http_pipeline_start },
+      { "http_retry", http_retry_start },
+      { "http_cut", http_cut_start },
+    };
+    for(int ii = 0; ii < (sizeof(tests) / sizeof(tests[0])); ii++) {
+      HSPTest *test = &tests[ii];
+      if(filter
+	 && strstr(test->name, filter) == NULL)
+	continue;
+      char path[100];
+      testPath(path, sizeof(path), "http");
+      httpServer = serverStart(path, httpFrame, httpServe);
+      runTest(test);
+      uint64_t connects = httpClient->connects;
+      UTHTTPClientReset(httpClient);
+      serverStop(httpServer);
+      uint32_t maxRequestsPerConn = httpServer->maxRequestsPerConn;
+      my_free(httpServer);
+      HSPHttpResult *r = httpResults;
+      if(ii == 0) {
+	check(r[0].status == UTHTTP_DONE
+	      && r[0].httpStatus == 200
+	      && r[0].body
+	      && !strcmp(r[0].body, HSP_TEST_CHUNKED_BODY),
+	      "http_chunked body decoded across fragments, extension and trailer");
+      }
+      else if(ii == 1) {
+	check(r[0].body && !strcmp(r[0].body, "a")
+	      && r[1].body && !strcmp(r[1].body, "bb")
+	      && r[2].body && !strcmp(r[2].body, "ccc"),
+	      "http_pipeline bodies");
+	check(r[0].order == 0 && r[1].order == 1 && r[2].order == 2,
+	      "http_pipeline responses in request order");
+	check(connects == 1,
+	      "http_pipeline one connection");
+	check(maxRequestsPerConn == 3,
+	      "http_pipeline server saw all requests on that connection");
+      }
+      else if(ii == 2) {
+	check(r[0].status == UTHTTP_DONE
+	      && r[0].retries == 1
+	      && r[0].body && !strcmp(r[0].body, "retried"),
+	      "http_retry request retried on a new connection after close");
+	check(r[1].status == UTHTTP_DONE
+	      && r[1].body && !strcmp(r[1].body, "after"),
+	      "http_retry pipelined request behind it retried too");
+	check(connects == 2, "http_retry reconnected once");
+      }
+      else if(ii == 3) {
+	check(r[0].status == UTHTTP_ERR,
+	      "http_cut partial response is an error, not retried");
+	check(r[1].status == UTHTTP_DONE
+	      && r[1].body && !strcmp(r[1].body, "next"),
+	      "http_cut request queued behind it still answered");
+      }
+    }
+  }
+
+  /*_________________---------------------------__________________
+    _________________    mod_ovs                __________________
+    -----------------___________________________------------------
+    mod_ovs is loaded against a stand-in ovsdb-server found through
+    $OVS_RUNDIR.  The stand-in answers get_schema with the schema the
+    test chose,  answers monitor with a single bridge,  and follows a
+    transact that inserts an sFlow row with the "update" the real
+    server would send.  It records every method it is asked for.
+  */
+
+#define HSP_TEST_OVSDB_BRIDGE "2c5ad5a6-0000-4000-8000-000000000001"
+#define HSP_TEST_OVSDB_SFLOW "2c5ad5a6-0000-4000-8000-000000000002"
+#define HSP_TEST_OVSDB_TICKS 5
+#define HSP_TEST_OVSDB_SCHEMA(version, lastcol)				\
+  "{\"name\":\"Open_vSwitch\",\"version\":\"" version "\",\"tables\":{" \
+  "\"Bridge\":{\"columns\":{\"name\":{\"type\":\"string\"},"		\
+  "\"sflow\":{\"type\":{\"key\":{\"type\":\"uuid\",\"refTable\":\"sFlow\"},\"min\":0,\"max\":1}}}}," \
+  "\"sFlow\":{\"columns\":{\"agent\":{\"type\":\"string\"},\"header\":{\"type\":\"integer\"}," \
+  "\"polling\":{\"type\":\"integer\"},\"sampling\":{\"type\":\"integer\"}," \
+  "\"" lastcol "\":{\"type\":{\"key\":\"string\",\"min\":1,\"max\":\"unlimited\"}}}}}}"
+
+  // touched by the server thread,  read once it has stopped
+  static char *ovsdbSchema;
+  static UTStringArray *ovsdbMethods;
+  static UTStringArray *ovsdbTransacts;
+  static uint32_t ovsdbTicks;
+
+  // back-to-back JSON objects,  as in mod_ovs.c:ovsdbFrame()
+  static size_t ovsdbFrame(UTStrBuf *rx, size_t *reqLen) {
+    int depth = 0;
+    bool inStr = NO, esc = NO;
+    for(size_t ii = 0; ii < UTSTRBUF_LEN(rx); ii++) {
+      char ch = UTSTRBUF_STR(rx)[ii];
+      if(inStr) {
+	if(esc) esc = NO;
+	else if(ch == '\\') esc = YES;
+	else if(ch == '"') inStr = NO;
+      }
+      else if(ch == '"') inStr = YES;
+      else if(ch == '{' || ch == '[') depth++;
+      else if((ch == '}' || ch == ']')
+	      && --depth == 0) {
+	*reqLen = ii + 1;
+	return *reqLen;
+      }
+    }
+    return 0;
+  }
+
+  static void ovsdbUpdate(cJSON *sflowRow, UTStrBuf *out) {
+    cJSON *upd = cJSON_CreateObject();
+    cJSON_AddStringToObject(upd, "method", "update");
+    cJSON *params = cJSON_CreateArray();
+    cJSON_AddItemToArray(params, cJSON_CreateNull());
+    cJSON *tables = cJSON_CreateObject();
+    cJSON *sflows = cJSON_CreateObject();
+    cJSON *sflow = cJSON_CreateObject();
+    cJSON_AddItemToObject(sflow, "new", cJSON_Duplicate(sflowRow, YES));
+    cJSON_AddItemToObject(sflows, HSP_TEST_OVSDB_SFLOW, sflow);
+    cJSON_AddItemToObject(tables, "sFlow", sflows);
+    cJSON *bridges = cJSON_Parse("{\"" HSP_TEST_OVSDB_BRIDGE "\":{\"new\":{\"name\":\"br0\","
+				 "\"sflow\":[\"uuid\",\"" HSP_TEST_OVSDB_SFLOW "\"]}}}");
+    cJSON_AddItemToObject(tables, "Bridge", bridges);
+    cJSON_AddItemToArray(params, tables);
+    cJSON_AddItemToObject(upd, "params", params);
+    cJSON_AddNullToObject(upd, "id");
+    char *str = cJSON_PrintUnformatted(upd);
+    UTStrBuf_printf(out, "%s", str);
+    my_free(str);
+    cJSON_Delete(upd);
+  }
+
+  static bool ovsdbServe(HSPTestConn *conn, char *req, UTStrBuf *out) {
+    cJSON *msg = cJSON_Parse(req);
+    cJSON *method = msg ? cJSON_GetObjectItem(msg, "method") : NULL;
+    cJSON *id = msg ? cJSON_GetObjectItem(msg, "id") : NULL;
+    if(method == NULL
+       || method->type != cJSON_String
+       || id == NULL
+       || id->type != cJSON_Number) {
+      cJSON_Delete(msg);
+      return NO;
+    }
+    strArrayAdd(ovsdbMethods, method->valuestring);
+    char *result = "{}";
+    cJSON *sflowRow = NULL;
+    if(!strcmp(method->valuestring, "get_schema"))
+      result = ovsdbSchema;
+    else if(!strcmp(method->valuestring, "monitor"))
+      result = "{\"Bridge\":{\"" HSP_TEST_OVSDB_BRIDGE "\":{\"new\":{\"name\":\"br0\",\"sflow\":[\"set\",[]]}}}}";
+    else if(!strcmp(method->valuestring, "transact")) {
+      cJSON *params = cJSON_GetObjectItem(msg, "params");
+      char *str = cJSON_PrintUnformatted(params);
+      strArrayAdd(ovsdbTransacts, str);
+      my_free(str);
+      cJSON *op;
+      cJSON_ArrayForEach(op, params) {
+	cJSON *opName = cJSON_GetObjectItem(op, "op");
+	if(opName
+	   && !strcmp(opName->valuestring, "insert"))
+	  sflowRow = cJSON_GetObjectItem(op, "row");
+      }
+      result = "[{}]";
+    }
+    UTStrBuf_printf(out, "{\"id\":%d,\"result\":%s,\"error\":null}", id->valueint, result);
+    if(sflowRow)
+      ovsdbUpdate(sflowRow, out);
+    cJSON_Delete(msg);
+    return YES;
+  }
+
+  // the hsflowd.c entry points that mod_ovs calls
+  void retainRootRequest(EVMod *mod, char *reason) { }
+  uint32_t sFlowSettingsChangeMask(void *data, size_t dataLen) { return HSP_SETTINGS_CHANGED_ALL; }
+
+  static void ovsdb_tick(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    // long enough for connect, schema, monitor, transact, update and
+    // a resync that should find nothing left to do
+    if(++ovsdbTicks == HSP_TEST_OVSDB_TICKS)
+      testDone(mod);
+  }
+
+  static void ovsdb_start(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    ovsdbTicks = 0;
+    EVEventRx(mod, EVGetEvent(testBus, EVEVENT_TICK), ovsdb_tick);
+    EVLoadModule(mod, "mod_ovs", NULL);
+  }
+
+  static bool ovsdbTransactHas(int txn, char *text) {
+    char *str = strArrayAt(ovsdbTransacts, txn);
+    return (str && strstr(str, text));
+  }
+
+  static void test_ovsdb(char *filter) {
+    HSPCollector coll = { .udpPort = 6343 };
+    coll.ipAddr.type = SFLADDRESSTYPE_IP_V4;
+    coll.ipAddr.address.ip_v4.addr = htonl(0x0a000001);
+    HSPSFlowSettings settings = {
+      .collectors = &coll,
+      .numCollectors = 1,
+      .samplingRate = 400,
+      .headerBytes = 128,
+    };
+    HSP sp = {
+      .sFlowSettings = &settings,
+      .actualPollingInterval = 20,
+    };
+    struct {
+      HSPTest test;
+      char *schema;
+    } tests[] = {
+      { { "ovsdb_sync", ovsdb_start, &sp }, HSP_TEST_OVSDB_SCHEMA("8.3.0", "targets") },
+      { { "ovsdb_old_schema", ovsdb_start, &sp }, HSP_TEST_OVSDB_SCHEMA("6.12.0", "targets") },
+      { { "ovsdb_missing_column", ovsdb_start, &sp }, HSP_TEST_OVSDB_SCHEMA("8.3.0", "collectors") },
+    };
+    char dir[80], path[100];
+    testPath(dir, sizeof(dir), "ovsdb");
+    snprintf(path, sizeof(path), "%s/db.sock", dir);
+    mkdir(dir, 0700);
+    setenv("OVS_RUNDIR", dir, YES);
+    for(int ii = 0; ii < (sizeof(tests) / sizeof(tests[0])); ii++) {
+      HSPTest *test = &tests[ii].test;
+      if(filter
+	 && strstr(test->name, filter) == NULL)
+	continue;
+      ovsdbSchema = tests[ii].schema;
+      ovsdbMethods = strArrayNew();
+      ovsdbTransacts = strArrayNew();
+      HSPTestServer *srv = serverStart(path, ovsdbFrame, ovsdbServe);
+      runTest(test);
+      serverStop(srv);
+      char *methods = strArrayStr(ovsdbMethods, NULL, NULL, ",", NULL);
+      printf("     %s: %s\n", test->name, methods);
+      if(ii == 0) {
+	check(!strcmp(methods, "get_schema,monitor,transact,transact"),
+	      "ovsdb_sync schema checked before monitor, one transact to set, one to clear");
+	check(ovsdbTransactHas(0, "\"op\":\"insert\",\"table\":\"sFlow\"")
+	      && ovsdbTransactHas(0, "\"sampling\":400")
+	      && ovsdbTransactHas(0, "\"header\":128")
+	      && ovsdbTransactHas(0, "\"polling\":20")
+	      && ovsdbTransactHas(0, "\"targets\":[\"set\",[\"10.0.0.1:6343\"]]"),
+	      "ovsdb_sync sFlow row inserted with the config");
+	check(ovsdbTransactHas(0, "\"sflow\":[\"named-uuid\",\"newsflow\"]")
+	      && ovsdbTransactHas(0, HSP_TEST_OVSDB_BRIDGE),
+	      "ovsdb_sync bridge pointed at the new row");
+	check(ovsdbTransactHas(1, "\"sflow\":[\"set\",[]]")
+	      && !ovsdbTransactHas(1, "insert"),
+	      "ovsdb_sync sFlow cleared from the bridge on shutdown");
+      }
+      else {
+	char what[128];
+	snprintf(what, sizeof(what), "%s schema rejected, no monitor, connection dropped", test->name);
+	check(!strcmp(methods, "get_schema")
+	      && srv->accepts == 1
+	      && srv->hangups == 1,
+	      what);
+      }
+      my_free(methods);
+      my_free(srv);
+      strArrayFree(ovsdbMethods);
+      strArrayFree(ovsdbTransacts);
+    }
+    unsetenv("OVS_RUNDIR");
+    rmdir(dir);
+  }
+
+  /*_________________---------------------------__________________
+    _________________      main                 __________________
+    -----------------___________________________------------------
+  */
+
+  int main(int argc, char *argv[]) {
+    char *filter = (argc > 1) ? argv[1] : NULL;
+#ifdef UTHEAP
+    UTHeapInit();
+#endif
+    // the stand-in servers hang up on purpose
+    signal(SIGPIPE, SIG_IGN);
+    test_http(filter);
+    test_ovsdb(filter);
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
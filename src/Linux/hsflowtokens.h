@@ -67,4 +67,30 @@ HSPTOKEN_DATA( HSPTOKEN_PORT, "port", HSPTOKENTYPE_OBJ, NULL)
 HSPTOKEN_DATA( HSPTOKEN_CGROUP_PROCS, "cgroup_procs", HSPTOKENTYPE_ATTRIB, NULL)
 HSPTOKEN_DATA( HSPTOKEN_CGROUP_ACCT, "cgroup_acct", HSPTOKENTYPE_ATTRIB, NULL)
 HSPTOKEN_DATA( HSPTOKEN_CGROUP_TRAFFIC, "markTraffic", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_COUNT_FDS, "countFDs", HSPTOKENTYPE_ATTRIB, NULL)
 HSPTOKEN_DATA( HSPTOKEN_NAMESPACE, "namespace", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_MAXSAMPLES, "maxSamples", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_MAXPACKETCPU, "maxPacketCPU", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_REPLAY, "replay", HSPTOKENTYPE_OBJ, NULL)
+HSPTOKEN_DATA( HSPTOKEN_FILE, "file", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_INIFINDEX, "inIfIndex", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_OUTIFINDEX, "outIfIndex", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_PACE, "pace", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_LOOPS, "loops", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_OUTPUT, "output", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_CACHESECS, "cacheSecs", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_DUMPRATE, "dumpRate", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_PSAMPLE, "psample", HSPTOKENTYPE_OBJ, NULL)
+HSPTOKEN_DATA( HSPTOKEN_DROPMON, "dropmon", HSPTOKENTYPE_OBJ, NULL)
+HSPTOKEN_DATA( HSPTOKEN_LIMIT, "limit", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_QUEUE, "queue", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_SW, "sw", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_HW, "hw", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_THREAD, "thread", HSPTOKENTYPE_OBJ, NULL)
+HSPTOKEN_DATA( HSPTOKEN_BUS, "bus", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_CPUS, "cpus", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_NICE, "nice", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_SCHED, "sched", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_PRIORITY, "priority", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_NUMA, "numa", HSPTOKENTYPE_ATTRIB, NULL)
+HSPTOKEN_DATA( HSPTOKEN_EGRESS, "egress", HSPTOKENTYPE_ATTRIB, NULL)
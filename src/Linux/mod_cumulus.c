@@ -252,15 +252,50 @@ extern "C" {
     if(sp->sFlowSettings == NULL)
       return; // no config (yet - may be waiting for DNS-SD)
 
+    // also called (with no mask) when interfaces change
+    if(!(sFlowSettingsChangeMask(data, dataLen) & HSP_SETTINGS_CHANGED_SAMPLING))
+      return;
+
     markSwitchPorts(mod);
     uint32_t channel = sampling_channel(mod);
     int sampling_dirn = sp->sFlowSettings->samplingDirection;
 
     SFLAdaptor *adaptor;
     UTHASH_WALK(sp->adaptorsByIndex, adaptor) {
+      HSPAdaptorNIO *niostate = ADAPTOR_NIO(adaptor);
+      uint32_t backoff = niostate->sampling_backoff ?: 1;
       uint32_t sampling_n = lookupPacketSamplingRate(adaptor, sp->sFlowSettings);
-      if(setSamplingRate(mod, adaptor, channel, sampling_n, sampling_dirn))
+      if(setSamplingRate(mod, adaptor, channel, sampling_n * backoff, sampling_dirn)) {
 	sp->hardwareSampling = YES;
+	niostate->sampling_backoff_upstream = backoff;
+      }
+    }
+  }
+
+  /*_________________---------------------------__________________
+    _________________    evt_tick               __________________
+    -----------------___________________________------------------
+    Push any change in overload back-off into the hardware.
+  */
+
+  static void evt_tick(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+
+    if(sp->sFlowSettings == NULL)
+      return;
+
+    uint32_t channel = sampling_channel(mod);
+    int sampling_dirn = sp->sFlowSettings->samplingDirection;
+    SFLAdaptor *adaptor;
+    UTHASH_WALK(sp->adaptorsByIndex, adaptor) {
+      HSPAdaptorNIO *niostate = ADAPTOR_NIO(adaptor);
+      uint32_t backoff = niostate->sampling_backoff ?: 1;
+      if(niostate->sampling_n_set
+	 && backoff != (niostate->sampling_backoff_upstream ?: 1)) {
+	uint32_t sampling_n = lookupPacketSamplingRate(adaptor, sp->sFlowSettings);
+	if(setSamplingRate(mod, adaptor, channel, sampling_n * backoff, sampling_dirn))
+	  niostate->sampling_backoff_upstream = backoff;
+      }
     }
   }
 
@@ -317,6 +352,7 @@ extern "C" {
     EVEventRx(mod, EVGetEvent(mdata->pollBus, HSPEVENT_HOST_COUNTER_SAMPLE), evt_host_cs);
     EVEventRx(mod, EVGetEvent(mdata->pollBus, HSPEVENT_CONFIG_CHANGED), evt_config_changed); 
     EVEventRx(mod, EVGetEvent(mdata->pollBus, HSPEVENT_INTFS_CHANGED), evt_intfs_changed);
+    EVEventRx(mod, EVGetEvent(mdata->pollBus, EVEVENT_TICK), evt_tick);
     EVEventRx(mod, EVGetEvent(mdata->pollBus, EVEVENT_FINAL), evt_final);
  }
 
@@ -18,7 +18,6 @@ extern "C" {
 #include <sys/prctl.h>
 #include <sched.h>
 #include <dbus/dbus.h>
-#define HSP_TELEMETRY_NAMES 1
 #include "hsflowd.h"
 #include "util_dbus.h"
 
@@ -55,6 +54,10 @@ static const char* introspect_xml =
 "		<method name=\"Get\">\n"
 "                     <arg name=\"field\" type=\"s\" direction=\"in\"/>\n"
 "		</method>\n"
+"		<method name=\"GetBusStats\">\n"
+"		</method>\n"
+"		<method name=\"GetCallbackStats\">\n"
+"		</method>\n"
 "	</interface>\n"
 "	<interface name=\"" HSP_DBUS_INTF_SWITCHPORT "\">\n"
 "		<method name=\"GetAll\">\n"
@@ -153,6 +156,24 @@ static const char* introspect_xml =
     return DBUS_HANDLER_RESULT_HANDLED;
   }
 
+  typedef struct {
+    DBusMessageIter *it;
+    bool oom;
+  } HSPDBusTelemetryWalk;
+
+  static void telemetryAppendCB(void *magic, const char *name, uint64_t val) {
+    HSPDBusTelemetryWalk *walk = (HSPDBusTelemetryWalk *)magic;
+    DBusMessageIter it3;
+    if(walk->oom
+       || !dbus_message_iter_open_container(walk->it, DBUS_TYPE_DICT_ENTRY, NULL, &it3)) {
+      walk->oom = YES;
+      return;
+    }
+    dbus_message_iter_append_basic(&it3, DBUS_TYPE_STRING, &name);
+    dbus_message_iter_append_basic(&it3, DBUS_TYPE_UINT64, &val);
+    dbus_message_iter_close_container(walk->it, &it3);
+  }
+
   /*_________________---------------------------__________________
     _________________     m_telemetry_GetAll    __________________
     -----------------___________________________------------------
@@ -160,22 +181,19 @@ static const char* introspect_xml =
     http://git.kernel.org/cgit/network/connman/connman.git/tree/gdbus/object.c
   */
   static DBusHandlerResult m_telemetry_GetAll(EVMod *mod, DBusMessage *msg) {
-    HSP *sp = (HSP *)EVROOTDATA(mod);
     DBusMessage *reply = dbus_message_new_method_return(msg);
     if (!reply)
       return DBUS_HANDLER_RESULT_NEED_MEMORY;
-    DBusMessageIter it1, it2, it3;
+    DBusMessageIter it1, it2;
     dbus_message_iter_init_append(reply, &it1);
     if(!dbus_message_iter_open_container(&it1, DBUS_TYPE_ARRAY, "{st}", &it2))
       return DBUS_HANDLER_RESULT_NEED_MEMORY;
 
-    for(int ii = 0; ii < HSP_TELEMETRY_NUM_COUNTERS; ii++) {
-      if(!dbus_message_iter_open_container(&it2, DBUS_TYPE_DICT_ENTRY, NULL, &it3))
-	return DBUS_HANDLER_RESULT_NEED_MEMORY;
-      dbus_message_iter_append_basic(&it3, DBUS_TYPE_STRING, &HSPTelemetryNames[ii]);
-      dbus_message_iter_append_basic(&it3, DBUS_TYPE_UINT64, &sp->telemetry[ii]);
-      dbus_message_iter_close_container(&it2, &it3);
-    }
+    // built-in counters first, then whatever the modules registered
+    HSPDBusTelemetryWalk walk = { .it = &it2 };
+    telemetryWalk(telemetryAppendCB, &walk);
+    if(walk.oom)
+      return DBUS_HANDLER_RESULT_NEED_MEMORY;
 
     dbus_message_iter_close_container(&it1, &it2);
     send_reply(mod, reply);
@@ -188,7 +206,6 @@ static const char* introspect_xml =
     -----------------___________________________------------------
   */
   static DBusHandlerResult m_telemetry_Get(EVMod *mod, DBusMessage *msg) {
-    HSP *sp = (HSP *)EVROOTDATA(mod);
     DBusMessageIter it;
     if(!dbus_message_iter_init(msg, &it))
       return DBUS_HANDLER_RESULT_NEED_MEMORY;
@@ -198,26 +215,101 @@ static const char* introspect_xml =
       return DBUS_HANDLER_RESULT_HANDLED;
     }
     char *varname=NULL;
-    uint64_t *pval64=NULL;
+    uint64_t val64=0;
     dbus_message_iter_get_basic(&it, &varname);
-    for(int ii = 0; ii < HSP_TELEMETRY_NUM_COUNTERS; ii++) {
-      if(my_strequal(varname, HSPTelemetryNames[ii]))
-	pval64 = &sp->telemetry[ii];
-    }
-    if(!pval64) {
+    if(!telemetryGetByName(varname, &val64)) {
       send_reply_err(mod, msg, "unknown field");
       return DBUS_HANDLER_RESULT_HANDLED;
     }
     DBusMessage *reply = dbus_message_new_method_return(msg);
     if (!reply)
       return DBUS_HANDLER_RESULT_NEED_MEMORY;
-    dbus_message_append_args(reply, DBUS_TYPE_INT64, pval64,  DBUS_TYPE_INVALID);
+    dbus_message_append_args(reply, DBUS_TYPE_INT64, &val64,  DBUS_TYPE_INVALID);
     send_reply(mod, reply);
     dbus_message_unref(reply);
     return DBUS_HANDLER_RESULT_HANDLED;
   }
 
 
+  /*_________________---------------------------__________________
+    _________________  m_telemetry_GetBusStats  __________________
+    -----------------___________________________------------------
+    one struct per bus: name, loops, maxLoop_uS, missedTicks,
+    missedDecis and the loop-latency histogram (log2 uS buckets).
+  */
+  static DBusHandlerResult m_telemetry_GetBusStats(EVMod *mod, DBusMessage *msg) {
+    DBusMessage *reply = dbus_message_new_method_return(msg);
+    if (!reply)
+      return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    DBusMessageIter it1, it2, it3, it4;
+    dbus_message_iter_init_append(reply, &it1);
+    if(!dbus_message_iter_open_container(&it1, DBUS_TYPE_ARRAY, "(sttttat)", &it2))
+      return DBUS_HANDLER_RESULT_NEED_MEMORY;
+
+    EVBus *bus;
+    UTHASH_WALK(mod->root->buses, bus) {
+      if(!dbus_message_iter_open_container(&it2, DBUS_TYPE_STRUCT, NULL, &it3))
+	return DBUS_HANDLER_RESULT_NEED_MEMORY;
+      dbus_message_iter_append_basic(&it3, DBUS_TYPE_STRING, &bus->name);
+      dbus_message_iter_append_basic(&it3, DBUS_TYPE_UINT64, &bus->stats.loops);
+      dbus_message_iter_append_basic(&it3, DBUS_TYPE_UINT64, &bus->stats.maxLoop_uS);
+      dbus_message_iter_append_basic(&it3, DBUS_TYPE_UINT64, &bus->stats.missedTicks);
+      dbus_message_iter_append_basic(&it3, DBUS_TYPE_UINT64, &bus->stats.missedDecis);
+      if(!dbus_message_iter_open_container(&it3, DBUS_TYPE_ARRAY, "t", &it4))
+	return DBUS_HANDLER_RESULT_NEED_MEMORY;
+      for(int ii = 0; ii < EVBUS_LATENCY_BUCKETS; ii++)
+	dbus_message_iter_append_basic(&it4, DBUS_TYPE_UINT64, &bus->stats.latency[ii]);
+      dbus_message_iter_close_container(&it3, &it4);
+      dbus_message_iter_close_container(&it2, &it3);
+    }
+
+    dbus_message_iter_close_container(&it1, &it2);
+    send_reply(mod, reply);
+    dbus_message_unref(reply);
+    return DBUS_HANDLER_RESULT_HANDLED;
+  }
+
+  /*_________________---------------------------__________________
+    _________________ m_telemetry_GetCallbackStats ________________
+    -----------------___________________________------------------
+    one struct per event-action or socket: bus, module, event (or
+    socket), calls, total_uS, max_uS.
+  */
+
+  static void addCallbackStats(EVBus *bus, EVMod *mod, char *name, EVStats *stats, void *magic) {
+    DBusMessageIter *it = (DBusMessageIter *)magic;
+    DBusMessageIter it2;
+    if(!dbus_message_iter_open_container(it, DBUS_TYPE_STRUCT, NULL, &it2))
+      return;
+    dbus_message_iter_append_basic(&it2, DBUS_TYPE_STRING, &bus->name);
+    dbus_message_iter_append_basic(&it2, DBUS_TYPE_STRING, &mod->name);
+    dbus_message_iter_append_basic(&it2, DBUS_TYPE_STRING, &name);
+    dbus_message_iter_append_basic(&it2, DBUS_TYPE_UINT64, &stats->calls);
+    dbus_message_iter_append_basic(&it2, DBUS_TYPE_UINT64, &stats->total_uS);
+    dbus_message_iter_append_basic(&it2, DBUS_TYPE_UINT64, &stats->max_uS);
+    dbus_message_iter_close_container(it, &it2);
+  }
+
+  static DBusHandlerResult m_telemetry_GetCallbackStats(EVMod *mod, DBusMessage *msg) {
+    DBusMessage *reply = dbus_message_new_method_return(msg);
+    if (!reply)
+      return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    DBusMessageIter it1, it2;
+    dbus_message_iter_init_append(reply, &it1);
+    if(!dbus_message_iter_open_container(&it1, DBUS_TYPE_ARRAY, "(sssttt)", &it2))
+      return DBUS_HANDLER_RESULT_NEED_MEMORY;
+
+    EVBus *bus;
+    UTHASH_WALK(mod->root->buses, bus) {
+      EVBusStatsWalk(bus, addCallbackStats, &it2);
+    }
+
+    dbus_message_iter_close_container(&it1, &it2);
+    send_reply(mod, reply);
+    dbus_message_unref(reply);
+    return DBUS_HANDLER_RESULT_HANDLED;
+  }
+
   /*_________________---------------------------__________________
     _________________     addSwitchPort         __________________
     -----------------___________________________------------------
@@ -327,6 +419,8 @@ static DBusHandlerResult dbusCB(DBusConnection *connection, DBusMessage *msg, vo
       if(!strcmp("GetVersion", method)) return m_telemetry_GetVersion(mod, msg);
       if(!strcmp("GetAll", method)) return m_telemetry_GetAll(mod, msg);
       if(!strcmp("Get", method)) return m_telemetry_Get(mod, msg);
+      if(!strcmp("GetBusStats", method)) return m_telemetry_GetBusStats(mod, msg);
+      if(!strcmp("GetCallbackStats", method)) return m_telemetry_GetCallbackStats(mod, msg);
     }
     else if(!strcmp(HSP_DBUS_INTF_SWITCHPORT, iface)) {
       if(!strcmp("GetAll", method)) return m_switchport_GetAll(mod, msg);
@@ -16,6 +16,7 @@ extern "C" {
 
 #include "hsflowd.h"
 #include "cpu_utils.h"
+#include "util_http.h"
 
   // limit the number of chars we will read from each line
   // in /proc/net/dev and /prov/net/vlan/config
@@ -94,39 +95,20 @@ extern "C" {
     EnumHSPContainerState state;
     uint32_t inspect_tx:1;
     uint32_t inspect_rx:1;
+    uint32_t marked:1;
     uint64_t memoryLimit;
   } HSPVMState_DOCKER;
 
   typedef void (*HSPDockerCB)(EVMod *mod, UTStrBuf *buf, cJSON *obj);
 
-  typedef enum {
-    HSPDOCKERREQ_HEADERS=0,
-    HSPDOCKERREQ_LENGTH,
-    HSPDOCKERREQ_CONTENT,
-    HSPDOCKERREQ_ENDCONTENT,
-    HSPDOCKERREQ_ERR
-  } HSPDockerRequestState;
-    
-  typedef struct _HSPDockerRequest {
-    struct _HSPDockerRequest *prev;
-    struct _HSPDockerRequest *next;
-    UTStrBuf *request;
-    UTStrBuf *response;
-    HSPDockerCB jsonCB;
-    bool eventFeed:1;
-    HSPDockerRequestState state;
-    int contentLength;
-    int chunkLength;
-  } HSPDockerRequest;
-
 #define HSP_DOCKER_SOCK  "/var/run/docker.sock"
-#define HSP_DOCKER_MAX_CONCURRENT 3
-#define HSP_DOCKER_HTTP " HTTP/1.1\nHost: " HSP_DOCKER_SOCK "\n\n"
+#define HSP_DOCKER_HOST "docker"
+#define HSP_DOCKER_HTTP_CONNS 2
+#define HSP_DOCKER_HTTP_PIPELINE 16
 #define HSP_DOCKER_API "v1.24"
-#define HSP_DOCKER_REQ_EVENTS "GET /" HSP_DOCKER_API "/events?filters={\"type\":[\"container\"]}" HSP_DOCKER_HTTP
-#define HSP_DOCKER_REQ_CONTAINERS "GET /" HSP_DOCKER_API "/containers/json" HSP_DOCKER_HTTP
-#define HSP_DOCKER_REQ_INSPECT_ID "GET /" HSP_DOCKER_API "/containers/%s/json" HSP_DOCKER_HTTP
-#define HSP_CONTENT_LENGTH_REGEX "^Content-Length: ([0-9]+)$"
+#define HSP_DOCKER_REQ_EVENTS "/" HSP_DOCKER_API "/events?filters={\"type\":[\"container\"]}"
+#define HSP_DOCKER_REQ_CONTAINERS "/" HSP_DOCKER_API "/containers/json"
+#define HSP_DOCKER_REQ_INSPECT_ID "/" HSP_DOCKER_API "/containers/%s/json"
   
 #define HSP_DOCKER_CMD "/usr/bin/docker"
 #define HSP_NETNS_DIR "/var/run/netns"
@@ -146,20 +128,23 @@ extern "C" {
     UTHash *pollActions;
     SFLCounters_sample_element vnodeElem;
     bool dockerSync:1;
-    bool dockerFlush:1;
+    bool reconciling:1;
     UTArray *eventQueue;
-    UTQ(HSPDockerRequest) requestQ;
-    uint32_t currentRequests;
-    regex_t *contentLengthPattern;
+    UTHTTPClient *http;
+    uint32_t inspectsPending;
+    // reconcile stats (see dockerAPI_containers)
+    struct timespec syncStart;
+    uint32_t syncKept;
+    uint32_t syncAdded;
+    uint32_t syncRemoved;
+    uint32_t syncInspected;
     uint32_t countdownToResync;
     int cgroupPathIdx;
   } HSP_mod_DOCKER;
 
 #define HSP_DOCKER_MAX_STATS_LINELEN 512
 
-  static void dockerAPIRequest(EVMod *mod, HSPDockerRequest *req);
-  static HSPDockerRequest *dockerRequest(EVMod *mod, UTStrBuf *cmd, HSPDockerCB jsonCB, bool eventFeed);
-  static void  dockerRequestFree(EVMod *mod, HSPDockerRequest *req);
+  static void dockerRequest(EVMod *mod, char *path, HSPDockerCB jsonCB, bool eventFeed);
   static void dockerSynchronize(EVMod *mod);
 
   /*_________________---------------------------__________________
@@ -717,11 +702,11 @@ extern "C" {
     adaptorsElem.tag = SFLCOUNTERS_ADAPTORS;
     adaptorsElem.counterBlock.adaptors = vm->interfaces;
     SFLADD_ELEMENT(&cs, &adaptorsElem);
-    SEMLOCK_DO(sp->sync_agent) {
+    TIMEDLOCK_DO(sp->sync_receiver) {
       sfl_poller_writeCountersSample(vm->poller, &cs);
       sp->counterSampleQueued = YES;
-      sp->telemetry[HSP_TELEMETRY_COUNTER_SAMPLES]++;
     }
+    HSP_TELEMETRY_INC(HSP_TELEMETRY_COUNTER_SAMPLES);
   }
 
   static void agentCB_getCounters_DOCKER_request(void *magic, SFLPoller *poller, SFL_COUNTERS_SAMPLE_TYPE *cs)
@@ -942,11 +927,15 @@ extern "C" {
   }
 
   static void inspectContainer(EVMod *mod, HSPVMState_DOCKER *container) {
-    UTStrBuf *req = UTStrBuf_new();
-    UTStrBuf_printf(req, HSP_DOCKER_REQ_INSPECT_ID, container->id);
-    dockerAPIRequest(mod, dockerRequest(mod, req, dockerAPI_inspect, NO));
-    UTStrBuf_free(req);
+    HSP_mod_DOCKER *mdata = (HSP_mod_DOCKER *)mod->data;
+    UTStrBuf *path = UTStrBuf_new();
+    UTStrBuf_printf(path, HSP_DOCKER_REQ_INSPECT_ID, container->id);
+    dockerRequest(mod, UTSTRBUF_STR(path), dockerAPI_inspect, NO);
+    UTStrBuf_free(path);
     container->inspect_tx = YES;
+    mdata->inspectsPending++;
+    if(mdata->reconciling)
+      mdata->syncInspected++;
   }
 
   static void dockerAPI_event(EVMod *mod, UTStrBuf *buf, cJSON *top) {
@@ -1034,9 +1023,41 @@ extern "C" {
     } // actor
   }
     
+  // A container that was running before the resync can be kept as it
+  // is (poller, adaptors and sequence numbers intact) unless it has been
+  // restarted in the meantime, in which case we need a fresh inspect to
+  // learn the new pid and namespace.
+  static bool containerUnchanged(HSPVMState_DOCKER *container, EnumHSPContainerState state, const char *name) {
+    char *str = (char *)name;
+    if(str && str[0] == '/') str++;
+    return (container->inspect_rx
+	    && container->state == state
+	    && my_strequal(str, container->name)
+	    && container->pid > 0
+	    && (kill(container->pid, 0) == 0 || errno == EPERM));
+  }
+
+  static void reconcileDone(EVMod *mod) {
+    HSP_mod_DOCKER *mdata = (HSP_mod_DOCKER *)mod->data;
+    struct timespec now;
+    EVClockMono(&now);
+    mdata->reconciling = NO;
+    myLog(LOG_INFO, "docker reconcile: %u containers (kept=%u added=%u removed=%u inspected=%u) in %d mS",
+	  UTHashN(mdata->vmsByID),
+	  mdata->syncKept,
+	  mdata->syncAdded,
+	  mdata->syncRemoved,
+	  mdata->syncInspected,
+	  EVTimeDiff_mS(&mdata->syncStart, &now));
+  }
+
   static void dockerAPI_containers(EVMod *mod, UTStrBuf *buf, cJSON *top) {
     HSP_mod_DOCKER *mdata = (HSP_mod_DOCKER *)mod->data;
     myDebug(1, "dockerAPI_containers");
+    // mark...
+    HSPVMState_DOCKER *container;
+    UTHASH_WALK(mdata->vmsByID, container)
+      container->marked = YES;
     // process containers
     int nc = cJSON_GetArraySize(top);
     for(int ii = 0; ii < nc; ii++) {
@@ -1068,13 +1089,41 @@ extern "C" {
       }
 #endif
 
-      HSPVMState_DOCKER *container = getContainer(mod, id->valuestring, YES);
-      container->state = containerState(state->valuestring);
+      EnumHSPContainerState st = containerState(state->valuestring);
+      container = getContainer(mod, id->valuestring, NO);
+      if(container) {
+	container->marked = NO;
+	if(containerUnchanged(container, st, name0->valuestring)) {
+	  mdata->syncKept++;
+	  continue;
+	}
+	// changed - inspect again
+	container->inspect_tx = NO;
+	container->inspect_rx = NO;
+      }
+      else {
+	container = getContainer(mod, id->valuestring, YES);
+	mdata->syncAdded++;
+      }
+      container->state = st;
       setContainerName(container, name0->valuestring);
       if(!container->inspect_tx)
 	inspectContainer(mod, container);
     }
 
+    // ...and sweep: anything still marked is no longer running
+    UTHASH_WALK(mdata->vmsByID, container) {
+      if(container->marked) {
+	myDebug(1, "docker reconcile: container %s is gone", container->name);
+	UTHashDel(mdata->pollActions, container);
+	removeAndFreeVM_DOCKER(mod, container);
+	mdata->syncRemoved++;
+      }
+    }
+
+    if(mdata->inspectsPending == 0)
+      reconcileDone(mod);
+
     // mark as sync'd and replay queued events
     mdata->dockerSync = YES;
     UTStrBuf *qbuf;
@@ -1103,217 +1152,104 @@ extern "C" {
     }
   }
 
-  static void processDockerJSON(EVMod *mod, HSPDockerRequest *req, UTStrBuf *buf) {
+  static void processDockerJSON(EVMod *mod, HSPDockerCB jsonCB, UTStrBuf *buf) {
     cJSON *top = cJSON_Parse(UTSTRBUF_STR(buf));
     if(top) {
       logJSON(1, "processDockerJSON:", top);
-      (*req->jsonCB)(mod, buf, top);
+      (*jsonCB)(mod, buf, top);
       cJSON_Delete(top);
     }
   }
 
-  // Assume headers include:
-  // Content-Type: Application/JSON
-  // Transfer-Encoding: chunked
-  //
-  // Assume that the chunks of JSON content do not have CR or LF characters within them
-  // (if they ever do then we can add another "within chunk" state and append lines to
-  // the response result there).
-  static void processDockerResponse(EVMod *mod, EVSocket *sock, HSPDockerRequest *req) {
+  static void dockerResync(EVMod *mod, uint32_t waitSecs) {
     HSP_mod_DOCKER *mdata = (HSP_mod_DOCKER *)mod->data;
-    char *line = UTSTRBUF_STR(sock->ioline);
-    myDebug(2, "readDockerAPI got answer: <%s>", line);
-    switch(req->state) {
-
-    case HSPDOCKERREQ_HEADERS:
-      UTStrBuf_chomp(sock->ioline);
-      if(UTRegexExtractInt(mdata->contentLengthPattern, line, 1, &req->contentLength, NULL, NULL)) {
-	myDebug(1, "got contentLength=%d", req->contentLength);
-      }
-      else if(UTSTRBUF_LEN(sock->ioline) == 0) {
-	req->state = req->contentLength
-	  ? HSPDOCKERREQ_CONTENT
-	  : HSPDOCKERREQ_LENGTH;
-      }
-      break;
-
-    case HSPDOCKERREQ_ENDCONTENT:
-      UTStrBuf_chomp(sock->ioline);
-      if(UTSTRBUF_LEN(sock->ioline) == 0)
-	req->state = HSPDOCKERREQ_LENGTH;
-      break;
-      
-    case HSPDOCKERREQ_LENGTH: {
-      UTStrBuf_chomp(sock->ioline);
-      char *endp = NULL;
-      req->chunkLength = strtol(line, &endp, 16); // hex
-      if(*endp != '\0') {
-	// failed to consume the whole string - must be an error.
-	myDebug(1, "Docker error: <%s> for request: <%s>",
-		line, UTSTRBUF_STR(req->request));
-	req->state = HSPDOCKERREQ_ERR;
-      }
-      else {
-	req->state = req->chunkLength
-	  ? HSPDOCKERREQ_CONTENT
-	  : HSPDOCKERREQ_ENDCONTENT;
-      }
-      break;
-    }
-
-    case HSPDOCKERREQ_CONTENT: {
-      int clen = req->chunkLength ?: req->contentLength;
-      assert(clen == UTSTRBUF_LEN(sock->ioline)); // assume no newlines in chunk
-      if(req->eventFeed)
-	processDockerJSON(mod, req, sock->ioline);
-      else {
-	if(req->response == NULL)
-	  req->response = UTStrBuf_new();
-	UTStrBuf_append_n(req->response, line, UTSTRBUF_LEN(sock->ioline));
-      }
-      req->state = HSPDOCKERREQ_ENDCONTENT;
-      break;
-    }
-      
-    case HSPDOCKERREQ_ERR:
-      // TODO: just wait for EOF, or should we force the socket to close?
-      break;
-    }
+    // drop everything in flight and start again later
+    UTHTTPClientReset(mdata->http);
+    mdata->countdownToResync = waitSecs;
   }
-  
-  static void readDockerCB(EVMod *mod, EVSocket *sock, EnumEVSocketReadStatus status, void *magic) {
+
+  static void dockerResponse(EVMod *mod, UTHTTPRequest *req, EnumUTHTTPStatus status) {
     HSP_mod_DOCKER *mdata = (HSP_mod_DOCKER *)mod->data;
-    HSPDockerRequest *req = (HSPDockerRequest *)magic;
+    HSPDockerCB jsonCB = (HSPDockerCB)req->magic;
+    if(jsonCB == dockerAPI_inspect
+       && status != UTHTTP_CHUNK) {
+      // final callback for an inspect, whatever the outcome
+      if(mdata->inspectsPending)
+	mdata->inspectsPending--;
+      if(mdata->reconciling
+	 && mdata->dockerSync
+	 && mdata->inspectsPending == 0)
+	reconcileDone(mod);
+    }
     switch(status) {
-    case EVSOCKETREAD_AGAIN:
-      break;
-    case EVSOCKETREAD_STR:
-      if(!mdata->dockerFlush) {
-	processDockerResponse(mod, sock, req);
-	UTStrBuf_reset(sock->ioline);
-      }
-      break;
-    case EVSOCKETREAD_EOF:
-      if(!mdata->dockerFlush) {
-	if(req->response)
-	  processDockerJSON(mod, req, req->response);
+    case UTHTTP_CHUNK:
+    case UTHTTP_DONE:
+      if(req->httpStatus < 200
+	 || req->httpStatus >= 300) {
+	myDebug(1, "Docker error: HTTP %d <%s> for request: <%s>",
+		req->httpStatus,
+		UTSTRBUF_STR(req->body),
+		req->path);
       }
-      // fall through
-    case EVSOCKETREAD_BADF:
-    case EVSOCKETREAD_ERR:
-      // clean up
-      assert(mdata->currentRequests > 0);
-      --mdata->currentRequests;
-
-      if(req->eventFeed) {
-	// we lost the event feed - need to flush and resync
-	mdata->dockerFlush = YES;
+      else if(UTSTRBUF_LEN(req->body)) {
+	// the event feed delivers one JSON event per chunk
+	processDockerJSON(mod, jsonCB, req->body);
       }
-
-      // free the request - (it's not in any other collection)
-      dockerRequestFree(mod, req);
-      req = NULL;
-      
-      if(mdata->dockerFlush &&
-	 mdata->currentRequests == 0) {
-	// no outstanding requests - flush is done
-	mdata->dockerFlush = NO;
-	mdata->countdownToResync = HSP_DOCKER_WAIT_EVENTDROP;
+      if(req->streaming
+	 && status == UTHTTP_DONE) {
+	// the event feed should never end - need to resync
+	dockerResync(mod, HSP_DOCKER_WAIT_EVENTDROP);
       }
-      
-      // see if we have another request queued
-      if(!mdata->dockerFlush
-	 && !UTQ_EMPTY(mdata->requestQ)) {
-	HSPDockerRequest *nextReq;
-	UTQ_REMOVE_HEAD(mdata->requestQ, nextReq);
-	dockerAPIRequest(mod, nextReq);
-      }
-    }
-  }
-    
-  static void readDockerAPI(EVMod *mod, EVSocket *sock, void *magic) {
-    EVSocketReadLines(mod, sock, readDockerCB, magic);
-  }
-
-  static void dockerAPIRequest(EVMod *mod, HSPDockerRequest *req) {
-    HSP_mod_DOCKER *mdata = (HSP_mod_DOCKER *)mod->data;
-    if(mdata->currentRequests >= HSP_DOCKER_MAX_CONCURRENT) {
-      // just queue it
-      UTQ_ADD_TAIL(mdata->requestQ, req);
-      return;
-    }
-    char *cmd = UTSTRBUF_STR(req->request);
-    ssize_t len = UTSTRBUF_LEN(req->request);
-    int fd = UTUnixDomainSocket(HSP_DOCKER_SOCK);
-    myDebug(1, "dockerAPIRequest(%s) fd==%d", cmd, fd);
-    if(fd < 0)  {
+      break;
+    case UTHTTP_NOSOCKET:
       // looks like docker was stopped
       // wait longer before retrying
-      mdata->dockerFlush = YES;
-      mdata->countdownToResync = HSP_DOCKER_WAIT_NOSOCKET;
-    }
-    else {
-      EVBusAddSocket(mod, mdata->pollBus, fd, readDockerAPI, req);
-      int cc;
-      while((cc = write(fd, cmd, len)) != len && errno == EINTR);
-      if(cc == len) {
-	mdata->currentRequests++;
-      }
-      else {
-	myLog(LOG_ERR, "dockerAPIRequest - write(%s) returned %d != %u: %s",
-	      cmd, cc, len, strerror(errno));
+      dockerResync(mod, HSP_DOCKER_WAIT_NOSOCKET);
+      break;
+    case UTHTTP_ERR:
+      if(req->streaming) {
+	// we lost the event feed - need to flush and resync
+	dockerResync(mod, HSP_DOCKER_WAIT_EVENTDROP);
       }
+      break;
     }
   }
 
-  static HSPDockerRequest *dockerRequest(EVMod *mod, UTStrBuf *cmd, HSPDockerCB jsonCB, bool eventFeed) {
-    HSPDockerRequest *req = (HSPDockerRequest *)my_calloc(sizeof(HSPDockerRequest));
-    req->request = UTStrBuf_copy(cmd);
-    req->jsonCB = jsonCB;
-    req->eventFeed = eventFeed;
-    return req;
-  }
-
-  static void  dockerRequestFree(EVMod *mod, HSPDockerRequest *req) {
-    UTStrBuf_free(req->request);
-    if(req->response) UTStrBuf_free(req->response);
-    my_free(req);
+  static void dockerRequest(EVMod *mod, char *path, HSPDockerCB jsonCB, bool eventFeed) {
+    HSP_mod_DOCKER *mdata = (HSP_mod_DOCKER *)mod->data;
+    UTHTTPRequest *req = UTHTTPRequestNew("GET", path, dockerResponse, (void *)jsonCB);
+    req->streaming = eventFeed;
+    UTHTTPSend(mdata->http, req);
   }
 
-  static void dockerClearAll(EVMod *mod) {
+  static void dockerSynchronize(EVMod *mod) {
     HSP_mod_DOCKER *mdata = (HSP_mod_DOCKER *)mod->data;
-    // clear everything out:
-    // 1. pollActions
-    UTHashReset(mdata->pollActions);
-    // 2. containers
+    // Keep the containers we already know about.  The listing we are
+    // about to request will be reconciled against them (mark and sweep)
+    // in dockerAPI_containers, so existing pollers carry on undisturbed.
+    // 1. requests and connections
+    UTHTTPClientReset(mdata->http);
+    mdata->inspectsPending = 0;
+    // 2. inspects that were lost in the reset must be sent again
     HSPVMState_DOCKER *container;
-    UTHASH_WALK(mdata->vmsByID, container)
-      removeAndFreeVM_DOCKER(mod, container);
+    UTHASH_WALK(mdata->vmsByID, container) {
+      if(!container->inspect_rx)
+	container->inspect_tx = NO;
+    }
     // 3. event queue
     UTStrBuf *qbuf;
     UTARRAY_WALK(mdata->eventQueue, qbuf)
       UTStrBuf_free(qbuf);
     UTArrayReset(mdata->eventQueue);
-    // 4. request queue
-    HSPDockerRequest *req, *nx;
-    for(req = mdata->requestQ.head; req; ) {
-      nx = req->next;
-      dockerRequestFree(mod, req);
-      req = nx;
-    }
-    UTQ_CLEAR(mdata->requestQ);
-  }
-  
-  static void dockerSynchronize(EVMod *mod) {
-    HSP_mod_DOCKER *mdata = (HSP_mod_DOCKER *)mod->data;
-    dockerClearAll(mod);
     mdata->dockerSync = NO;
-    mdata->dockerFlush = NO;
-    mdata->cgroupPathIdx = -1;    
+    mdata->cgroupPathIdx = -1;
+    mdata->reconciling = YES;
+    EVClockMono(&mdata->syncStart);
+    mdata->syncKept = mdata->syncAdded = mdata->syncRemoved = mdata->syncInspected = 0;
     // start the event monitor before we capture the current state.  Events will be queued until we have
     // read all the current containers, then replayed.  At that point we will be "in sync".
-    dockerAPIRequest(mod, dockerRequest(mod, UTStrBuf_wrap(HSP_DOCKER_REQ_EVENTS), dockerAPI_event, YES));
-    dockerAPIRequest(mod, dockerRequest(mod, UTStrBuf_wrap(HSP_DOCKER_REQ_CONTAINERS), dockerAPI_containers, NO));
+    dockerRequest(mod, HSP_DOCKER_REQ_EVENTS, dockerAPI_event, YES);
+    dockerRequest(mod, HSP_DOCKER_REQ_CONTAINERS, dockerAPI_containers, NO);
   }
 
   static void evt_config_first(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
@@ -1336,7 +1272,6 @@ extern "C" {
 
     requestVNodeRole(mod, HSP_VNODE_PRIORITY_DOCKER);
 
-    mdata->contentLengthPattern = UTRegexCompile(HSP_CONTENT_LENGTH_REGEX);
     mdata->vmsByUUID = UTHASH_NEW(HSPVMState_DOCKER, vm.uuid, UTHASH_DFLT);
     mdata->vmsByID = UTHASH_NEW(HSPVMState_DOCKER, id, UTHASH_SKEY);
     mdata->pollActions = UTHASH_NEW(HSPVMState_DOCKER, id, UTHASH_IDTY);
@@ -1345,6 +1280,8 @@ extern "C" {
     
     // register call-backs
     mdata->pollBus = EVGetBus(mod, HSPBUS_POLL, YES);
+    mdata->http = UTHTTPClientNew(mod, mdata->pollBus, HSP_DOCKER_SOCK, HSP_DOCKER_HOST,
+				  HSP_DOCKER_HTTP_CONNS, HSP_DOCKER_HTTP_PIPELINE);
     EVEventRx(mod, EVGetEvent(mdata->pollBus, EVEVENT_TICK), evt_tick);
     EVEventRx(mod, EVGetEvent(mdata->pollBus, EVEVENT_TOCK), evt_tock);
     EVEventRx(mod, EVGetEvent(mdata->pollBus, HSPEVENT_HOST_COUNTER_SAMPLE), evt_host_cs);
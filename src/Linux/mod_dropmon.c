@@ -0,0 +1,701 @@
+/* This software is distributed under the following license:
+ * http://sflow.net/license.html
+ */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "hsflowd.h"
+#include "util_netlink.h"
+
+  // Dropped packets from the kernel drop monitor (NET_DM generic netlink
+  // family, "packet alert" mode), exported as sFlow discarded-packet
+  // events.  The kernel truncates each packet and bounds its own queue,
+  // and here the alerts are summarized per drop point (where + why +
+  // input port).  Only the first alert for each point in each second is
+  // eligible for export, and only "limit" events are exported per second
+  // overall.  The rest are counted and reported in the "drops" field of
+  // the next event exported for the same point.  That way a drop storm
+  // costs one hash lookup per alert, not one sFlow event.
+
+#define HSP_DROPMON_READ_BATCH 100
+#define HSP_DROPMON_MSG_BYTES 16384
+#define HSP_DROPMON_RCV_BUF 4000000
+#define HSP_DROPMON_DEFAULT_LIMIT 50
+#define HSP_DROPMON_DEFAULT_QUEUE 1000
+#define HSP_DROPMON_MAX_POINTS 1000
+#define HSP_DROPMON_POINT_TIMEOUT 60
+
+  // copied from linux/net_dropmon.h so we can compile on one
+  // platform and run on another. New attributes are only
+  // ever added at the end.
+  typedef enum {
+    HSP_NET_DM_CMD_UNSPEC=0,
+    HSP_NET_DM_CMD_ALERT,
+    HSP_NET_DM_CMD_CONFIG,
+    HSP_NET_DM_CMD_START,
+    HSP_NET_DM_CMD_STOP,
+    HSP_NET_DM_CMD_PACKET_ALERT,
+    HSP_NET_DM_CMD_CONFIG_GET,
+    HSP_NET_DM_CMD_CONFIG_NEW,
+    HSP_NET_DM_CMD_STATS_GET,
+    HSP_NET_DM_CMD_STATS_NEW
+  } EnumDropmonCommands;
+
+  typedef enum {
+    HSP_NET_DM_ATTR_UNSPEC=0,
+    HSP_NET_DM_ATTR_ALERT_MODE,		/* u8 */
+    HSP_NET_DM_ATTR_PC,			/* u64 */
+    HSP_NET_DM_ATTR_SYMBOL,		/* string */
+    HSP_NET_DM_ATTR_IN_PORT,		/* nested */
+    HSP_NET_DM_ATTR_TIMESTAMP,		/* u64 */
+    HSP_NET_DM_ATTR_PROTO,		/* u16 */
+    HSP_NET_DM_ATTR_PAYLOAD,		/* binary */
+    HSP_NET_DM_ATTR_PAD,
+    HSP_NET_DM_ATTR_TRUNC_LEN,		/* u32 */
+    HSP_NET_DM_ATTR_ORIG_LEN,		/* u32 */
+    HSP_NET_DM_ATTR_QUEUE_LEN,		/* u32 */
+    HSP_NET_DM_ATTR_STATS,		/* nested */
+    HSP_NET_DM_ATTR_HW_STATS,		/* nested */
+    HSP_NET_DM_ATTR_ORIGIN,		/* u16 */
+    HSP_NET_DM_ATTR_HW_TRAP_GROUP_NAME,	/* string */
+    HSP_NET_DM_ATTR_HW_TRAP_NAME,	/* string */
+    HSP_NET_DM_ATTR_HW_ENTRIES,		/* nested */
+    HSP_NET_DM_ATTR_HW_ENTRY,		/* nested */
+    HSP_NET_DM_ATTR_HW_TRAP_COUNT,	/* u32 */
+    HSP_NET_DM_ATTR_SW_DROPS,		/* flag */
+    HSP_NET_DM_ATTR_HW_DROPS,		/* flag */
+    HSP_NET_DM_ATTR_FLOW_ACTION_COOKIE,	/* binary */
+    HSP_NET_DM_ATTR_REASON,		/* string */
+    __HSP_NET_DM_ATTR_MAX
+  } EnumDropmonAttributes;
+
+#define HSP_NET_DM_ATTR_PORT_NETDEV_IFINDEX 0
+#define HSP_NET_DM_ATTR_STATS_DROPPED 0
+#define HSP_NET_DM_ALERT_MODE_PACKET 1
+#define HSP_NET_DM_ORIGIN_SW 0
+#define HSP_NET_DM_ORIGIN_HW 1
+
+#define HSP_DROPMON_GENL_NAME "NET_DM"
+#define HSP_DROPMON_MCGRP_NAME "events"
+
+  typedef struct _HSPDropPoint {
+    char *key;
+    uint16_t origin;
+    uint32_t ifIndex;
+    char *where;  // function (sw) or trap group (hw)
+    char *why;    // drop reason (sw) or trap name (hw)
+    uint32_t reason; // SFLDrop_reason
+    uint32_t count; // this second
+    uint32_t unreported;
+    bool exported; // this second
+    time_t lastActive;
+  } HSPDropPoint;
+
+  typedef struct _HSP_mod_DROPMON {
+    EVBus *packetBus;
+    bool dropmon_configured;
+    bool started;
+    int nl_sock;
+    int familyId;
+    uint32_t mcGroupId;
+    u_char *recv_buf;
+    SFLNotifier *notifier;
+    UTHash *pointHT;
+    uint32_t budget; // events left this second
+    uint64_t kernelDrops;
+    // telemetry
+    uint32_t t_alerts;
+    uint32_t t_events;
+    uint32_t t_suppressed;
+    uint32_t t_kernel_drops;
+    uint32_t t_overruns;
+    uint32_t t_points;
+    uint32_t t_lost;
+  } HSP_mod_DROPMON;
+
+  /*_________________---------------------------__________________
+    _________________   drop reason codes       __________________
+    -----------------___________________________------------------
+    Map devlink trap names and Linux drop reasons to the sFlow
+    drop_reason enumeration.  Anything not listed is "unknown".
+    Only looked up once per drop point.
+  */
+
+  typedef struct {
+    char *name;
+    uint32_t code;
+  } HSPDropReasonMap;
+
+  static const HSPDropReasonMap hwTrapReasons[] = {
+    { "source_mac_is_multicast", SFLDrop_src_mac_is_multicast },
+    { "vlan_tag_mismatch", SFLDrop_vlan_tag_mismatch },
+    { "ingress_vlan_filter", SFLDrop_ingress_vlan_filter },
+    { "ingress_spanning_tree_filter", SFLDrop_ingress_spanning_tree_filter },
+    { "port_list_is_empty", SFLDrop_port_list_is_empty },
+    { "port_loopback_filter", SFLDrop_port_loopback_filter },
+    { "blackhole_route", SFLDrop_blackhole_route },
+    { "ttl_value_is_too_small", SFLDrop_ttl_exceeded },
+    { "tail_drop", SFLDrop_no_buffer_space },
+    { "non_ip", SFLDrop_non_ip },
+    { "uc_dip_over_mc_dmac", SFLDrop_uc_dip_over_mc_dmac },
+    { "dip_is_loopback_address", SFLDrop_dip_is_loopback_address },
+    { "sip_is_mc", SFLDrop_sip_is_mc },
+    { "sip_is_loopback_address", SFLDrop_sip_is_loopback_address },
+    { "ip_header_corrupted", SFLDrop_ip_header_corrupted },
+    { "ipv4_sip_is_limited_bc", SFLDrop_ipv4_sip_is_limited_bc },
+    { "ipv6_mc_dip_reserved_scope", SFLDrop_ipv6_mc_dip_reserved_scope },
+    { "ipv6_mc_dip_interface_local_scope", SFLDrop_ipv6_mc_dip_interface_local_scope },
+    { "mtu_value_is_too_small", SFLDrop_pkt_too_big },
+    { "unresolved_neigh", SFLDrop_unresolved_neigh },
+    { "mc_reverse_path_forwarding", SFLDrop_mc_reverse_path_forwarding },
+    { "reject_route", SFLDrop_net_unreachable },
+    { "non_routable_packet", SFLDrop_non_routable_packet },
+    { "decap_error", SFLDrop_decap_error },
+    { "overlay_smac_is_mc", SFLDrop_overlay_smac_is_mc },
+    { "ingress_flow_action_drop", SFLDrop_acl },
+    { "egress_flow_action_drop", SFLDrop_acl },
+    { "early_drop", SFLDrop_red },
+    { "blackhole_neigh", SFLDrop_blackhole_arp_neigh },
+    { "egress_vlan_filter", SFLDrop_egress_vlan_filter },
+    { NULL, 0 }
+  };
+
+  static const HSPDropReasonMap swDropReasons[] = {
+    { "NO_SOCKET", SFLDrop_port_unreachable },
+    { "IP_NOPROTO", SFLDrop_protocol_unreachable },
+    { "IP_INNOROUTES", SFLDrop_net_unreachable },
+    { "IP_OUTNOROUTES", SFLDrop_net_unreachable },
+    { "IP_INHDR", SFLDrop_ip_header_corrupted },
+    { "IP_CSUM", SFLDrop_ip_header_corrupted },
+    { "PKT_TOO_SMALL", SFLDrop_ip_header_corrupted },
+    { "PKT_TOO_BIG", SFLDrop_pkt_too_big },
+    { "IP_RPFILTER", SFLDrop_uc_reverse_path_forwarding },
+    { "UNICAST_IN_L2_MULTICAST", SFLDrop_uc_dip_over_mc_dmac },
+    { "NETFILTER_DROP", SFLDrop_acl },
+    { "TC_INGRESS", SFLDrop_acl },
+    { "TC_EGRESS", SFLDrop_acl },
+    { "TC_DROP", SFLDrop_acl },
+    { "XDP", SFLDrop_acl },
+    { "QDISC_DROP", SFLDrop_no_buffer_space },
+    { "CPU_BACKLOG", SFLDrop_no_buffer_space },
+    { "FULL_RING", SFLDrop_no_buffer_space },
+    { "SOCKET_RCVBUFF", SFLDrop_no_buffer_space },
+    { "PROTO_MEM", SFLDrop_no_buffer_space },
+    { "NOMEM", SFLDrop_no_buffer_space },
+    { "NEIGH_FAILED", SFLDrop_unresolved_neigh },
+    { "NEIGH_QUEUEFULL", SFLDrop_unresolved_neigh },
+    { "NEIGH_DEAD", SFLDrop_unresolved_neigh },
+    { NULL, 0 }
+  };
+
+  static uint32_t dropReasonCode(const HSPDropReasonMap *map, char *name) {
+    if(name)
+      for(const HSPDropReasonMap *rm = map; rm->name; rm++)
+	if(!strcasecmp(rm->name, name))
+	  return rm->code;
+    return SFLDrop_unknown;
+  }
+
+  /*_________________---------------------------__________________
+    _________________     attribute access      __________________
+    -----------------___________________________------------------
+  */
+
+  static uint32_t nla_u32(struct nlattr *attr) {
+    if(attr == NULL)
+      return 0;
+    switch(UTNLA_PAYLOAD(attr)) {
+    case 1: return *(uint8_t *)UTNLA_DATA(attr);
+    case 2: return *(uint16_t *)UTNLA_DATA(attr);
+    case 4:
+    case 8: return *(uint32_t *)UTNLA_DATA(attr);
+    }
+    return 0;
+  }
+
+  static char *nla_str(struct nlattr *attr) {
+    if(attr == NULL
+       || UTNLA_PAYLOAD(attr) == 0)
+      return NULL;
+    char *str = (char *)UTNLA_DATA(attr);
+    // must be terminated within the attribute
+    return (str[UTNLA_PAYLOAD(attr) - 1] == '\0') ? str : NULL;
+  }
+
+  static void nla_parse(struct nlattr **tb, int maxType, struct nlattr *attr, int len) {
+    for(; UTNLA_OK(attr, len); attr = UTNLA_NEXT(attr, len)) {
+      int type = UTNLA_TYPE(attr);
+      if(type < maxType)
+	tb[type] = attr;
+    }
+  }
+
+  static void nla_parse_nested(struct nlattr **tb, int maxType, struct nlattr *nest) {
+    if(nest)
+      nla_parse(tb, maxType, UTNLA_DATA(nest), UTNLA_PAYLOAD(nest));
+  }
+
+  /*_________________---------------------------__________________
+    _________________      drop points          __________________
+    -----------------___________________________------------------
+  */
+
+  static HSPDropPoint *getDropPoint(EVMod *mod, uint16_t origin, uint32_t ifIndex, char *where, char *why) {
+    HSP_mod_DROPMON *mdata = (HSP_mod_DROPMON *)mod->data;
+    char keybuf[512];
+    snprintf(keybuf, sizeof(keybuf), "%u|%u|%s|%s", origin, ifIndex, where ?: "", why ?: "");
+    HSPDropPoint search = { .key = keybuf };
+    HSPDropPoint *pt = UTHashGet(mdata->pointHT, &search);
+    if(pt == NULL) {
+      if(UTHashN(mdata->pointHT) >= HSP_DROPMON_MAX_POINTS)
+	return NULL;
+      pt = (HSPDropPoint *)my_calloc(sizeof(HSPDropPoint));
+      pt->key = my_strdup(keybuf);
+      pt->origin = origin;
+      pt->ifIndex = ifIndex;
+      pt->where = my_strdup(where ?: "");
+      pt->why = my_strdup(why ?: "");
+      pt->reason = dropReasonCode((origin == HSP_NET_DM_ORIGIN_HW) ? hwTrapReasons : swDropReasons, why);
+      UTHashAdd(mdata->pointHT, pt);
+      telemetrySet(mdata->t_points, UTHashN(mdata->pointHT));
+      myDebug(1, "dropmon: new drop point %s reason=%u", pt->key, pt->reason);
+    }
+    return pt;
+  }
+
+  static void freeDropPoint(HSPDropPoint *pt) {
+    my_free(pt->key);
+    my_free(pt->where);
+    my_free(pt->why);
+    my_free(pt);
+  }
+
+  /*_________________---------------------------__________________
+    _________________     exportDiscard         __________________
+    -----------------___________________________------------------
+  */
+
+  static void exportDiscard(EVMod *mod, HSPDropPoint *pt, char *symbol, uint16_t proto, u_char *payload, uint32_t payload_len, uint32_t orig_len) {
+    HSP_mod_DROPMON *mdata = (HSP_mod_DROPMON *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+
+    SFLEvent_discarded_packet discard = { 0 };
+    discard.drops = pt->unreported;
+    discard.input = pt->ifIndex;
+    discard.reason = pt->reason;
+
+    // packet header
+    SFLFlow_sample_element hdrElem = { 0 };
+    uint32_t header_protocol = 0;
+    if(pt->origin == HSP_NET_DM_ORIGIN_HW)
+      header_protocol = SFLHEADER_ETHERNET_ISO8023;
+    else if(proto == 0x0800)
+      header_protocol = SFLHEADER_IPv4;
+    else if(proto == 0x86DD)
+      header_protocol = SFLHEADER_IPv6;
+    if(header_protocol
+       && payload
+       && payload_len) {
+      uint32_t hdrLen = payload_len;
+      if(hdrLen > mdata->notifier->sFlowEsMaximumHeaderSize)
+	hdrLen = mdata->notifier->sFlowEsMaximumHeaderSize;
+      hdrElem.tag = SFLFLOW_HEADER;
+      hdrElem.flowType.header.header_protocol = header_protocol;
+      hdrElem.flowType.header.frame_length = orig_len ?: payload_len;
+      hdrElem.flowType.header.header_length = hdrLen;
+      hdrElem.flowType.header.header_bytes = payload;
+      SFLADD_ELEMENT(&discard, &hdrElem);
+    }
+
+    // where and why
+    SFLFlow_sample_element fnElem = { 0 };
+    SFLFlow_sample_element whyElem = { 0 };
+    if(pt->origin == HSP_NET_DM_ORIGIN_HW) {
+      whyElem.tag = SFLFLOW_EX_HW_TRAP;
+      whyElem.flowType.hw_trap.group.str = pt->where;
+      whyElem.flowType.hw_trap.group.len = my_strlen(pt->where);
+      whyElem.flowType.hw_trap.trap.str = pt->why;
+      whyElem.flowType.hw_trap.trap.len = my_strlen(pt->why);
+      SFLADD_ELEMENT(&discard, &whyElem);
+    }
+    else {
+      // full symbol (with offset) from this alert
+      fnElem.tag = SFLFLOW_EX_FUNCTION;
+      fnElem.flowType.function.symbol.str = symbol ?: pt->where;
+      fnElem.flowType.function.symbol.len = my_strlen(fnElem.flowType.function.symbol.str);
+      SFLADD_ELEMENT(&discard, &fnElem);
+      if(pt->why[0]) {
+	whyElem.tag = SFLFLOW_EX_LINUX_REASON;
+	whyElem.flowType.linux_reason.reason.str = pt->why;
+	whyElem.flowType.linux_reason.reason.len = my_strlen(pt->why);
+	SFLADD_ELEMENT(&discard, &whyElem);
+      }
+    }
+
+    TIMEDLOCK_DO(sp->sync_receiver) {
+      sfl_agent_set_now(sp->agent, mdata->packetBus->now.tv_sec, mdata->packetBus->now.tv_nsec);
+      sfl_notifier_writeEventDiscardedPacket(mdata->notifier, &discard);
+    }
+    HSP_TELEMETRY_INC(mdata->t_events);
+    pt->unreported = 0;
+  }
+
+  /*_________________---------------------------__________________
+    _________________      processAlert         __________________
+    -----------------___________________________------------------
+  */
+
+  static void processAlert(EVMod *mod, struct nlattr **tb) {
+    HSP_mod_DROPMON *mdata = (HSP_mod_DROPMON *)mod->data;
+
+    HSP_TELEMETRY_INC(mdata->t_alerts);
+
+    uint16_t origin = nla_u32(tb[HSP_NET_DM_ATTR_ORIGIN]);
+    struct nlattr *port[HSP_NET_DM_ATTR_PORT_NETDEV_IFINDEX + 1] = { 0 };
+    nla_parse_nested(port, HSP_NET_DM_ATTR_PORT_NETDEV_IFINDEX + 1, tb[HSP_NET_DM_ATTR_IN_PORT]);
+    uint32_t ifIndex = nla_u32(port[HSP_NET_DM_ATTR_PORT_NETDEV_IFINDEX]);
+
+    char *symbol = NULL;
+    char *where, *why;
+    char fnbuf[128];
+    if(origin == HSP_NET_DM_ORIGIN_HW) {
+      where = nla_str(tb[HSP_NET_DM_ATTR_HW_TRAP_GROUP_NAME]);
+      why = nla_str(tb[HSP_NET_DM_ATTR_HW_TRAP_NAME]);
+    }
+    else {
+      // aggregate by function: "tcp_v4_rcv+0x1a0/0x10b0" -> "tcp_v4_rcv"
+      symbol = nla_str(tb[HSP_NET_DM_ATTR_SYMBOL]);
+      where = NULL;
+      if(symbol) {
+	snprintf(fnbuf, sizeof(fnbuf), "%s", symbol);
+	char *plus = strchr(fnbuf, '+');
+	if(plus)
+	  *plus = '\0';
+	where = fnbuf;
+      }
+      why = nla_str(tb[HSP_NET_DM_ATTR_REASON]);
+    }
+
+    HSPDropPoint *pt = getDropPoint(mod, origin, ifIndex, where, why);
+    if(pt == NULL) {
+      // table full - count it and move on
+      HSP_TELEMETRY_INC(mdata->t_suppressed);
+      return;
+    }
+    pt->count++;
+    pt->lastActive = mdata->packetBus->now.tv_sec;
+
+    if(pt->exported
+       || mdata->budget == 0) {
+      pt->unreported++;
+      HSP_TELEMETRY_INC(mdata->t_suppressed);
+      return;
+    }
+    pt->exported = YES;
+    mdata->budget--;
+
+    struct nlattr *payload = tb[HSP_NET_DM_ATTR_PAYLOAD];
+    exportDiscard(mod,
+		  pt,
+		  symbol,
+		  nla_u32(tb[HSP_NET_DM_ATTR_PROTO]), // ethertype, host byte order
+		  payload ? UTNLA_DATA(payload) : NULL,
+		  payload ? UTNLA_PAYLOAD(payload) : 0,
+		  nla_u32(tb[HSP_NET_DM_ATTR_ORIG_LEN]));
+  }
+
+  /*_________________---------------------------__________________
+    _________________      processStats         __________________
+    -----------------___________________________------------------
+    Packets the kernel dropped because its alert queue was full.
+  */
+
+  static void processStats(EVMod *mod, struct nlattr **tb) {
+    HSP_mod_DROPMON *mdata = (HSP_mod_DROPMON *)mod->data;
+    uint64_t dropped = 0;
+    int statsAttrs[] = { HSP_NET_DM_ATTR_STATS, HSP_NET_DM_ATTR_HW_STATS };
+    for(int ii = 0; ii < 2; ii++) {
+      struct nlattr *stats[HSP_NET_DM_ATTR_STATS_DROPPED + 1] = { 0 };
+      nla_parse_nested(stats, HSP_NET_DM_ATTR_STATS_DROPPED + 1, tb[statsAttrs[ii]]);
+      struct nlattr *attr = stats[HSP_NET_DM_ATTR_STATS_DROPPED];
+      if(attr
+	 && UTNLA_PAYLOAD(attr) == 8)
+	dropped += *(uint64_t *)UTNLA_DATA(attr);
+    }
+    if(dropped > mdata->kernelDrops)
+      telemetryAdd(mdata->t_kernel_drops, dropped - mdata->kernelDrops);
+    mdata->kernelDrops = dropped;
+  }
+
+  /*_________________---------------------------__________________
+    _________________      readAlerts           __________________
+    -----------------___________________________------------------
+  */
+
+  static void readAlerts(EVMod *mod, EVSocket *sock, void *magic)
+  {
+    HSP_mod_DROPMON *mdata = (HSP_mod_DROPMON *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+
+    for(int batch = 0; batch < HSP_DROPMON_READ_BATCH; batch++) {
+      int numbytes = recv(sock->fd, mdata->recv_buf, HSP_DROPMON_MSG_BYTES, 0);
+      if(numbytes <= 0) {
+	if(numbytes < 0
+	   && errno == ENOBUFS) {
+	  HSP_TELEMETRY_INC(mdata->t_overruns);
+	  continue;
+	}
+	break;
+      }
+      if(sp->sFlowSettings == NULL)
+	continue; // config was turned off
+      for(struct nlmsghdr *nlh = (struct nlmsghdr *)mdata->recv_buf; NLMSG_OK(nlh, numbytes); nlh = NLMSG_NEXT(nlh, numbytes)) {
+	if(nlh->nlmsg_type != mdata->familyId)
+	  continue;
+	struct genlmsghdr *genl = (struct genlmsghdr *)NLMSG_DATA(nlh);
+	struct nlattr *tb[__HSP_NET_DM_ATTR_MAX] = { 0 };
+	nla_parse(tb,
+		  __HSP_NET_DM_ATTR_MAX,
+		  (struct nlattr *)((char *)genl + GENL_HDRLEN),
+		  nlh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN));
+	switch(genl->cmd) {
+	case HSP_NET_DM_CMD_PACKET_ALERT: processAlert(mod, tb); break;
+	case HSP_NET_DM_CMD_STATS_NEW: processStats(mod, tb); break;
+	}
+      }
+    }
+  }
+
+  /*_________________---------------------------__________________
+    _________________      startDropmon         __________________
+    -----------------___________________________------------------
+    Must be done while we are still root (CAP_NET_ADMIN).
+  */
+
+  static int configDropmon(EVMod *mod, int fd) {
+    HSP_mod_DROPMON *mdata = (HSP_mod_DROPMON *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    uint8_t mode = HSP_NET_DM_ALERT_MODE_PACKET;
+    uint32_t truncLen = sp->sFlowSettings_file->headerBytes;
+    uint32_t queueLen = sp->dropmon.queue;
+    UTNLAttr cfg[] = {
+      { HSP_NET_DM_ATTR_ALERT_MODE, &mode, sizeof(mode) },
+      { HSP_NET_DM_ATTR_TRUNC_LEN, &truncLen, sizeof(truncLen) },
+      { HSP_NET_DM_ATTR_QUEUE_LEN, &queueLen, sizeof(queueLen) },
+    };
+    return UTNLGeneric_transact(fd, mdata->familyId, HSP_NET_DM_CMD_CONFIG, 2, cfg, 3);
+  }
+
+  static int startDropmon(EVMod *mod, int fd, bool sw, bool hw) {
+    HSP_mod_DROPMON *mdata = (HSP_mod_DROPMON *)mod->data;
+    UTNLAttr start[2];
+    int nAttrs = 0;
+    if(sw)
+      start[nAttrs++] = (UTNLAttr){ HSP_NET_DM_ATTR_SW_DROPS, NULL, 0 };
+    if(hw)
+      start[nAttrs++] = (UTNLAttr){ HSP_NET_DM_ATTR_HW_DROPS, NULL, 0 };
+    return UTNLGeneric_transact(fd, mdata->familyId, HSP_NET_DM_CMD_START, 2, start, nAttrs);
+  }
+
+  static bool configAndStart(EVMod *mod, int fd) {
+    HSP_mod_DROPMON *mdata = (HSP_mod_DROPMON *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    int err = configDropmon(mod, fd);
+    if(err == EBUSY) {
+      // still running, probably left on by a previous instance
+      myLog(LOG_INFO, "dropmon: drop monitor busy - stopping it and trying again");
+      UTNLGeneric_transact(fd, mdata->familyId, HSP_NET_DM_CMD_STOP, 2, NULL, 0);
+      err = configDropmon(mod, fd);
+    }
+    if(err) {
+      myLog(LOG_ERR, "dropmon: CONFIG failed: %s", strerror(err));
+      return NO;
+    }
+    err = startDropmon(mod, fd, sp->dropmon.sw, sp->dropmon.hw);
+    if(err
+       && sp->dropmon.sw
+       && sp->dropmon.hw) {
+      // kernel may not support hardware drops
+      myLog(LOG_INFO, "dropmon: START(sw+hw) failed: %s - trying sw only", strerror(err));
+      err = startDropmon(mod, fd, YES, NO);
+    }
+    if(err) {
+      myLog(LOG_ERR, "dropmon: START failed: %s", strerror(err));
+      return NO;
+    }
+    return YES;
+  }
+
+  static int openDropmon(EVMod *mod)
+  {
+    HSP_mod_DROPMON *mdata = (HSP_mod_DROPMON *)mod->data;
+
+    int fd = UTNLGeneric_open();
+    if(fd < 0)
+      return -1;
+
+    mdata->familyId = UTNLGeneric_resolve(fd, HSP_DROPMON_GENL_NAME, HSP_DROPMON_MCGRP_NAME, &mdata->mcGroupId);
+    if(mdata->familyId <= 0
+       || !UTNLGeneric_join(fd, mdata->mcGroupId)
+       || !configAndStart(mod, fd)) {
+      close(fd);
+      return -1;
+    }
+    mdata->started = YES;
+
+    int rcvbuf = UTNL_setRcvBuf(fd, HSP_DROPMON_RCV_BUF);
+    myDebug(1, "dropmon socket fd=%d family=%d group=%u rcvbuf=%d",
+	    fd,
+	    mdata->familyId,
+	    mdata->mcGroupId,
+	    rcvbuf);
+
+    // set the socket to non-blocking
+    int fdFlags = fcntl(fd, F_GETFL);
+    fdFlags |= O_NONBLOCK;
+    if(fcntl(fd, F_SETFL, fdFlags) < 0) {
+      myLog(LOG_ERR, "dropmon fcntl(O_NONBLOCK) failed: %s", strerror(errno));
+      close(fd);
+      return -1;
+    }
+
+    return fd;
+  }
+
+  /*_________________---------------------------__________________
+    _________________    evt_config_changed     __________________
+    -----------------___________________________------------------
+  */
+
+  static void evt_config_changed(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    HSP_mod_DROPMON *mdata = (HSP_mod_DROPMON *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+
+    if(sp->sFlowSettings == NULL)
+      return; // no config (yet - may be waiting for DNS-SD)
+
+    if(mdata->dropmon_configured) {
+      // already configured from the first time (when we still had root privileges)
+      return;
+    }
+
+    // one notifier for the whole agent: ds_class=0, ds_index=0
+    SFLDataSource_instance dsi;
+    SFL_DS_SET(dsi, 0, 0, 0);
+    TIMEDLOCK_DO(sp->sync_receiver) {
+      mdata->notifier = sfl_agent_addNotifier(sp->agent, &dsi);
+      sfl_notifier_set_sFlowEsReceiver(mdata->notifier, HSP_SFLOW_RECEIVER_INDEX);
+      sfl_notifier_set_sFlowEsMaximumHeaderSize(mdata->notifier, sp->sFlowSettings_file->headerBytes);
+    }
+
+    mdata->nl_sock = openDropmon(mod);
+    if(mdata->nl_sock > 0)
+      EVBusAddSocket(mod, mdata->packetBus, mdata->nl_sock, readAlerts, NULL);
+
+    mdata->dropmon_configured = YES;
+  }
+
+  /*_________________---------------------------__________________
+    _________________       evt_tick            __________________
+    -----------------___________________________------------------
+    Reset the per-second budget, flush suppressed counts for points
+    that went quiet (as an event with no header), age out idle drop
+    points and ask the kernel how many alerts it had to drop.
+    Without the flush a point that went quiet with drops still
+    unreported would never be reported, or aged out.
+  */
+
+  static void evt_tick(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    HSP_mod_DROPMON *mdata = (HSP_mod_DROPMON *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+
+    mdata->budget = sp->dropmon.limit;
+
+    time_t now = mdata->packetBus->now.tv_sec;
+    UTArray *expired = NULL;
+    HSPDropPoint *pt;
+    UTHASH_WALK(mdata->pointHT, pt) {
+      if(pt->count)
+	myDebug(2, "dropmon: %s drops=%u unreported=%u", pt->key, pt->count, pt->unreported);
+      else if(pt->unreported
+	      && mdata->budget) {
+	// quiet for a second - report what was suppressed
+	mdata->budget--;
+	exportDiscard(mod, pt, NULL, 0, NULL, 0, 0);
+      }
+      pt->count = 0;
+      pt->exported = NO;
+      if((now - pt->lastActive) > HSP_DROPMON_POINT_TIMEOUT) {
+	if(pt->unreported) {
+	  // never found the budget to report these
+	  telemetryAdd(mdata->t_lost, pt->unreported);
+	  pt->unreported = 0;
+	}
+	if(expired == NULL)
+	  expired = UTArrayNew(UTARRAY_DFLT);
+	UTArrayAdd(expired, pt);
+      }
+    }
+    if(expired) {
+      // delete outside the walk - UTHashDel() may rebuild the table
+      UTARRAY_WALK(expired, pt) {
+	UTHashDel(mdata->pointHT, pt);
+	freeDropPoint(pt);
+      }
+      UTArrayFree(expired);
+    }
+    telemetrySet(mdata->t_points, UTHashN(mdata->pointHT));
+
+    if(mdata->started)
+      UTNLGeneric_sendAttrs(mdata->nl_sock, mdata->familyId, HSP_NET_DM_CMD_STATS_GET, 2, NULL, 0, 0);
+  }
+
+  /*_________________---------------------------__________________
+    _________________       evt_final           __________________
+    -----------------___________________________------------------
+    The kernel keeps monitoring until told to stop.  This only works
+    if we kept CAP_NET_ADMIN (e.g. running with -P).
+  */
+
+  static void evt_final(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    HSP_mod_DROPMON *mdata = (HSP_mod_DROPMON *)mod->data;
+    if(mdata->started) {
+      UTNLGeneric_sendAttrs(mdata->nl_sock, mdata->familyId, HSP_NET_DM_CMD_STOP, 2, NULL, 0, 0);
+      mdata->started = NO;
+    }
+  }
+
+  /*_________________---------------------------__________________
+    _________________    module init            __________________
+    -----------------___________________________------------------
+  */
+
+  void mod_dropmon(EVMod *mod) {
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    mod->data = my_calloc(sizeof(HSP_mod_DROPMON));
+    HSP_mod_DROPMON *mdata = (HSP_mod_DROPMON *)mod->data;
+    mdata->recv_buf = (u_char *)my_calloc(HSP_DROPMON_MSG_BYTES);
+    mdata->pointHT = UTHASH_NEW(HSPDropPoint, key, UTHASH_SKEY);
+    if(sp->dropmon.limit == 0)
+      sp->dropmon.limit = HSP_DROPMON_DEFAULT_LIMIT;
+    if(sp->dropmon.queue == 0)
+      sp->dropmon.queue = HSP_DROPMON_DEFAULT_QUEUE;
+    mdata->budget = sp->dropmon.limit;
+    mdata->t_alerts = telemetryRegister("dropmon_alerts", HSPTELEMETRY_COUNTER);
+    mdata->t_events = telemetryRegister("dropmon_events", HSPTELEMETRY_COUNTER);
+    mdata->t_suppressed = telemetryRegister("dropmon_suppressed", HSPTELEMETRY_COUNTER);
+    mdata->t_kernel_drops = telemetryRegister("dropmon_kernel_drops", HSPTELEMETRY_COUNTER);
+    mdata->t_overruns = telemetryRegister("dropmon_overruns", HSPTELEMETRY_COUNTER);
+    mdata->t_points = telemetryRegister("dropmon_points", HSPTELEMETRY_GAUGE);
+    mdata->t_lost = telemetryRegister("dropmon_lost", HSPTELEMETRY_COUNTER);
+    mdata->packetBus = EVGetBus(mod, HSPBUS_PACKET, YES);
+    EVEventRx(mod, EVGetEvent(mdata->packetBus, HSPEVENT_CONFIG_CHANGED), evt_config_changed);
+    EVEventRx(mod, EVGetEvent(mdata->packetBus, EVEVENT_TICK), evt_tick);
+    EVEventRx(mod, EVGetEvent(mdata->packetBus, EVEVENT_FINAL), evt_final);
+  }
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
@@ -19,34 +19,17 @@ extern "C" {
 
 #include "hsflowd.h"
 #include "cJSON.h"
+#include "util_http.h"
 
 #define HSP_DEFAULT_EAPI_STARTDELAY 2
 #define HSP_DEFAULT_EAPI_RETRYDELAY 20
 
-  typedef enum {
-    HSPEAPIREQ_HEADERS=0,
-    HSPEAPIREQ_LENGTH,
-    HSPEAPIREQ_CONTENT,
-    HSPEAPIREQ_ENDCONTENT,
-    HSPEAPIREQ_ERR
-  } HSPEapiRequestState;
-
   typedef void (*HSPEapiCB)(EVMod *mod, UTStrBuf *buf, cJSON *obj);
-  
-  typedef struct _HSPEapiRequest {
-    UTStrBuf *request;
-    UTStrBuf *response;
-    HSPEapiCB jsonCB;
-    HSPEapiRequestState state;
-    int contentLength;
-    int chunkLength;
-  } HSPEapiRequest;
 
 #define HSP_EAPI_SOCK  "/var/run/command-api.sock"
-#define HSP_EAPI_HTTP "HTTP/1.0\nHost: localhost\n"
-#define HSP_EAPI_CONTENT "Content-Type: application/json\nContent-Length: %u\n\n"
-#define HSP_EAPI_REQ_FMT "POST / " HSP_EAPI_HTTP HSP_EAPI_CONTENT "%s"
-#define HSP_CONTENT_LENGTH_REGEX "^Content-Length: ([0-9]+)$"
+#define HSP_EAPI_HOST "localhost"
+#define HSP_EAPI_HTTP_CONNS 1
+#define HSP_EAPI_HTTP_PIPELINE 1
 
   typedef struct _HSP_mod_Eapi {
     int countdown;
@@ -56,8 +39,7 @@ extern "C" {
     EVEvent *configStartEvent;
     EVEvent *configEvent;
     EVEvent *configEndEvent;
-    int currentRequests;
-    regex_t *contentLengthPattern;
+    UTHTTPClient *http;
   } HSP_mod_Eapi;
 
 
@@ -190,168 +172,40 @@ Expecting something like:
     -----------------___________________________------------------
   */
 
-  static void processEapiJSON(EVMod *mod, HSPEapiRequest *req, UTStrBuf *buf) {
+  static void processEapiJSON(EVMod *mod, HSPEapiCB jsonCB, UTStrBuf *buf) {
     myDebug(3, "processEapiJSON");
     cJSON *top = cJSON_Parse(UTSTRBUF_STR(buf));
     if(top) {
       logJSON(1, "processEapiJSON:", top);
-      (*req->jsonCB)(mod, buf, top);
+      (*jsonCB)(mod, buf, top);
       cJSON_Delete(top);
     }
   }
 
-  /*_________________---------------------------__________________
-    _________________   processEapiResponse     __________________
-    -----------------___________________________------------------
-  */
-  // Assume headers include:
-  // Content-Type: Application/JSON
-  // Transfer-Encoding: chunked
-  //
-  // Assume that the chunks of JSON content do not have CR or LF characters within them
-  // (if they ever do then we can add another "within chunk" state and append lines to
-  // the response result there).
-  static void processEapiResponse(EVMod *mod, EVSocket *sock, HSPEapiRequest *req) {
-    HSP_mod_Eapi *mdata = (HSP_mod_Eapi *)mod->data;
-    char *line = UTSTRBUF_STR(sock->ioline);
-    myDebug(2, "EAPI got answer: <%s> state=%d", line, req->state);
-
-    // handle missing length
-    if(req->state == HSPEAPIREQ_LENGTH
-       && line[0] == '{') {
-      myDebug(2, "EAPI got content when expecting length");
-      req->state = HSPEAPIREQ_CONTENT;
-      req->contentLength = UTSTRBUF_LEN(sock->ioline);
-    }
-
-    switch(req->state) {
-      
-    case HSPEAPIREQ_HEADERS:
-      UTStrBuf_chomp(sock->ioline);
-      if(UTRegexExtractInt(mdata->contentLengthPattern, line, 1, &req->contentLength, NULL, NULL)) {
-	myDebug(1, "got contentLength=%d", req->contentLength);
-      }
-      else if(UTSTRBUF_LEN(sock->ioline) == 0) {
-	req->state = req->contentLength
-	  ? HSPEAPIREQ_CONTENT
-	  : HSPEAPIREQ_LENGTH;
-      }
-      break;
-
-    case HSPEAPIREQ_ENDCONTENT:
-      UTStrBuf_chomp(sock->ioline);
-      if(UTSTRBUF_LEN(sock->ioline) == 0)
-	req->state = HSPEAPIREQ_LENGTH;
-      break;
-      
-    case HSPEAPIREQ_LENGTH: {
-      UTStrBuf_chomp(sock->ioline);
-      char *endp = NULL;
-      req->chunkLength = strtol(line, &endp, 16); // hex
-      if(*endp != '\0') {
-	// failed to consume the whole string - must be an error.
-	myDebug(1, "EAPI error: <%s> for request: <%s>",
-		line, UTSTRBUF_STR(req->request));
-	req->state = HSPEAPIREQ_ERR;
-      }
-      else {
-	req->state = req->chunkLength
-	  ? HSPEAPIREQ_CONTENT
-	  : HSPEAPIREQ_ENDCONTENT;
-      }
-      break;
-    }
-
-    case HSPEAPIREQ_CONTENT: {
-      int clen = req->chunkLength ?: req->contentLength;
-      assert(clen == UTSTRBUF_LEN(sock->ioline)); // assume no newlines in chunk
-      if(req->response == NULL)
-	req->response = UTStrBuf_new();
-      UTStrBuf_append_n(req->response, line, UTSTRBUF_LEN(sock->ioline));
-      req->state = HSPEAPIREQ_ENDCONTENT;
-      break;
-    }
-      
-    case HSPEAPIREQ_ERR:
-      // TODO: just wait for EOF, or should we force the socket to close?
-      break;
-    }
-  }
-
   /*________________---------------------------__________________
-    ________________      eapiRequest New/Free __________________
+    ________________    eapiResponse           __________________
     ----------------___________________________------------------
   */
 
-  static HSPEapiRequest *eapiRequestNew(EVMod *mod, HSPEapiCB jsonCB) {
-    HSPEapiRequest *req = (HSPEapiRequest *)my_calloc(sizeof(HSPEapiRequest));
-    req->request = UTStrBuf_new();
-    req->jsonCB = jsonCB;
-    return req;
-  }
-
-  static void  eapiRequestFree(EVMod *mod, HSPEapiRequest *req) {
-    myDebug(3, "eapiRequestFree");
-    UTStrBuf_free(req->request);
-    if(req->response) UTStrBuf_free(req->response);
-    my_free(req);
-  }
-
-  /*________________---------------------------__________________
-    ________________    readEapiCB             __________________
-    ----------------___________________________------------------
-  */
-  
-  static void readEapiCB(EVMod *mod, EVSocket *sock, EnumEVSocketReadStatus status, void *magic) {
-    HSP_mod_Eapi *mdata = (HSP_mod_Eapi *)mod->data;
-    HSPEapiRequest *req = (HSPEapiRequest *)magic;
-    myDebug(3, "readEapiCB: status=%d", status);
+  static void eapiResponse(EVMod *mod, UTHTTPRequest *req, EnumUTHTTPStatus status) {
+    HSPEapiCB jsonCB = (HSPEapiCB)req->magic;
+    myDebug(3, "eapiResponse: status=%d http=%d", status, req->httpStatus);
     switch(status) {
-    case EVSOCKETREAD_AGAIN:
+    case UTHTTP_CHUNK:
       break;
-    case EVSOCKETREAD_STR:
-      processEapiResponse(mod, sock, req);
-      UTStrBuf_reset(sock->ioline);
+    case UTHTTP_DONE:
+      if(req->httpStatus < 200
+	 || req->httpStatus >= 300)
+	myDebug(1, "EAPI error: HTTP %d <%s>", req->httpStatus, UTSTRBUF_STR(req->body));
+      else if(UTSTRBUF_LEN(req->body))
+	processEapiJSON(mod, jsonCB, req->body);
       break;
-    case EVSOCKETREAD_EOF:
-      if(req->response)
-	processEapiJSON(mod, req, req->response);
-      // fall through
-    case EVSOCKETREAD_BADF:
-    case EVSOCKETREAD_ERR:
-      // clean up
-      assert(mdata->currentRequests > 0);
-      --mdata->currentRequests;
-      eapiRequestFree(mod, req);
-      req = NULL;
-    }
-  }
-
-  static void readEapi(EVMod *mod, EVSocket *sock, void *magic) {
-    EVSocketReadLines(mod, sock, readEapiCB, magic);
-  }
-
-  static void eapiRequest(EVMod *mod, HSPEapiRequest *req) {
-    HSP_mod_Eapi *mdata = (HSP_mod_Eapi *)mod->data;
-    char *cmd = UTSTRBUF_STR(req->request);
-    ssize_t len = UTSTRBUF_LEN(req->request);
-    int fd = UTUnixDomainSocket(HSP_EAPI_SOCK);
-    myDebug(1, "eapiRequest(%s) fd==%d", cmd, fd);
-    if(fd < 0)  {
+    case UTHTTP_NOSOCKET:
       myLog(LOG_ERR, "eapiRequest - cannot open unixsocket: %s", HSP_EAPI_SOCK);
-    }
-    else {
-      EVBusAddSocket(mod, mdata->configBus, fd, readEapi, req);
-      int cc;
-      while((cc = write(fd, cmd, len)) != len && errno == EINTR);
-      if(cc == len) {
-	myDebug(3, "eapiRequest: request sent");
-	mdata->currentRequests++;
-      }
-      else {
-	myLog(LOG_ERR, "eapiRequest - write(%s) returned %d != %u: %s",
-	      cmd, cc, len, strerror(errno));
-      }
+      break;
+    case UTHTTP_ERR:
+      myDebug(1, "eapiRequest - connection lost");
+      break;
     }
   }
 
@@ -362,6 +216,7 @@ Expecting something like:
 
   static void eapi(EVMod *mod)
   {
+    HSP_mod_Eapi *mdata = (HSP_mod_Eapi *)mod->data;
     cJSON *root = cJSON_CreateObject(), *params, *cmds;
     cJSON_AddItemToObject(root, "jsonrpc", cJSON_CreateString("2.0"));
     cJSON_AddItemToObject(root, "method", cJSON_CreateString("runCmds"));
@@ -372,11 +227,12 @@ Expecting something like:
     cJSON_AddItemToObject(params, "format", cJSON_CreateString("json"));
     cJSON_AddItemToObject(params, "timestamps", cJSON_CreateBool(NO));
     cJSON_AddItemToObject(root, "id", cJSON_CreateString("hsflowd-1"));
-    HSPEapiRequest *req = eapiRequestNew(mod, eapi_show_sflow);
+    UTHTTPRequest *req = UTHTTPRequestNew("POST", "/", eapiResponse, (void *)eapi_show_sflow);
     char *msg = cJSON_Print(root);
-    UTStrBuf_printf(req->request, HSP_EAPI_REQ_FMT, my_strlen(msg), msg);
+    UTHTTPRequestContent(req, "application/json", msg);
+    my_free(msg);
     cJSON_Delete(root);
-    eapiRequest(mod, req);
+    UTHTTPSend(mdata->http, req);
   }
 
   /*_________________---------------------------__________________
@@ -403,7 +259,6 @@ Expecting something like:
     HSP_mod_Eapi *mdata = (HSP_mod_Eapi *)mod->data;
     mdata->retryDelay = HSP_DEFAULT_EAPI_RETRYDELAY;
     mdata->countdown = HSP_DEFAULT_EAPI_STARTDELAY;
-    mdata->contentLengthPattern = UTRegexCompile(HSP_CONTENT_LENGTH_REGEX);
 
     // register call-backs
     mdata->pollBus = EVGetBus(mod, HSPBUS_POLL, YES);
@@ -414,6 +269,8 @@ Expecting something like:
     // not sure if we need a different bus here - only necessary if
     // we think we might block the thread for more than about 200mS
     mdata->configBus = EVGetBus(mod, HSPBUS_CONFIG, YES);
+    mdata->http = UTHTTPClientNew(mod, mdata->configBus, HSP_EAPI_SOCK, HSP_EAPI_HOST,
+				  HSP_EAPI_HTTP_CONNS, HSP_EAPI_HTTP_PIPELINE);
     EVEventRx(mod, EVGetEvent(mdata->configBus, EVEVENT_TICK), evt_tick);
   }
 
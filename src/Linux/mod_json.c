@@ -70,6 +70,9 @@ extern "C" {
     UTQ(HSPApplication) timeoutQ;
     UTArray *pollActions;
     time_t next_app_timeout_check;
+    // telemetry
+    uint32_t t_msgs;
+    uint32_t t_parse_errors;
   } HSP_mod_JSON;
 
   /*_________________---------------------------__________________
@@ -114,7 +117,7 @@ extern "C" {
 
     assert(EVCurrentBus() == mdata->packetBus);
 
-    SEMLOCK_DO(sp->sync_agent) {
+    TIMEDLOCK_DO(sp->sync_receiver) {
       // we stashed a pointer to the application in the userData field
       HSPApplication *application = (HSPApplication *)poller->userData;
 
@@ -134,7 +137,7 @@ extern "C" {
 	  SFLADD_ELEMENT(cs, &application->counters);
 	  sfl_poller_writeCountersSample(poller, cs);
 	  sp->counterSampleQueued = YES;
-	  sp->telemetry[HSP_TELEMETRY_COUNTER_SAMPLES]++;
+	  HSP_TELEMETRY_INC(HSP_TELEMETRY_COUNTER_SAMPLES);
 	  // and any rtcount metrics that we have been collecting
 	}
       }
@@ -177,7 +180,7 @@ extern "C" {
     // before we allocate anything, make sure there isn't a clash on servicePort
     if(servicePort) {
       SFLPoller *poller = NULL;
-      SEMLOCK_DO(sp->sync_agent) {
+      TIMEDLOCK_DO(sp->sync_pollers) {
 	poller = sfl_agent_getPoller(sp->agent, &dsi);
       }
       if(poller) {
@@ -198,10 +201,10 @@ extern "C" {
     aa->servicePort = servicePort;
     uint32_t sampling_n = 0;
     uint32_t polling_secs = 0;
-    aa->settings_revisionNo = sp->revisionNo;
+    aa->settings_revisionNo = sp->appSettingsRevisionNo;
     lookupApplicationSettings(sp->sFlowSettings, "app", application, &sampling_n, &polling_secs);
     // poller
-    SEMLOCK_DO(sp->sync_agent) {
+    TIMEDLOCK_DO(sp->sync_pollers) {
       aa->poller = sfl_agent_addPoller(sp->agent, &dsi, mod, agentCB_getCounters_request);
       sfl_poller_set_sFlowCpInterval(aa->poller, polling_secs);
       sfl_poller_set_sFlowCpReceiver(aa->poller, HSP_SFLOW_RECEIVER_INDEX);
@@ -216,7 +219,7 @@ extern "C" {
     aa->json_counters = YES;
     aa->last_json_counters = mdata->packetBus->now.tv_sec;
     // sampler
-    SEMLOCK_DO(sp->sync_agent) {
+    TIMEDLOCK_DO(sp->sync_samplers) {
       aa->sampler = sfl_agent_addSampler(sp->agent, &dsi);
       sfl_sampler_set_sFlowFsPacketSamplingRate(aa->sampler, sampling_n);
       sfl_sampler_set_sFlowFsReceiver(aa->sampler, HSP_SFLOW_RECEIVER_INDEX);
@@ -268,13 +271,15 @@ extern "C" {
       // could move this to agentCB_getCounters(), but the test is not expensive
       // so doing it for every sample seems OK... and smoother than changing them
       // all at once.  This way they change when the next sample comes in.
-      if(aa->settings_revisionNo != sp->revisionNo) {
+      if(aa->settings_revisionNo != sp->appSettingsRevisionNo) {
 	uint32_t sampling_n = 0;
 	uint32_t polling_secs = 0;
-	aa->settings_revisionNo = sp->revisionNo;
+	aa->settings_revisionNo = sp->appSettingsRevisionNo;
 	lookupApplicationSettings(sp->sFlowSettings, "app", application, &sampling_n, &polling_secs);
-	SEMLOCK_DO(sp->sync_agent) {
+	TIMEDLOCK_DO(sp->sync_pollers) {
 	  sfl_poller_set_sFlowCpInterval(aa->poller, polling_secs);
+	}
+	TIMEDLOCK_DO(sp->sync_samplers) {
 	  sfl_sampler_set_sFlowFsPacketSamplingRate(aa->sampler, sampling_n);
 	}
       }
@@ -309,10 +314,12 @@ extern "C" {
       // remove from HT
       UTHashDel(mdata->applicationHT, aa);
       // remove sampler and poller
-      SEMLOCK_DO(sp->sync_agent) {
-	sfl_agent_removeSampler(sp->agent, &aa->sampler->dsi);
+      TIMEDLOCK_DO(sp->sync_pollers) {
 	sfl_agent_removePoller(sp->agent, &aa->poller->dsi);
       }
+      TIMEDLOCK_DO(sp->sync_samplers) {
+	sfl_agent_removeSampler(sp->agent, &aa->sampler->dsi);
+      }
       // maybe it was just added to the pollActions by the other thread?
       // Make sure it's not there by deleting it here.
       // TODO: identity-hash would be faster here.
@@ -420,11 +427,11 @@ extern "C" {
     myDebug(2, "sendAppSample (sampling_n=%d)", sampling_n);
     // and send it out
     EVBus *bus = EVCurrentBus();
-    sfl_agent_set_now(sp->agent, bus->now.tv_sec, bus->now.tv_nsec);
-    SEMLOCK_DO(sp->sync_agent) {
+    TIMEDLOCK_DO(sp->sync_receiver) {
+      sfl_agent_set_now(sp->agent, bus->now.tv_sec, bus->now.tv_nsec);
       sfl_sampler_writeFlowSample(app->sampler, &fs);
-      sp->telemetry[HSP_TELEMETRY_FLOW_SAMPLES]++;
     }
+    HSP_TELEMETRY_INC(HSP_TELEMETRY_FLOW_SAMPLES);
   }
 
   /*_________________---------------------------__________________
@@ -676,11 +683,11 @@ static void readJSON_flowSample(EVMod *mod, cJSON *fs)
         SFLADD_ELEMENT(&csample, &c_par);
 
 	// submit the counter sample
-	SEMLOCK_DO(sp->sync_agent) {
+	TIMEDLOCK_DO(sp->sync_receiver) {
 	  sfl_poller_writeCountersSample(application->poller, &csample);
 	  sp->counterSampleQueued = YES;
-	  sp->telemetry[HSP_TELEMETRY_COUNTER_SAMPLES]++;
 	}
+	HSP_TELEMETRY_INC(HSP_TELEMETRY_COUNTER_SAMPLES);
       }
     }
   }
@@ -960,13 +967,13 @@ static void readJSON_flowSample(EVMod *mod, cJSON *fs)
       uint32_t len = (char *)xdr_ptr(&buf) - (char *)mstart - 4;
       mstart[0] = htonl(len);
       fstart[0] = htonl(num_fields);
-      SEMLOCK_DO(sp->sync_agent) {
+      TIMEDLOCK_DO(sp->sync_receiver) {
 	sfl_receiver_writeEncoded(receiver,
 				  1,
 				  buf.xdr,
 				  (buf.cursor << 2));
-	sp->telemetry[HSP_TELEMETRY_RTMETRIC_SAMPLES]++;
       }
+      HSP_TELEMETRY_INC(HSP_TELEMETRY_RTMETRIC_SAMPLES);
     }
   }
 
@@ -1193,13 +1200,13 @@ static void readJSON_flowSample(EVMod *mod, cJSON *fs)
       uint32_t len = (char *)xdr_ptr(&buf) - (char *)mstart - 4;
       mstart[0] = htonl(len);
       fstart[0] = htonl(num_fields);
-      SEMLOCK_DO(sp->sync_agent) {
+      TIMEDLOCK_DO(sp->sync_receiver) {
 	sfl_receiver_writeEncoded(receiver,
 				  1,
 				  buf.xdr,
 				  (buf.cursor << 2));
-	sp->telemetry[HSP_TELEMETRY_RTFLOW_SAMPLES]++;
       }
+      HSP_TELEMETRY_INC(HSP_TELEMETRY_RTFLOW_SAMPLES);
     }
   }
 
@@ -1210,6 +1217,7 @@ static void readJSON_flowSample(EVMod *mod, cJSON *fs)
 
   static void readJSON(EVMod *mod, EVSocket *sock, void *magic)
   {
+    HSP_mod_JSON *mdata = (HSP_mod_JSON *)mod->data;
     HSP *sp = (HSP *)EVROOTDATA(mod);
 
     if(sp->sFlowSettings == NULL) {
@@ -1224,8 +1232,11 @@ static void readJSON_flowSample(EVMod *mod, cJSON *fs)
 	int len = read(sock->fd, buf, HSP_MAX_JSON_MSG_BYTES);
 	if(len <= 0) break;
 	myDebug(2, "got JSON msg: %u bytes", len);
+	HSP_TELEMETRY_INC(mdata->t_msgs);
 	cJSON *top = cJSON_Parse(buf);
-	if(top) {
+	if(top == NULL)
+	  HSP_TELEMETRY_INC(mdata->t_parse_errors);
+	else {
 	  if(getDebug()) logJSON(top, "got JSON message");
 	  cJSON *fs = cJSON_GetObjectItem(top, "flow_sample");
 	  if(fs) readJSON_flowSample(mod, fs);
@@ -1290,6 +1301,8 @@ static void readJSON_flowSample(EVMod *mod, cJSON *fs)
     mdata->pollActions = UTArrayNew(UTARRAY_SYNC);
     // but the applicationHT is only ever accessed from the packetBus
     mdata->applicationHT = UTHASH_NEW(HSPApplication, application, UTHASH_SKEY);
+    mdata->t_msgs = telemetryRegister("json_msgs", HSPTELEMETRY_COUNTER);
+    mdata->t_parse_errors = telemetryRegister("json_parse_errors", HSPTELEMETRY_COUNTER);
 
     mdata->pollBus = EVGetBus(mod, HSPBUS_POLL, YES);
     mdata->packetBus = EVGetBus(mod, HSPBUS_PACKET, YES);
@@ -129,7 +129,7 @@ extern "C" {
 	    if(--MySkipCount == 0) {
 	      /* reached zero. Set the next skip */
 	      uint32_t sr = mdata->subSamplingRate;
-	      MySkipCount = sr == 1 ? 1 : sfl_random((2 * sr) - 1);
+	      MySkipCount = sfl_random_skip(NULL, sr);
 
 	      /* and take a sample */
 	      char *prefix = nfnl_get_pointer_to_data(tb, NFULA_PREFIX, char);
@@ -931,6 +931,9 @@ extern "C" {
     // make sure CPS sFlow is pointed at the right socket
     CPSSetSampleUDPPort(mod);
 
+    if(!(sFlowSettingsChangeMask(data, dataLen) & HSP_SETTINGS_CHANGED_SAMPLING))
+      return;
+
     uint64_t allocated1 = cps_api_objects_allocated();
 
     // The sampling-rate settings may have changed.
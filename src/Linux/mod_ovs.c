@@ -7,6 +7,7 @@ extern "C" {
 #endif
 
 #include "hsflowd.h"
+#include "cJSON.h"
 
   typedef enum { SFVSSTATE_INIT=0,
 		 SFVSSTATE_READCONFIG,
@@ -15,6 +16,7 @@ extern "C" {
 		 SFVSSTATE_SYNC_SEARCH,
 		 SFVSSTATE_SYNC_FOUND,
 		 SFVSSTATE_SYNC_DESTROY,
+		 SFVSSTATE_SYNC_TRANSACT,
 		 SFVSSTATE_SYNC_FAILED,
 		 SFVSSTATE_SYNC_OK,
 		 SFVSSTATE_END,
@@ -28,6 +30,7 @@ extern "C" {
     "SYNC_SEARCH",
     "SYNC_FOUND",
     "SYNC_DESTROY",
+    "SYNC_TRANSACT",
     "SYNC_FAILED",
     "SYNC_OK",
     "END"
@@ -62,6 +65,37 @@ extern "C" {
 // new sflow id must start with '@'
 #define SFVS_NEW_SFLOW_ID "@newsflow"
 
+// direct JSON-RPC connection to ovsdb-server (RFC 7047). When
+// this is available we use it in preference to ovs-vsctl.  Like
+// ovs-vsctl, look for the socket under $OVS_RUNDIR if it is set.
+#define SFVS_OVSDB_RUNDIR "/var/run/openvswitch"
+#define SFVS_OVSDB_SOCK "db.sock"
+#define SFVS_OVSDB_DB "Open_vSwitch"
+#define SFVS_OVSDB_NEW_SFLOW_ID "newsflow"
+#define SFVS_OVSDB_RETRY_SECS 30
+// schema 7.0.0 shipped with OVS 2.0.  Older servers are left to
+// ovs-vsctl,  which knows how to work around their differences.
+#define SFVS_OVSDB_MIN_SCHEMA_MAJOR 7
+// don't keep retrying a server whose schema we can't use
+#define SFVS_OVSDB_SCHEMA_RETRY_SECS 600
+#define SFVS_OVSDB_FINAL_WAIT_MS 2000
+
+  // local replica of the rows we monitor
+  typedef struct _SFVSBridge {
+    char *uuid;
+    char *name;
+    char *sflow; // uuid of referenced sFlow row (or NULL)
+  } SFVSBridge;
+
+  typedef struct _SFVSSFlow {
+    char *uuid;
+    char *agent;
+    uint32_t header;
+    uint32_t polling;
+    uint32_t sampling;
+    UTStringArray *targets;
+  } SFVSSFlow;
+
   typedef struct _HSP_mod_OVS {
     EnumSFVSState state;
     time_t tick;
@@ -75,6 +109,23 @@ extern "C" {
     int usingAtVar;
     int usedAtVarOK;
     int ovs10;
+    // OVSDB
+    EVBus *pollBus;
+    EVSocket *ovsdb;
+    char *ovsdb_path;
+    time_t ovsdb_retry;
+    UTStrBuf *ovsdb_rx;
+    size_t ovsdb_scan;
+    int ovsdb_depth;
+    bool ovsdb_inStr;
+    bool ovsdb_esc;
+    uint32_t ovsdb_id;
+    uint32_t ovsdb_schema_id;
+    uint32_t ovsdb_monitor_id;
+    uint32_t ovsdb_txn_id;
+    bool ovsdb_monitoring;
+    UTHash *ovsdb_bridges;
+    UTHash *ovsdb_sflows;
   } HSP_mod_OVS;
 
   /*_________________---------------------------__________________
@@ -188,6 +239,13 @@ extern "C" {
     return str;
   }
 
+  static bool haveConfig(EVMod *mod) {
+    HSP_mod_OVS *mdata = (HSP_mod_OVS *)mod->data;
+    return (mdata->config.error == NO
+	    && mdata->config.num_collectors > 0
+	    && (mdata->config.sampling_n > 0 || mdata->config.polling_secs > 0));
+  }
+
   /*_________________---------------------------__________________
     _________________     syncOVS - utils       __________________
     -----------------___________________________------------------
@@ -487,9 +545,7 @@ extern "C" {
     myExec((void *)mod, version_cmd, readVersion, line, SFVS_MAX_LINELEN, NULL);
     // adapt if OVS is upgraded under our feet
     if(mdata->ovs10 == NO) mdata->useAtVar = YES;
-    if(mdata->config.error
-       || mdata->config.num_collectors == 0
-       || (mdata->config.sampling_n == 0 && mdata->config.polling_secs == 0)) {
+    if(!haveConfig(mod)) {
       // no config or no targets or no sampling/polling - clear everything
       myDebug(1, "no config found: clearing all OVS sFlow config");
       setStr(&mdata->sflowUUID, "[]");
@@ -554,7 +610,607 @@ extern "C" {
     return mdata->cmdFailed ? NO : YES;
   }
 
+  /*_________________---------------------------__________________
+    _________________      OVSDB - replica      __________________
+    -----------------___________________________------------------
+  */
+
+  static void bridgeFree(SFVSBridge *br) {
+    setStr(&br->uuid, NULL);
+    setStr(&br->name, NULL);
+    setStr(&br->sflow, NULL);
+    my_free(br);
+  }
+
+  static void sflowFree(SFVSSFlow *sfl) {
+    setStr(&sfl->uuid, NULL);
+    setStr(&sfl->agent, NULL);
+    strArrayFree(sfl->targets);
+    my_free(sfl);
+  }
+
+  static void ovsdbClearReplica(EVMod *mod) {
+    HSP_mod_OVS *mdata = (HSP_mod_OVS *)mod->data;
+    SFVSBridge *br;
+    UTHASH_WALK(mdata->ovsdb_bridges, br) bridgeFree(br);
+    UTHashReset(mdata->ovsdb_bridges);
+    SFVSSFlow *sfl;
+    UTHASH_WALK(mdata->ovsdb_sflows, sfl) sflowFree(sfl);
+    UTHashReset(mdata->ovsdb_sflows);
+  }
+
+  // OVSDB encodes an empty optional value as ["set",[]], a
+  // single-valued one as the bare atom, and a uuid as ["uuid","..."]
+
+  static char *ovsdbString(cJSON *val) {
+    if(val && val->type == cJSON_String)
+      return val->valuestring;
+    return NULL;
+  }
+
+  static uint32_t ovsdbInteger(cJSON *val) {
+    if(val && val->type == cJSON_Number)
+      return (uint32_t)val->valueint;
+    return 0;
+  }
+
+  static char *ovsdbUUID(cJSON *val) {
+    if(val
+       && val->type == cJSON_Array
+       && cJSON_GetArraySize(val) == 2
+       && my_strequal(cJSON_GetArrayItem(val, 0)->valuestring, "uuid"))
+      return cJSON_GetArrayItem(val, 1)->valuestring;
+    return NULL;
+  }
+
+  static void ovsdbStringSet(cJSON *val, UTStringArray *ar) {
+    strArrayReset(ar);
+    if(val == NULL)
+      return;
+    if(val->type == cJSON_String)
+      strArrayAdd(ar, val->valuestring);
+    else if(val->type == cJSON_Array
+	    && cJSON_GetArraySize(val) == 2
+	    && my_strequal(cJSON_GetArrayItem(val, 0)->valuestring, "set")) {
+      cJSON *elem;
+      cJSON_ArrayForEach(elem, cJSON_GetArrayItem(val, 1)) {
+	if(elem->type == cJSON_String)
+	  strArrayAdd(ar, elem->valuestring);
+      }
+    }
+    strArraySort(ar);
+  }
+
+  /*_________________---------------------------__________________
+    _________________    ovsdbApplyUpdates      __________________
+    -----------------___________________________------------------
+    Apply a <table-updates> object from the monitor reply or an
+    "update" notification. With monitor (v1) semantics "new" holds
+    every monitored column, so a row with "new" is replaced outright
+    and a row with only "old" has been deleted.
+  */
+
+  static void ovsdbApplyUpdates(EVMod *mod, cJSON *updates) {
+    HSP_mod_OVS *mdata = (HSP_mod_OVS *)mod->data;
+    if(updates == NULL)
+      return;
+    cJSON *row;
+    cJSON *bridges = cJSON_GetObjectItem(updates, "Bridge");
+    if(bridges) {
+      cJSON_ArrayForEach(row, bridges) {
+	SFVSBridge search = { .uuid = row->string };
+	SFVSBridge *br = UTHashDelKey(mdata->ovsdb_bridges, &search);
+	if(br)
+	  bridgeFree(br);
+	cJSON *new = cJSON_GetObjectItem(row, "new");
+	if(new) {
+	  br = (SFVSBridge *)my_calloc(sizeof(SFVSBridge));
+	  setStr(&br->uuid, row->string);
+	  setStr(&br->name, ovsdbString(cJSON_GetObjectItem(new, "name")));
+	  setStr(&br->sflow, ovsdbUUID(cJSON_GetObjectItem(new, "sflow")));
+	  UTHashAdd(mdata->ovsdb_bridges, br);
+	  myDebug(1, "ovsdb bridge %s sflow=%s", br->name, br->sflow ?: "[]");
+	}
+      }
+    }
+    cJSON *sflows = cJSON_GetObjectItem(updates, "sFlow");
+    if(sflows) {
+      cJSON_ArrayForEach(row, sflows) {
+	SFVSSFlow search = { .uuid = row->string };
+	SFVSSFlow *sfl = UTHashDelKey(mdata->ovsdb_sflows, &search);
+	if(sfl)
+	  sflowFree(sfl);
+	cJSON *new = cJSON_GetObjectItem(row, "new");
+	if(new) {
+	  sfl = (SFVSSFlow *)my_calloc(sizeof(SFVSSFlow));
+	  sfl->targets = strArrayNew();
+	  setStr(&sfl->uuid, row->string);
+	  setStr(&sfl->agent, ovsdbString(cJSON_GetObjectItem(new, "agent")));
+	  sfl->header = ovsdbInteger(cJSON_GetObjectItem(new, "header"));
+	  sfl->polling = ovsdbInteger(cJSON_GetObjectItem(new, "polling"));
+	  sfl->sampling = ovsdbInteger(cJSON_GetObjectItem(new, "sampling"));
+	  ovsdbStringSet(cJSON_GetObjectItem(new, "targets"), sfl->targets);
+	  UTHashAdd(mdata->ovsdb_sflows, sfl);
+	  myDebug(1, "ovsdb sflow %s", sfl->uuid);
+	}
+      }
+    }
+  }
+
+  /*_________________---------------------------__________________
+    _________________      OVSDB - requests     __________________
+    -----------------___________________________------------------
+  */
+
+  static void ovsdbDisconnect(EVMod *mod);
+
+  static bool ovsdbSend(EVMod *mod, cJSON *msg) {
+    HSP_mod_OVS *mdata = (HSP_mod_OVS *)mod->data;
+    char *str = cJSON_PrintUnformatted(msg);
+    cJSON_Delete(msg);
+    myDebug(2, "ovsdb send: %s", str);
+    int len = my_strlen(str);
+    int sent = 0;
+    while(sent < len) {
+      int cc = write(mdata->ovsdb->fd, str + sent, len - sent);
+      if(cc < 0 && errno == EINTR)
+	continue;
+      if(cc <= 0) {
+	myLog(LOG_ERR, "OVS: ovsdb write failed: %s", strerror(errno));
+	break;
+      }
+      sent += cc;
+    }
+    my_free(str);
+    if(sent < len) {
+      ovsdbDisconnect(mod);
+      return NO;
+    }
+    return YES;
+  }
+
+  static cJSON *ovsdbRequest(EVMod *mod, char *method, uint32_t *p_id) {
+    HSP_mod_OVS *mdata = (HSP_mod_OVS *)mod->data;
+    cJSON *req = cJSON_CreateObject();
+    cJSON_AddStringToObject(req, "method", method);
+    cJSON *params = cJSON_CreateArray();
+    cJSON_AddItemToArray(params, cJSON_CreateString(SFVS_OVSDB_DB));
+    cJSON_AddItemToObject(req, "params", params);
+    *p_id = ++mdata->ovsdb_id;
+    cJSON_AddNumberToObject(req, "id", *p_id);
+    return req;
+  }
+
+  // the columns we monitor,  and so require the schema to have
+  static const char *ovsdbBridgeCols[] = { "name", "sflow" };
+  static const char *ovsdbSFlowCols[] = { "agent", "header", "polling", "sampling", "targets" };
+#define SFVS_OVSDB_NCOLS(cols) (sizeof(cols) / sizeof(cols[0]))
+
+  static bool ovsdbGetSchema(EVMod *mod) {
+    HSP_mod_OVS *mdata = (HSP_mod_OVS *)mod->data;
+    return ovsdbSend(mod, ovsdbRequest(mod, "get_schema", &mdata->ovsdb_schema_id));
+  }
+
+  static void ovsdbMonitorColumns(cJSON *monitor, char *table, const char **cols, int n) {
+    cJSON *req = cJSON_CreateObject();
+    cJSON_AddItemToObject(req, "columns", cJSON_CreateStringArray(cols, n));
+    cJSON_AddItemToObject(monitor, table, req);
+  }
+
+  static bool ovsdbMonitor(EVMod *mod) {
+    HSP_mod_OVS *mdata = (HSP_mod_OVS *)mod->data;
+    cJSON *req = ovsdbRequest(mod, "monitor", &mdata->ovsdb_monitor_id);
+    cJSON *params = cJSON_GetObjectItem(req, "params");
+    cJSON_AddItemToArray(params, cJSON_CreateNull());
+    cJSON *monitor = cJSON_CreateObject();
+    ovsdbMonitorColumns(monitor, "Bridge", ovsdbBridgeCols, SFVS_OVSDB_NCOLS(ovsdbBridgeCols));
+    ovsdbMonitorColumns(monitor, "sFlow", ovsdbSFlowCols, SFVS_OVSDB_NCOLS(ovsdbSFlowCols));
+    cJSON_AddItemToArray(params, monitor);
+    return ovsdbSend(mod, req);
+  }
+
+  static cJSON *ovsdbEmptySet(void) {
+    cJSON *set = cJSON_CreateArray();
+    cJSON_AddItemToArray(set, cJSON_CreateString("set"));
+    cJSON_AddItemToArray(set, cJSON_CreateArray());
+    return set;
+  }
+
+  static cJSON *ovsdbRef(char *type, char *id) {
+    cJSON *ref = cJSON_CreateArray();
+    cJSON_AddItemToArray(ref, cJSON_CreateString(type));
+    cJSON_AddItemToArray(ref, cJSON_CreateString(id));
+    return ref;
+  }
+
+  static cJSON *ovsdbOp(char *op, char *table, char *uuid, cJSON *row) {
+    cJSON *obj = cJSON_CreateObject();
+    cJSON_AddStringToObject(obj, "op", op);
+    cJSON_AddStringToObject(obj, "table", table);
+    if(uuid) {
+      // where: [["_uuid", "==", ["uuid", <uuid>]]]
+      cJSON *cond = cJSON_CreateArray();
+      cJSON_AddItemToArray(cond, cJSON_CreateString("_uuid"));
+      cJSON_AddItemToArray(cond, cJSON_CreateString("=="));
+      cJSON_AddItemToArray(cond, ovsdbRef("uuid", uuid));
+      cJSON *where = cJSON_CreateArray();
+      cJSON_AddItemToArray(where, cond);
+      cJSON_AddItemToObject(obj, "where", where);
+    }
+    cJSON_AddItemToObject(obj, "row", row);
+    return obj;
+  }
+
+  static cJSON *ovsdbSFlowRow(EVMod *mod) {
+    HSP_mod_OVS *mdata = (HSP_mod_OVS *)mod->data;
+    cJSON *row = cJSON_CreateObject();
+    if(mdata->config.agent_dev)
+      cJSON_AddStringToObject(row, "agent", mdata->config.agent_dev);
+    else
+      cJSON_AddItemToObject(row, "agent", ovsdbEmptySet());
+    cJSON_AddNumberToObject(row, "header", mdata->config.header_bytes);
+    cJSON_AddNumberToObject(row, "polling", mdata->config.polling_secs);
+    cJSON_AddNumberToObject(row, "sampling", mdata->config.sampling_n);
+    cJSON *targets = cJSON_CreateArray();
+    cJSON_AddItemToArray(targets, cJSON_CreateString("set"));
+    cJSON_AddItemToArray(targets, cJSON_CreateStringArray((const char **)strArray(mdata->config.targets),
+							  strArrayN(mdata->config.targets)));
+    cJSON_AddItemToObject(row, "targets", targets);
+    return row;
+  }
+
+  static bool sflowMatchesConfig(EVMod *mod, SFVSSFlow *sfl) {
+    HSP_mod_OVS *mdata = (HSP_mod_OVS *)mod->data;
+    return (my_strequal(sfl->agent, mdata->config.agent_dev)
+	    && sfl->header == mdata->config.header_bytes
+	    && sfl->polling == mdata->config.polling_secs
+	    && sfl->sampling == mdata->config.sampling_n
+	    && strArrayEqual(sfl->targets, mdata->config.targets));
+  }
+
+  /*_________________---------------------------__________________
+    _________________       syncOVSDB           __________________
+    -----------------___________________________------------------
+    Compare the replica with the config and submit whatever
+    changes are needed as a single transaction.  We keep the first
+    sFlow row that is referenced by a bridge and point every bridge
+    at it.  There is no need to destroy the others: sFlow is not a
+    root table, so ovsdb-server garbage-collects unreferenced rows.
+  */
+
+  static bool syncOVSDB(EVMod *mod) {
+    HSP_mod_OVS *mdata = (HSP_mod_OVS *)mod->data;
+    uint32_t txn_id;
+    cJSON *req = ovsdbRequest(mod, "transact", &txn_id);
+    cJSON *ops = cJSON_GetObjectItem(req, "params");
+    int nops = 0;
+    SFVSBridge *br;
+
+    if(!haveConfig(mod)) {
+      myDebug(1, "no config found: clearing all OVS sFlow config");
+      UTHASH_WALK(mdata->ovsdb_bridges, br) {
+	if(br->sflow) {
+	  cJSON *row = cJSON_CreateObject();
+	  cJSON_AddItemToObject(row, "sflow", ovsdbEmptySet());
+	  cJSON_AddItemToArray(ops, ovsdbOp("update", "Bridge", br->uuid, row));
+	  nops++;
+	}
+      }
+    }
+    else {
+      SFVSSFlow *keep = NULL;
+      UTHASH_WALK(mdata->ovsdb_bridges, br) {
+	if(br->sflow) {
+	  SFVSSFlow search = { .uuid = br->sflow };
+	  if((keep = UTHashGet(mdata->ovsdb_sflows, &search)) != NULL)
+	    break;
+	}
+      }
+      char *refType = "uuid";
+      char *refId;
+      if(keep) {
+	myDebug(1, "adopting sflow uuid %s", keep->uuid);
+	refId = keep->uuid;
+	if(!sflowMatchesConfig(mod, keep)) {
+	  cJSON_AddItemToArray(ops, ovsdbOp("update", "sFlow", keep->uuid, ovsdbSFlowRow(mod)));
+	  nops++;
+	}
+      }
+      else {
+	refType = "named-uuid";
+	refId = SFVS_OVSDB_NEW_SFLOW_ID;
+	cJSON *op = ovsdbOp("insert", "sFlow", NULL, ovsdbSFlowRow(mod));
+	cJSON_AddStringToObject(op, "uuid-name", SFVS_OVSDB_NEW_SFLOW_ID);
+	cJSON_AddItemToArray(ops, op);
+	nops++;
+      }
+      int nbridges = 0;
+      UTHASH_WALK(mdata->ovsdb_bridges, br) {
+	if(keep == NULL
+	   || !my_strequal(br->sflow, keep->uuid)) {
+	  myDebug(1, "setting sflow for bridge %s", br->name);
+	  cJSON *row = cJSON_CreateObject();
+	  cJSON_AddItemToObject(row, "sflow", ovsdbRef(refType, refId));
+	  cJSON_AddItemToArray(ops, ovsdbOp("update", "Bridge", br->uuid, row));
+	  nops++;
+	  nbridges++;
+	}
+      }
+      if(keep == NULL && nbridges == 0) {
+	// no bridges yet - an unreferenced row would just be collected
+	nops = 0;
+      }
+    }
+
+    if(nops == 0) {
+      cJSON_Delete(req);
+      setState(mod, SFVSSTATE_SYNC_OK);
+      return YES;
+    }
+    if(debug(1)) {
+      char *str = cJSON_PrintUnformatted(ops);
+      myLog(LOG_INFO, "ovsdb transact: %s", str);
+      my_free(str);
+    }
+    mdata->ovsdb_txn_id = txn_id;
+    if(!ovsdbSend(mod, req))
+      return NO;
+    setState(mod, SFVSSTATE_SYNC_TRANSACT);
+    return YES;
+  }
+
+  /*_________________---------------------------__________________
+    _________________      OVSDB - replies      __________________
+    -----------------___________________________------------------
+  */
+
+  static bool ovsdbTransactOK(cJSON *result) {
+    bool ok = YES;
+    cJSON *opr;
+    cJSON_ArrayForEach(opr, result) {
+      cJSON *err = cJSON_GetObjectItem(opr, "error");
+      if(err && err->type == cJSON_String) {
+	cJSON *details = cJSON_GetObjectItem(opr, "details");
+	myLog(LOG_ERR, "OVS: ovsdb transaction error: %s (%s)",
+	      err->valuestring,
+	      ovsdbString(details) ?: "");
+	ok = NO;
+      }
+    }
+    return ok;
+  }
+
+  /*_________________---------------------------__________________
+    _________________    ovsdbSchemaOK          __________________
+    -----------------___________________________------------------
+    Check the get_schema reply before we monitor or transact.  A
+    server that is too old, or whose tables have lost a column we
+    use, is treated like one that is not there: we fall back on
+    ovs-vsctl and only try again after SFVS_OVSDB_SCHEMA_RETRY_SECS.
+  */
+
+  static bool ovsdbTableOK(cJSON *tables, char *table, const char **cols, int n) {
+    cJSON *columns = cJSON_GetObjectItem(cJSON_GetObjectItem(tables, table), "columns");
+    if(columns == NULL) {
+      myLog(LOG_ERR, "OVS: ovsdb schema has no %s table", table);
+      return NO;
+    }
+    for(int ii = 0; ii < n; ii++) {
+      if(cJSON_GetObjectItem(columns, cols[ii]) == NULL) {
+	myLog(LOG_ERR, "OVS: ovsdb schema has no %s:%s column", table, cols[ii]);
+	return NO;
+      }
+    }
+    return YES;
+  }
+
+  static bool ovsdbSchemaOK(cJSON *schema) {
+    char *version = ovsdbString(cJSON_GetObjectItem(schema, "version"));
+    uint32_t major = 0;
+    if(version == NULL
+       || sscanf(version, "%u.", &major) != 1
+       || major < SFVS_OVSDB_MIN_SCHEMA_MAJOR) {
+      myLog(LOG_ERR, "OVS: ovsdb schema version %s not supported (need %u.0.0 or later)",
+	    version ?: "<none>",
+	    SFVS_OVSDB_MIN_SCHEMA_MAJOR);
+      return NO;
+    }
+    cJSON *tables = cJSON_GetObjectItem(schema, "tables");
+    if(!ovsdbTableOK(tables, "Bridge", ovsdbBridgeCols, SFVS_OVSDB_NCOLS(ovsdbBridgeCols))
+       || !ovsdbTableOK(tables, "sFlow", ovsdbSFlowCols, SFVS_OVSDB_NCOLS(ovsdbSFlowCols)))
+      return NO;
+    myDebug(1, "ovsdb schema version %s OK", version);
+    return YES;
+  }
+
+  static void ovsdbMessage(EVMod *mod, cJSON *msg) {
+    HSP_mod_OVS *mdata = (HSP_mod_OVS *)mod->data;
+    char *method = ovsdbString(cJSON_GetObjectItem(msg, "method"));
+    cJSON *id = cJSON_GetObjectItem(msg, "id");
+    if(method) {
+      if(my_strequal(method, "echo")) {
+	// keepalive from server - echo the params back
+	cJSON *reply = cJSON_CreateObject();
+	cJSON_AddItemToObject(reply, "result", cJSON_Duplicate(cJSON_GetObjectItem(msg, "params"), YES));
+	cJSON_AddNullToObject(reply, "error");
+	cJSON_AddItemToObject(reply, "id", cJSON_Duplicate(id, YES));
+	ovsdbSend(mod, reply);
+      }
+      else if(my_strequal(method, "update")) {
+	ovsdbApplyUpdates(mod, cJSON_GetArrayItem(cJSON_GetObjectItem(msg, "params"), 1));
+	// something changed - check it still matches the config
+	switch(mdata->state) {
+	case SFVSSTATE_SYNC_TRANSACT:
+	case SFVSSTATE_SYNC_FAILED:
+	case SFVSSTATE_SYNC_OK:
+	  setState(mod, SFVSSTATE_SYNC);
+	  break;
+	default:
+	  break;
+	}
+      }
+      return;
+    }
+    if(id == NULL
+       || id->type != cJSON_Number)
+      return;
+    cJSON *error = cJSON_GetObjectItem(msg, "error");
+    cJSON *result = cJSON_GetObjectItem(msg, "result");
+    bool failed = (error && error->type != cJSON_NULL);
+    if(id->valueint == mdata->ovsdb_schema_id) {
+      mdata->ovsdb_schema_id = 0;
+      if(failed
+	 || !ovsdbSchemaOK(result)) {
+	if(failed)
+	  myLog(LOG_ERR, "OVS: ovsdb get_schema(%s) failed", SFVS_OVSDB_DB);
+	myLog(LOG_ERR, "OVS: not using ovsdb at %s, falling back on %s",
+	      mdata->ovsdb_path,
+	      SFVS_OVS_CMD);
+	ovsdbDisconnect(mod);
+	mdata->ovsdb_retry = mdata->pollBus->now.tv_sec + SFVS_OVSDB_SCHEMA_RETRY_SECS;
+	return;
+      }
+      ovsdbMonitor(mod);
+    }
+    else if(id->valueint == mdata->ovsdb_monitor_id) {
+      mdata->ovsdb_monitor_id = 0;
+      if(failed) {
+	myLog(LOG_ERR, "OVS: ovsdb monitor request failed");
+	ovsdbDisconnect(mod);
+	return;
+      }
+      myDebug(1, "ovsdb monitor established");
+      ovsdbClearReplica(mod);
+      ovsdbApplyUpdates(mod, result);
+      mdata->ovsdb_monitoring = YES;
+    }
+    else if(id->valueint == mdata->ovsdb_txn_id) {
+      mdata->ovsdb_txn_id = 0;
+      if(failed || !ovsdbTransactOK(result)) {
+	if(failed)
+	  myLog(LOG_ERR, "OVS: ovsdb transact request failed");
+	if(mdata->state == SFVSSTATE_SYNC_TRANSACT)
+	  setState(mod, SFVSSTATE_SYNC_FAILED);
+      }
+      else if(mdata->state == SFVSSTATE_SYNC_TRANSACT)
+	setState(mod, SFVSSTATE_SYNC_OK);
+    }
+  }
+
+  /*_________________---------------------------__________________
+    _________________      OVSDB - socket       __________________
+    -----------------___________________________------------------
+    The server sends JSON objects back-to-back with no delimiter,
+    so track brace depth (outside of strings) to find where each
+    one ends. The scan state persists across reads so that a large
+    message is only scanned once.
+  */
+
+  static void ovsdbFrame(EVMod *mod) {
+    HSP_mod_OVS *mdata = (HSP_mod_OVS *)mod->data;
+    UTStrBuf *rx = mdata->ovsdb_rx;
+    while(mdata->ovsdb_scan < UTSTRBUF_LEN(rx)) {
+      char ch = UTSTRBUF_STR(rx)[mdata->ovsdb_scan++];
+      if(mdata->ovsdb_inStr) {
+	if(mdata->ovsdb_esc) mdata->ovsdb_esc = NO;
+	else if(ch == '\\') mdata->ovsdb_esc = YES;
+	else if(ch == '"') mdata->ovsdb_inStr = NO;
+	continue;
+      }
+      if(ch == '"') mdata->ovsdb_inStr = YES;
+      else if(ch == '{' || ch == '[') mdata->ovsdb_depth++;
+      else if(ch == '}' || ch == ']') {
+	if(--mdata->ovsdb_depth == 0) {
+	  // complete message
+	  size_t msgLen = mdata->ovsdb_scan;
+	  char save = UTSTRBUF_STR(rx)[msgLen];
+	  UTSTRBUF_STR(rx)[msgLen] = '\0';
+	  myDebug(2, "ovsdb recv: %s", UTSTRBUF_STR(rx));
+	  cJSON *msg = cJSON_Parse(UTSTRBUF_STR(rx));
+	  UTSTRBUF_STR(rx)[msgLen] = save;
+	  UTStrBuf_snip_prefix(rx, msgLen);
+	  mdata->ovsdb_scan = 0;
+	  if(msg) {
+	    ovsdbMessage(mod, msg);
+	    cJSON_Delete(msg);
+	  }
+	  else {
+	    myLog(LOG_ERR, "OVS: ovsdb JSON parse failed");
+	  }
+	  // may have disconnected while processing
+	  if(mdata->ovsdb == NULL)
+	    return;
+	}
+      }
+    }
+  }
+
+  static bool ovsdbRead(EVMod *mod) {
+    HSP_mod_OVS *mdata = (HSP_mod_OVS *)mod->data;
+    char buf[4096];
+    int cc;
+    while((cc = read(mdata->ovsdb->fd, buf, sizeof(buf))) < 0 && errno == EINTR);
+    if(cc <= 0) {
+      myLog(LOG_INFO, "OVS: ovsdb connection closed");
+      ovsdbDisconnect(mod);
+      return NO;
+    }
+    UTStrBuf_append_n(mdata->ovsdb_rx, buf, cc);
+    ovsdbFrame(mod);
+    return (mdata->ovsdb != NULL);
+  }
+
+  static void readOVSDB(EVMod *mod, EVSocket *sock, void *magic) {
+    ovsdbRead(mod);
+  }
+
+  static void ovsdbDisconnect(EVMod *mod) {
+    HSP_mod_OVS *mdata = (HSP_mod_OVS *)mod->data;
+    if(mdata->ovsdb) {
+      EVSocketClose(mod, mdata->ovsdb);
+      mdata->ovsdb = NULL;
+    }
+    UTStrBuf_reset(mdata->ovsdb_rx);
+    mdata->ovsdb_scan = 0;
+    mdata->ovsdb_depth = 0;
+    mdata->ovsdb_inStr = NO;
+    mdata->ovsdb_esc = NO;
+    mdata->ovsdb_schema_id = 0;
+    mdata->ovsdb_monitor_id = 0;
+    mdata->ovsdb_txn_id = 0;
+    mdata->ovsdb_monitoring = NO;
+    ovsdbClearReplica(mod);
+    mdata->ovsdb_retry = mdata->pollBus->now.tv_sec + SFVS_OVSDB_RETRY_SECS;
+    // fall back on ovs-vsctl
+    if(mdata->state == SFVSSTATE_SYNC_TRANSACT)
+      setState(mod, SFVSSTATE_SYNC);
+  }
+
+  static bool ovsdbConnect(EVMod *mod) {
+    HSP_mod_OVS *mdata = (HSP_mod_OVS *)mod->data;
+    mdata->ovsdb_retry = mdata->pollBus->now.tv_sec + SFVS_OVSDB_RETRY_SECS;
+    // not using UTUnixDomainSocket() here because it logs an
+    // error on every failure, and ovs-vsctl is a valid fallback
+    int fd = socket(PF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0)
+      return NO;
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    strncpy(addr.sun_path, mdata->ovsdb_path, sizeof(addr.sun_path) - 1);
+    if(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+      myDebug(1, "OVS: ovsdb connect(%s) failed: %s", mdata->ovsdb_path, strerror(errno));
+      close(fd);
+      return NO;
+    }
+    myDebug(1, "OVS: connected to ovsdb at %s", mdata->ovsdb_path);
+    mdata->ovsdb = EVBusAddSocket(mod, mdata->pollBus, fd, readOVSDB, NULL);
+    // monitor only once we know the schema is one we can use
+    return ovsdbGetSchema(mod);
+  }
+
   static void evt_config_changed(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    // per-application settings are not pushed to OVS
+    if(sFlowSettingsChangeMask(data, dataLen) == HSP_SETTINGS_CHANGED_APPS)
+      return;
     setState(mod, SFVSSTATE_READCONFIG);
   }
 
@@ -569,6 +1225,10 @@ extern "C" {
       setState(mod, SFVSSTATE_SYNC);
     }
 
+    if(mdata->ovsdb == NULL
+       && evt->bus->now.tv_sec >= mdata->ovsdb_retry)
+      ovsdbConnect(mod);
+
     switch(mdata->state) {
 
     case SFVSSTATE_READCONFIG:
@@ -577,7 +1237,15 @@ extern "C" {
       break;
 
     case SFVSSTATE_SYNC:
-      {
+      if(mdata->ovsdb) {
+	// wait for the monitor to be established, and for
+	// any previous transaction to complete
+	if(mdata->ovsdb_monitoring
+	   && mdata->ovsdb_txn_id == 0
+	   && syncOVSDB(mod) == NO)
+	  setState(mod, SFVSSTATE_SYNC_FAILED);
+      }
+      else {
 	if(syncOVS(mod)) setState(mod, SFVSSTATE_SYNC_OK);
 	else setState(mod, SFVSSTATE_SYNC_FAILED);
       }
@@ -588,6 +1256,7 @@ extern "C" {
     case SFVSSTATE_SYNC_SEARCH:
     case SFVSSTATE_SYNC_FOUND:
     case SFVSSTATE_SYNC_DESTROY:
+    case SFVSSTATE_SYNC_TRANSACT:
     case SFVSSTATE_SYNC_FAILED:
     case SFVSSTATE_SYNC_OK:
     case SFVSSTATE_END:
@@ -606,6 +1275,25 @@ extern "C" {
     HSP_mod_OVS *mdata = (HSP_mod_OVS *)mod->data;
     myDebug(1, "graceful shutdown: turning off OVS sFlow");
     mdata->config.num_collectors = 0;
+    if(mdata->ovsdb
+       && mdata->ovsdb_monitoring) {
+      // submit the transaction and give it a moment to complete
+      if(mdata->ovsdb_txn_id == 0
+	 && syncOVSDB(mod)
+	 && mdata->ovsdb_txn_id) {
+	for(int waited_ms = 0;
+	    mdata->ovsdb && mdata->ovsdb_txn_id && waited_ms < SFVS_OVSDB_FINAL_WAIT_MS;
+	    waited_ms += 100) {
+	  fd_set readfds;
+	  FD_ZERO(&readfds);
+	  FD_SET(mdata->ovsdb->fd, &readfds);
+	  struct timeval timeout = { .tv_sec = 0, .tv_usec = 100000 };
+	  if(select(mdata->ovsdb->fd + 1, &readfds, NULL, NULL, &timeout) > 0)
+	    ovsdbRead(mod);
+	}
+      }
+      return;
+    }
     syncOVS(mod);
   }
 
@@ -625,13 +1313,20 @@ extern "C" {
     mdata->config.targets = strArrayNew();
     mdata->ovs10 = NO;
     mdata->useAtVar = YES;
+    mdata->ovsdb_rx = UTStrBuf_new();
+    char *rundir = getenv("OVS_RUNDIR");
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", rundir ?: SFVS_OVSDB_RUNDIR, SFVS_OVSDB_SOCK);
+    setStr(&mdata->ovsdb_path, path);
+    mdata->ovsdb_bridges = UTHASH_NEW(SFVSBridge, uuid, UTHASH_SKEY);
+    mdata->ovsdb_sflows = UTHASH_NEW(SFVSSFlow, uuid, UTHASH_SKEY);
     setState(mod, SFVSSTATE_READCONFIG);
 
     // register call-backs
-    EVBus *pollBus = EVGetBus(mod, HSPBUS_POLL, YES);
-    EVEventRx(mod, EVGetEvent(pollBus, HSPEVENT_CONFIG_CHANGED), evt_config_changed);
-    EVEventRx(mod, EVGetEvent(pollBus, EVEVENT_TICK), evt_tick);
-    EVEventRx(mod, EVGetEvent(pollBus, EVEVENT_FINAL), evt_final);
+    mdata->pollBus = EVGetBus(mod, HSPBUS_POLL, YES);
+    EVEventRx(mod, EVGetEvent(mdata->pollBus, HSPEVENT_CONFIG_CHANGED), evt_config_changed);
+    EVEventRx(mod, EVGetEvent(mdata->pollBus, EVEVENT_TICK), evt_tick);
+    EVEventRx(mod, EVGetEvent(mdata->pollBus, EVEVENT_FINAL), evt_final);
   }
 
 #if defined(__cplusplus)
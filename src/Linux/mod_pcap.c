@@ -28,7 +28,11 @@ extern "C" {
     EVSocket *sock;
     uint32_t samplingRate;
     uint32_t subSamplingRate;
+    uint32_t skip;
+    uint32_t backoff;
     uint32_t drops;
+    uint32_t ps_drop;
+    bool kernelSampling:1;
     bool promisc:1;
     bool vport:1;
     bool vport_set:1;
@@ -52,7 +56,6 @@ extern "C" {
 
   static void readPackets_pcap_cb(u_char *user, const struct pcap_pkthdr *hdr, const u_char *buf)
   {
-    static uint32_t MySkipCount=1;
     BPFSoc *bpfs = (BPFSoc *)user;
     uint32_t sr = bpfs->subSamplingRate;
 
@@ -61,9 +64,9 @@ extern "C" {
       return;
     }
 
-    if(--MySkipCount == 0) {
+    if(bpfs->skip <= 1) {
       /* reached zero. Set the next skip */
-      MySkipCount = sr == 1 ? 1 : sfl_random((2 * sr) - 1);
+      bpfs->skip = sfl_random_skip(NULL, sr);
 
       EVMod *mod = bpfs->module;
       HSP *sp = (HSP *)EVROOTDATA(mod);
@@ -121,7 +124,12 @@ extern "C" {
 		 hdr->caplen - 14, /* length of captured payload */
 		 hdr->len, /* length of packet (pdu) */
 		 bpfs->drops, /* droppedSamples */
-		 bpfs->samplingRate);
+		 bpfs->samplingRate * (bpfs->backoff ?: 1));
+      // only report these drops once
+      bpfs->drops = 0;
+    }
+    else {
+      bpfs->skip--;
     }
   }
 
@@ -205,7 +213,7 @@ extern "C" {
     };
 
     // overwrite the sampling-rate
-    code[1].k = bpfs->samplingRate;
+    code[1].k = bpfs->samplingRate * (bpfs->backoff ?: 1);
     myDebug(1, "PCAP: sampling rate set to %u for dev=%s", code[1].k, bpfs->deviceName);
     struct sock_fprog bpf = {
       .len = 5, // ARRAY_SIZE(code),
@@ -222,6 +230,7 @@ extern "C" {
 
     // success - now we don't need to sub-sample in user-space
     bpfs->subSamplingRate = 1;
+    bpfs->kernelSampling = YES;
     myDebug(1, "PCAP: kernel sampling OK");
     return YES;
   }
@@ -233,6 +242,7 @@ extern "C" {
 
   static void evt_tick(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
     HSP_mod_PCAP *mdata = (HSP_mod_PCAP *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
     // read pcap stats to get drops - will go out with
     // packet samples sent from readPackets.c
     BPFSoc *bpfs;
@@ -240,7 +250,23 @@ extern "C" {
       struct pcap_stat stats;
       if(bpfs->pcap
 	 && pcap_stats(bpfs->pcap, &stats) == 0) {
-	bpfs->drops = stats.ps_drop;
+	bpfs->drops += (stats.ps_drop - bpfs->ps_drop);
+	bpfs->ps_drop = stats.ps_drop;
+      }
+      // apply any overload back-off in the kernel (or at least
+      // before we do any work in user-space)
+      if(bpfs->pcap
+	 && bpfs->adaptor) {
+	HSPAdaptorNIO *nio = ADAPTOR_NIO(bpfs->adaptor);
+	uint32_t backoff = nio->sampling_backoff ?: 1;
+	if(backoff != (bpfs->backoff ?: 1)) {
+	  bpfs->backoff = backoff;
+	  if(bpfs->kernelSampling)
+	    setKernelSampling(sp, bpfs, pcap_fileno(bpfs->pcap));
+	  else
+	    bpfs->subSamplingRate = bpfs->samplingRate * backoff;
+	  nio->sampling_backoff_upstream = backoff;
+	}
       }
     }
   }
@@ -255,7 +281,10 @@ extern "C" {
     HSP *sp = (HSP *)EVROOTDATA(mod);
     
     bpfs->samplingRate = lookupPacketSamplingRate(bpfs->adaptor, sp->sFlowSettings);
-    bpfs->subSamplingRate = bpfs->samplingRate;
+    bpfs->backoff = ADAPTOR_NIO(bpfs->adaptor)->sampling_backoff ?: 1;
+    bpfs->subSamplingRate = bpfs->samplingRate * bpfs->backoff;
+    bpfs->kernelSampling = NO;
+    bpfs->ps_drop = 0;
     bpfs->pcap = pcap_open_live(bpfs->deviceName,
 				sp->sFlowSettings_file->headerBytes,
 				bpfs->promisc,
@@ -269,6 +298,7 @@ extern "C" {
     myDebug(1, "PCAP: device %s opened OK", bpfs->deviceName);
     int fd = pcap_fileno(bpfs->pcap);
     setKernelSampling(sp, bpfs, fd);
+    ADAPTOR_NIO(bpfs->adaptor)->sampling_backoff_upstream = bpfs->backoff;
     bpfs->sock = EVBusAddSocket(mod, mdata->packetBus, fd, readPackets_pcap, bpfs);
     // assume we always want to get counters for anything we are tapping.
     // Have to force this here in case there are no samples that would
@@ -0,0 +1,315 @@
+/* This software is distributed under the following license:
+ * http://sflow.net/license.html
+ */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "hsflowd.h"
+#include "util_netlink.h"
+
+  // Packet samples from the psample generic netlink family,  as sent by
+  // "tc ... action sample" and by switch ASIC drivers (e.g. mlxsw) that
+  // sample in hardware.  Test with something like:
+  // tc qdisc add dev veth0 handle ffff: ingress
+  // tc filter add dev veth0 parent ffff: matchall action sample rate 100 group 1
+  // Direction is taken from out_ifindex unless set with psample { egress=on|off }.
+
+#define HSP_READPACKET_BATCH_PSAMPLE 10000
+  // big enough for a TSO/GRO super-packet plus attributes
+#define HSP_PSAMPLE_MSG_BYTES (65536 + 512)
+#define HSP_PSAMPLE_RCV_BUF 8000000
+#define HSP_PSAMPLE_DEFAULT_GROUP 1
+
+  // copied from linux/psample.h so we can compile on one
+  // platform and run on another. New attributes are only
+  // ever added at the end.
+  typedef enum {
+    HSP_PSAMPLE_ATTR_IIFINDEX=0,
+    HSP_PSAMPLE_ATTR_OIFINDEX,
+    HSP_PSAMPLE_ATTR_ORIGSIZE,
+    HSP_PSAMPLE_ATTR_SAMPLE_GROUP,
+    HSP_PSAMPLE_ATTR_GROUP_SEQ,
+    HSP_PSAMPLE_ATTR_SAMPLE_RATE,
+    HSP_PSAMPLE_ATTR_DATA,
+    HSP_PSAMPLE_ATTR_GROUP_REFCOUNT,
+    HSP_PSAMPLE_ATTR_TUNNEL,
+    HSP_PSAMPLE_ATTR_PAD,
+    HSP_PSAMPLE_ATTR_OUT_TC,
+    HSP_PSAMPLE_ATTR_OUT_TC_OCC,
+    HSP_PSAMPLE_ATTR_LATENCY,
+    HSP_PSAMPLE_ATTR_TIMESTAMP,
+    HSP_PSAMPLE_ATTR_PROTO,
+    __HSP_PSAMPLE_ATTR_MAX
+  } EnumPsampleAttributes;
+
+#define HSP_PSAMPLE_CMD_SAMPLE 0
+#define HSP_PSAMPLE_GENL_NAME "psample"
+#define HSP_PSAMPLE_MCGRP_NAME "packets"
+
+  typedef struct _HSP_mod_PSAMPLE {
+    EVBus *packetBus;
+    bool psample_configured;
+    int nl_sock;
+    int familyId;
+    uint32_t mcGroupId;
+    u_char *recv_buf;
+    // sequence-gap drop accounting
+    uint32_t last_grp_seq;
+    bool grp_seq_set;
+    uint32_t drops; // not yet reported with a sample
+    // sub-sampling (if the configured rate is lower than the hardware/tc rate)
+    uint32_t samplingRate;
+    uint32_t skip;
+    // telemetry
+    uint32_t t_samples;
+    uint32_t t_drops;
+    uint32_t t_overruns;
+  } HSP_mod_PSAMPLE;
+
+  /*_________________---------------------------__________________
+    _________________     nla_u32               __________________
+    -----------------___________________________------------------
+    ifindex attributes are u16 in current kernels, but be tolerant.
+  */
+
+  static uint32_t nla_u32(struct nlattr *attr) {
+    if(attr == NULL)
+      return 0;
+    switch(UTNLA_PAYLOAD(attr)) {
+    case 1: return *(uint8_t *)UTNLA_DATA(attr);
+    case 2: return *(uint16_t *)UTNLA_DATA(attr);
+    case 4:
+    case 8: return *(uint32_t *)UTNLA_DATA(attr);
+    }
+    return 0;
+  }
+
+  /*_________________---------------------------__________________
+    _________________      processSample        __________________
+    -----------------___________________________------------------
+  */
+
+  static void processSample(EVMod *mod, struct nlmsghdr *nlh) {
+    HSP_mod_PSAMPLE *mdata = (HSP_mod_PSAMPLE *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+
+    struct genlmsghdr *genl = (struct genlmsghdr *)NLMSG_DATA(nlh);
+    if(genl->cmd != HSP_PSAMPLE_CMD_SAMPLE)
+      return;
+
+    struct nlattr *tb[__HSP_PSAMPLE_ATTR_MAX] = { 0 };
+    struct nlattr *attr = (struct nlattr *)((char *)genl + GENL_HDRLEN);
+    int len = nlh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+    for(; UTNLA_OK(attr, len); attr = UTNLA_NEXT(attr, len)) {
+      int type = UTNLA_TYPE(attr);
+      if(type < __HSP_PSAMPLE_ATTR_MAX)
+	tb[type] = attr;
+    }
+
+    // only the group we were configured to listen to
+    uint32_t grp = nla_u32(tb[HSP_PSAMPLE_ATTR_SAMPLE_GROUP]);
+    if(grp != sp->psample.group)
+      return;
+
+    u_char *data = tb[HSP_PSAMPLE_ATTR_DATA] ? UTNLA_DATA(tb[HSP_PSAMPLE_ATTR_DATA]) : NULL;
+    int data_len = tb[HSP_PSAMPLE_ATTR_DATA] ? UTNLA_PAYLOAD(tb[HSP_PSAMPLE_ATTR_DATA]) : 0;
+    if(data == NULL
+       || data_len <= 14) // need more than just the MAC header
+      return;
+
+    // check for drops indicated by sequence no (per group)
+    uint32_t grp_seq = nla_u32(tb[HSP_PSAMPLE_ATTR_GROUP_SEQ]);
+    // a sequence that goes backwards (or repeats) means the group was
+    // recreated or the driver reloaded, so count no drops for that one
+    if(mdata->grp_seq_set
+       && grp_seq > mdata->last_grp_seq) {
+      uint32_t drops = grp_seq - mdata->last_grp_seq - 1;
+      if(drops) {
+	telemetryAdd(mdata->t_drops, drops);
+	mdata->drops += drops;
+      }
+    }
+    mdata->last_grp_seq = grp_seq;
+    mdata->grp_seq_set = YES;
+
+    uint32_t ifin = nla_u32(tb[HSP_PSAMPLE_ATTR_IIFINDEX]);
+    uint32_t ifout = nla_u32(tb[HSP_PSAMPLE_ATTR_OIFINDEX]);
+    uint32_t rate = nla_u32(tb[HSP_PSAMPLE_ATTR_SAMPLE_RATE]) ?: 1;
+    uint32_t origsize = nla_u32(tb[HSP_PSAMPLE_ATTR_ORIGSIZE]);
+    // the data may have been truncated (e.g. "trunc" on the tc action)
+    if(origsize < data_len)
+      origsize = data_len;
+
+    // sub-sample if we were asked for a lower rate than the
+    // sampler is running at
+    uint32_t sampling_n = rate;
+    if(!sp->hardwareSampling
+       && mdata->samplingRate > rate) {
+      uint32_t subSamplingRate = (mdata->samplingRate + rate - 1) / rate;
+      if(--mdata->skip != 0)
+	return;
+      // reached zero. Set the next skip and take this one
+      mdata->skip = sfl_random_skip(NULL, subSamplingRate);
+      sampling_n = rate * subSamplingRate;
+    }
+
+    // Forwarded packets sampled on egress carry both in_ifindex and
+    // out_ifindex,  so only the presence of out_ifindex says egress.
+    // Set psample { egress=on|off } if the sampler says otherwise.
+    uint32_t dsopts = sp->psample.ds_options;
+    bool egress = sp->psample.egress_set ? sp->psample.egress : (ifout != 0);
+    dsopts |= egress ? HSP_SAMPLEOPT_EGRESS : HSP_SAMPLEOPT_INGRESS;
+
+    myDebug(3, "psample: grp=%u seq=%u in=%u out=%u rate=%u origsize=%u data_len=%u",
+	    grp, grp_seq, ifin, ifout, rate, origsize, data_len);
+
+    HSP_TELEMETRY_INC(mdata->t_samples);
+    uint32_t drops = mdata->drops;
+    mdata->drops = 0;
+    takeSample(sp,
+	       ifin ? adaptorByIndex(sp, ifin) : NULL,
+	       ifout ? adaptorByIndex(sp, ifout) : NULL,
+	       NULL,
+	       dsopts,
+	       0, // hook
+	       data, // mac header
+	       14, // mac header len
+	       data + 14, // payload
+	       data_len - 14, // length of captured payload
+	       origsize - 14, // length of packet (pdu)
+	       drops,
+	       sampling_n);
+  }
+
+  /*_________________---------------------------__________________
+    _________________      readPackets          __________________
+    -----------------___________________________------------------
+  */
+
+  static void readPackets_psample(EVMod *mod, EVSocket *sock, void *magic)
+  {
+    HSP_mod_PSAMPLE *mdata = (HSP_mod_PSAMPLE *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+
+    if(sp->sFlowSettings == NULL) {
+      // config was turned off
+      return;
+    }
+
+    for(int batch = 0; batch < HSP_READPACKET_BATCH_PSAMPLE; batch++) {
+      int numbytes = recv(sock->fd, mdata->recv_buf, HSP_PSAMPLE_MSG_BYTES, 0);
+      if(numbytes <= 0) {
+	if(numbytes < 0
+	   && errno == ENOBUFS) {
+	  // socket overrun - the sequence numbers will tell us how many
+	  HSP_TELEMETRY_INC(mdata->t_overruns);
+	  continue;
+	}
+	break;
+      }
+      for(struct nlmsghdr *nlh = (struct nlmsghdr *)mdata->recv_buf; NLMSG_OK(nlh, numbytes); nlh = NLMSG_NEXT(nlh, numbytes)) {
+	if(nlh->nlmsg_type == mdata->familyId)
+	  processSample(mod, nlh);
+      }
+    }
+  }
+
+  /*_________________---------------------------__________________
+    _________________     openPSAMPLE           __________________
+    -----------------___________________________------------------
+    Must be done while we are still root.
+  */
+
+  static int openPSAMPLE(EVMod *mod)
+  {
+    HSP_mod_PSAMPLE *mdata = (HSP_mod_PSAMPLE *)mod->data;
+
+    int fd = UTNLGeneric_open();
+    if(fd < 0)
+      return -1;
+
+    mdata->familyId = UTNLGeneric_resolve(fd, HSP_PSAMPLE_GENL_NAME, HSP_PSAMPLE_MCGRP_NAME, &mdata->mcGroupId);
+    if(mdata->familyId <= 0
+       || !UTNLGeneric_join(fd, mdata->mcGroupId)) {
+      close(fd);
+      return -1;
+    }
+
+    // increase receiver buffer size
+    int rcvbuf = UTNL_setRcvBuf(fd, HSP_PSAMPLE_RCV_BUF);
+    myDebug(1, "PSAMPLE socket fd=%d family=%d group=%u rcvbuf=%d",
+	    fd,
+	    mdata->familyId,
+	    mdata->mcGroupId,
+	    rcvbuf);
+
+    // set the socket to non-blocking
+    int fdFlags = fcntl(fd, F_GETFL);
+    fdFlags |= O_NONBLOCK;
+    if(fcntl(fd, F_SETFL, fdFlags) < 0) {
+      myLog(LOG_ERR, "PSAMPLE fcntl(O_NONBLOCK) failed: %s", strerror(errno));
+      close(fd);
+      return -1;
+    }
+
+    return fd;
+  }
+
+  /*_________________---------------------------__________________
+    _________________    evt_config_changed     __________________
+    -----------------___________________________------------------
+  */
+
+  static void evt_config_changed(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    HSP_mod_PSAMPLE *mdata = (HSP_mod_PSAMPLE *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+
+    if(sp->sFlowSettings == NULL)
+      return; // no config (yet - may be waiting for DNS-SD)
+
+    mdata->samplingRate = sp->sFlowSettings->samplingRate;
+
+    if(mdata->psample_configured) {
+      // already configured from the first time (when we still had root privileges)
+      return;
+    }
+
+    if(sp->psample.group != 0) {
+      // open the generic netlink socket while we are still root
+      mdata->nl_sock = openPSAMPLE(mod);
+      if(mdata->nl_sock > 0)
+	EVBusAddSocket(mod, mdata->packetBus, mdata->nl_sock, readPackets_psample, NULL);
+    }
+
+    mdata->psample_configured = YES;
+  }
+
+  /*_________________---------------------------__________________
+    _________________    module init            __________________
+    -----------------___________________________------------------
+  */
+
+  void mod_psample(EVMod *mod) {
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    mod->data = my_calloc(sizeof(HSP_mod_PSAMPLE));
+    HSP_mod_PSAMPLE *mdata = (HSP_mod_PSAMPLE *)mod->data;
+    mdata->recv_buf = (u_char *)my_calloc(HSP_PSAMPLE_MSG_BYTES);
+    mdata->skip = 1;
+    if(sp->psample.group == 0)
+      sp->psample.group = HSP_PSAMPLE_DEFAULT_GROUP;
+    if(sp->psample.ds_options == 0)
+      sp->psample.ds_options = (HSP_SAMPLEOPT_PSAMPLE
+				| HSP_SAMPLEOPT_BRIDGE
+				| HSP_SAMPLEOPT_IF_POLLER);
+    mdata->t_samples = telemetryRegister("psample_samples", HSPTELEMETRY_COUNTER);
+    mdata->t_drops = telemetryRegister("psample_drops", HSPTELEMETRY_COUNTER);
+    mdata->t_overruns = telemetryRegister("psample_overruns", HSPTELEMETRY_COUNTER);
+    mdata->packetBus = EVGetBus(mod, HSPBUS_PACKET, YES);
+    EVEventRx(mod, EVGetEvent(mdata->packetBus, HSPEVENT_CONFIG_CHANGED), evt_config_changed);
+  }
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
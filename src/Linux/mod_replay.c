@@ -0,0 +1,754 @@
+/* This software is distributed under the following license:
+ * http://sflow.net/license.html
+ */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "hsflowd.h"
+
+  // Offline packet replay.  Frames are read from a pcap or pcapng
+  // capture file and pushed through the same 1-in-N sampling and
+  // takeSample() path that mod_pcap uses,  so the cost of the whole
+  // pipeline (sampling, flow-sample encoding, datagram output) can be
+  // measured without live traffic.  The datagrams go to the configured
+  // collectors,  or with output=file to a pcap file (see datagramSink()
+  // in hsflowd.c) so no network is involved at all.  With pace=off
+  // the file is replayed as fast as the packet thread can go, with
+  // pace=on at the rate it was recorded.  A summary is logged at the
+  // end of each pass.
+  //
+  // The file formats are decoded here rather than with libpcap so
+  // that the module has no dependencies:
+  // https://www.tcpdump.org/manpages/pcap-savefile.5.txt
+  // https://www.ietf.org/archive/id/draft-ietf-opsawg-pcapng-01.txt
+
+#define HSP_REPLAY_BUF_BYTES 1048576
+#define HSP_REPLAY_BATCH 10000
+#define HSP_REPLAY_MAX_INTERFACES 64
+
+#define HSP_PCAP_MAGIC_US 0xa1b2c3d4
+#define HSP_PCAP_MAGIC_NS 0xa1b23c4d
+#define HSP_PCAP_HDR_BYTES 24
+#define HSP_PCAP_REC_BYTES 16
+
+#define HSP_PCAPNG_SHB 0x0A0D0D0A
+#define HSP_PCAPNG_IDB 0x00000001
+#define HSP_PCAPNG_SPB 0x00000003
+#define HSP_PCAPNG_EPB 0x00000006
+#define HSP_PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4D
+#define HSP_PCAPNG_OPT_IF_TSRESOL 9
+
+#define HSP_LINKTYPE_ETHERNET 1
+#define HSP_LINKTYPE_RAW 101
+#define HSP_LINKTYPE_LINUX_SLL 113
+#define HSP_LINKTYPE_IPV4 228
+#define HSP_LINKTYPE_IPV6 229
+
+  typedef enum {
+    HSP_REPLAY_FMT_NONE=0,
+    HSP_REPLAY_FMT_PCAP,
+    HSP_REPLAY_FMT_PCAPNG
+  } EnumHSPReplayFormat;
+
+  typedef struct _HSPReplayIf {
+    uint32_t linkType;
+    uint32_t snapLen;
+    uint64_t tsPerSec;
+  } HSPReplayIf;
+
+  typedef struct _HSPReplayPkt {
+    uint64_t ts_nS;
+    uint32_t linkType;
+    u_char *data;
+    uint32_t cap_len;
+    uint32_t pkt_len;
+  } HSPReplayPkt;
+
+  typedef struct _HSP_mod_REPLAY {
+    EVBus *packetBus;
+    EVSocket *sock;
+    int fd;
+    // read buffer
+    u_char *buf;
+    size_t bufSize;
+    size_t len;
+    size_t off;
+    size_t nextOff;
+    bool eof:1;
+    bool havePkt:1;
+    bool done:1;
+    // file format
+    EnumHSPReplayFormat format;
+    bool swap:1;
+    HSPReplayIf ifs[HSP_REPLAY_MAX_INTERFACES];
+    uint32_t numIfs;
+    HSPReplayPkt pkt;
+    // sampling
+    SFLAdaptor *ad_tap;
+    SFLAdaptor *ad_in;
+    SFLAdaptor *ad_out;
+    uint32_t options;
+    uint32_t samplingRate;
+    uint32_t skip;
+    // pacing
+    struct timespec wallStart;
+    uint64_t fileStart_nS;
+    bool fileStarted:1;
+    uint32_t pass;
+    // stats for this pass
+    struct timespec passStart;
+    uint32_t datagramsStart;
+    uint64_t pkts;
+    uint64_t bytes;
+    uint64_t samples;
+    uint64_t skipped;
+    uint64_t read_nS;
+    uint64_t take_nS;
+  } HSP_mod_REPLAY;
+
+  /*_________________---------------------------__________________
+    _________________      utils                __________________
+    -----------------___________________________------------------
+  */
+
+  static uint64_t clock_nS(struct timespec *ts) {
+    struct timespec now;
+    if(ts == NULL)
+      ts = &now;
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    return ((uint64_t)ts->tv_sec * 1000000000) + ts->tv_nsec;
+  }
+
+  static uint64_t since_nS(struct timespec *t0) {
+    struct timespec t1;
+    clock_nS(&t1);
+    return ((int64_t)(t1.tv_sec - t0->tv_sec) * 1000000000) + (t1.tv_nsec - t0->tv_nsec);
+  }
+
+  static uint32_t get32(HSP_mod_REPLAY *mdata, u_char *p) {
+    uint32_t val;
+    memcpy(&val, p, 4);
+    return mdata->swap ? __builtin_bswap32(val) : val;
+  }
+
+  static uint16_t get16(HSP_mod_REPLAY *mdata, u_char *p) {
+    uint16_t val;
+    memcpy(&val, p, 2);
+    return mdata->swap ? __builtin_bswap16(val) : val;
+  }
+
+  static uint64_t ts_nS(uint64_t ts, uint64_t tsPerSec) {
+    if(tsPerSec == 1000000000)
+      return ts;
+    if(tsPerSec == 1000000)
+      return ts * 1000;
+    return ((ts / tsPerSec) * 1000000000)
+      + (uint64_t)((double)(ts % tsPerSec) * 1e9 / (double)tsPerSec);
+  }
+
+  static uint32_t datagramsSent(HSP *sp) {
+    uint32_t dgrams = 0;
+    TIMEDLOCK_DO(sp->sync_receiver) {
+      for(SFLReceiver *rcv = sp->agent->receivers; rcv; rcv = rcv->nxt)
+	dgrams += sfl_receiver_samplePacketsSent(rcv);
+    }
+    return dgrams;
+  }
+
+  /*_________________---------------------------__________________
+    _________________    buffered reader        __________________
+    -----------------___________________________------------------
+    The unconsumed part of the buffer always starts at mdata->off,
+    so a record can be parsed in place and only consumed later
+    (needed for pace=on, where a packet may have to wait for the
+    next tick).
+  */
+
+  static bool readerNeed(HSP_mod_REPLAY *mdata, size_t bytes) {
+    if((mdata->len - mdata->off) >= bytes)
+      return YES;
+    if(mdata->eof)
+      return NO;
+    if(mdata->off) {
+      memmove(mdata->buf, mdata->buf + mdata->off, mdata->len - mdata->off);
+      mdata->len -= mdata->off;
+      mdata->nextOff -= mdata->off;
+      mdata->off = 0;
+    }
+    if(bytes > mdata->bufSize) {
+      // a record bigger than the buffer
+      mdata->buf = my_realloc(mdata->buf, bytes);
+      mdata->bufSize = bytes;
+    }
+    while(mdata->len < bytes) {
+      ssize_t cc = read(mdata->fd, mdata->buf + mdata->len, mdata->bufSize - mdata->len);
+      if(cc < 0) {
+	if(errno == EINTR)
+	  continue;
+	myLog(LOG_ERR, "replay: read() failed : %s", strerror(errno));
+	mdata->eof = YES;
+	return NO;
+      }
+      if(cc == 0) {
+	mdata->eof = YES;
+	return NO;
+      }
+      mdata->len += cc;
+    }
+    return YES;
+  }
+
+  static void readerConsume(HSP_mod_REPLAY *mdata) {
+    mdata->off = mdata->nextOff;
+    mdata->havePkt = NO;
+  }
+
+  /*_________________---------------------------__________________
+    _________________    readHeader             __________________
+    -----------------___________________________------------------
+  */
+
+  static bool readHeader(EVMod *mod) {
+    HSP_mod_REPLAY *mdata = (HSP_mod_REPLAY *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    mdata->format = HSP_REPLAY_FMT_NONE;
+    mdata->numIfs = 0;
+    mdata->swap = NO;
+    if(!readerNeed(mdata, 4)) {
+      myLog(LOG_ERR, "replay: %s is empty", sp->replay.file);
+      return NO;
+    }
+    uint32_t magic;
+    memcpy(&magic, mdata->buf + mdata->off, 4);
+    if(magic == HSP_PCAPNG_SHB) {
+      // the SHB is parsed along with the other blocks
+      mdata->format = HSP_REPLAY_FMT_PCAPNG;
+      mdata->nextOff = mdata->off;
+      return YES;
+    }
+    if(!readerNeed(mdata, HSP_PCAP_HDR_BYTES)) {
+      myLog(LOG_ERR, "replay: %s truncated", sp->replay.file);
+      return NO;
+    }
+    uint64_t tsPerSec = 0;
+    if(magic == HSP_PCAP_MAGIC_US)
+      tsPerSec = 1000000;
+    else if(magic == HSP_PCAP_MAGIC_NS)
+      tsPerSec = 1000000000;
+    else if(magic == __builtin_bswap32(HSP_PCAP_MAGIC_US)) {
+      tsPerSec = 1000000;
+      mdata->swap = YES;
+    }
+    else if(magic == __builtin_bswap32(HSP_PCAP_MAGIC_NS)) {
+      tsPerSec = 1000000000;
+      mdata->swap = YES;
+    }
+    else {
+      myLog(LOG_ERR, "replay: %s is not a pcap or pcapng file (magic=0x%08x)", sp->replay.file, magic);
+      return NO;
+    }
+    u_char *hdr = mdata->buf + mdata->off;
+    mdata->format = HSP_REPLAY_FMT_PCAP;
+    mdata->ifs[0].snapLen = get32(mdata, hdr + 16);
+    // the top bits of the link-type field may carry FCS info
+    mdata->ifs[0].linkType = get32(mdata, hdr + 20) & 0x0FFFFFFF;
+    mdata->ifs[0].tsPerSec = tsPerSec;
+    mdata->numIfs = 1;
+    mdata->off += HSP_PCAP_HDR_BYTES;
+    mdata->nextOff = mdata->off;
+    return YES;
+  }
+
+  /*_________________---------------------------__________________
+    _________________    nextPacket             __________________
+    -----------------___________________________------------------
+    Parse the next packet into mdata->pkt, but do not consume it.
+    Returns NO at the end of the file or on a format error.
+  */
+
+  static bool nextPacket_pcap(EVMod *mod) {
+    HSP_mod_REPLAY *mdata = (HSP_mod_REPLAY *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    if(!readerNeed(mdata, HSP_PCAP_REC_BYTES))
+      return NO;
+    u_char *rec = mdata->buf + mdata->off;
+    uint32_t ts_sec = get32(mdata, rec);
+    uint32_t ts_frac = get32(mdata, rec + 4);
+    uint32_t cap_len = get32(mdata, rec + 8);
+    uint32_t pkt_len = get32(mdata, rec + 12);
+    if(cap_len > 0x4000000) {
+      myLog(LOG_ERR, "replay: %s corrupt record (caplen=%u)", sp->replay.file, cap_len);
+      return NO;
+    }
+    if(!readerNeed(mdata, HSP_PCAP_REC_BYTES + cap_len))
+      return NO;
+    rec = mdata->buf + mdata->off;
+    HSPReplayIf *ifp = &mdata->ifs[0];
+    mdata->pkt.ts_nS = ((uint64_t)ts_sec * 1000000000) + ts_nS(ts_frac, ifp->tsPerSec);
+    mdata->pkt.linkType = ifp->linkType;
+    mdata->pkt.data = rec + HSP_PCAP_REC_BYTES;
+    mdata->pkt.cap_len = cap_len;
+    mdata->pkt.pkt_len = pkt_len;
+    mdata->nextOff = mdata->off + HSP_PCAP_REC_BYTES + cap_len;
+    return YES;
+  }
+
+  static void pcapng_idb(HSP_mod_REPLAY *mdata, u_char *body, uint32_t bodyLen) {
+    if(mdata->numIfs == HSP_REPLAY_MAX_INTERFACES
+       || bodyLen < 8)
+      return;
+    HSPReplayIf *ifp = &mdata->ifs[mdata->numIfs++];
+    ifp->linkType = get16(mdata, body);
+    ifp->snapLen = get32(mdata, body + 4);
+    ifp->tsPerSec = 1000000;
+    // walk the options looking for if_tsresol
+    u_char *opt = body + 8;
+    u_char *end = body + bodyLen;
+    while(opt + 4 <= end) {
+      uint16_t code = get16(mdata, opt);
+      uint16_t optLen = get16(mdata, opt + 2);
+      if(code == 0 || opt + 4 + optLen > end)
+	break;
+      if(code == HSP_PCAPNG_OPT_IF_TSRESOL
+	 && optLen >= 1) {
+	u_char res = opt[4];
+	uint32_t exp = res & 0x7F;
+	if(res & 0x80) {
+	  if(exp < 63)
+	    ifp->tsPerSec = 1LL << exp;
+	}
+	else if(exp <= 18) {
+	  ifp->tsPerSec = 1;
+	  while(exp--)
+	    ifp->tsPerSec *= 10;
+	}
+      }
+      opt += 4 + ((optLen + 3) & ~3);
+    }
+  }
+
+  static bool nextPacket_pcapng(EVMod *mod) {
+    HSP_mod_REPLAY *mdata = (HSP_mod_REPLAY *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    for(;;) {
+      if(!readerNeed(mdata, 12))
+	return NO;
+      u_char *blk = mdata->buf + mdata->off;
+      uint32_t blockType;
+      memcpy(&blockType, blk, 4);
+      if(blockType == HSP_PCAPNG_SHB) {
+	// new section: byte order may change and the interfaces are reset
+	uint32_t bom;
+	memcpy(&bom, blk + 8, 4);
+	if(bom == HSP_PCAPNG_BYTE_ORDER_MAGIC)
+	  mdata->swap = NO;
+	else if(bom == __builtin_bswap32(HSP_PCAPNG_BYTE_ORDER_MAGIC))
+	  mdata->swap = YES;
+	else {
+	  myLog(LOG_ERR, "replay: %s bad pcapng byte-order magic", sp->replay.file);
+	  return NO;
+	}
+	mdata->numIfs = 0;
+      }
+      else
+	blockType = get32(mdata, blk);
+      uint32_t blockLen = get32(mdata, blk + 4);
+      if(blockLen < 12
+	 || (blockLen & 3)
+	 || blockLen > 0x4000000) {
+	myLog(LOG_ERR, "replay: %s corrupt block (len=%u)", sp->replay.file, blockLen);
+	return NO;
+      }
+      if(!readerNeed(mdata, blockLen))
+	return NO;
+      blk = mdata->buf + mdata->off;
+      u_char *body = blk + 8;
+      uint32_t bodyLen = blockLen - 12;
+      mdata->nextOff = mdata->off + blockLen;
+
+      switch(blockType) {
+      case HSP_PCAPNG_IDB:
+	pcapng_idb(mdata, body, bodyLen);
+	break;
+      case HSP_PCAPNG_EPB:
+	if(bodyLen >= 20) {
+	  uint32_t ifIdx = get32(mdata, body);
+	  uint64_t ts = ((uint64_t)get32(mdata, body + 4) << 32) + get32(mdata, body + 8);
+	  uint32_t cap_len = get32(mdata, body + 12);
+	  if(ifIdx < mdata->numIfs
+	     && cap_len <= (bodyLen - 20)) {
+	    HSPReplayIf *ifp = &mdata->ifs[ifIdx];
+	    mdata->pkt.ts_nS = ts_nS(ts, ifp->tsPerSec);
+	    mdata->pkt.linkType = ifp->linkType;
+	    mdata->pkt.data = body + 20;
+	    mdata->pkt.cap_len = cap_len;
+	    mdata->pkt.pkt_len = get32(mdata, body + 16);
+	    return YES;
+	  }
+	}
+	mdata->skipped++;
+	break;
+      case HSP_PCAPNG_SPB:
+	if(bodyLen >= 4
+	   && mdata->numIfs) {
+	  // no timestamp,  so use the last one we saw
+	  HSPReplayIf *ifp = &mdata->ifs[0];
+	  uint32_t pkt_len = get32(mdata, body);
+	  uint32_t cap_len = bodyLen - 4;
+	  if(cap_len > pkt_len)
+	    cap_len = pkt_len;
+	  if(ifp->snapLen && cap_len > ifp->snapLen)
+	    cap_len = ifp->snapLen;
+	  mdata->pkt.linkType = ifp->linkType;
+	  mdata->pkt.data = body + 4;
+	  mdata->pkt.cap_len = cap_len;
+	  mdata->pkt.pkt_len = pkt_len;
+	  return YES;
+	}
+	mdata->skipped++;
+	break;
+      default:
+	// SHB, name resolution, statistics, custom...
+	break;
+      }
+      // not a packet - move on
+      mdata->off = mdata->nextOff;
+    }
+  }
+
+  static bool nextPacket(EVMod *mod) {
+    HSP_mod_REPLAY *mdata = (HSP_mod_REPLAY *)mod->data;
+    if(mdata->havePkt == NO) {
+      bool ok = (mdata->format == HSP_REPLAY_FMT_PCAPNG)
+	? nextPacket_pcapng(mod)
+	: nextPacket_pcap(mod);
+      if(!ok)
+	return NO;
+      mdata->havePkt = YES;
+    }
+    return YES;
+  }
+
+  /*_________________---------------------------__________________
+    _________________      samplePacket         __________________
+    -----------------___________________________------------------
+  */
+
+  static void samplePacket(EVMod *mod, HSPReplayPkt *pkt) {
+    HSP_mod_REPLAY *mdata = (HSP_mod_REPLAY *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+
+    mdata->pkts++;
+    mdata->bytes += pkt->pkt_len;
+
+    if(mdata->samplingRate == 0)
+      return;
+    if(mdata->skip > 1) {
+      mdata->skip--;
+      return;
+    }
+    mdata->skip = sfl_random_skip(NULL, mdata->samplingRate);
+
+    // split off the link-layer header the way the live sources do
+    const u_char *mac_hdr = NULL;
+    uint32_t mac_len = 0;
+    const u_char *cap_hdr = pkt->data;
+    uint32_t cap_len = pkt->cap_len;
+    switch(pkt->linkType) {
+    case HSP_LINKTYPE_ETHERNET:
+      if(cap_len < 14) {
+	mdata->skipped++;
+	return;
+      }
+      mac_hdr = pkt->data;
+      mac_len = 14;
+      cap_hdr += 14;
+      cap_len -= 14;
+      break;
+    case HSP_LINKTYPE_LINUX_SLL:
+      if(cap_len < 17) {
+	mdata->skipped++;
+	return;
+      }
+      cap_hdr += 16;
+      cap_len -= 16;
+      break;
+    case HSP_LINKTYPE_RAW:
+    case HSP_LINKTYPE_IPV4:
+    case HSP_LINKTYPE_IPV6:
+      if(cap_len < 1) {
+	mdata->skipped++;
+	return;
+      }
+      break;
+    default:
+      mdata->skipped++;
+      return;
+    }
+
+    SFLAdaptor *ad_in = mdata->ad_in;
+    SFLAdaptor *ad_out = mdata->ad_out;
+    if(ad_in == NULL
+       && ad_out == NULL
+       && mac_hdr) {
+      // no mapping configured, so try the MACs as mod_pcap does
+      SFLMacAddress macdst, macsrc;
+      memset(&macdst, 0, sizeof(macdst));
+      memset(&macsrc, 0, sizeof(macsrc));
+      memcpy(macdst.mac, mac_hdr, 6);
+      memcpy(macsrc.mac, mac_hdr + 6, 6);
+      ad_in = adaptorByMac(sp, &macsrc);
+      ad_out = adaptorByMac(sp, &macdst);
+    }
+
+    struct timespec t0;
+    clock_nS(&t0);
+    takeSample(sp,
+	       ad_in,
+	       ad_out,
+	       mdata->ad_tap,
+	       mdata->options,
+	       0 /*hook*/,
+	       mac_hdr,
+	       mac_len,
+	       cap_hdr,
+	       cap_len,
+	       pkt->pkt_len,
+	       0 /* drops */,
+	       mdata->samplingRate);
+    mdata->take_nS += since_nS(&t0);
+    mdata->samples++;
+  }
+
+  /*_________________---------------------------__________________
+    _________________    pass start, end        __________________
+    -----------------___________________________------------------
+  */
+
+  static bool passStart(EVMod *mod) {
+    HSP_mod_REPLAY *mdata = (HSP_mod_REPLAY *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    if(lseek(mdata->fd, 0, SEEK_SET) == -1) {
+      myLog(LOG_ERR, "replay: lseek(%s) failed : %s", sp->replay.file, strerror(errno));
+      return NO;
+    }
+    mdata->len = mdata->off = mdata->nextOff = 0;
+    mdata->eof = NO;
+    mdata->havePkt = NO;
+    mdata->fileStarted = NO;
+    mdata->pkts = mdata->bytes = mdata->samples = mdata->skipped = 0;
+    mdata->read_nS = mdata->take_nS = 0;
+    mdata->pass++;
+    if(!readHeader(mod))
+      return NO;
+    mdata->datagramsStart = datagramsSent(sp);
+    clock_nS(&mdata->passStart);
+    mdata->wallStart = mdata->passStart;
+    return YES;
+  }
+
+  static void passEnd(EVMod *mod) {
+    HSP_mod_REPLAY *mdata = (HSP_mod_REPLAY *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    double secs = since_nS(&mdata->passStart) / 1e9;
+    if(secs <= 0)
+      secs = 1e-9;
+    // the receiver may still be holding a partly-filled datagram
+    uint32_t dgrams = datagramsSent(sp) - mdata->datagramsStart;
+    myLog(LOG_INFO, "replay: %s pass %u: %"PRIu64" pkts (%"PRIu64" bytes, %"PRIu64" skipped) in %.3f secs",
+	  sp->replay.file,
+	  mdata->pass,
+	  mdata->pkts,
+	  mdata->bytes,
+	  mdata->skipped,
+	  secs);
+    myLog(LOG_INFO, "replay: pkts/sec=%.0f samples/sec=%.0f (%"PRIu64" @ 1:%u) datagrams/sec=%.0f (%u)",
+	  mdata->pkts / secs,
+	  mdata->samples / secs,
+	  mdata->samples,
+	  mdata->samplingRate,
+	  dgrams / secs,
+	  dgrams);
+    myLog(LOG_INFO, "replay: read+sample nS/pkt=%.1f takeSample nS/sample=%.1f",
+	  mdata->pkts ? ((double)mdata->read_nS / mdata->pkts) : 0.0,
+	  mdata->samples ? ((double)mdata->take_nS / mdata->samples) : 0.0);
+  }
+
+  static void replayDone(EVMod *mod) {
+    HSP_mod_REPLAY *mdata = (HSP_mod_REPLAY *)mod->data;
+    mdata->done = YES;
+    if(mdata->sock) {
+      EVSocketClose(mod, mdata->sock);
+      mdata->sock = NULL;
+    }
+    else if(mdata->fd > 0)
+      close(mdata->fd);
+    mdata->fd = -1;
+    my_free(mdata->buf);
+    mdata->buf = NULL;
+  }
+
+  // returns NO if there is nothing more to replay
+  static bool endOfFile(EVMod *mod) {
+    HSP_mod_REPLAY *mdata = (HSP_mod_REPLAY *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    passEnd(mod);
+    if(mdata->pkts == 0) {
+      // nothing usable in the file - don't go round again (and again)
+      myLog(LOG_ERR, "replay: %s has no packets to replay", sp->replay.file);
+      replayDone(mod);
+      return NO;
+    }
+    if(sp->replay.loops == 0
+       || mdata->pass < sp->replay.loops) {
+      if(passStart(mod))
+	return YES;
+    }
+    replayDone(mod);
+    return NO;
+  }
+
+  /*_________________---------------------------__________________
+    _________________    replay fast, paced     __________________
+    -----------------___________________________------------------
+  */
+
+  // pace=off: the file fd is always readable,  so the packet bus
+  // calls back here as fast as it can,  one batch at a time,  and
+  // still gets to run its other events in between.
+
+  static void readPackets_replay(EVMod *mod, EVSocket *sock, void *magic) {
+    HSP_mod_REPLAY *mdata = (HSP_mod_REPLAY *)mod->data;
+    struct timespec t0;
+    clock_nS(&t0);
+    uint64_t take0 = mdata->take_nS;
+    for(int ii = 0; ii < HSP_REPLAY_BATCH; ii++) {
+      if(!nextPacket(mod)) {
+	mdata->read_nS += since_nS(&t0) - (mdata->take_nS - take0);
+	endOfFile(mod);
+	return;
+      }
+      samplePacket(mod, &mdata->pkt);
+      readerConsume(mdata);
+    }
+    mdata->read_nS += since_nS(&t0) - (mdata->take_nS - take0);
+  }
+
+  // pace=on: release whatever was due since the last tick.
+
+  static void evt_deci(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    HSP_mod_REPLAY *mdata = (HSP_mod_REPLAY *)mod->data;
+    if(mdata->done
+       || mdata->fd <= 0)
+      return;
+    struct timespec t0;
+    clock_nS(&t0);
+    uint64_t take0 = mdata->take_nS;
+    uint64_t elapsed_nS = since_nS(&mdata->wallStart);
+    for(;;) {
+      if(!nextPacket(mod)) {
+	mdata->read_nS += since_nS(&t0) - (mdata->take_nS - take0);
+	endOfFile(mod);
+	return;
+      }
+      if(!mdata->fileStarted) {
+	mdata->fileStart_nS = mdata->pkt.ts_nS;
+	mdata->fileStarted = YES;
+      }
+      if(mdata->pkt.ts_nS > mdata->fileStart_nS
+	 && (mdata->pkt.ts_nS - mdata->fileStart_nS) > elapsed_nS)
+	break; // not due yet
+      samplePacket(mod, &mdata->pkt);
+      readerConsume(mdata);
+    }
+    mdata->read_nS += since_nS(&t0) - (mdata->take_nS - take0);
+  }
+
+  /*_________________---------------------------__________________
+    _________________    evt_config_first       __________________
+    -----------------___________________________------------------
+  */
+
+  static void evt_config_first(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    HSP_mod_REPLAY *mdata = (HSP_mod_REPLAY *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+
+    if(sp->replay.dev) {
+      mdata->ad_tap = adaptorByName(sp, sp->replay.dev);
+      if(mdata->ad_tap == NULL) {
+	myLog(LOG_ERR, "replay: device %s not found", sp->replay.dev);
+	return;
+      }
+      mdata->options = (HSP_SAMPLEOPT_DEV_SAMPLER
+			| HSP_SAMPLEOPT_DEV_POLLER);
+    }
+    if(sp->replay.inIfIndex) {
+      mdata->ad_in = adaptorByIndex(sp, sp->replay.inIfIndex);
+      if(mdata->ad_in == NULL)
+	myLog(LOG_ERR, "replay: inIfIndex %u not found", sp->replay.inIfIndex);
+    }
+    if(sp->replay.outIfIndex) {
+      mdata->ad_out = adaptorByIndex(sp, sp->replay.outIfIndex);
+      if(mdata->ad_out == NULL)
+	myLog(LOG_ERR, "replay: outIfIndex %u not found", sp->replay.outIfIndex);
+    }
+    if(mdata->ad_in
+       && mdata->ad_out)
+      mdata->options |= HSP_SAMPLEOPT_BRIDGE;
+
+    mdata->samplingRate = sp->replay.samplingRate;
+    if(mdata->samplingRate == 0) {
+      SFLAdaptor *ad = mdata->ad_tap ?: (mdata->ad_in ?: mdata->ad_out);
+      mdata->samplingRate = ad
+	? lookupPacketSamplingRate(ad, sp->sFlowSettings)
+	: sp->sFlowSettings->samplingRate;
+    }
+    mdata->skip = sfl_random_skip(NULL, mdata->samplingRate);
+
+    if((mdata->fd = open(sp->replay.file, O_RDONLY | O_CLOEXEC)) < 0) {
+      myLog(LOG_ERR, "replay: cannot open %s : %s", sp->replay.file, strerror(errno));
+      return;
+    }
+    if(sp->replay.output
+       && !datagramSinkOpen(sp, sp->replay.output)) {
+      close(mdata->fd);
+      mdata->fd = -1;
+      return;
+    }
+    mdata->bufSize = HSP_REPLAY_BUF_BYTES;
+    mdata->buf = my_calloc(mdata->bufSize);
+    if(!passStart(mod)) {
+      replayDone(mod);
+      return;
+    }
+    myLog(LOG_INFO, "replay: %s (%s) sampling=%u pace=%s loops=%u output=%s",
+	  sp->replay.file,
+	  mdata->format == HSP_REPLAY_FMT_PCAPNG ? "pcapng" : "pcap",
+	  mdata->samplingRate,
+	  sp->replay.pace ? "on" : "off",
+	  sp->replay.loops,
+	  sp->replay.output ?: "collectors");
+    if(sp->replay.pace)
+      EVEventRx(mod, EVGetEvent(mdata->packetBus, EVEVENT_DECI), evt_deci);
+    else
+      mdata->sock = EVBusAddSocket(mod, mdata->packetBus, mdata->fd, readPackets_replay, NULL);
+  }
+
+  /*_________________---------------------------__________________
+    _________________    module init            __________________
+    -----------------___________________________------------------
+  */
+
+  void mod_replay(EVMod *mod) {
+    mod->data = my_calloc(sizeof(HSP_mod_REPLAY));
+    HSP_mod_REPLAY *mdata = (HSP_mod_REPLAY *)mod->data;
+    mdata->fd = -1;
+    mdata->packetBus = EVGetBus(mod, HSPBUS_PACKET, YES);
+    EVEventRx(mod, EVGetEvent(mdata->packetBus, HSPEVENT_CONFIG_FIRST), evt_config_first);
+  }
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
@@ -45,6 +45,12 @@ extern "C" {
 
 #define HSP_SYSTEMD_CGROUP_PROCS "/sys/fs/cgroup/systemd/%s/cgroup.procs"
 #define HSP_SYSTEMD_CGROUP_ACCT "/sys/fs/cgroup/%s%s/%s"
+
+  // cgroup v2 (unified hierarchy) - no per-controller directory, so
+  // the "acct" arg to the format is always passed in as ""
+#define HSP_SYSTEMD_CGROUP2_TEST "/sys/fs/cgroup/cgroup.controllers"
+#define HSP_SYSTEMD_CGROUP2_PROCS "/sys/fs/cgroup%s/cgroup.procs"
+#define HSP_SYSTEMD_CGROUP2_ACCT "/sys/fs/cgroup%s%s/%s"
   
   typedef void (*HSPDBusHandler)(EVMod *mod, DBusMessage *dbm, void *magic);
 
@@ -73,6 +79,9 @@ extern "C" {
     bool blockIOAccounting:1;
     HSPUnitCounters cntr;
     uint listenSocksRev;
+    uint32_t fds;
+    uint32_t fdsMaxByProcess;
+    time_t fdsDue;
   } HSPDBusUnit;
 
   typedef struct _HSPDBusProcess {
@@ -100,6 +109,12 @@ extern "C" {
     bool marked:1;
   } HSPListenSock;
 
+  // what the packet bus sees: a published sapId -> dsIndex map
+  typedef struct _HSPSapIndex {
+    HSPSapId sapId;
+    uint32_t dsIndex;
+  } HSPSapIndex;
+
   typedef struct _HSP_mod_SYSTEMD {
     DBusConnection *connection;
     DBusError error;
@@ -122,12 +137,17 @@ extern "C" {
     uint32_t page_size;
     char *cgroup_procs;
     char *cgroup_acct;
+    bool cgroup_unified;
     UTHash *listenSocks;
     UTHash *listenSocksByInode;
     int nl_sock;
     uint32_t nextListenSockQuery;
     uint listenSocksRev;
     uint packetSamples;
+    EVHashRCU *sapIndex;
+    HSPSapIndex *sapIndexBlock;
+    uint sapIndexRev;
+    bool sapIndexStale;
   } HSP_mod_SYSTEMD;
 
   /*_________________---------------------------__________________
@@ -190,6 +210,7 @@ extern "C" {
 	containerHTPrint(mdata->vmsByUUID, "vmsByUUID");
     }
 
+    mdata->sapIndexStale = YES;
     if(container->id) my_free(container->id);
     removeAndFreeVM(mod, &container->vm);
   }
@@ -211,6 +232,7 @@ extern "C" {
 	// add to collections
 	UTHashAdd(mdata->vmsByID, container);
 	UTHashAdd(mdata->vmsByUUID, container);
+	mdata->sapIndexStale = YES;
       }
     }
     return container;
@@ -272,8 +294,10 @@ extern "C" {
     if(mdata->listenSocks) {
       HSPListenSock *listenSock;
       UTHASH_WALK(mdata->listenSocks, listenSock)
-	if(listenSock->unit == unit)
+	if(listenSock->unit == unit) {
 	  listenSock->unit = NULL;
+	  mdata->sapIndexStale = YES;
+	}
     }
     my_free(unit);
   }
@@ -466,9 +490,11 @@ extern "C" {
 		  uint32_t ino = atoi(linkStr + 8);
 		  HSPListenSock search = { .inode = ino };
 		  HSPListenSock *listenSock = UTHashGet(mdata->listenSocksByInode, &search);
-		  if(listenSock) {
+		  if(listenSock
+		     && listenSock->unit != unit) {
 		    myDebug(1, "fd link inode = %u", ino);
 		    listenSock->unit = unit;
+		    mdata->sapIndexStale = YES;
 		  }
 		}
 	      }
@@ -488,9 +514,22 @@ extern "C" {
 
   static uint32_t accumulateFileDescriptors(EVMod *mod, HSPDBusUnit *unit, uint32_t *pMaxByProcess) {
     HSP_mod_SYSTEMD *mdata = (HSP_mod_SYSTEMD *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
     // re-map the sockets for these processes if there was any change at all
     // to the listenSocks hash table since the last time we were here.
     bool mapListenSocks = mdata->listenSocks && (mdata->listenSocksRev != unit->listenSocksRev);
+    // otherwise walk /proc/<pid>/fd only when a count is due.  That is
+    // every poll by default,  but systemd { countFDs=<secs> } can space
+    // the walks out or (with 0) turn them off.
+    time_t now_mono = mdata->pollBus->now.tv_sec;
+    bool countDue = (sp->systemd.countFDs
+		     && now_mono >= unit->fdsDue);
+    if(!mapListenSocks
+       && !countDue) {
+      if(pMaxByProcess)
+	*pMaxByProcess = unit->fdsMaxByProcess;
+      return unit->fds;
+    }
     HSPDBusProcess *process;
     uint32_t unitFDs = 0;
     uint32_t maxProcessFDs = 0;
@@ -500,6 +539,10 @@ extern "C" {
       if(processFDs > maxProcessFDs)
 	maxProcessFDs = processFDs;
     }
+    unit->fds = unitFDs;
+    unit->fdsMaxByProcess = maxProcessFDs;
+    if(countDue)
+      unit->fdsDue = now_mono + sp->systemd.countFDs;
     if(pMaxByProcess)
       *pMaxByProcess = maxProcessFDs;
     if(mapListenSocks)
@@ -547,6 +590,74 @@ extern "C" {
     return (found > 0);
   }
 
+  /*_________________---------------------------__________________
+    _________________     readCgroupValue       __________________
+    -----------------___________________________------------------
+    for single-value files such as memory.current or pids.current
+  */
+
+  static bool readCgroupValue(EVMod *mod, char *cgroup, char *fname, uint64_t *p_val64) {
+    HSP_mod_SYSTEMD *mdata = (HSP_mod_SYSTEMD *)mod->data;
+    bool found = NO;
+    char statsFileName[HSP_SYSTEMD_MAX_FNAME_LEN+1];
+    snprintf(statsFileName, HSP_SYSTEMD_MAX_FNAME_LEN, mdata->cgroup_acct, "", cgroup, fname);
+    FILE *statsFile = fopen(statsFileName, "r");
+    if(statsFile == NULL) {
+      myDebug(2, "cannot open %s : %s", statsFileName, strerror(errno));
+    }
+    else {
+      char line[HSP_SYSTEMD_MAX_STATS_LINELEN];
+      if(fgets(line, HSP_SYSTEMD_MAX_STATS_LINELEN, statsFile)
+	 && sscanf(line, "%"SCNu64, p_val64) == 1)
+	found = YES;
+      fclose(statsFile);
+    }
+    return found;
+  }
+
+  /*_________________---------------------------__________________
+    _________________     readCgroupIOStat      __________________
+    -----------------___________________________------------------
+    cgroup v2 io.stat has one line per device, with key=value fields:
+    8:0 rbytes=1459200 wbytes=314773504 rios=192 wios=353 dbytes=0 dios=0
+  */
+
+  static bool readCgroupIOStat(EVMod *mod, char *cgroup, SFLHost_vrt_dsk_counters *dskio) {
+    HSP_mod_SYSTEMD *mdata = (HSP_mod_SYSTEMD *)mod->data;
+    bool found = NO;
+    char statsFileName[HSP_SYSTEMD_MAX_FNAME_LEN+1];
+    snprintf(statsFileName, HSP_SYSTEMD_MAX_FNAME_LEN, mdata->cgroup_acct, "", cgroup, "io.stat");
+    FILE *statsFile = fopen(statsFileName, "r");
+    if(statsFile == NULL) {
+      myDebug(2, "cannot open %s : %s", statsFileName, strerror(errno));
+    }
+    else {
+      // an empty file just means no I/O yet, which is still a valid reading
+      found = YES;
+      char line[HSP_SYSTEMD_MAX_STATS_LINELEN];
+      while(fgets(line, HSP_SYSTEMD_MAX_STATS_LINELEN, statsFile)) {
+	char *p = line;
+	char buf[MAX_PROC_TOKLEN];
+	// skip the major:minor device field
+	if(parseNextTok(&p, " \n", NO, 0, NO, buf, MAX_PROC_TOKLEN) == NULL)
+	  continue;
+	while(parseNextTok(&p, " \n", NO, 0, NO, buf, MAX_PROC_TOKLEN)) {
+	  char *eq = strchr(buf, '=');
+	  if(eq == NULL)
+	    continue;
+	  *eq++ = '\0';
+	  uint64_t val64 = strtoull(eq, NULL, 0);
+	  if(my_strequal(buf, "rbytes")) dskio->rd_bytes += val64;
+	  else if(my_strequal(buf, "wbytes")) dskio->wr_bytes += val64;
+	  else if(my_strequal(buf, "rios")) dskio->rd_req += val64;
+	  else if(my_strequal(buf, "wios")) dskio->wr_req += val64;
+	}
+      }
+      fclose(statsFile);
+    }
+    return found;
+  }
+
   /*________________---------------------------__________________
     ________________   getCounters_SYSTEMD     __________________
     ----------------___________________________------------------
@@ -565,6 +676,17 @@ extern "C" {
       return;
     }
 
+    if(mdata->cgroup_unified) {
+      // the process list is only refreshed at resync time, but the cgroup
+      // can tell us right now if the unit has gone quiet.
+      uint64_t pids = 0;
+      if(readCgroupValue(mod, unit->cgroup, "pids.current", &pids)
+	 && pids == 0) {
+	removeAndFreeVM_SYSTEMD(mod, container);
+	return;
+      }
+    }
+
     SFL_COUNTERS_SAMPLE_TYPE cs = { 0 };
     HSPVMState *vm = (HSPVMState *)&container->vm;
     // host ID
@@ -609,28 +731,54 @@ extern "C" {
     enum SFLVirDomainState virState = SFL_VIR_DOMAIN_RUNNING;
     cpuElem.counterBlock.host_vrt_cpu.state = virState;
 
-    uint64_t cpu_total = 0;
-    if(unit->cpuAccounting) {
+    uint64_t cpu_mS = 0;
+    if(mdata->cgroup_unified) {
+      // cpu.stat usage_usec is always present in cgroup v2
+      HSPNameVal cpuVals[] = {
+	{ "usage_usec",0,0 },
+	{ NULL,0,0},
+      };
+      if(readCgroupCounters(mod, "", unit->cgroup, "cpu.stat", 1, cpuVals, NO)
+	 && cpuVals[0].nv_found)
+	cpu_mS = cpuVals[0].nv_val64 / 1000;
+    }
+    else if(unit->cpuAccounting) {
       HSPNameVal cpuVals[] = {
 	{ "user",0,0 },
 	{ "system",0,0},
 	{ NULL,0,0},
       };
+      uint64_t cpu_total = 0;
       if(readCgroupCounters(mod, "cpuacct", unit->cgroup, "cpuacct.stat", 2, cpuVals, NO)) {
 	if(cpuVals[0].nv_found) cpu_total += cpuVals[0].nv_val64;
 	if(cpuVals[1].nv_found) cpu_total += cpuVals[1].nv_val64;
       }
+      cpu_mS = JIFFY_TO_MS(cpu_total);
     }
-    if(cpu_total == 0) {
-      cpu_total = accumulateProcessCPU(mod, unit);
+    if(cpu_mS == 0) {
+      cpu_mS = JIFFY_TO_MS(accumulateProcessCPU(mod, unit));
     }
-    cpuElem.counterBlock.host_vrt_cpu.cpuTime = (uint32_t)(JIFFY_TO_MS(cpu_total));
+    cpuElem.counterBlock.host_vrt_cpu.cpuTime = (uint32_t)cpu_mS;
     SFLADD_ELEMENT(&cs, &cpuElem);
 
     SFLCounters_sample_element memElem = { 0 };
     memElem.tag = SFLCOUNTERS_HOST_VRT_MEM;
     uint64_t rss = 0;
-    if(unit->memoryAccounting) {
+    if(mdata->cgroup_unified) {
+      // memory.current only appears if MemoryAccounting is on. It
+      // includes the page cache,  which the v1 "rss" figure did not,
+      // so take memory.stat "file" off it.
+      if(readCgroupValue(mod, unit->cgroup, "memory.current", &rss)) {
+	HSPNameVal memVals[] = {
+	  { "file",0,0 },
+	  { NULL,0,0},
+	};
+	if(readCgroupCounters(mod, "", unit->cgroup, "memory.stat", 1, memVals, NO)
+	   && memVals[0].nv_found)
+	  rss = (memVals[0].nv_val64 < rss) ? (rss - memVals[0].nv_val64) : 0;
+      }
+    }
+    else if(unit->memoryAccounting) {
       HSPNameVal memVals[] = {
 	{ "rss",0,0 },
 	{ NULL,0,0},
@@ -650,7 +798,13 @@ extern "C" {
     // VM disk I/O counters
     SFLCounters_sample_element dskElem = { 0 };
     dskElem.tag = SFLCOUNTERS_HOST_VRT_DSK;
-    if(unit->blockIOAccounting) {
+    bool gotDsk = NO;
+    if(mdata->cgroup_unified) {
+      // io.stat only appears if IOAccounting is on
+      gotDsk = readCgroupIOStat(mod, unit->cgroup, &dskElem.counterBlock.host_vrt_dsk);
+    }
+    else if(unit->blockIOAccounting) {
+      gotDsk = YES;
       HSPNameVal dskValsB[] = {
 	{ "Read",0,0 },
 	{ "Write",0,0},
@@ -680,7 +834,7 @@ extern "C" {
 	}
       }
     }
-    else {
+    if(!gotDsk) {
       // This requires root privileges to be retained, so don't even try
       // unless we are still root:
       if(getuid() == 0)
@@ -691,7 +845,9 @@ extern "C" {
 
     // count file-descriptors and build inode->unit here. That way
     // the fd-counter is correct, but it also has the effect of
-    // smoothing the /proc walks out over the polling interval
+    // smoothing the /proc walks out over the polling interval.
+    // The walk is skipped unless the listen-socket map changed
+    // or a (rate-limited) count is due.
     uint32_t maxProcessFDs = 0;
     accumulateFileDescriptors(mod, unit, &maxProcessFDs);
     // TODO: add fd count to new structure (or append to existing one)
@@ -701,11 +857,11 @@ extern "C" {
     // the ulimit might soon be reached. Running out of file-descriptors
     // is such a classic meltdown scenario...
 
-    SEMLOCK_DO(sp->sync_agent) {
+    TIMEDLOCK_DO(sp->sync_receiver) {
       sfl_poller_writeCountersSample(vm->poller, &cs);
       sp->counterSampleQueued = YES;
-      sp->telemetry[HSP_TELEMETRY_COUNTER_SAMPLES]++;
     }
+    HSP_TELEMETRY_INC(HSP_TELEMETRY_COUNTER_SAMPLES);
   }
 
   /*_________________---------------------------__________________
@@ -921,9 +1077,13 @@ extern "C" {
 		  my_free(process);
 	    // find or allocate the container
 	    getContainer(mod, unit, YES);
-	    getDbusProperty(mod, unit, handler_cpuAccounting, "CPUAccounting");
-	    getDbusProperty(mod, unit, handler_memoryAccounting, "MemoryAccounting");
-	    getDbusProperty(mod, unit, handler_blockIOAccounting, "BlockIOAccounting");
+	    // with cgroup v2 the presence of the accounting files is
+	    // enough to tell us what is enabled,  so don't ask.
+	    if(!mdata->cgroup_unified) {
+	      getDbusProperty(mod, unit, handler_cpuAccounting, "CPUAccounting");
+	      getDbusProperty(mod, unit, handler_memoryAccounting, "MemoryAccounting");
+	      getDbusProperty(mod, unit, handler_blockIOAccounting, "BlockIOAccounting");
+	    }
 	    // TODO: could try and get "MemoryCurrent" and "CPUUsageNSec" here, but since they
 	    // are usually not limited,  these numbers are usually == (uint64_t)-1.  So
 	    // we have to get the numbers from the cgroup accounting (if enabled) or fall
@@ -1218,6 +1378,59 @@ extern "C" {
     UTNLDiag_recv(mod, mdata->nl_sock, diagCB);
   }
 
+  /*_________________---------------------------__________________
+    _________________    publishSapIndex        __________________
+    -----------------___________________________------------------
+    The listen sockets, units and containers all belong to the poll
+    bus. Resolve them down to a sapId->dsIndex table here and publish
+    a read-only copy, so the packet bus never has to touch (or lock)
+    any of them. Entries are allocated as one block so the whole
+    generation can be retired with a single EVDeferFree().
+  */
+
+  static void sapIndexBlockFree(void *obj) {
+    my_free(obj);
+  }
+
+  static void publishSapIndex(EVMod *mod) {
+    HSP_mod_SYSTEMD *mdata = (HSP_mod_SYSTEMD *)mod->data;
+    if(mdata->sapIndex == NULL
+       || (mdata->sapIndexStale == NO
+	   && mdata->sapIndexRev == mdata->listenSocksRev))
+      return;
+    mdata->sapIndexStale = NO;
+    mdata->sapIndexRev = mdata->listenSocksRev;
+    HSPSapIndex *oldBlock = mdata->sapIndexBlock;
+    HSPSapIndex *block = NULL;
+    uint32_t nsaps = UTHashN(mdata->listenSocks);
+    if(nsaps)
+      block = (HSPSapIndex *)my_calloc(nsaps * sizeof(HSPSapIndex));
+    uint32_t ii = 0;
+    EVHashRCUReset(mdata->sapIndex);
+    HSPListenSock *lsock;
+    UTHASH_WALK(mdata->listenSocks, lsock) {
+      if(lsock->unit == NULL
+	 || ii >= nsaps)
+	continue;
+      HSPVMState_SYSTEMD search;
+      memcpy(search.vm.uuid, lsock->unit->uuid, 16);
+      HSPVMState_SYSTEMD *container = UTHashGet(mdata->vmsByUUID, &search);
+      if(container
+	 && container->vm.dsIndex) {
+	HSPSapIndex *sapIdx = &block[ii++];
+	sapIdx->sapId = lsock->sapId;
+	sapIdx->dsIndex = container->vm.dsIndex;
+	EVHashRCUAdd(mdata->sapIndex, sapIdx);
+      }
+    }
+    // force the swap even if the table is still empty
+    mdata->sapIndex->dirty = YES;
+    EVHashRCUPublish(mod, mdata->sapIndex);
+    mdata->sapIndexBlock = block;
+    EVDeferFree(mod, oldBlock, sapIndexBlockFree);
+    myDebug(1, "%s published %u listen socket entries", mod->name, ii);
+  }
+
   /*_________________---------------------------__________________
     _________________    dsIndexForSAP          __________________
     -----------------___________________________------------------
@@ -1225,17 +1438,9 @@ extern "C" {
   */
   static uint32_t dsIndexForSAP(EVMod *mod, uint8_t protocol, uint16_t port) {
     HSP_mod_SYSTEMD *mdata = (HSP_mod_SYSTEMD *)mod->data;
-    HSPListenSock search = { .sapId = { .protocol = protocol, .port = port } };
-    HSPListenSock *lsock = UTHashGet(mdata->listenSocks, &search);
-    if(lsock
-       && lsock->unit) {
-      HSPVMState_SYSTEMD *container = UTHashGet(mdata->vmsByUUID, lsock->unit->uuid);
-      if(container) {
-	HSPVMState *vm = (HSPVMState *)&container->vm;
-	return vm->dsIndex;
-      }
-    }
-    return 0;
+    HSPSapIndex search = { .sapId = { .protocol = protocol, .port = port } };
+    HSPSapIndex *sapIdx = EVHashRCUGet(mdata->sapIndex, &search);
+    return sapIdx ? sapIdx->dsIndex : 0;
   }
 	
   /*_________________---------------------------__________________
@@ -1302,7 +1507,6 @@ extern "C" {
   /*_________________---------------------------__________________
     _________________    markListenSockets      __________________
     -----------------___________________________------------------
-    TODO: lock?
   */
   static void markListenSockets(EVMod *mod) {
     HSP_mod_SYSTEMD *mdata = (HSP_mod_SYSTEMD *)mod->data;
@@ -1314,7 +1518,7 @@ extern "C" {
   /*_________________---------------------------__________________
     _________________    sweepListenSockets     __________________
     -----------------___________________________------------------
-    TODO: lock?
+    Safe to free here: the packet bus only sees publishSapIndex().
   */
   static void sweepListenSockets(EVMod *mod) {
     HSP_mod_SYSTEMD *mdata = (HSP_mod_SYSTEMD *)mod->data;
@@ -1376,6 +1580,9 @@ extern "C" {
 	mdata->countdownToResync = sp->systemd.refreshVMListSecs ?: sp->refreshVMListSecs;
       }
     }
+
+    // push any socket->service mapping changes out to the packet bus
+    publishSapIndex(mod);
   }
 
   static void evt_tock(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
@@ -1518,8 +1725,16 @@ static DBusHandlerResult dbusCB(DBusConnection *connection, DBusMessage *message
     requestVNodeRole(mod, HSP_VNODE_PRIORITY_SYSTEMD);
 
     // path formats for cgroup info - can be overridden in config
-    mdata->cgroup_procs = sp->systemd.cgroup_procs ?: HSP_SYSTEMD_CGROUP_PROCS;
-    mdata->cgroup_acct = sp->systemd.cgroup_acct ?: HSP_SYSTEMD_CGROUP_ACCT;
+    mdata->cgroup_unified = UTFileExists(HSP_SYSTEMD_CGROUP2_TEST);
+    if(mdata->cgroup_unified) {
+      myDebug(1, "systemd: cgroup v2 (unified) hierarchy detected");
+      mdata->cgroup_procs = sp->systemd.cgroup_procs ?: HSP_SYSTEMD_CGROUP2_PROCS;
+      mdata->cgroup_acct = sp->systemd.cgroup_acct ?: HSP_SYSTEMD_CGROUP2_ACCT;
+    }
+    else {
+      mdata->cgroup_procs = sp->systemd.cgroup_procs ?: HSP_SYSTEMD_CGROUP_PROCS;
+      mdata->cgroup_acct = sp->systemd.cgroup_acct ?: HSP_SYSTEMD_CGROUP_ACCT;
+    }
     
     // get page size for scaling memory pages->bytes
 #if defined(PAGESIZE)
@@ -1534,8 +1749,9 @@ static DBusHandlerResult dbusCB(DBusConnection *connection, DBusMessage *message
     if(sp->systemd.markTraffic) {
       mdata->packetBus = EVGetBus(mod, HSPBUS_PACKET, YES);
       EVEventRx(mod, EVGetEvent(mdata->packetBus, HSPEVENT_FLOW_SAMPLE), evt_flow_sample);
-      mdata->listenSocks = UTHASH_NEW(HSPListenSock, sapId, UTHASH_SYNC); // need sync (poll + packet thread)
+      mdata->listenSocks = UTHASH_NEW(HSPListenSock, sapId, UTHASH_DFLT); // only used in poll thread
       mdata->listenSocksByInode = UTHASH_NEW(HSPListenSock, inode, UTHASH_DFLT); // only used in poll thread
+      mdata->sapIndex = EVHashRCUNew(UTHASH_NEW(HSPSapIndex, sapId, UTHASH_DFLT)); // read from packet thread
     }
 
     // poll bus
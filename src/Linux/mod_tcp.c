@@ -98,12 +98,40 @@ extern "C" {
 #define HSP_TCP_TIMEOUT_MS 400
     EnumPktDirection pktdirn;
   } HSPTCPSample;
-    
+
+  // Recent answers, so that an elephant flow sampled many times a
+  // second costs one netlink round-trip per cacheSecs rather than one
+  // per sample. Filled by single queries and by bulk dumps alike.
+  typedef struct _HSPTCPConn {
+    struct inet_diag_sockid id; // same 36-byte key as sampleHT
+    struct timespec rtime;
+    struct my_tcp_info tcpi;
+    bool udp:1;
+    bool gotInfo:1;
+  } HSPTCPConn;
+
+#define HSP_TCP_CACHE_MAX 100000
+#define HSP_TCP_KEY_LEN 36
+
   typedef struct _HSP_mod_TCP {
     EVBus *packetBus;
     int nl_sock;
+    int nl_dump_sock[2]; // one per family, so the dumps can overlap
     UTHash *sampleHT;
     UTQ(HSPTCPSample) timeoutQ;
+    UTHash *connHT;
+    // adaptive bulk-dump mode
+    uint32_t queries; // this second
+    uint32_t lookups; // this second
+    bool dumpMode;
+    // telemetry
+    uint32_t t_requests;
+    uint32_t t_found;
+    uint32_t t_timeouts;
+    uint32_t t_rtt;
+    uint32_t t_cache_hits;
+    uint32_t t_dumps;
+    uint32_t t_conns;
   } HSP_mod_TCP;
 
 
@@ -156,32 +184,114 @@ extern "C" {
     return buf;
   }
   
+  /*_________________---------------------------__________________
+    _________________      addTCPInfo           __________________
+    -----------------___________________________------------------
+  */
+
+  static void addTCPInfo(HSPPendingSample *ps, struct my_tcp_info *tcpi, EnumPktDirection pktdirn) {
+    // populate tcp_info structure
+    SFLFlow_sample_element *tcpElem = pendingSample_calloc(ps, sizeof(SFLFlow_sample_element));
+    tcpElem->tag = SFLFLOW_EX_TCP_INFO;
+    tcpElem->flowType.tcp_info.dirn = pktdirn;
+    tcpElem->flowType.tcp_info.snd_mss = tcpi->tcpi_snd_mss;
+    tcpElem->flowType.tcp_info.rcv_mss = tcpi->tcpi_rcv_mss;
+    tcpElem->flowType.tcp_info.unacked = tcpi->tcpi_unacked;
+    tcpElem->flowType.tcp_info.lost = tcpi->tcpi_lost;
+    tcpElem->flowType.tcp_info.retrans = tcpi->tcpi_total_retrans;
+    tcpElem->flowType.tcp_info.pmtu = tcpi->tcpi_pmtu;
+    tcpElem->flowType.tcp_info.rtt = tcpi->tcpi_rtt;
+    tcpElem->flowType.tcp_info.rttvar = tcpi->tcpi_rttvar;
+    tcpElem->flowType.tcp_info.snd_cwnd = tcpi->tcpi_snd_cwnd;
+    tcpElem->flowType.tcp_info.reordering = tcpi->tcpi_reordering;
+    tcpElem->flowType.tcp_info.min_rtt = tcpi->tcpi_min_rtt;
+    // add to sample
+    SFLADD_ELEMENT(ps->fs, tcpElem);
+  }
+
+  /*_________________---------------------------__________________
+    _________________      connection cache     __________________
+    -----------------___________________________------------------
+  */
+
+  static HSPTCPConn *connCacheGet(EVMod *mod, struct inet_diag_sockid *id, bool udp) {
+    HSP_mod_TCP *mdata = (HSP_mod_TCP *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    if(sp->tcp.cacheSecs == 0)
+      return NULL;
+    HSPTCPConn search = { .id = *id };
+    HSPTCPConn *conn = UTHashGet(mdata->connHT, &search);
+    if(conn
+       && conn->udp == udp
+       && EVTimeDiff_mS(&conn->rtime, &mdata->packetBus->now) <= (sp->tcp.cacheSecs * 1000))
+      return conn;
+    return NULL;
+  }
+
+  static void connCachePut(EVMod *mod, struct inet_diag_sockid *id, bool udp, struct my_tcp_info *tcpi) {
+    HSP_mod_TCP *mdata = (HSP_mod_TCP *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    if(sp->tcp.cacheSecs == 0)
+      return;
+    HSPTCPConn search = { .id = *id };
+    HSPTCPConn *conn = UTHashGet(mdata->connHT, &search);
+    if(conn == NULL) {
+      if(UTHashN(mdata->connHT) >= HSP_TCP_CACHE_MAX)
+	return;
+      conn = (HSPTCPConn *)my_calloc(sizeof(HSPTCPConn));
+      conn->id = *id;
+      UTHashAdd(mdata->connHT, conn);
+    }
+    conn->rtime = mdata->packetBus->now;
+    conn->udp = udp;
+    conn->gotInfo = (tcpi != NULL);
+    if(tcpi)
+      conn->tcpi = *tcpi;
+  }
+
+  static void connCacheAge(EVMod *mod) {
+    HSP_mod_TCP *mdata = (HSP_mod_TCP *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    HSPTCPConn *conn;
+    UTHASH_WALK(mdata->connHT, conn) {
+      if(EVTimeDiff_mS(&conn->rtime, &mdata->packetBus->now) > (sp->tcp.cacheSecs * 1000)) {
+	UTHashDel(mdata->connHT, conn);
+	my_free(conn);
+      }
+    }
+    telemetrySet(mdata->t_conns, UTHashN(mdata->connHT));
+  }
+
   /*_________________---------------------------__________________
     _________________     parse_diag_msg        __________________
     -----------------___________________________------------------
   */
 
-  static void parse_diag_msg(EVMod *mod, struct inet_diag_msg *diag_msg, int rtalen)
+  static void parse_diag_msg(EVMod *mod, struct inet_diag_msg *diag_msg, int rtalen, bool dumped)
   {
     HSP_mod_TCP *mdata = (HSP_mod_TCP *)mod->data;
     HSP *sp = (HSP *)EVROOTDATA(mod);
 
     // see if we can get back to the sample that triggered this lookup
     HSPTCPSample search = { .conn_req.id = diag_msg->id };
-    HSPTCPSample *found = UTHashDelKey(mdata->sampleHT, &search);
-
-    // user info.  Prefer getpwuid_r() if avaiable...
-    struct passwd *uid_info = getpwuid(diag_msg->idiag_uid);
-    myDebug(1, "diag_msg: UDP=%s UID=%u(%s) inode=%u",
-	    found ? (found->udp ? "YES":"NO") : "<sample not found>",
-	    diag_msg->idiag_uid,
-	    uid_info->pw_name,
-	    diag_msg->idiag_inode);
+    HSPTCPSample *found = dumped ? NULL : UTHashDelKey(mdata->sampleHT, &search);
+
+    if(!dumped) {
+      // user info.  Prefer getpwuid_r() if avaiable...
+      struct passwd *uid_info = getpwuid(diag_msg->idiag_uid);
+      myDebug(1, "diag_msg: UDP=%s UID=%u(%s) inode=%u",
+	      found ? (found->udp ? "YES":"NO") : "<sample not found>",
+	      diag_msg->idiag_uid,
+	      uid_info ? uid_info->pw_name : "",
+	      diag_msg->idiag_inode);
+    }
     // Theoretically we could follow the inode back to
     // the socket and get the application (command line)
     // but there does not seem to be a direct lookup
     // for that.
 
+    struct my_tcp_info tcpi = { 0 };
+    bool gotInfo = NO;
     if(rtalen > 0) {
       struct rtattr *attr = (struct rtattr *)(diag_msg + 1);
       
@@ -197,47 +307,40 @@ extern "C" {
 	  // kernel tcp_info has fewer fields the extras will all be 0 (correct),
 	  // or if the kernel's has more fields they will simply be ignored (no problem,
 	  // but we should check back in case they are worth exporting!)
-	  struct my_tcp_info tcpi = { 0 };
 	  int readLen = RTA_PAYLOAD(attr);
 	  if(readLen > sizeof(struct my_tcp_info)) {
 	    myDebug(2, "New kernel has new fields in struct tcp_info. Check it out!");
 	    readLen = sizeof(struct my_tcp_info);
 	  }
 	  memcpy(&tcpi, RTA_DATA(attr), readLen);
-	  myDebug(1, "TCP diag: RTT=%uuS (variance=%uuS) [%s]",
-		  tcpi.tcpi_rtt, tcpi.tcpi_rttvar,
-		  diag_sockid_print(&diag_msg->id));
-	  if(found) {
-	    myDebug(1, "found TCPSample: %s RTT:%uuS", tcpSamplePrint(found), tcpi.tcpi_rtt);
-	    HSPPendingSample *ps;
-	    UTARRAY_WALK(found->samples, ps) {
-	      // populate tcp_info structure
-	      SFLFlow_sample_element *tcpElem = pendingSample_calloc(ps, sizeof(SFLFlow_sample_element));
-	      tcpElem->tag = SFLFLOW_EX_TCP_INFO;
-	      tcpElem->flowType.tcp_info.dirn = found->pktdirn;
-	      tcpElem->flowType.tcp_info.snd_mss = tcpi.tcpi_snd_mss;
-	      tcpElem->flowType.tcp_info.rcv_mss = tcpi.tcpi_rcv_mss;
-	      tcpElem->flowType.tcp_info.unacked = tcpi.tcpi_unacked;
-	      tcpElem->flowType.tcp_info.lost = tcpi.tcpi_lost;
-	      tcpElem->flowType.tcp_info.retrans = tcpi.tcpi_total_retrans;
-	      tcpElem->flowType.tcp_info.pmtu = tcpi.tcpi_pmtu;
-	      tcpElem->flowType.tcp_info.rtt = tcpi.tcpi_rtt;
-	      tcpElem->flowType.tcp_info.rttvar = tcpi.tcpi_rttvar;
-	      tcpElem->flowType.tcp_info.snd_cwnd = tcpi.tcpi_snd_cwnd;
-	      tcpElem->flowType.tcp_info.reordering = tcpi.tcpi_reordering;
-	      tcpElem->flowType.tcp_info.min_rtt = tcpi.tcpi_min_rtt;
-	      // add to sample
-	      SFLADD_ELEMENT(ps->fs, tcpElem);
-	      // release sample
-	      releasePendingSample(sp, ps);
-	    }
-	  }
+	  gotInfo = YES;
+	  if(!dumped)
+	    myDebug(1, "TCP diag: RTT=%uuS (variance=%uuS) [%s]",
+		    tcpi.tcpi_rtt, tcpi.tcpi_rttvar,
+		    diag_sockid_print(&diag_msg->id));
 	}
 	attr = RTA_NEXT(attr, rtalen); 
       }
     }
 
+    // remember the answer for the next sample on this connection.
+    // Dumps only ask for established TCP sockets.
+    if(dumped || found)
+      connCachePut(mod, &diag_msg->id, found ? found->udp : NO, gotInfo ? &tcpi : NULL);
+
     if(found) {
+      if(gotInfo) {
+	myDebug(1, "found TCPSample: %s RTT:%uuS", tcpSamplePrint(found), tcpi.tcpi_rtt);
+	HSP_TELEMETRY_INC(mdata->t_found);
+	telemetryObserve(mdata->t_rtt, tcpi.tcpi_rtt);
+      }
+      HSPPendingSample *ps;
+      UTARRAY_WALK(found->samples, ps) {
+	if(gotInfo)
+	  addTCPInfo(ps, &tcpi, found->pktdirn);
+	// release sample
+	releasePendingSample(sp, ps);
+      }
       // unlink from Q
       UTQ_REMOVE(mdata->timeoutQ, found);
       // and free my control-block
@@ -252,16 +355,75 @@ extern "C" {
   */
 
 #define MAGIC_SEQ 0x50C00L
+#define MAGIC_SEQ_DUMP 0x50C01L
 
   static void diagCB(void *magic, int sockFd, uint32_t seqNo, struct inet_diag_msg *diag_msg, int rtalen) {
     if(seqNo == MAGIC_SEQ)
-      parse_diag_msg((EVMod *)magic, diag_msg, rtalen);
+      parse_diag_msg((EVMod *)magic, diag_msg, rtalen, NO);
+    else if(seqNo == MAGIC_SEQ_DUMP)
+      parse_diag_msg((EVMod *)magic, diag_msg, rtalen, YES);
   }
 
   static void readNL(EVMod *mod, EVSocket *sock, void *magic)
   {
+    UTNLDiag_recv(mod, sock->fd, diagCB);
+  }
+
+  /*_________________---------------------------__________________
+    _________________       bulk dump           __________________
+    -----------------___________________________------------------
+    When the query rate is high it is cheaper to ask for every
+    established TCP socket once a second than to keep asking
+    about them one at a time.  Samples that miss the dump (new
+    or non-TCP connections) still fall back to a single query.
+  */
+
+  static void requestDump(EVMod *mod) {
+    HSP_mod_TCP *mdata = (HSP_mod_TCP *)mod->data;
+    int families[2] = { AF_INET, AF_INET6 };
+    for(int ii = 0; ii < 2; ii++) {
+      if(mdata->nl_dump_sock[ii] <= 0)
+	continue;
+      struct inet_diag_req_v2 dump_req = { 0 };
+      dump_req.sdiag_family = families[ii];
+      dump_req.sdiag_protocol = IPPROTO_TCP;
+      dump_req.idiag_states = (1<<TCP_ESTABLISHED);
+      dump_req.idiag_ext |= (1 << (INET_DIAG_INFO - 1));
+      if(UTNLDiag_send(mdata->nl_dump_sock[ii], &dump_req, sizeof(dump_req), YES, MAGIC_SEQ_DUMP) > 0)
+	HSP_TELEMETRY_INC(mdata->t_dumps);
+    }
+  }
+
+  /*_________________---------------------------__________________
+    _________________       evt_tick            __________________
+    -----------------___________________________------------------
+  */
+
+  static void evt_tick(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
     HSP_mod_TCP *mdata = (HSP_mod_TCP *)mod->data;
-    UTNLDiag_recv(mod, mdata->nl_sock, diagCB);
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    if(sp->tcp.cacheSecs) {
+      // Go to bulk mode on the query rate.  Stay there while the demand
+      // (which the dumps are now answering) is still at least half that.
+      bool dumpMode = NO;
+      if(sp->tcp.dumpRate) {
+	dumpMode = mdata->dumpMode
+	  ? (mdata->lookups >= (sp->tcp.dumpRate / 2))
+	  : (mdata->queries > sp->tcp.dumpRate);
+      }
+      if(dumpMode != mdata->dumpMode) {
+	myDebug(1, "tcp: %s bulk dump mode (queries=%u lookups=%u)",
+		dumpMode ? "entering" : "leaving",
+		mdata->queries,
+		mdata->lookups);
+	mdata->dumpMode = dumpMode;
+      }
+      if(mdata->dumpMode)
+	requestDump(mod);
+      connCacheAge(mod);
+    }
+    mdata->queries = 0;
+    mdata->lookups = 0;
   }
 
   /*_________________---------------------------__________________
@@ -280,6 +442,7 @@ extern "C" {
       }
       else {
 	myDebug(1, "removing timed-out request (%s)", tcpSamplePrint(ts));
+	HSP_TELEMETRY_INC(mdata->t_timeouts);
 	HSPTCPSample *next_ts = ts->next;
 	// remove from Q
 	UTQ_REMOVE(mdata->timeoutQ, ts);
@@ -397,6 +560,18 @@ extern "C" {
 	// I have no cookie :(
 	sockid->idiag_cookie[0] = INET_DIAG_NOCOOKIE;
 	sockid->idiag_cookie[1] = INET_DIAG_NOCOOKIE;
+	// answered recently?
+	mdata->lookups++;
+	HSPTCPConn *conn = connCacheGet(mod, sockid, tcpSample->udp);
+	if(conn) {
+	  HSP_TELEMETRY_INC(mdata->t_cache_hits);
+	  if(conn->gotInfo) {
+	    telemetryObserve(mdata->t_rtt, conn->tcpi.tcpi_rtt);
+	    addTCPInfo(ps, &conn->tcpi, tcpSample->pktdirn);
+	  }
+	  tcpSampleFree(tcpSample);
+	  return;
+	}
 	// put a hold on this one while we look it up
 	holdPendingSample(ps);
 	HSPTCPSample *tsInQ = UTHashGet(mdata->sampleHT, tcpSample);
@@ -411,6 +586,8 @@ extern "C" {
 	  // add to HT and timeout queue
 	  UTHashAdd(mdata->sampleHT, tcpSample);
 	  UTQ_ADD_TAIL(mdata->timeoutQ, tcpSample);
+	  HSP_TELEMETRY_INC(mdata->t_requests);
+	  mdata->queries++;
 	  // send the netlink request
 	  UTNLDiag_send(mdata->nl_sock,
 			&tcpSample->conn_req,
@@ -440,6 +617,16 @@ extern "C" {
       return;
     }
     EVBusAddSocket(mod, mdata->packetBus, mdata->nl_sock, readNL, NULL);
+
+    // separate sockets for bulk dumps,  so they never hold up single queries
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    if(sp->tcp.cacheSecs
+       && sp->tcp.dumpRate) {
+      for(int ii = 0; ii < 2; ii++) {
+	if((mdata->nl_dump_sock[ii] = UTNLDiag_open()) > 0)
+	  EVBusAddSocket(mod, mdata->packetBus, mdata->nl_dump_sock[ii], readNL, NULL);
+      }
+    }
   }
 
   /*_________________---------------------------__________________
@@ -453,11 +640,21 @@ extern "C" {
     mdata->sampleHT = UTHASH_NEW(HSPTCPSample, conn_req.id, UTHASH_DFLT);
     // trim the hash-key len to select only the socket part of inet_diag_sockid
     // and leave out the interface and the cookie
-    mdata->sampleHT->f_len = 36;
+    mdata->sampleHT->f_len = HSP_TCP_KEY_LEN;
+    mdata->connHT = UTHASH_NEW(HSPTCPConn, id, UTHASH_DFLT);
+    mdata->connHT->f_len = HSP_TCP_KEY_LEN;
+    mdata->t_requests = telemetryRegister("tcp_diag_requests", HSPTELEMETRY_COUNTER);
+    mdata->t_found = telemetryRegister("tcp_diag_found", HSPTELEMETRY_COUNTER);
+    mdata->t_timeouts = telemetryRegister("tcp_diag_timeouts", HSPTELEMETRY_COUNTER);
+    mdata->t_rtt = telemetryRegister("tcp_rtt_uS", HSPTELEMETRY_HISTOGRAM);
+    mdata->t_cache_hits = telemetryRegister("tcp_info_cache_hits", HSPTELEMETRY_COUNTER);
+    mdata->t_dumps = telemetryRegister("tcp_diag_dumps", HSPTELEMETRY_COUNTER);
+    mdata->t_conns = telemetryRegister("tcp_info_cache_entries", HSPTELEMETRY_GAUGE);
     // register call-backs
     mdata->packetBus = EVGetBus(mod, HSPBUS_PACKET, YES);
     EVEventRx(mod, EVGetEvent(mdata->packetBus, HSPEVENT_CONFIG_FIRST), evt_config_first);
     EVEventRx(mod, EVGetEvent(mdata->packetBus, EVEVENT_DECI), evt_deci);
+    EVEventRx(mod, EVGetEvent(mdata->packetBus, EVEVENT_TICK), evt_tick);
     EVEventRx(mod, EVGetEvent(mdata->packetBus, HSPEVENT_FLOW_SAMPLE), evt_flow_sample);
   }
 
@@ -436,11 +436,11 @@ extern "C" {
       adaptorsElem.counterBlock.adaptors = xenstat_adaptors(mod, state->domId, &myAdaptors, HSP_MAX_VIFS);
       SFLADD_ELEMENT(cs, &adaptorsElem);
 
-      SEMLOCK_DO(sp->sync_agent) {
+      TIMEDLOCK_DO(sp->sync_receiver) {
 	sfl_poller_writeCountersSample(poller, cs);
 	sp->counterSampleQueued = YES;
-	sp->telemetry[HSP_TELEMETRY_COUNTER_SAMPLES]++;
       }
+      HSP_TELEMETRY_INC(HSP_TELEMETRY_COUNTER_SAMPLES);
     }
   }
 
@@ -448,7 +448,7 @@ extern "C" {
   {
     EVMod *mod = (EVMod *)poller->magic;
     HSP_mod_XEN *mdata = (HSP_mod_XEN *)mod->data;
-    // defer, since the agent mutex is currently held and we don't want to block it
+    // defer, since the pollers lock is currently held and we don't want to block it
     UTArrayAdd(mdata->pollActions, poller);
   }
 
@@ -356,8 +356,8 @@ extern "C" {
     HSPAdaptorNIO *adaptorNIO = ADAPTOR_NIO(adaptor);
     // optical data
 #ifdef HSP_TEST_QSFP
-    adaptorNIO->modinfo_type = ETH_MODULE_SFF_8436;
-    adaptorNIO->modinfo_len = ETH_MODULE_SFF_8436_LEN;
+    nioOptics(adaptorNIO)->modinfo_type = ETH_MODULE_SFF_8436;
+    nioOptics(adaptorNIO)->modinfo_len = ETH_MODULE_SFF_8436_LEN;
     adaptorNIO->ethtool_GMODULEINFO = NO;
 #endif
     if(adaptorNIO->ethtool_GMODULEINFO) {
@@ -370,8 +370,9 @@ extern "C" {
 	      adaptor->deviceName,
 	      modinfo.eeprom_len,
 	      modinfo.type);
-	adaptorNIO->modinfo_len = modinfo.eeprom_len;
-	adaptorNIO->modinfo_type = modinfo.type;
+	HSPNIOOptics *optics = nioOptics(adaptorNIO);
+	optics->modinfo_len = modinfo.eeprom_len;
+	optics->modinfo_type = modinfo.type;
 	return YES;
       }
       else {
@@ -439,78 +440,295 @@ extern "C" {
     return NO;
   }
 
+/*________________---------------------------__________________
+  ________________  ethtool string sets      __________________
+  ----------------___________________________------------------
+  Finding the counters we want means pulling the whole
+  ETHTOOL_GSTRINGS table and comparing every name,  but devices
+  with the same driver and the same number of stats share the
+  same table.  So the resolved indices are cached by (driver,
+  n_stats) and identical devices skip GSTRINGS altogether.
+  Entries are few (one per driver flavour) and never freed.
+*/
+
+  typedef struct _HSPEthtoolStringSet {
+    char *key; // <driver>/<n_stats>
+    uint32_t nctrs;
+    ETCTRFlags et_found;
+    // indices are 1-based so that 0 means "not found"
+    uint32_t idx_mcasts_in;
+    uint32_t idx_mcasts_out;
+    uint32_t idx_bcasts_in;
+    uint32_t idx_bcasts_out;
+    uint32_t idx_peer_ifindex;
+  } HSPEthtoolStringSet;
+
+  static UTHash *ethtoolStringSets = NULL;
+  static pthread_mutex_t ethtoolStringSetsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+  static HSPEthtoolStringSet *ethtool_read_GSTRINGS(struct ifreq *ifr, int fd, uint32_t nctrs)
+  {
+    HSPEthtoolStringSet *sset = NULL;
+    struct ethtool_gstrings *ctrNames;
+    uint32_t bytes = sizeof(*ctrNames) + (nctrs * ETH_GSTRING_LEN);
+    ctrNames = (struct ethtool_gstrings *)my_calloc(bytes);
+    ctrNames->cmd = ETHTOOL_GSTRINGS;
+    ctrNames->string_set = ETH_SS_STATS;
+    ctrNames->len = nctrs;
+    ifr->ifr_data = (char *)ctrNames;
+    if(ioctl(fd, SIOCETHTOOL, ifr) >= 0) {
+      sset = (HSPEthtoolStringSet *)my_calloc(sizeof(HSPEthtoolStringSet));
+      sset->nctrs = nctrs;
+      // copy out one at a time to make sure we have null-termination
+      char cname[ETH_GSTRING_LEN+1];
+      cname[ETH_GSTRING_LEN] = '\0';
+      for(int ii=0; ii < nctrs; ii++) {
+	memcpy(cname, &ctrNames->data[ii * ETH_GSTRING_LEN], ETH_GSTRING_LEN);
+	myDebug(1, "ethtool counter %s is at index %d", cname, ii);
+	// then see if this is one of the ones we want,
+	// and record the index if it is.
+	if(staticStringsIndexOf(HSP_ethtool_mcasts_in_names, cname) != -1) {
+	  sset->idx_mcasts_in = ii+1;
+	  sset->et_found |= HSP_ETCTR_MC_IN;
+	}
+	else if(staticStringsIndexOf(HSP_ethtool_mcasts_out_names, cname) != -1) {
+	  sset->idx_mcasts_out = ii+1;
+	  sset->et_found |= HSP_ETCTR_MC_OUT;
+	}
+	else if(staticStringsIndexOf(HSP_ethtool_bcasts_in_names, cname) != -1) {
+	  sset->idx_bcasts_in = ii+1;
+	  sset->et_found |= HSP_ETCTR_BC_IN;
+	}
+	else if(staticStringsIndexOf(HSP_ethtool_bcasts_out_names, cname) != -1) {
+	  sset->idx_bcasts_out = ii+1;
+	  sset->et_found |= HSP_ETCTR_BC_OUT;
+	}
+	if(staticStringsIndexOf(HSP_ethtool_peer_ifindex_names, cname) != -1) {
+	  sset->idx_peer_ifindex = ii+1;
+	}
+      }
+    }
+    my_free(ctrNames);
+    return sset;
+  }
+
 /*________________---------------------------__________________
   ________________  ethtool_get_GSTATS       __________________
   ----------------___________________________------------------
+  The ioctl half of this runs on the discovery worker threads,  so
+  it only fills in the job.  ethtool_apply_GSTATS() then updates
+  the adaptor from the poll thread.
 */
 
-  static void ethtool_get_GSTATS(HSP *sp, struct ifreq *ifr, int fd, SFLAdaptor *adaptor)
+  typedef struct _HSPEthtoolJob {
+    SFLAdaptor *adaptor;
+    uint32_t nctrs;
+    HSPEthtoolStringSet *sset;
+    bool cacheHit;
+    bool gotPeer;
+    uint32_t peer_ifIndex;
+  } HSPEthtoolJob;
+
+  static void ethtool_get_GSTATS(int fd, HSPEthtoolJob *job)
   {
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, job->adaptor->deviceName, sizeof(ifr.ifr_name)-1);
+
     // see if the ethtool stats block can give us multicast/broadcast counters too
+    job->nctrs = ethtool_num_counters(&ifr, fd);
+    if(job->nctrs == 0)
+      return;
+
+    // the driver name is the cache key (with the number of counters)
+    struct ethtool_drvinfo drvinfo;
+    char key[sizeof(drvinfo.driver) + 16];
+    key[0] = '\0';
+    memset(&drvinfo, 0, sizeof(drvinfo));
+    drvinfo.cmd = ETHTOOL_GDRVINFO;
+    ifr.ifr_data = (char *)&drvinfo;
+    if(ioctl(fd, SIOCETHTOOL, &ifr) >= 0
+       && drvinfo.driver[0]) {
+      drvinfo.driver[sizeof(drvinfo.driver)-1] = '\0';
+      snprintf(key, sizeof(key), "%s/%u", drvinfo.driver, job->nctrs);
+    }
+
+    if(key[0]) {
+      HSPEthtoolStringSet search = { .key = key };
+      pthread_mutex_lock(&ethtoolStringSetsMutex);
+      job->sset = UTHashGet(ethtoolStringSets, &search);
+      pthread_mutex_unlock(&ethtoolStringSetsMutex);
+      job->cacheHit = (job->sset != NULL);
+    }
+
+    if(job->sset == NULL) {
+      HSPEthtoolStringSet *sset = ethtool_read_GSTRINGS(&ifr, fd, job->nctrs);
+      if(sset
+	 && key[0]) {
+	sset->key = my_strdup(key);
+	pthread_mutex_lock(&ethtoolStringSetsMutex);
+	// another worker may have beaten us to it
+	HSPEthtoolStringSet *existing = UTHashGet(ethtoolStringSets, sset);
+	if(existing) {
+	  my_free(sset->key);
+	  my_free(sset);
+	  sset = existing;
+	}
+	else
+	  UTHashAdd(ethtoolStringSets, sset);
+	pthread_mutex_unlock(&ethtoolStringSetsMutex);
+      }
+      job->sset = sset;
+    }
+
+    if(job->sset
+       && job->sset->idx_peer_ifindex) {
+      // Now go ahead and make the call to get the peer_ifindex. This should
+      // work for veth pairs. If the container's device is a macvlan then it's
+      // peer ifIndex will be reported as 0.
+      // Understanding where a macvlan connects to can be
+      // gleaned from a netlink call to RTM_GETLINK,  where the IFLA_LINK
+      // attribute should have the ifIndex of the interface that the macvlan
+      // is on.  See https://github.com/jbenc/plotnetcfg.  However we don't
+      // really need that information to correctly model a macvlan setup as
+      // an sFlow bridge,  so we don't even try to get it here.
+      uint32_t bytes = sizeof(struct ethtool_stats);
+      bytes += job->nctrs * sizeof(uint64_t);
+      bytes += 32; // pad - just in case driver wants to write more
+      struct ethtool_stats *et_stats = (struct ethtool_stats *)my_calloc(bytes);
+      et_stats->cmd = ETHTOOL_GSTATS;
+      et_stats->n_stats = job->nctrs;
+      ifr.ifr_data = (char *)et_stats;
+      if(ioctl(fd, SIOCETHTOOL, &ifr) >= 0) {
+	job->peer_ifIndex = et_stats->data[job->sset->idx_peer_ifindex - 1];
+	job->gotPeer = YES;
+      }
+      my_free(et_stats);
+    }
+  }
+
+  static void ethtool_apply_GSTATS(HSP *sp, HSPEthtoolJob *job)
+  {
+    SFLAdaptor *adaptor = job->adaptor;
     HSPAdaptorNIO *adaptorNIO = ADAPTOR_NIO(adaptor);
-    adaptorNIO->et_nctrs = ethtool_num_counters(ifr, fd);
-    if(adaptorNIO->et_nctrs) {
-      struct ethtool_gstrings *ctrNames;
-      uint32_t bytes = sizeof(*ctrNames) + (adaptorNIO->et_nctrs * ETH_GSTRING_LEN);
-      ctrNames = (struct ethtool_gstrings *)my_calloc(bytes);
-      ctrNames->cmd = ETHTOOL_GSTRINGS;
-      ctrNames->string_set = ETH_SS_STATS;
-      ctrNames->len = adaptorNIO->et_nctrs;
-      ifr->ifr_data = (char *)ctrNames;
-      if(ioctl(fd, SIOCETHTOOL, ifr) >= 0) {
-	// copy out one at a time to make sure we have null-termination
-	char cname[ETH_GSTRING_LEN+1];
-	cname[ETH_GSTRING_LEN] = '\0';
-	adaptorNIO->et_found = 0;
-	for(int ii=0; ii < adaptorNIO->et_nctrs; ii++) {
-	  memcpy(cname, &ctrNames->data[ii * ETH_GSTRING_LEN], ETH_GSTRING_LEN);
-	  myDebug(1, "ethtool counter %s is at index %d", cname, ii);
-	  // then see if this is one of the ones we want,
-	  // and record the index if it is.
-	  if(staticStringsIndexOf(HSP_ethtool_mcasts_in_names, cname) != -1) {
-	    adaptorNIO->et_idx_mcasts_in = ii+1;
-	    adaptorNIO->et_found |= HSP_ETCTR_MC_IN;
-	  }
-	  else if(staticStringsIndexOf(HSP_ethtool_mcasts_out_names, cname) != -1) {
-	    adaptorNIO->et_idx_mcasts_out = ii+1;
-	    adaptorNIO->et_found |= HSP_ETCTR_MC_OUT;
-	  }
-	  else if(staticStringsIndexOf(HSP_ethtool_bcasts_in_names, cname) != -1) {
-	    adaptorNIO->et_idx_bcasts_in = ii+1;
-	    adaptorNIO->et_found |= HSP_ETCTR_BC_IN;
-	    }
-	  else if(staticStringsIndexOf(HSP_ethtool_bcasts_out_names, cname) != -1) {
-	    adaptorNIO->et_idx_bcasts_out = ii+1;
-	    adaptorNIO->et_found |= HSP_ETCTR_BC_OUT;
-	  }
-	  if(staticStringsIndexOf(HSP_ethtool_peer_ifindex_names, cname) != -1) {
-	    // Now go ahead and make the call to get the peer_ifindex. This should
-	    // work for veth pairs. If the container's device is a macvlan then it's
-	    // peer ifIndex will be reported as 0.
-	    // Understanding where a macvlan connects to can be
-	    // gleaned from a netlink call to RTM_GETLINK,  where the IFLA_LINK
-	    // attribute should have the ifIndex of the interface that the macvlan
-	    // is on.  See https://github.com/jbenc/plotnetcfg.  However we don't
-	    // really need that information to correctly model a macvlan setup as
-	    // an sFlow bridge,  so we don't even try to get it here.
-	      struct ethtool_stats *et_stats = (struct ethtool_stats *)my_calloc(bytes);
-	      et_stats->cmd = ETHTOOL_GSTATS;
-	      et_stats->n_stats = adaptorNIO->et_nctrs;
-	      ifr->ifr_data = (char *)et_stats;
-	      if(ioctl(fd, SIOCETHTOOL, ifr) >= 0) {
-		adaptor->peer_ifIndex = et_stats->data[ii];
-		UTHashAdd(sp->adaptorsByPeerIndex, adaptor);
-		myDebug(1, "Interface %s (ifIndex=%u) has peer_ifindex=%u",
-			adaptor->deviceName,
-			adaptor->ifIndex,
-			adaptor->peer_ifIndex);
-	      }
-	      my_free(et_stats);
-	  }
+    HSPEthtoolStringSet *sset = job->sset;
+    if(sset == NULL) {
+      // no stats,  or GSTRINGS failed
+      adaptorNIO->et_found = 0;
+      if(adaptorNIO->et)
+	adaptorNIO->et->et_nctrs = 0;
+      return;
+    }
+    adaptorNIO->et_found = sset->et_found;
+    // only interfaces that have counters we want pay for the extension
+    if(adaptorNIO->et_found) {
+      HSPNIOEthtool *et = nioEthtool(adaptorNIO);
+      et->et_nctrs = sset->nctrs;
+      et->et_idx_mcasts_in = sset->idx_mcasts_in;
+      et->et_idx_mcasts_out = sset->idx_mcasts_out;
+      et->et_idx_bcasts_in = sset->idx_bcasts_in;
+      et->et_idx_bcasts_out = sset->idx_bcasts_out;
+    }
+    else if(adaptorNIO->et)
+      adaptorNIO->et->et_nctrs = sset->nctrs;
+    if(job->gotPeer) {
+      adaptor->peer_ifIndex = job->peer_ifIndex;
+      EVHashRCUAdd(sp->adaptorsByPeerIndex, adaptor);
+      myDebug(1, "Interface %s (ifIndex=%u) has peer_ifindex=%u",
+	      adaptor->deviceName,
+	      adaptor->ifIndex,
+	      adaptor->peer_ifIndex);
+    }
+    // string sets without a key (no driver name) are not cached
+    if(sset->key == NULL)
+      my_free(sset);
+  }
+
+/*________________---------------------------__________________
+  ________________  ethtool_discovery        __________________
+  ----------------___________________________------------------
+  Run ethtool_get_GSTATS() for every queued adaptor,  spread across
+  HSP_ETHTOOL_THREADS workers (each with its own socket) when there
+  are enough of them to make it worthwhile.  Results are applied
+  afterwards on this thread,  in the original order.
+*/
+
+  typedef struct _HSPEthtoolWork {
+    HSPEthtoolJob *jobs;
+    uint32_t n_jobs;
+    uint32_t next_job;
+  } HSPEthtoolWork;
+
+  static void *ethtool_worker(void *magic)
+  {
+    HSPEthtoolWork *work = (HSPEthtoolWork *)magic;
+    int fd = socket(PF_INET, SOCK_DGRAM, 0);
+    if(fd < 0) {
+      myLog(LOG_ERR, "ethtool_worker: socket() failed: %s", strerror(errno));
+      return NULL;
+    }
+    for(;;) {
+      uint32_t jj = __atomic_fetch_add(&work->next_job, 1, __ATOMIC_RELAXED);
+      if(jj >= work->n_jobs)
+	break;
+      ethtool_get_GSTATS(fd, &work->jobs[jj]);
+    }
+    close(fd);
+    return NULL;
+  }
+
+  static void ethtool_discovery(HSP *sp, UTArray *queue, int fd)
+  {
+    if(UTArrayN(queue) == 0)
+      return;
+    if(ethtoolStringSets == NULL)
+      ethtoolStringSets = UTHASH_NEW(HSPEthtoolStringSet, key, UTHASH_SKEY);
+    HSPEthtoolWork work = { 0 };
+    work.n_jobs = UTArrayN(queue);
+    work.jobs = (HSPEthtoolJob *)my_calloc(work.n_jobs * sizeof(HSPEthtoolJob));
+    for(uint32_t jj = 0; jj < work.n_jobs; jj++)
+      work.jobs[jj].adaptor = UTArrayAt(queue, jj);
+
+    uint32_t n_threads = 0;
+    pthread_t threads[HSP_ETHTOOL_THREADS];
+    if(work.n_jobs >= HSP_ETHTOOL_PARALLEL_MIN) {
+      pthread_attr_t attr;
+      pthread_attr_init(&attr);
+      pthread_attr_setstacksize(&attr, EV_BUS_STACKSIZE);
+      for(; n_threads < HSP_ETHTOOL_THREADS; n_threads++) {
+	int err = pthread_create(&threads[n_threads], &attr, ethtool_worker, &work);
+	if(err) {
+	  myLog(LOG_ERR, "ethtool_discovery: pthread_create() failed: %s", strerror(err));
+	  break;
 	}
       }
-      my_free(ctrNames);
+      pthread_attr_destroy(&attr);
+    }
+    if(n_threads == 0) {
+      // do it here,  with the caller's socket
+      for(uint32_t jj = 0; jj < work.n_jobs; jj++)
+	ethtool_get_GSTATS(fd, &work.jobs[jj]);
     }
+    for(uint32_t tt = 0; tt < n_threads; tt++)
+      pthread_join(threads[tt], NULL);
+
+    uint32_t hits = 0, misses = 0;
+    for(uint32_t jj = 0; jj < work.n_jobs; jj++) {
+      HSPEthtoolJob *job = &work.jobs[jj];
+      if(job->nctrs) {
+	if(job->cacheHit) hits++;
+	else misses++;
+      }
+      ethtool_apply_GSTATS(sp, job);
+    }
+    telemetryAdd(sp->t_ethtool_sset_hits, hits);
+    telemetryAdd(sp->t_ethtool_sset_misses, misses);
+    myDebug(1, "ethtool_discovery: %u devices, %u threads, string-set cache hits=%u misses=%u",
+	    work.n_jobs,
+	    n_threads,
+	    hits,
+	    misses);
+    my_free(work.jobs);
   }
 
 /*________________---------------------------__________________
@@ -518,7 +736,7 @@ extern "C" {
   ----------------___________________________------------------
 */
 
-  static bool read_ethtool_info(HSP *sp, struct ifreq *ifr, int fd, SFLAdaptor *adaptor)
+  static bool read_ethtool_info(HSP *sp, struct ifreq *ifr, int fd, SFLAdaptor *adaptor, UTArray *gstatsQ)
   {
     bool changed = NO;
     HSPAdaptorNIO *nio = ADAPTOR_NIO(adaptor);
@@ -549,7 +767,8 @@ extern "C" {
 #endif
 
     if(nio->ethtool_GSTATS) {
-      ethtool_get_GSTATS(sp, ifr, fd, adaptor);
+      // deferred - see ethtool_discovery()
+      UTArrayAdd(gstatsQ, adaptor);
     }
     return changed;
   }
@@ -613,6 +832,14 @@ extern "C" {
   ----------------___________________________------------------
 */
 
+  static void localIPFree(void *obj) {
+    UTHash *localHT = (UTHash *)obj;
+    SFLAddress *ad;
+    UTHASH_WALK(localHT, ad)
+      my_free(ad);
+    UTHashFree(localHT);
+  }
+
   int readInterfaces(HSP *sp, bool full_discovery,  uint32_t *p_added, uint32_t *p_removed, uint32_t *p_cameup, uint32_t *p_wentdown, uint32_t *p_changed)
   {
   uint32_t ad_added=0, ad_removed=0, ad_cameup=0, ad_wentdown=0, ad_changed=0;
@@ -622,6 +849,9 @@ extern "C" {
 
   { SFLAdaptor *ad;  UTHASH_WALK(sp->adaptorsByName, ad) ad->marked = YES; }
 
+  struct timespec t_start;
+  EVClockMono(&t_start);
+
   // Walk the interfaces and collect the non-loopback interfaces so that we
   // have a list of MAC addresses for each interface (usually only 1).
   //
@@ -636,6 +866,7 @@ extern "C" {
     return 0;
   }
 
+  UTArray *gstatsQ = UTArrayNew(UTARRAY_DFLT);
   FILE *procFile = fopen("/proc/net/dev", "r");
   if(procFile) {
     struct ifreq ifr;
@@ -783,7 +1014,7 @@ extern "C" {
 	// but it only really makes sense to receive it on the POLL_BUS
 	EVEventTxAll(sp->rootModule, HSPEVENT_INTF_READ, &adaptor, sizeof(adaptor));
 	// use ethtool to get info about direction/speed and more
-	if(read_ethtool_info(sp, &ifr, fd, adaptor) == YES) {
+	if(read_ethtool_info(sp, &ifr, fd, adaptor, gstatsQ) == YES) {
 	  ad_changed++;
 	}
       }
@@ -801,8 +1032,21 @@ extern "C" {
     fclose(procFile);
   }
 
+  // the ethtool GSTRINGS/GSTATS lookups for all the adaptors at once
+  ethtool_discovery(sp, gstatsQ, fd);
+  UTArrayFree(gstatsQ);
+
   close (fd);
 
+  if(full_discovery) {
+    struct timespec t_end;
+    EVClockMono(&t_end);
+    int64_t discovery_mS = ((t_end.tv_sec - t_start.tv_sec) * 1000)
+      + ((t_end.tv_nsec - t_start.tv_nsec) / 1000000);
+    telemetrySet(sp->t_discovery_mS, discovery_mS);
+    myDebug(1, "readInterfaces: full discovery took %"PRId64" mS", discovery_mS);
+  }
+
   // now remove and free any that are still marked
   ad_removed = deleteMarkedAdaptors(sp, sp->adaptorsByName, YES);
 
@@ -827,23 +1071,16 @@ extern "C" {
   if(p_wentdown) *p_wentdown = ad_wentdown;
   if(p_changed) *p_changed = ad_changed;
 
-  // swap in new localIP lookup tables
-  UTHash *oldLocalIP = sp->localIP;
-  UTHash *oldLocalIP6 = sp->localIP6;
-  sp->localIP = newLocalIP;
-  sp->localIP6 = newLocalIP6;
-  if(oldLocalIP) {
-    SFLAddress *ad;
-    UTHASH_WALK(oldLocalIP, ad)
-      my_free(ad);
-    UTHashFree(oldLocalIP);
-  }
-  if(oldLocalIP6) {
-    SFLAddress *ad;
-    UTHASH_WALK(oldLocalIP6, ad)
-      my_free(ad);
-    UTHashFree(oldLocalIP6);
-  }
+  // publish peer_ifIndex changes for the packet bus
+  EVHashRCUPublish(sp->rootModule, sp->adaptorsByPeerIndex);
+
+  // swap in new localIP lookup tables. isLocalAddress() may be
+  // reading the old ones from another bus, so retire them with a
+  // grace period rather than freeing them here.
+  UTHash *oldLocalIP = __atomic_exchange_n(&sp->localIP, newLocalIP, __ATOMIC_ACQ_REL);
+  UTHash *oldLocalIP6 = __atomic_exchange_n(&sp->localIP6, newLocalIP6, __ATOMIC_ACQ_REL);
+  EVDeferFree(sp->rootModule, oldLocalIP, localIPFree);
+  EVDeferFree(sp->rootModule, oldLocalIP6, localIPFree);
 
   return sp->adaptorsByName->entries;
 }
@@ -854,8 +1091,8 @@ extern "C" {
 */
   bool isLocalAddress(HSP *sp, SFLAddress *addr) {
     UTHash *localHT = (addr->type == SFLADDRESSTYPE_IP_V6)
-      ? sp->localIP6
-      : sp->localIP;
+      ? __atomic_load_n(&sp->localIP6, __ATOMIC_ACQUIRE)
+      : __atomic_load_n(&sp->localIP, __ATOMIC_ACQUIRE);
     return (UTHashGet(localHT, addr) != NULL);
   }
   
@@ -19,14 +19,19 @@ extern "C" {
     -----------------___________________________------------------
   */
 
+  static uint32_t nioAttachedAggID(HSPAdaptorNIO *nio) {
+    // LACP state is only allocated for bonds and their slaves
+    return nio->lacp ? nio->lacp->attachedAggID : 0;
+  }
+
   static void shareActorIDFromSlave(HSP *sp, HSPAdaptorNIO *bond_nio, HSPAdaptorNIO *aggregator_slave_nio) {
     SFLAdaptor *adaptor;
     UTHASH_WALK(sp->adaptorsByIndex, adaptor) {
       HSPAdaptorNIO *nio = ADAPTOR_NIO(adaptor);
       if(nio->bond_slave
 	 && nio != aggregator_slave_nio
-	 && nio->lacp.attachedAggID == bond_nio->lacp.attachedAggID) {
-	memcpy(nio->lacp.actorSystemID, aggregator_slave_nio->lacp.actorSystemID, 6);
+	 && nioAttachedAggID(nio) == nioAttachedAggID(bond_nio)) {
+	memcpy(nioLACP(nio)->actorSystemID, aggregator_slave_nio->lacp->actorSystemID, 6);
       }
     }
   }
@@ -47,14 +52,16 @@ extern "C" {
       char line[MAX_PROC_LINE_CHARS];
       SFLAdaptor *currentSlave = NULL;
       HSPAdaptorNIO *slave_nio = NULL;
+      SFLLACP_counters *slave_lacp = NULL;
       HSPAdaptorNIO *bond_nio = ADAPTOR_NIO(bond);
+      SFLLACP_counters *bond_lacp = nioLACP(bond_nio);
       HSPAdaptorNIO *aggregator_slave_nio = NULL;
-      bond_nio->lacp.attachedAggID = bond->ifIndex;
+      bond_lacp->attachedAggID = bond->ifIndex;
       uint32_t aggID = 0;
       // make sure we don't hold on to stale data - may need
       // to pick up actorSystemID from a slave port.
-      memset(bond_nio->lacp.actorSystemID, 0, 6);
-      memset(bond_nio->lacp.partnerSystemID, 0, 6);
+      memset(bond_lacp->actorSystemID, 0, 6);
+      memset(bond_lacp->partnerSystemID, 0, 6);
       int readingMaster = YES; // bond master data comes first
       int gotActorID = NO;
       while(fgets(line, MAX_PROC_LINE_CHARS, procFile)) {
@@ -68,13 +75,13 @@ extern "C" {
 	  if(readingMaster) {
 	    if(my_strequal(tok_var, "MII Status")) {
 	      if(my_strequal(tok_val, "up")) {
-		bond_nio->lacp.portState.v.actorAdmin = 2; // dot3adAggPortActorAdminState
-		bond_nio->lacp.portState.v.actorOper = 2;
-		bond_nio->lacp.portState.v.partnerAdmin = 2;
-		bond_nio->lacp.portState.v.partnerOper = 2;
+		bond_lacp->portState.v.actorAdmin = 2; // dot3adAggPortActorAdminState
+		bond_lacp->portState.v.actorOper = 2;
+		bond_lacp->portState.v.partnerAdmin = 2;
+		bond_lacp->portState.v.partnerOper = 2;
 	      }
 	      else {
-		bond_nio->lacp.portState.all = 0;
+		bond_lacp->portState.all = 0;
 	      }
 	    }
 
@@ -85,10 +92,10 @@ extern "C" {
 	      char sys_mac[MAX_PROC_LINE_CHARS];
 	      uint64_t code;
 	      if(sscanf(tok_val, "%"SCNu64"  %s", &code, sys_mac) == 2) {
-		if(hexToBinary((u_char *)sys_mac,bond_nio->lacp.actorSystemID, 6) != 6) {
+		if(hexToBinary((u_char *)sys_mac,bond_lacp->actorSystemID, 6) != 6) {
 		  myLog(LOG_ERR, "updateBondCounters: system mac read error: %s", sys_mac);
 		}
-		else if(!isAllZero(bond_nio->lacp.actorSystemID, 6)) {
+		else if(!isAllZero(bond_lacp->actorSystemID, 6)) {
 		  gotActorID = YES;
 		}
 	      }
@@ -98,7 +105,7 @@ extern "C" {
 	      myDebug(1, "updateBondCounters: %s partner mac is %s",
 		      bond->deviceName,
 		      tok_val);
-	      if(hexToBinary((u_char *)tok_val,bond_nio->lacp.partnerSystemID, 6) != 6) {
+	      if(hexToBinary((u_char *)tok_val,bond_lacp->partnerSystemID, 6) != 6) {
 		myLog(LOG_ERR, "updateBondCounters: partner mac read error: %s", tok_val);
 	      }
 	    }
@@ -117,15 +124,16 @@ extern "C" {
 	    readingMaster = NO;
 	    currentSlave = adaptorByName(sp, trimWhitespace(tok_val));
 	    slave_nio = currentSlave ? ADAPTOR_NIO(currentSlave) : NULL;
+	    slave_lacp = slave_nio ? nioLACP(slave_nio) : NULL;
 	    myDebug(1, "updateBondCounters: bond %s slave %s %s",
 		  bond->deviceName,
 		  tok_val,
 		  currentSlave ? "found" : "not found");
 	    if(slave_nio) {
 	      // initialize from bond
-	      slave_nio->lacp.attachedAggID = bond->ifIndex;
-	      memcpy(slave_nio->lacp.partnerSystemID, bond_nio->lacp.partnerSystemID, 6);
-	      memcpy(slave_nio->lacp.actorSystemID, bond_nio->lacp.actorSystemID, 6);
+	      slave_lacp->attachedAggID = bond->ifIndex;
+	      memcpy(slave_lacp->partnerSystemID, bond_lacp->partnerSystemID, 6);
+	      memcpy(slave_lacp->actorSystemID, bond_lacp->actorSystemID, 6);
 
 	      // make sure the parent is going to export separate
 	      // counters if the slave is going to (because it was
@@ -152,13 +160,13 @@ extern "C" {
 	  if(readingMaster == NO && slave_nio) {
 	    if(my_strequal(tok_var, "MII Status")) {
 	      if(my_strequal(tok_val, "up")) {
-		slave_nio->lacp.portState.v.actorAdmin = 2; // dot3adAggPortActorAdminState
-		slave_nio->lacp.portState.v.actorOper = 2;
-		slave_nio->lacp.portState.v.partnerAdmin = 2;
-		slave_nio->lacp.portState.v.partnerOper = 2;
+		slave_lacp->portState.v.actorAdmin = 2; // dot3adAggPortActorAdminState
+		slave_lacp->portState.v.actorOper = 2;
+		slave_lacp->portState.v.partnerAdmin = 2;
+		slave_lacp->portState.v.partnerOper = 2;
 	      }
 	      else {
-		slave_nio->lacp.portState.all = 0;
+		slave_lacp->portState.all = 0;
 	      }
 	    }
 
@@ -167,7 +175,7 @@ extern "C" {
 		// Still looking for our actorSystemID, so capture this here in case we
 		// decide below that it is the one we want.  Note that this mac may not be the
 		// same as the mac associated with this port that we read back in readInterfaces.c.
-		if(hexToBinary((u_char *)tok_val,slave_nio->lacp.actorSystemID, 6) != 6) {
+		if(hexToBinary((u_char *)tok_val,slave_lacp->actorSystemID, 6) != 6) {
 		  myLog(LOG_ERR, "updateBondCounters: permanent HW addr read error: %s", tok_val);
 		}
 	      }
@@ -272,7 +280,7 @@ extern "C" {
     UTHASH_WALK(sp->adaptorsByIndex, search_ad) {
       if(search_ad != bond) {
 	HSPAdaptorNIO *search_nio = ADAPTOR_NIO(search_ad);
-	if(search_nio && search_nio->lacp.attachedAggID == bond->ifIndex) {
+	if(search_nio && nioAttachedAggID(search_nio) == bond->ifIndex) {
 
 	  myDebug(1, "synthesizeBondMetaData: bond %s component %s (ifSpeed=%"PRIu64" dirn=%u up=%s)",
 		  bond->deviceName,
@@ -313,7 +321,7 @@ extern "C" {
     UTHASH_WALK(sp->adaptorsByIndex, adaptor) {
       HSPAdaptorNIO *nio = ADAPTOR_NIO(adaptor);
       if(nio->bond_slave
-	 && nio->lacp.attachedAggID == bond_nio->lacp.attachedAggID) {
+	 && nioAttachedAggID(nio) == nioAttachedAggID(bond_nio)) {
 	// put the slave on the same polling schedule as the master.
 	// This isn't strictly necessary, but it will reduce the
 	// frequency of access to th /proc/net/bonding file.
@@ -330,6 +338,12 @@ extern "C" {
 
   void syncBondPolling(HSP *sp) {
     SFLAdaptor *adaptor;
+    // forget old relationships - they are recorded again below
+    UTHASH_WALK(sp->adaptorsByIndex, adaptor) {
+      HSPAdaptorNIO *nio = ADAPTOR_NIO(adaptor);
+      if(nio->poller)
+	nio->poller->syncMaster = NULL;
+    }
     UTHASH_WALK(sp->adaptorsByIndex, adaptor) {
       if(ADAPTOR_NIO(adaptor)->bond_master)
 	syncSlavePolling(sp, adaptor);
@@ -362,8 +376,229 @@ extern "C" {
     }
   }
 
+  /*_________________---------------------------__________________
+    _________________      levelPolling         __________________
+    -----------------___________________________------------------
+    The poll-bus records what each getCounters callback costs
+    (poller->cost_uS).  With random or clustered countdowns several
+    expensive ones (SFP EEPROM reads, bond state) can land in the
+    same second and stall the bus,  so reassign countdowns greedily,
+    most expensive first,  to the least loaded second of the polling
+    interval.  Pollers synchronized to a master move with it,  and
+    switch ports stay on syncPollingInterval boundaries.  Only applied
+    if it lowers the peak by at least 10%.
+  */
+
+  typedef struct _HSPPollUnit {
+    SFLPoller *poller;
+    uint64_t cost_uS; // including followers
+    uint32_t step;
+    time_t countdown;
+  } HSPPollUnit;
+
+  static int pollUnitCompare(const void *a, const void *b) {
+    HSPPollUnit *ua = *(HSPPollUnit **)a;
+    HSPPollUnit *ub = *(HSPPollUnit **)b;
+    if(ua->cost_uS > ub->cost_uS) return -1;
+    if(ua->cost_uS < ub->cost_uS) return 1;
+    return 0;
+  }
+
+  static bool levelCandidate(SFLPoller *pl, uint32_t interval) {
+    return (pl->sFlowCpInterval == interval
+	    && pl->countersCountdown > 0
+	    && pl->countersCountdown <= interval
+	    && pl->cost_uS > 0);
+  }
+
+  static uint64_t peakLoad(uint64_t *load, uint32_t interval) {
+    uint64_t peak = 0;
+    for(uint32_t cd = 1; cd <= interval; cd++)
+      if(load[cd] > peak)
+	peak = load[cd];
+    return peak;
+  }
+
+  void levelPolling(HSP *sp) {
+    uint32_t interval = sp->actualPollingInterval;
+    if(interval <= 1)
+      return;
+    // load per second, indexed by countdown (1..interval)
+    uint64_t *load_before = (uint64_t *)my_calloc((interval + 1) * sizeof(uint64_t));
+    uint64_t *load_after = (uint64_t *)my_calloc((interval + 1) * sizeof(uint64_t));
+    UTHash *units = UTHASH_NEW(HSPPollUnit, poller, UTHASH_DFLT);
+    uint64_t peak_before = 0, peak_after = 0;
+    uint32_t moves = 0;
+
+    TIMEDLOCK_DO(sp->sync_pollers) {
+      SFLPoller *pl;
+      // each measured poller that is not synchronized to another is a unit
+      for(pl = sp->agent->pollers; pl; pl = pl->nxt) {
+	if(!levelCandidate(pl, interval))
+	  continue;
+	load_before[pl->countersCountdown] += pl->cost_uS;
+	if(pl->syncMaster == NULL) {
+	  HSPPollUnit *unit = (HSPPollUnit *)my_calloc(sizeof(HSPPollUnit));
+	  unit->poller = pl;
+	  unit->cost_uS = pl->cost_uS;
+	  unit->step = 1;
+	  unit->countdown = pl->countersCountdown;
+	  UTHashAdd(units, unit);
+	}
+      }
+      // followers add to their master's unit,  or stay where they are
+      for(pl = sp->agent->pollers; pl; pl = pl->nxt) {
+	if(!levelCandidate(pl, interval)
+	   || pl->syncMaster == NULL)
+	  continue;
+	HSPPollUnit search = { .poller = pl->syncMaster };
+	HSPPollUnit *unit = UTHashGet(units, &search);
+	if(unit)
+	  unit->cost_uS += pl->cost_uS;
+	else
+	  load_after[pl->countersCountdown] += pl->cost_uS;
+      }
+      // switch ports must stay clustered (see syncPolling)
+      if(sp->syncPollingInterval > 1) {
+	SFLAdaptor *adaptor;
+	UTHASH_WALK(sp->adaptorsByIndex, adaptor) {
+	  HSPAdaptorNIO *nio = ADAPTOR_NIO(adaptor);
+	  if(nio->poller
+	     && nio->switchPort) {
+	    HSPPollUnit search = { .poller = nio->poller };
+	    HSPPollUnit *unit = UTHashGet(units, &search);
+	    if(unit)
+	      unit->step = sp->syncPollingInterval;
+	  }
+	}
+      }
+      // most expensive first
+      uint32_t n_units = UTHashN(units);
+      HSPPollUnit **sorted = (HSPPollUnit **)my_calloc((n_units + 1) * sizeof(HSPPollUnit *));
+      uint32_t n_sorted = 0;
+      HSPPollUnit *unit;
+      UTHASH_WALK(units, unit)
+	sorted[n_sorted++] = unit;
+      qsort(sorted, n_sorted, sizeof(HSPPollUnit *), pollUnitCompare);
+      for(uint32_t ii = 0; ii < n_sorted; ii++) {
+	unit = sorted[ii];
+	// prefer to stay put unless somewhere else is strictly lighter
+	time_t best = 0;
+	uint64_t bestLoad = UINT64_MAX;
+	if((unit->countdown % unit->step) == 0) {
+	  best = unit->countdown;
+	  bestLoad = load_after[best];
+	}
+	for(uint32_t cd = unit->step; cd <= interval; cd += unit->step) {
+	  if(load_after[cd] < bestLoad) {
+	    best = cd;
+	    bestLoad = load_after[cd];
+	  }
+	}
+	if(best == 0)
+	  best = unit->countdown; // no legal slot - leave it alone
+	unit->countdown = best;
+	load_after[best] += unit->cost_uS;
+      }
+      my_free(sorted);
+
+      peak_before = peakLoad(load_before, interval);
+      peak_after = peakLoad(load_after, interval);
+      if((peak_after * 10) < (peak_before * 9)) {
+	UTHASH_WALK(units, unit) {
+	  if(unit->poller->countersCountdown != unit->countdown) {
+	    unit->poller->countersCountdown = unit->countdown;
+	    moves++;
+	  }
+	}
+	// bring the followers along
+	for(pl = sp->agent->pollers; pl; pl = pl->nxt) {
+	  if(pl->syncMaster
+	     && pl->syncMaster->countersCountdown
+	     && pl->countersCountdown != pl->syncMaster->countersCountdown) {
+	    pl->countersCountdown = pl->syncMaster->countersCountdown;
+	    moves++;
+	  }
+	}
+      }
+    }
+
+    myDebug(1, "levelPolling: units=%u peak_uS before=%"PRIu64" after=%"PRIu64" moves=%u",
+	    UTHashN(units),
+	    peak_before,
+	    peak_after,
+	    moves);
+    telemetryAdd(sp->t_poll_level_moves, moves);
+    HSPPollUnit *unit;
+    UTHASH_WALK(units, unit)
+      my_free(unit);
+    UTHashFree(units);
+    my_free(load_before);
+    my_free(load_after);
+  }
+
 #if ( HSP_OPTICAL_STATS && ETHTOOL_GMODULEEEPROM )
 
+  /*_________________---------------------------__________________
+    _________________   asynchronous optics     __________________
+    -----------------___________________________------------------
+    Module EEPROM reads go over a slow I2C bus,  so they are done in
+    a separate thread (HSPBUS_OPTICS) and only every
+    HSP_OPTICS_POLL_SECS.  The identification and calibration pages
+    are read in full when a module is first seen and then every
+    HSP_OPTICS_ID_SECS.  In between only the few bytes of live
+    diagnostics are read,  and patched into the cached image before
+    it is parsed.  Results go back to the poll bus only if they changed.
+  */
+
+#define HSP_OPTICS_MAX_LANES 4
+#define HSP_OPTICS_IMAGE_LEN ETH_MODULE_SFF_8436_LEN
+  // live diagnostics: SFF-8472 A2h bytes 96-105 (temp, vcc, bias, tx, rx)
+#define SFF8472_DIAG_OFFSET (256 + 96)
+#define SFF8472_DIAG_LEN 10
+  // SFF-8436 lower page bytes 0-49 (identifier, temp, vcc, rx power, bias)
+#define SFF8436_DIAG_OFFSET 0
+#define SFF8436_DIAG_LEN 50
+
+  typedef struct _HSPOpticsRequest {
+    char devName[IFNAMSIZ];
+    uint32_t ifIndex;
+    uint32_t modinfo_type;
+    uint32_t modinfo_len;
+  } HSPOpticsRequest;
+
+  typedef struct _HSPOpticsReading {
+    char devName[IFNAMSIZ];
+    uint32_t ifIndex;
+    uint32_t module_total_lanes;
+    uint32_t module_supply_voltage;
+    int32_t module_temperature;
+    uint32_t num_lanes;
+    SFLLane lanes[HSP_OPTICS_MAX_LANES];
+  } HSPOpticsReading;
+
+  typedef struct _HSPOpticsModule {
+    char *devName;
+    uint32_t ifIndex;
+    uint32_t modinfo_type;
+    uint32_t modinfo_len;
+    bool id_ok;
+    time_t next_id_read;
+    time_t last_request;
+    HSPOpticsReading last; // as last sent to the poll bus
+    u_char image[HSP_OPTICS_IMAGE_LEN];
+  } HSPOpticsModule;
+
+  struct _HSPOpticsWorker {
+    int fd;
+    UTHash *modules; // by devName - only touched in the optics thread
+    EVEvent *readingEvent;
+    uint32_t t_id_reads;
+    uint32_t t_diag_reads;
+    uint32_t t_errors;
+    uint32_t t_unchanged;
+  };
+
   /*_________________---------------------------__________________
     _________________    SFF8472 SFP Data       __________________
     -----------------___________________________------------------
@@ -399,32 +634,21 @@ extern "C" {
   }
 #define SFF8472_CAL_RXPWR(x, ff) (x) = sff8472_calibration_rxpwr((x), (ff))
 
-  static void sff8472_read(SFLAdaptor *adaptor, struct ifreq *ifr, int fd)
+  static bool sff8472_parse(HSPOpticsModule *om, HSPOpticsReading *rd)
   {
-    struct ethtool_eeprom *eeprom = NULL;
-    HSPAdaptorNIO *nio = ADAPTOR_NIO(adaptor);
-
-    if(nio->modinfo_len < ETH_MODULE_SFF_8472_LEN)
-      goto out;
-
-    eeprom = (struct ethtool_eeprom *)my_calloc(sizeof(*eeprom) + ETH_MODULE_SFF_8472_LEN);
-    eeprom->cmd = ETHTOOL_GMODULEEEPROM;
-    eeprom->len = ETH_MODULE_SFF_8472_LEN;
-    ifr->ifr_data = (char *)eeprom;
-    if(ioctl(fd, SIOCETHTOOL, ifr) < 0) {
-      myLog(LOG_ERR, "SFF8036 ethtool ioctl failed: %s", strerror(errno));
-      goto out;
-    }
+    if(om->modinfo_len < ETH_MODULE_SFF_8472_LEN)
+      return NO;
 
-    if(eeprom->data[0] != 0x03 ||
-       eeprom->data[1] != 0x04) {
-      goto out;
+    u_char *data = om->image;
+    if(data[0] != 0x03 ||
+       data[1] != 0x04) {
+      return NO;
     }
 
     // test (SFF_A0_DOM & SFF_A0_DOM_IMPL)
-    if(!(eeprom->data[92] & 0x40)) {
+    if(!(data[92] & 0x40)) {
       // no optical stats
-      goto out;
+      return NO;
     }
 
     uint32_t num_lanes = 1;
@@ -433,10 +657,10 @@ extern "C" {
     double tx_power, tx_power_max, tx_power_min;
     double rx_power, rx_power_max, rx_power_min;
 
-    uint16_t *eew = (uint16_t *)(eeprom->data);
+    uint16_t *eew = (uint16_t *)data;
 
     // wavelength
-    if(!(eeprom->data[8] & 0x0c)) {
+    if(!(data[8] & 0x0c)) {
       wavelength = ntohs(eew[30]);
     }
 
@@ -460,7 +684,7 @@ extern "C" {
     rx_power_min = ntohs(eew[128 + 17]);
 
     // calibration
-    if(eeprom->data[92] & 0x10) {
+    if(data[92] & 0x10) {
       // apply external calibration
       SFF8472_CAL(bias_current, eew, (128 + 38));
       SFF8472_CAL(tx_power, eew, (128 + 40));
@@ -480,14 +704,12 @@ extern "C" {
       SFF8472_CAL_RXPWR(rx_power_max, (float *)rxpwr);
     }
 
-    // populate sFlow structure
-    nio->sfp.lanes = (SFLLane *)my_realloc(nio->sfp.lanes, sizeof(SFLLane) * num_lanes);
-    nio->sfp.module_id = adaptor->ifIndex;
-    nio->sfp.module_total_lanes = num_lanes;
-    nio->sfp.module_supply_voltage = (voltage / 10); // mV
-    nio->sfp.module_temperature = (temperature * 1000); // mC
-    nio->sfp.num_lanes = num_lanes;
-    SFLLane *lane = &(nio->sfp.lanes[0]);
+    // populate reading
+    rd->module_total_lanes = num_lanes;
+    rd->module_supply_voltage = (voltage / 10); // mV
+    rd->module_temperature = (temperature * 1000); // mC
+    rd->num_lanes = num_lanes;
+    SFLLane *lane = &(rd->lanes[0]);
     lane->lane_index = 1;
     lane->tx_bias_current = (bias_current * 2); // uA
     lane->tx_power = (tx_power / 10); // uW
@@ -500,10 +722,10 @@ extern "C" {
     lane->rx_wavelength = wavelength; // same as tx_wavelength
 
     myDebug(1, "SFP8472 %s u=%u(nm) T=%u(mC) V=%u(mV) I=%u(uA) tx=%u(uW) [%u-%u] rx=%u(uW) [%u-%u]",
-	    adaptor->deviceName,
+	    om->devName,
 	    lane->tx_wavelength,
-	    nio->sfp.module_temperature,
-	    nio->sfp.module_supply_voltage,
+	    rd->module_temperature,
+	    rd->module_supply_voltage,
 	    lane->tx_bias_current,
 	    lane->tx_power,
 	    lane->tx_power_min,
@@ -511,81 +733,23 @@ extern "C" {
 	    lane->rx_power,
 	    lane->rx_power_min,
 	    lane->rx_power_max);
-
-  out:
-    if(eeprom)
-      my_free(eeprom);
+    return YES;
   }
 
-  static void sff8436_read(SFLAdaptor *adaptor, struct ifreq *ifr, int fd)
-  {
-    struct ethtool_eeprom *eeprom = NULL;
-    HSPAdaptorNIO *nio = ADAPTOR_NIO(adaptor);
-
-    if(nio->modinfo_len < ETH_MODULE_SFF_8436_LEN)
-      goto out;
+  /*_________________---------------------------__________________
+    _________________    SFF8436 QSFP Data      __________________
+    -----------------___________________________------------------
+  */
 
-    eeprom = (struct ethtool_eeprom *)my_calloc(sizeof(*eeprom) + ETH_MODULE_SFF_8436_LEN);
-    eeprom->cmd = ETHTOOL_GMODULEEEPROM;
-    eeprom->len = ETH_MODULE_SFF_8436_LEN;
-#ifdef HSP_TEST_QSFP
-    int bytes = hexToBinary((u_char *)
-			    "0d-00-02-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-1b-10-00-00-7f-92-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-ff-ff-ff-ff-ff-ff-ff-ff-00"
-			    "0d-00-23-00-00-00-00-40-40-06-d5-05-69-00-00-05"
-			    "0a-00-0a-00-46-49-4e-49-53-41-52-20-43-4f-52-50"
-			    "20-20-20-20-07-00-90-65-46-43-42-47-34-31-30-51"
-			    "42-31-43-31-30-2d-46-43-41-20-42-68-07-d0-46-db"
-			    "00-01-04-da-44-53-4a-30-30-41-41-20-20-20-20-20"
-			    "20-20-20-20-31-34-31-30-32-37-20-20-08-00-00-39"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "0f-10-00-a1-53-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "4b-00-fb-00-46-00-00-00-00-00-00-00-00-00-00-00"
-			    "94-70-6e-f0-86-c4-7b-0c-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-22-22-00-00-00-00-00-00-00-00-00-00-33-33"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00",
-			    &eeprom->data[0],
-			    ETH_MODULE_SFF_8436_LEN);
-    if(bytes != ETH_MODULE_SFF_8436_LEN) {
-      myLog(LOG_ERR, "test QSFP: hexToBinary failed (bytes=%d)", bytes);
-    }
-#else
-    ifr->ifr_data = (char *)eeprom;
-    if(ioctl(fd, SIOCETHTOOL, ifr) < 0) {
-      myLog(LOG_ERR, "SFF8036 ethtool ioctl failed: %s", strerror(errno));
-      goto out;
-    }
-#endif
+  static bool sff8436_parse(HSPOpticsModule *om, HSPOpticsReading *rd)
+  {
+    if(om->modinfo_len < ETH_MODULE_SFF_8436_LEN)
+      return NO;
 
+    u_char *data = om->image;
     // check for SFF8436_ID_DWDM_QSFP_PLUS
-    if(eeprom->data[0] != 0x0d) {
-      goto out;
+    if(data[0] != 0x0d) {
+      return NO;
     }
 
     uint32_t num_lanes = 4;
@@ -593,7 +757,7 @@ extern "C" {
     double temperature, voltage, bias_current[4];
     double rx_power[4], rx_power_max, rx_power_min;
 
-    uint16_t *eew = (uint16_t *)(eeprom->data);
+    uint16_t *eew = (uint16_t *)data;
 
     // wavelength - determined by transciever technology code
 #ifndef SFF8436_DEVICE_TECH_OFFSET
@@ -618,7 +782,7 @@ extern "C" {
 #define SFF8436_TRANS_850_VCSEL (0 << 4)
 #endif
 
-    uint8_t tx_tech = (eeprom->data[SFF8436_DEVICE_TECH_OFFSET]
+    uint8_t tx_tech = (data[SFF8436_DEVICE_TECH_OFFSET]
 		       & SFF8436_TRANS_TECH_MASK);
     switch (tx_tech) {
     case SFF8436_TRANS_850_VCSEL: wavelength = 850; break;
@@ -650,16 +814,14 @@ extern "C" {
     rx_power_max = ntohs(eew[256 + 24]);
     rx_power_min = ntohs(eew[256 + 25]);
 
-    // populate sFlow structure
-    nio->sfp.lanes = (SFLLane *)my_realloc(nio->sfp.lanes, sizeof(SFLLane) * num_lanes);
-    nio->sfp.module_id = adaptor->ifIndex;
-    nio->sfp.module_total_lanes = num_lanes;
-    nio->sfp.module_supply_voltage = (voltage / 10); // mV
-    nio->sfp.module_temperature = (temperature * 1000); // mC
-    nio->sfp.num_lanes = num_lanes;
+    // populate reading
+    rd->module_total_lanes = num_lanes;
+    rd->module_supply_voltage = (voltage / 10); // mV
+    rd->module_temperature = (temperature * 1000); // mC
+    rd->num_lanes = num_lanes;
 
     for (int ch=0; ch < num_lanes; ch++) {
-      SFLLane *lane = &(nio->sfp.lanes[ch]);
+      SFLLane *lane = &(rd->lanes[ch]);
       lane->lane_index = (ch + 1);
       lane->tx_bias_current = (bias_current[ch] * 2); // uA
       lane->tx_wavelength = wavelength;
@@ -669,11 +831,11 @@ extern "C" {
       lane->rx_wavelength = wavelength; // same as tx_wavelength
 
       myDebug(1, "SFP8436 %s[%u] u=%u(nm) T=%u(mC) V=%u(mV) I=%u(uA) tx=%u(uW) [%u-%u] rx=%u(uW) [%u-%u]",
-	    adaptor->deviceName,
+	    om->devName,
 	    ch,
 	    lane->tx_wavelength,
-	    nio->sfp.module_temperature,
-	    nio->sfp.module_supply_voltage,
+	    rd->module_temperature,
+	    rd->module_supply_voltage,
 	    lane->tx_bias_current,
 	    lane->tx_power,
 	    lane->tx_power_min,
@@ -682,12 +844,279 @@ extern "C" {
 	    lane->rx_power_min,
 	    lane->rx_power_max);
     }
+    return YES;
+  }
+
+  /*_________________---------------------------__________________
+    _________________    eepromRead             __________________
+    -----------------___________________________------------------
+    Read [offset, offset+len) of the module EEPROM into the image.
+  */
+
+  static bool eepromRead(HSPOpticsWorker *ow, HSPOpticsModule *om, uint32_t offset, uint32_t len)
+  {
+    if((offset + len) > HSP_OPTICS_IMAGE_LEN)
+      return NO;
+#ifdef HSP_TEST_QSFP
+    if(om->modinfo_type == ETH_MODULE_SFF_8436) {
+      u_char test[ETH_MODULE_SFF_8436_LEN];
+      int bytes = hexToBinary((u_char *)
+			      "0d-00-02-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-1b-10-00-00-7f-92-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-ff-ff-ff-ff-ff-ff-ff-ff-00"
+			      "0d-00-23-00-00-00-00-40-40-06-d5-05-69-00-00-05"
+			      "0a-00-0a-00-46-49-4e-49-53-41-52-20-43-4f-52-50"
+			      "20-20-20-20-07-00-90-65-46-43-42-47-34-31-30-51"
+			      "42-31-43-31-30-2d-46-43-41-20-42-68-07-d0-46-db"
+			      "00-01-04-da-44-53-4a-30-30-41-41-20-20-20-20-20"
+			      "20-20-20-20-31-34-31-30-32-37-20-20-08-00-00-39"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "0f-10-00-a1-53-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "4b-00-fb-00-46-00-00-00-00-00-00-00-00-00-00-00"
+			      "94-70-6e-f0-86-c4-7b-0c-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			      "00-00-22-22-00-00-00-00-00-00-00-00-00-00-33-33"
+			      "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00",
+			      test,
+			      ETH_MODULE_SFF_8436_LEN);
+      if(bytes != ETH_MODULE_SFF_8436_LEN) {
+	myLog(LOG_ERR, "test QSFP: hexToBinary failed (bytes=%d)", bytes);
+	return NO;
+      }
+      memcpy(om->image + offset, test + offset, len);
+      return YES;
+    }
+#endif
+    bool ok = NO;
+    struct ethtool_eeprom *eeprom = (struct ethtool_eeprom *)my_calloc(sizeof(*eeprom) + len);
+    eeprom->cmd = ETHTOOL_GMODULEEEPROM;
+    eeprom->offset = offset;
+    eeprom->len = len;
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, om->devName, sizeof(ifr.ifr_name)-1);
+    ifr.ifr_data = (char *)eeprom;
+    if(ioctl(ow->fd, SIOCETHTOOL, &ifr) < 0) {
+      myDebug(1, "%s module eeprom read (offset=%u len=%u) failed: %s",
+	      om->devName,
+	      offset,
+	      len,
+	      strerror(errno));
+    }
+    else {
+      memcpy(om->image + offset, eeprom->data, len);
+      ok = YES;
+    }
+    my_free(eeprom);
+    return ok;
+  }
+
+  /*_________________---------------------------__________________
+    _________________  optics thread handlers   __________________
+    -----------------___________________________------------------
+  */
+
+  static void evt_optics_read(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    HSPOpticsWorker *ow = sp->opticsWorker;
+    HSPOpticsRequest req;
+    if(dataLen != sizeof(req))
+      return;
+    memcpy(&req, data, sizeof(req));
+    time_t now = EVCurrentBus()->now.tv_sec;
+
+    HSPOpticsModule search = { .devName = req.devName };
+    HSPOpticsModule *om = UTHashGet(ow->modules, &search);
+    if(om == NULL) {
+      om = (HSPOpticsModule *)my_calloc(sizeof(HSPOpticsModule));
+      om->devName = my_strdup(req.devName);
+      UTHashAdd(ow->modules, om);
+    }
+    om->last_request = now;
+    if(om->ifIndex != req.ifIndex
+       || om->modinfo_type != req.modinfo_type
+       || om->modinfo_len != req.modinfo_len) {
+      // new or different module - start again
+      om->ifIndex = req.ifIndex;
+      om->modinfo_type = req.modinfo_type;
+      om->modinfo_len = (req.modinfo_len > HSP_OPTICS_IMAGE_LEN) ? HSP_OPTICS_IMAGE_LEN : req.modinfo_len;
+      om->id_ok = NO;
+    }
+
+    bool ok = NO;
+    if(!om->id_ok
+       || now >= om->next_id_read) {
+      HSP_TELEMETRY_INC(ow->t_id_reads);
+      ok = om->id_ok = eepromRead(ow, om, 0, om->modinfo_len);
+      om->next_id_read = now + HSP_OPTICS_ID_SECS;
+    }
+    else {
+      HSP_TELEMETRY_INC(ow->t_diag_reads);
+      switch(om->modinfo_type) {
+      case ETH_MODULE_SFF_8472:
+	ok = eepromRead(ow, om, SFF8472_DIAG_OFFSET, SFF8472_DIAG_LEN);
+	break;
+      case ETH_MODULE_SFF_8436:
+	ok = eepromRead(ow, om, SFF8436_DIAG_OFFSET, SFF8436_DIAG_LEN);
+	// identifier byte comes with it,  so a swapped module shows up here
+	if(ok && om->image[0] != 0x0d)
+	  om->id_ok = NO;
+	break;
+      }
+    }
+    if(!ok) {
+      HSP_TELEMETRY_INC(ow->t_errors);
+      om->id_ok = NO;
+    }
+
+    HSPOpticsReading rd;
+    memset(&rd, 0, sizeof(rd)); // compared with memcmp below
+    memcpy(rd.devName, req.devName, IFNAMSIZ);
+    rd.ifIndex = req.ifIndex;
+    if(ok) {
+      switch(om->modinfo_type) {
+      case ETH_MODULE_SFF_8472: sff8472_parse(om, &rd); break;
+      case ETH_MODULE_SFF_8436: sff8436_parse(om, &rd); break;
+      }
+    }
+
+    if(memcmp(&rd, &om->last, sizeof(rd)) == 0) {
+      HSP_TELEMETRY_INC(ow->t_unchanged);
+      return;
+    }
+    om->last = rd;
+    EVEventTx(mod, ow->readingEvent, &rd, sizeof(rd));
+  }
+
+  static void evt_optics_tick(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    HSPOpticsWorker *ow = sp->opticsWorker;
+    time_t now = evt->bus->now.tv_sec;
+    if((now % HSP_OPTICS_POLL_SECS) != 0)
+      return;
+    // forget modules that are no longer asked about
+    UTArray *stale = UTArrayNew(UTARRAY_DFLT);
+    HSPOpticsModule *om;
+    UTHASH_WALK(ow->modules, om) {
+      if((now - om->last_request) > HSP_OPTICS_ID_SECS)
+	UTArrayAdd(stale, om);
+    }
+    UTARRAY_WALK(stale, om) {
+      UTHashDel(ow->modules, om);
+      my_free(om->devName);
+      my_free(om);
+    }
+    UTArrayFree(stale);
+  }
+
+  /*_________________---------------------------__________________
+    _________________  poll thread handlers     __________________
+    -----------------___________________________------------------
+  */
+
+  static void evt_optics_reading(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    HSPOpticsReading rd;
+    if(dataLen != sizeof(rd))
+      return;
+    memcpy(&rd, data, sizeof(rd));
+    SFLAdaptor *adaptor = adaptorByName(sp, rd.devName);
+    if(adaptor == NULL
+       || adaptor->ifIndex != rd.ifIndex)
+      return;
+    HSPNIOOptics *optics = nioOptics(ADAPTOR_NIO(adaptor));
+    if(rd.num_lanes) {
+      optics->sfp.lanes = (SFLLane *)my_realloc(optics->sfp.lanes, sizeof(SFLLane) * rd.num_lanes);
+      memcpy(optics->sfp.lanes, rd.lanes, sizeof(SFLLane) * rd.num_lanes);
+    }
+    optics->sfp.module_id = adaptor->ifIndex;
+    optics->sfp.module_total_lanes = rd.module_total_lanes;
+    optics->sfp.module_supply_voltage = rd.module_supply_voltage;
+    optics->sfp.module_temperature = rd.module_temperature;
+    optics->sfp.num_lanes = rd.num_lanes;
+  }
+
+  static void requestOpticsRead(HSP *sp, SFLAdaptor *adaptor) {
+    HSPNIOOptics *optics = ADAPTOR_NIO(adaptor)->optics;
+    if(sp->opticsReadEvent == NULL
+       || optics == NULL)
+      return;
+    switch(optics->modinfo_type) {
+    case ETH_MODULE_SFF_8472:
+    case ETH_MODULE_SFF_8436:
+      break;
+    default:
+      return;
+    }
+    time_t clk = sp->pollBus->now.tv_sec;
+    if(clk < optics->next_read)
+      return;
+    uint32_t secs = HSP_OPTICS_POLL_SECS;
+    if(secs < sp->actualPollingInterval)
+      secs = sp->actualPollingInterval;
+    optics->next_read = clk + secs;
+    HSPOpticsRequest req = { .ifIndex = adaptor->ifIndex,
+			     .modinfo_type = optics->modinfo_type,
+			     .modinfo_len = optics->modinfo_len };
+    strncpy(req.devName, adaptor->deviceName, IFNAMSIZ-1);
+    EVEventTx(sp->rootModule, sp->opticsReadEvent, &req, sizeof(req));
+  }
 
-  out:
-    if(eeprom)
-      my_free(eeprom);
+  /*_________________---------------------------__________________
+    _________________      opticsInit           __________________
+    -----------------___________________________------------------
+  */
+
+  void opticsInit(HSP *sp) {
+    int fd = socket(PF_INET, SOCK_DGRAM, 0);
+    if(fd < 0) {
+      myLog(LOG_ERR, "optics: socket() failed: %s", strerror(errno));
+      return;
+    }
+    HSPOpticsWorker *ow = (HSPOpticsWorker *)my_calloc(sizeof(HSPOpticsWorker));
+    ow->fd = fd;
+    ow->modules = UTHASH_NEW(HSPOpticsModule, devName, UTHASH_SKEY);
+    ow->t_id_reads = telemetryRegister("optics_id_reads", HSPTELEMETRY_COUNTER);
+    ow->t_diag_reads = telemetryRegister("optics_diag_reads", HSPTELEMETRY_COUNTER);
+    ow->t_errors = telemetryRegister("optics_read_errors", HSPTELEMETRY_COUNTER);
+    ow->t_unchanged = telemetryRegister("optics_unchanged", HSPTELEMETRY_COUNTER);
+    sp->opticsWorker = ow;
+    EVBus *opticsBus = EVGetBus(sp->rootModule, HSPBUS_OPTICS, YES);
+    ow->readingEvent = EVGetEvent(sp->pollBus, HSPEVENT_OPTICS_READING);
+    EVEventRx(sp->rootModule, ow->readingEvent, evt_optics_reading);
+    EVEventRx(sp->rootModule, EVGetEvent(opticsBus, EVEVENT_TICK), evt_optics_tick);
+    sp->opticsReadEvent = EVGetEvent(opticsBus, HSPEVENT_OPTICS_READ);
+    EVEventRx(sp->rootModule, sp->opticsReadEvent, evt_optics_read);
   }
 
+#else /* ( HSP_OPTICAL_STATS && ETHTOOL_GMODULEEEPROM ) */
+
+  void opticsInit(HSP *sp) { }
+
 #endif /* ( HSP_OPTICAL_STATS && ETHTOOL_GMODULEEEPROM ) */
 
   /*_________________---------------------------__________________
@@ -716,7 +1145,9 @@ extern "C" {
     uint64_t maxDeltaBytes = HSP_MAX_NIO_DELTA64;
 
     SFLHost_nio_counters delta;
-    HSP_ethtool_counters et_delta;
+    HSP_ethtool_counters et_delta = { 0 };
+    // ethtool state is only allocated for interfaces that have some
+    HSPNIOEthtool *et = nio->et_found ? nioEthtool(nio) : nio->et;
 #define NIO_COMPUTE_DELTA(field) delta.field = ctrs->field - nio->last_nio.field
     NIO_COMPUTE_DELTA(pkts_in);
     NIO_COMPUTE_DELTA(errs_in);
@@ -747,11 +1178,13 @@ extern "C" {
       }
     }
 
-#define ET_COMPUTE_DELTA(field) et_delta.field = et_ctrs->field - nio->et_last.field
-    ET_COMPUTE_DELTA(mcasts_in);
-    ET_COMPUTE_DELTA(mcasts_out);
-    ET_COMPUTE_DELTA(bcasts_in);
-    ET_COMPUTE_DELTA(bcasts_out);
+    if(et) {
+#define ET_COMPUTE_DELTA(field) et_delta.field = et_ctrs->field - et->et_last.field
+      ET_COMPUTE_DELTA(mcasts_in);
+      ET_COMPUTE_DELTA(mcasts_out);
+      ET_COMPUTE_DELTA(bcasts_in);
+      ET_COMPUTE_DELTA(bcasts_out);
+    }
 
     if(accumulate) {
       // sanity check in case the counters were reset under out feet.
@@ -806,15 +1239,17 @@ extern "C" {
       NIO_ACCUMULATE(nio, errs_out);
       NIO_ACCUMULATE(nio, drops_out);
 #define ET_ACCUMULATE(tgt, field) (tgt)->et_total.field += et_delta.field
-      ET_ACCUMULATE(nio, mcasts_in);
-      ET_ACCUMULATE(nio, mcasts_out);
-      ET_ACCUMULATE(nio, bcasts_in);
-      ET_ACCUMULATE(nio, bcasts_out);
-      
+      if(et) {
+	ET_ACCUMULATE(et, mcasts_in);
+	ET_ACCUMULATE(et, mcasts_out);
+	ET_ACCUMULATE(et, bcasts_in);
+	ET_ACCUMULATE(et, bcasts_out);
+      }
+
       if(nio->bond_slave
 	 && sp->synthesizeBondCounters) {
 	// pour these deltas into the bond totals too
-	SFLAdaptor *bond = adaptorByIndex(sp, nio->lacp.attachedAggID);
+	SFLAdaptor *bond = adaptorByIndex(sp, nioAttachedAggID(nio));
 	if(bond) {
 	  HSPAdaptorNIO *bond_nio = ADAPTOR_NIO(bond);
 	  bond_nio->last_update = sp->pollBus->now.tv_sec;
@@ -827,17 +1262,20 @@ extern "C" {
 	  NIO_ACCUMULATE(bond_nio, errs_out);
 	  NIO_ACCUMULATE(bond_nio, drops_out);
 
-	  ET_ACCUMULATE(bond_nio, mcasts_in);
-	  ET_ACCUMULATE(bond_nio, mcasts_out);
-	  ET_ACCUMULATE(bond_nio, bcasts_in);
-	  ET_ACCUMULATE(bond_nio, bcasts_out);
+	  if(bond_nio->et) {
+	    ET_ACCUMULATE(bond_nio->et, mcasts_in);
+	    ET_ACCUMULATE(bond_nio->et, mcasts_out);
+	    ET_ACCUMULATE(bond_nio->et, bcasts_in);
+	    ET_ACCUMULATE(bond_nio->et, bcasts_out);
+	  }
 	}
       }
     }
 
     // latch - with struct copy
     nio->last_nio = *ctrs;
-    nio->et_last = *et_ctrs;
+    if(et)
+      et->et_last = *et_ctrs;
 
     return accumulate;
   }
@@ -930,17 +1368,19 @@ extern "C" {
 	      .drops_out = (uint32_t)drops_out
 	    };
 	    HSP_ethtool_counters et_ctrs = { 0 };
+	    HSPNIOEthtool *et = niostate->et;
 	    if (niostate->ethtool_GSTATS
-		&& niostate->et_found) {
+		&& niostate->et_found
+		&& et) {
 	      // get the latest stats block for this device via ethtool
 	      // and read out the counters that we located by name.
 
 	      uint32_t bytes = sizeof(struct ethtool_stats);
-	      bytes += niostate->et_nctrs * sizeof(uint64_t);
+	      bytes += et->et_nctrs * sizeof(uint64_t);
 	      bytes += 32; // pad - just in case driver wants to write more
 	      struct ethtool_stats *et_stats = (struct ethtool_stats *)my_calloc(bytes);
 	      et_stats->cmd = ETHTOOL_GSTATS;
-	      et_stats->n_stats = niostate->et_nctrs;
+	      et_stats->n_stats = et->et_nctrs;
 
 	      // now issue the ioctl
 	      strncpy(ifr.ifr_name, adaptor->deviceName, sizeof(ifr.ifr_name)-1);
@@ -954,14 +1394,14 @@ extern "C" {
 			    et_stats->data[xx]);
 		  }
 		}
-		if(niostate->et_idx_mcasts_in)
-		  et_ctrs.mcasts_in = et_stats->data[niostate->et_idx_mcasts_in - 1];
-		if(niostate->et_idx_mcasts_out)
-		  et_ctrs.mcasts_out = et_stats->data[niostate->et_idx_mcasts_out - 1];
-		if(niostate->et_idx_bcasts_in)
-		  et_ctrs.bcasts_in = et_stats->data[niostate->et_idx_bcasts_in - 1];
-		if(niostate->et_idx_bcasts_out)
-		  et_ctrs.bcasts_out = et_stats->data[niostate->et_idx_bcasts_out - 1];
+		if(et->et_idx_mcasts_in)
+		  et_ctrs.mcasts_in = et_stats->data[et->et_idx_mcasts_in - 1];
+		if(et->et_idx_mcasts_out)
+		  et_ctrs.mcasts_out = et_stats->data[et->et_idx_mcasts_out - 1];
+		if(et->et_idx_bcasts_in)
+		  et_ctrs.bcasts_in = et_stats->data[et->et_idx_bcasts_in - 1];
+		if(et->et_idx_bcasts_out)
+		  et_ctrs.bcasts_out = et_stats->data[et->et_idx_bcasts_out - 1];
 	      }
 	      my_free(et_stats);
 	    }
@@ -969,15 +1409,12 @@ extern "C" {
 #if ( HSP_OPTICAL_STATS && ETHTOOL_GMODULEEEPROM )
 	    if(filter) {
 	      // If we are refreshing stats for an individual device, then
-	      // check for SFP (lane) stats too. This operation can be slow so
-	      // it's important to avoid doing it when we are refreshing
-	      // counters for all interfaces for host-sflow network totals.
+	      // ask for SFP (lane) stats too. The EEPROM read is slow, so
+	      // it happens in the optics thread,  on its own schedule,  and
+	      // the result is picked up by the next counter sample.
 	      // Since the host-sflow network totals do not include optical
-	      // stats,  this is not a problem.
-	      switch(niostate->modinfo_type) {
-	      case ETH_MODULE_SFF_8472: sff8472_read(adaptor, &ifr, fd); break;
-	      case ETH_MODULE_SFF_8436: sff8436_read(adaptor, &ifr, fd); break;
-	      }
+	      // stats,  there is no need to do this for all interfaces.
+	      requestOpticsRead(sp, adaptor);
 	    }
 #endif /*  ( HSP_OPTICAL_STATS && ETHTOOL_GMODULEEEPROM ) */
 
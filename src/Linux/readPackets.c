@@ -11,6 +11,7 @@ extern "C" {
 #include <netinet/in.h>
 #include <netinet/ip.h>
 #include <netinet/ip6.h>
+#include <sys/resource.h>
 
   /*_________________-----------------------------------__________________
     _________________   agentCB_getCounters_interface   __________________
@@ -51,30 +52,33 @@ extern "C" {
 	uint32_t ifStatus = adaptorNIO->up ? (SFLSTATUS_ADMIN_UP | SFLSTATUS_OPER_UP) : 0;
 
 	// more detailed counters may have been found via ethtool or equivalent:
-	if(adaptorNIO->et_found & HSP_ETCTR_MC_IN) {
-	  mcasts_in = (uint32_t)adaptorNIO->et_total.mcasts_in;
-	  pkts_in -= mcasts_in;
-	}
-	if(adaptorNIO->et_found & HSP_ETCTR_BC_IN) {
-	  bcasts_in = (uint32_t)adaptorNIO->et_total.bcasts_in;
-	  pkts_in -= bcasts_in;
-	}
-	if(adaptorNIO->et_found & HSP_ETCTR_MC_OUT) {
-	  mcasts_out = (uint32_t)adaptorNIO->et_total.mcasts_out;
-	  pkts_out -= mcasts_out;
-	}
-	if(adaptorNIO->et_found & HSP_ETCTR_BC_OUT) {
-	  bcasts_out = (uint32_t)adaptorNIO->et_total.bcasts_out;
-	  pkts_out -= bcasts_out;
-	}
-	if(adaptorNIO->et_found & HSP_ETCTR_UNKN) {
-	  unknown_in = (uint32_t)adaptorNIO->et_total.unknown_in;
-	}
-	if((adaptorNIO->et_found & HSP_ETCTR_ADMIN)
-	   && (adaptorNIO->et_found & HSP_ETCTR_OPER)) {
-	  ifStatus = 0;
-	  if((adaptorNIO->et_last.adminStatus & 1)) ifStatus |= SFLSTATUS_ADMIN_UP;
-	  if((adaptorNIO->et_last.operStatus & 1)) ifStatus |= SFLSTATUS_OPER_UP;
+	HSPNIOEthtool *et = adaptorNIO->et;
+	if(et) {
+	  if(adaptorNIO->et_found & HSP_ETCTR_MC_IN) {
+	    mcasts_in = (uint32_t)et->et_total.mcasts_in;
+	    pkts_in -= mcasts_in;
+	  }
+	  if(adaptorNIO->et_found & HSP_ETCTR_BC_IN) {
+	    bcasts_in = (uint32_t)et->et_total.bcasts_in;
+	    pkts_in -= bcasts_in;
+	  }
+	  if(adaptorNIO->et_found & HSP_ETCTR_MC_OUT) {
+	    mcasts_out = (uint32_t)et->et_total.mcasts_out;
+	    pkts_out -= mcasts_out;
+	  }
+	  if(adaptorNIO->et_found & HSP_ETCTR_BC_OUT) {
+	    bcasts_out = (uint32_t)et->et_total.bcasts_out;
+	    pkts_out -= bcasts_out;
+	  }
+	  if(adaptorNIO->et_found & HSP_ETCTR_UNKN) {
+	    unknown_in = (uint32_t)et->et_total.unknown_in;
+	  }
+	  if((adaptorNIO->et_found & HSP_ETCTR_ADMIN)
+	     && (adaptorNIO->et_found & HSP_ETCTR_OPER)) {
+	    ifStatus = 0;
+	    if((et->et_last.adminStatus & 1)) ifStatus |= SFLSTATUS_ADMIN_UP;
+	    if((et->et_last.operStatus & 1)) ifStatus |= SFLSTATUS_OPER_UP;
+	  }
 	}
 
 	if(debug(1)) {
@@ -140,23 +144,26 @@ extern "C" {
 	     ||*/ adaptorNIO->bond_slave) {
 	  updateBondCounters(sp, adaptor);
 	  lacp_elem.tag = SFLCOUNTERS_LACP;
-	  lacp_elem.counterBlock.lacp = adaptorNIO->lacp; // struct copy
+	  lacp_elem.counterBlock.lacp = *nioLACP(adaptorNIO); // struct copy
 	  SFLADD_ELEMENT(cs, &lacp_elem);
 	}
 
 	// possibly include SFP struct with optical gauges
 	SFLCounters_sample_element sfp_elem = { 0 };
-	if(adaptorNIO->sfp.num_lanes) {
+	if(adaptorNIO->optics
+	   && adaptorNIO->optics->sfp.num_lanes) {
 	  sfp_elem.tag = SFLCOUNTERS_SFP;
-	  sfp_elem.counterBlock.sfp = adaptorNIO->sfp; // struct copy - picks up lasers list
+	  sfp_elem.counterBlock.sfp = adaptorNIO->optics->sfp; // struct copy - picks up lasers list
 	  SFLADD_ELEMENT(cs, &sfp_elem);
 	}
 
-	SEMLOCK_DO(sp->sync_agent) {
+	TIMEDLOCK_DO(sp->sync_receiver) {
+	  // port name is fixed for this poller - send it pre-encoded
+	  encodeCountersCached(sp, poller, nioCountersCache(adaptorNIO), my_strhash(devName), &pn_elem);
 	  sfl_poller_writeCountersSample(poller, cs);
 	  sp->counterSampleQueued = YES;
-	  sp->telemetry[HSP_TELEMETRY_COUNTER_SAMPLES]++;
 	}
+	HSP_TELEMETRY_INC(HSP_TELEMETRY_COUNTER_SAMPLES);
       }
     }
   }
@@ -176,20 +183,27 @@ extern "C" {
   static SFLPoller *getPoller(HSP *sp, SFLAdaptor *adaptor)
   {
     HSPAdaptorNIO *adaptorNIO = ADAPTOR_NIO(adaptor);
-    if(adaptorNIO->poller == NULL) {
+    // The poller is published with a release-store once it is fully set
+    // up,  so readers only need the cached pointer,  never the lock.
+    SFLPoller *poller = __atomic_load_n(&adaptorNIO->poller, __ATOMIC_ACQUIRE);
+    if(poller == NULL) {
       SFLDataSource_instance dsi;
       SFL_DS_SET(dsi, 0, adaptor->ifIndex, 0); // ds_class,ds_index,ds_instance
-      SEMLOCK_DO(sp->sync_agent) {
-	adaptorNIO->poller = sfl_agent_addPoller(sp->agent, &dsi, sp, agentCB_getCounters_interface_request);
-	sfl_poller_set_sFlowCpInterval(adaptorNIO->poller, sp->actualPollingInterval);
-	sfl_poller_set_sFlowCpReceiver(adaptorNIO->poller, HSP_SFLOW_RECEIVER_INDEX);
-	// remember the device name to make the lookups easier later.
-	// Don't want to point directly to the SFLAdaptor or SFLAdaptorNIO object
-	// in case it gets freed at some point.  The device name is enough.
-	adaptorNIO->poller->userData = (void *)my_strdup(adaptor->deviceName);
+      TIMEDLOCK_DO(sp->sync_pollers) {
+	poller = adaptorNIO->poller;
+	if(poller == NULL) {
+	  poller = sfl_agent_addPoller(sp->agent, &dsi, sp, agentCB_getCounters_interface_request);
+	  sfl_poller_set_sFlowCpInterval(poller, sp->actualPollingInterval);
+	  sfl_poller_set_sFlowCpReceiver(poller, HSP_SFLOW_RECEIVER_INDEX);
+	  // remember the device name to make the lookups easier later.
+	  // Don't want to point directly to the SFLAdaptor or SFLAdaptorNIO object
+	  // in case it gets freed at some point.  The device name is enough.
+	  poller->userData = (void *)my_strdup(adaptor->deviceName);
+	  __atomic_store_n(&adaptorNIO->poller, poller, __ATOMIC_RELEASE);
+	}
       }
     }
-    return adaptorNIO->poller;
+    return poller;
   }
 
   /*_________________---------------------------__________________
@@ -209,17 +223,23 @@ extern "C" {
   static SFLSampler *getSampler(HSP *sp, SFLAdaptor *adaptor)
   {
     HSPAdaptorNIO *adaptorNIO = ADAPTOR_NIO(adaptor);
-    if(adaptorNIO->sampler == NULL) {
+    // same publication scheme as getPoller()
+    SFLSampler *sampler = __atomic_load_n(&adaptorNIO->sampler, __ATOMIC_ACQUIRE);
+    if(sampler == NULL) {
       SFLDataSource_instance dsi;
       SFL_DS_SET(dsi, 0, adaptor->ifIndex, 0); // ds_class,ds_index,ds_instance
       // add sampler
-      SEMLOCK_DO(sp->sync_agent) {
-	adaptorNIO->sampler = sfl_agent_addSampler(sp->agent, &dsi);
-	sfl_sampler_set_sFlowFsReceiver(adaptorNIO->sampler, HSP_SFLOW_RECEIVER_INDEX);
-	sfl_sampler_set_sFlowFsMaximumHeaderSize(adaptorNIO->sampler, sp->sFlowSettings_file->headerBytes);
+      TIMEDLOCK_DO(sp->sync_samplers) {
+	sampler = adaptorNIO->sampler;
+	if(sampler == NULL) {
+	  sampler = sfl_agent_addSampler(sp->agent, &dsi);
+	  sfl_sampler_set_sFlowFsReceiver(sampler, HSP_SFLOW_RECEIVER_INDEX);
+	  sfl_sampler_set_sFlowFsMaximumHeaderSize(sampler, sp->sFlowSettings_file->headerBytes);
+	  __atomic_store_n(&adaptorNIO->sampler, sampler, __ATOMIC_RELEASE);
+	}
       }
     }
-    return adaptorNIO->sampler;
+    return sampler;
   }
 
 
@@ -251,11 +271,11 @@ extern "C" {
   {
     if(--ps->refCount == 0) {
       EVBus *bus = EVCurrentBus();
-      SEMLOCK_DO(sp->sync_agent) {
+      TIMEDLOCK_DO(sp->sync_receiver) {
 	sfl_agent_set_now(ps->sampler->agent, bus->now.tv_sec, bus->now.tv_nsec);
 	sfl_sampler_writeFlowSample(ps->sampler, ps->fs);
-	sp->telemetry[HSP_TELEMETRY_FLOW_SAMPLES]++;
       }
+      HSP_TELEMETRY_INC(HSP_TELEMETRY_FLOW_SAMPLES);
       void *ptr;
       UTARRAY_WALK(ps->ptrsToFree, ptr) my_free(ptr);
       UTArrayFree(ps->ptrsToFree);
@@ -264,6 +284,20 @@ extern "C" {
     }
   }
 
+  /*_________________---------------------------__________________
+    _________________    softBackoff            __________________
+    -----------------___________________________------------------
+    The part of the requested overload back-off that the packet
+    source did not already apply upstream (in the kernel or ASIC).
+    Both are powers of 2.
+  */
+
+  static uint32_t softBackoff(HSPAdaptorNIO *nio) {
+    uint32_t backoff = nio->sampling_backoff ?: 1;
+    uint32_t upstream = nio->sampling_backoff_upstream ?: 1;
+    return (backoff > upstream) ? (backoff / upstream) : 1;
+  }
+
   /*_________________---------------------------__________________
     _________________    takeSample             __________________
     -----------------___________________________------------------
@@ -425,6 +459,42 @@ extern "C" {
 	getPoller(sp, ad_out);
     }
 
+    // If it's a switch port then samplerNIO->sampling_n may be set, so that
+    // takes precendence (allows different ports to have different sampling
+    // settings).
+    uint32_t actualSamplingRate = sampling_n;
+    HSPAdaptorNIO *samplerNIO = ADAPTOR_NIO(sampler_dev);
+    if(samplerNIO->sampling_n_set && samplerNIO->sampling_n) {
+      actualSamplingRate = samplerNIO->sampling_n;
+    }
+
+    // estimate the sample pool from the samples.  Could maybe do this
+    // above with the (possibly more granular) ulogSamplingRate, but then
+    // we would have to look up the sampler object every time, which
+    // might be too expensive in the case where ulogSamplingRate==1.
+    sampler->samplePool += actualSamplingRate;
+
+    // accumulate total drops
+    if(drops)
+      telemetryAdd(HSP_TELEMETRY_DROPPED_SAMPLES, drops);
+
+    // also accumulate dropped-samples we detected against whichever sampler
+    // sends the next sample. This is not perfect,  but is likely to accrue
+    // drops against the point whose sampling-rate needs to be adjusted.
+    samplerNIO->netlink_drops += drops;
+
+    // overload back-off: whatever the source could not apply upstream
+    // we apply here by keeping 1-in-N of the samples it offers.
+    samplerNIO->overload_samples++;
+    uint32_t backoff = softBackoff(samplerNIO);
+    if(backoff > 1) {
+      if(sfl_random(backoff) != 1) {
+	my_free(fs);
+	return;
+      }
+      actualSamplingRate *= backoff;
+    }
+
     // build the sampled header structure
     HSPPendingSample *ps = pendingSampleNew(sampler, fs);
     SFLFlow_sample_element *hdrElem = pendingSample_calloc(ps, sizeof(SFLFlow_sample_element));
@@ -475,29 +545,7 @@ extern "C" {
 
     // submit the actual sampling rate so it goes out with the sFlow feed
     // otherwise the sampler object would fill in his own (sub-sampling) rate.
-    // If it's a switch port then samplerNIO->sampling_n may be set, so that
-    // takes precendence (allows different ports to have different sampling
-    // settings).
-    uint32_t actualSamplingRate = sampling_n;
-    HSPAdaptorNIO *samplerNIO = ADAPTOR_NIO(sampler_dev);
-    if(samplerNIO->sampling_n_set && samplerNIO->sampling_n) {
-      actualSamplingRate = samplerNIO->sampling_n;
-    }
     fs->sampling_rate = actualSamplingRate;
-    
-    // estimate the sample pool from the samples.  Could maybe do this
-    // above with the (possibly more granular) ulogSamplingRate, but then
-    // we would have to look up the sampler object every time, which
-    // might be too expensive in the case where ulogSamplingRate==1.
-    sampler->samplePool += actualSamplingRate;
-    
-    // accumulate total drops
-    sp->telemetry[HSP_TELEMETRY_DROPPED_SAMPLES] += drops;
-
-    // also accumulate dropped-samples we detected against whichever sampler
-    // sends the next sample. This is not perfect,  but is likely to accrue
-    // drops against the point whose sampling-rate needs to be adjusted.
-    samplerNIO->netlink_drops += drops;
     fs->drops = samplerNIO->netlink_drops;
 
     // wrap it and send it out in case someone else wants to annotate it
@@ -507,6 +555,106 @@ extern "C" {
     releasePendingSample(sp, ps);
   }
 
+  /*_________________---------------------------__________________
+    _________________  samplingOverloadTick     __________________
+    -----------------___________________________------------------
+    Called every second on the poll bus (which owns adaptorsByIndex)
+    when maxSamples or maxPacketCPU is configured. If the budget is
+    exceeded, or more than HSP_OVERLOAD_MAX_DROP_PC% of the samples
+    were dropped, then the busiest samplers double their back-off.
+    After HSP_OVERLOAD_CALM_SECS below half the budget they halve it
+    again. Sources that can apply the back-off upstream (pcap BPF,
+    Cumulus) pick it up from sampling_backoff and record what they did
+    in sampling_backoff_upstream. Anything left over is applied in
+    takeSample. Either way the effective rate goes out in the
+    flow sample. The packet thread only ever increments
+    overload_samples and netlink_drops, so the per-interval counts
+    are taken as deltas here.
+  */
+
+  void samplingOverloadTick(HSP *sp) {
+    EVBus *bus = EVCurrentBus();
+    assert(bus == sp->pollBus);
+
+    // CPU used by the packet thread since last time
+    EVBus *packetBus = EVGetBus(sp->rootModule, HSPBUS_PACKET, NO);
+    clockid_t cpuClock;
+    struct timespec cpu_ts;
+    if(packetBus == NULL
+       || packetBus->thread == NULL
+       || pthread_getcpuclockid(*packetBus->thread, &cpuClock) != 0
+       || clock_gettime(cpuClock, &cpu_ts) != 0)
+      return;
+    uint64_t cpu_uS = (cpu_ts.tv_sec * 1000000LL) + (cpu_ts.tv_nsec / 1000);
+    uint64_t wall_uS = (bus->now.tv_sec * 1000000LL) + (bus->now.tv_nsec / 1000);
+    uint32_t cpuPC = 0;
+    if(sp->overload.last_wall_uS
+       && wall_uS > sp->overload.last_wall_uS) {
+      cpuPC = ((cpu_uS - sp->overload.last_cpu_uS) * 100) / (wall_uS - sp->overload.last_wall_uS);
+    }
+    sp->overload.last_cpu_uS = cpu_uS;
+    sp->overload.last_wall_uS = wall_uS;
+
+    // samples delivered and drops seen per sampler
+    uint32_t samples = 0;
+    uint32_t drops = 0;
+    uint32_t active = 0;
+    SFLAdaptor *adaptor;
+    UTHASH_WALK(sp->adaptorsByIndex, adaptor) {
+      HSPAdaptorNIO *nio = ADAPTOR_NIO(adaptor);
+      uint32_t offered = nio->overload_samples - nio->overload_samples_last;
+      if(offered) {
+	samples += offered / softBackoff(nio);
+	active++;
+      }
+      drops += nio->netlink_drops - nio->overload_drops;
+    }
+
+    // an occasional netlink drop is not a reason to back off
+    bool dropping = ((uint64_t)drops * 100) > ((uint64_t)(samples + drops) * HSP_OVERLOAD_MAX_DROP_PC);
+    bool overloaded = ((sp->overload.maxSamples && samples > sp->overload.maxSamples)
+		       || (sp->overload.maxCPU && cpuPC > sp->overload.maxCPU)
+		       || dropping);
+    bool calm = (!overloaded
+		 && (sp->overload.maxSamples == 0 || (samples * 2) < sp->overload.maxSamples)
+		 && (sp->overload.maxCPU == 0 || (cpuPC * 2) < sp->overload.maxCPU));
+    sp->overload.calmSecs = calm ? (sp->overload.calmSecs + 1) : 0;
+    bool recover = (sp->overload.calmSecs >= HSP_OVERLOAD_CALM_SECS);
+    if(recover)
+      sp->overload.calmSecs = 0;
+
+    // back off the samplers that are sending at least their fair share
+    uint32_t fairShare = active ? (samples / active) : 0;
+
+    UTHASH_WALK(sp->adaptorsByIndex, adaptor) {
+      HSPAdaptorNIO *nio = ADAPTOR_NIO(adaptor);
+      uint32_t offered = nio->overload_samples - nio->overload_samples_last;
+      uint32_t backoff = nio->sampling_backoff ?: 1;
+      uint32_t newBackoff = backoff;
+      if(overloaded) {
+	if(offered
+	   && (offered / softBackoff(nio)) >= fairShare
+	   && backoff < HSP_OVERLOAD_MAX_BACKOFF)
+	  newBackoff = backoff * 2;
+      }
+      else if(recover
+	      && backoff > 1)
+	newBackoff = backoff / 2;
+      if(newBackoff != backoff) {
+	myLog(LOG_INFO, "overload: %s sampling back-off %u -> %u (samples/sec=%u, cpu=%u%%, drops=%u)",
+	      adaptor->deviceName,
+	      backoff,
+	      newBackoff,
+	      samples,
+	      cpuPC,
+	      drops);
+	nio->sampling_backoff = newBackoff;
+      }
+      nio->overload_samples_last += offered;
+      nio->overload_drops = nio->netlink_drops;
+    }
+  }
+
   /*_________________---------------------------__________________
     _________________   configSwitchPorts       __________________
     -----------------___________________________------------------
@@ -0,0 +1,304 @@
+/* This software is distributed under the following license:
+ * http://sflow.net/license.html
+ */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "hsflowd.h"
+
+  /*_________________---------------------------__________________
+    _________________     telemetry             __________________
+    -----------------___________________________------------------
+    Every thread that bumps a counter gets its own shard, allocated
+    on first use and aligned to a cache line,  so the hot path is a
+    plain (relaxed-atomic) load and store with no lock and no shared
+    cache lines.  Readers sum across the shards.  Shards are never
+    freed, so a thread that exits still contributes its counts.
+    Gauges are single global values.  Histograms use power-of-2
+    buckets, and their count lives in the ordinary counter slot.
+    Registration is idempotent by name and takes a mutex.  The
+    built-in counters (EnumHSPTelemetry) are pre-registered.
+  */
+
+#define HSP_TELEMETRY_CACHE_LINE 64
+
+  typedef struct _HSPTelemetryShard {
+    struct _HSPTelemetryShard *nxt;
+    uint64_t counters[HSP_TELEMETRY_MAX];
+    uint64_t hist[HSP_TELEMETRY_MAX_HISTOGRAMS][HSP_TELEMETRY_HIST_BUCKETS];
+    uint64_t histSum[HSP_TELEMETRY_MAX_HISTOGRAMS];
+  } __attribute__((aligned(HSP_TELEMETRY_CACHE_LINE))) HSPTelemetryShard;
+
+  typedef struct _HSPTelemetryVar {
+    const char *name;
+    EnumHSPTelemetryType type;
+    uint32_t histIndex;
+  } HSPTelemetryVar;
+
+  static HSPTelemetryVar telemetryVars[HSP_TELEMETRY_MAX] = {
+    { "flow_samples", HSPTELEMETRY_COUNTER, 0 },
+    { "counter_samples", HSPTELEMETRY_COUNTER, 0 },
+    { "rtmetric_samples", HSPTELEMETRY_COUNTER, 0 },
+    { "rtflow_samples", HSPTELEMETRY_COUNTER, 0 },
+    { "datagrams", HSPTELEMETRY_COUNTER, 0 },
+    { "dropped_samples", HSPTELEMETRY_COUNTER, 0 },
+  };
+  static uint32_t telemetryN = HSP_TELEMETRY_NUM_COUNTERS;
+  static uint32_t telemetryHistN = 0;
+  static int64_t telemetryGauges[HSP_TELEMETRY_MAX];
+  static pthread_mutex_t telemetryMutex = PTHREAD_MUTEX_INITIALIZER;
+  static HSPTelemetryShard *telemetryShards = NULL;
+  static __thread HSPTelemetryShard *myShard = NULL;
+
+  /*_________________---------------------------__________________
+    _________________     telemetryRegister     __________________
+    -----------------___________________________------------------
+  */
+
+  uint32_t telemetryRegister(const char *name, EnumHSPTelemetryType type) {
+    uint32_t id = HSP_TELEMETRY_NONE;
+    pthread_mutex_lock(&telemetryMutex);
+    for(uint32_t ii = 0; ii < telemetryN; ii++) {
+      if(my_strequal((char *)telemetryVars[ii].name, (char *)name)) {
+	if(telemetryVars[ii].type == type)
+	  id = ii;
+	else
+	  myLog(LOG_ERR, "telemetry: %s already registered with another type", name);
+	goto out;
+      }
+    }
+    if(telemetryN == HSP_TELEMETRY_MAX
+       || (type == HSPTELEMETRY_HISTOGRAM
+	   && telemetryHistN == HSP_TELEMETRY_MAX_HISTOGRAMS)) {
+      myLog(LOG_ERR, "telemetry: no room to register %s", name);
+      goto out;
+    }
+    id = telemetryN;
+    telemetryVars[id].name = my_strdup((char *)name);
+    telemetryVars[id].type = type;
+    if(type == HSPTELEMETRY_HISTOGRAM)
+      telemetryVars[id].histIndex = telemetryHistN++;
+    // readers may walk without the mutex,  so publish the
+    // entry only after it has been filled in
+    __atomic_store_n(&telemetryN, id + 1, __ATOMIC_RELEASE);
+  out:
+    pthread_mutex_unlock(&telemetryMutex);
+    return id;
+  }
+
+  /*_________________---------------------------__________________
+    _________________     shards                __________________
+    -----------------___________________________------------------
+  */
+
+  static HSPTelemetryShard *shardNew(void) {
+    HSPTelemetryShard *shard = NULL;
+    if(posix_memalign((void **)&shard, HSP_TELEMETRY_CACHE_LINE, sizeof(HSPTelemetryShard)) != 0) {
+      myLog(LOG_ERR, "telemetry: posix_memalign failed");
+      exit(EXIT_FAILURE);
+    }
+    memset(shard, 0, sizeof(*shard));
+    pthread_mutex_lock(&telemetryMutex);
+    shard->nxt = telemetryShards;
+    __atomic_store_n(&telemetryShards, shard, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&telemetryMutex);
+    return shard;
+  }
+
+  static inline HSPTelemetryShard *getShard(void) {
+    if(__builtin_expect(myShard == NULL, 0))
+      myShard = shardNew();
+    return myShard;
+  }
+
+  // only the owning thread writes to a shard, so a relaxed
+  // load+store is enough (and avoids a locked instruction)
+  static inline void shardAdd(uint64_t *ctr, uint64_t delta) {
+    __atomic_store_n(ctr, __atomic_load_n(ctr, __ATOMIC_RELAXED) + delta, __ATOMIC_RELAXED);
+  }
+
+  /*_________________---------------------------__________________
+    _________________     update                __________________
+    -----------------___________________________------------------
+  */
+
+  void telemetryAdd(uint32_t id, uint64_t delta) {
+    if(id >= HSP_TELEMETRY_MAX)
+      return;
+    shardAdd(&getShard()->counters[id], delta);
+  }
+
+  void telemetrySet(uint32_t id, int64_t val) {
+    if(id >= HSP_TELEMETRY_MAX)
+      return;
+    __atomic_store_n(&telemetryGauges[id], val, __ATOMIC_RELAXED);
+  }
+
+  static uint32_t histBucket(uint64_t val) {
+    // bucket b holds values < 2^b (and >= 2^(b-1))
+    uint32_t bkt = val ? (64 - __builtin_clzll(val)) : 0;
+    return (bkt < HSP_TELEMETRY_HIST_BUCKETS) ? bkt : (HSP_TELEMETRY_HIST_BUCKETS - 1);
+  }
+
+  void telemetryObserve(uint32_t id, uint64_t val) {
+    if(id >= HSP_TELEMETRY_MAX
+       || telemetryVars[id].type != HSPTELEMETRY_HISTOGRAM)
+      return;
+    HSPTelemetryShard *shard = getShard();
+    uint32_t hi = telemetryVars[id].histIndex;
+    shardAdd(&shard->counters[id], 1);
+    shardAdd(&shard->histSum[hi], val);
+    shardAdd(&shard->hist[hi][histBucket(val)], 1);
+  }
+
+  /*_________________---------------------------__________________
+    _________________     read                  __________________
+    -----------------___________________________------------------
+  */
+
+  uint64_t telemetryGet(uint32_t id) {
+    if(id >= HSP_TELEMETRY_MAX)
+      return 0;
+    if(telemetryVars[id].type == HSPTELEMETRY_GAUGE)
+      return (uint64_t)__atomic_load_n(&telemetryGauges[id], __ATOMIC_RELAXED);
+    uint64_t sum = 0;
+    for(HSPTelemetryShard *shard = __atomic_load_n(&telemetryShards, __ATOMIC_ACQUIRE); shard; shard = shard->nxt)
+      sum += __atomic_load_n(&shard->counters[id], __ATOMIC_RELAXED);
+    return sum;
+  }
+
+  static void histogramRead(uint32_t id, uint64_t *buckets, uint64_t *sum) {
+    uint32_t hi = telemetryVars[id].histIndex;
+    memset(buckets, 0, HSP_TELEMETRY_HIST_BUCKETS * sizeof(uint64_t));
+    *sum = 0;
+    for(HSPTelemetryShard *shard = __atomic_load_n(&telemetryShards, __ATOMIC_ACQUIRE); shard; shard = shard->nxt) {
+      *sum += __atomic_load_n(&shard->histSum[hi], __ATOMIC_RELAXED);
+      for(int bb = 0; bb < HSP_TELEMETRY_HIST_BUCKETS; bb++)
+	buckets[bb] += __atomic_load_n(&shard->hist[hi][bb], __ATOMIC_RELAXED);
+    }
+  }
+
+  // upper bound of the bucket holding the given percentile
+  static uint64_t histPercentile(uint64_t *buckets, int pc) {
+    uint64_t total = 0;
+    for(int bb = 0; bb < HSP_TELEMETRY_HIST_BUCKETS; bb++)
+      total += buckets[bb];
+    if(total == 0)
+      return 0;
+    uint64_t rank = ((total * pc) + 99) / 100;
+    uint64_t cum = 0;
+    for(int bb = 0; bb < HSP_TELEMETRY_HIST_BUCKETS; bb++) {
+      cum += buckets[bb];
+      if(cum >= rank)
+	return bb ? ((1LL << bb) - 1) : 0;
+    }
+    return (1LL << (HSP_TELEMETRY_HIST_BUCKETS - 1)) - 1;
+  }
+
+  /*_________________---------------------------__________________
+    _________________     telemetryWalk         __________________
+    -----------------___________________________------------------
+    Calls back with every value as a name/uint64 pair.  Histograms
+    are expanded to <name>.count, <name>.sum, <name>.p50 and
+    <name>.p99.
+  */
+
+  void telemetryWalk(HSPTelemetryCB cb, void *magic) {
+    uint32_t nvars = __atomic_load_n(&telemetryN, __ATOMIC_ACQUIRE);
+    for(uint32_t id = 0; id < nvars; id++) {
+      HSPTelemetryVar *var = &telemetryVars[id];
+      if(var->type == HSPTELEMETRY_HISTOGRAM) {
+	uint64_t buckets[HSP_TELEMETRY_HIST_BUCKETS];
+	uint64_t sum;
+	histogramRead(id, buckets, &sum);
+	char vname[128];
+	snprintf(vname, sizeof(vname), "%s.count", var->name);
+	(*cb)(magic, vname, telemetryGet(id));
+	snprintf(vname, sizeof(vname), "%s.sum", var->name);
+	(*cb)(magic, vname, sum);
+	snprintf(vname, sizeof(vname), "%s.p50", var->name);
+	(*cb)(magic, vname, histPercentile(buckets, 50));
+	snprintf(vname, sizeof(vname), "%s.p99", var->name);
+	(*cb)(magic, vname, histPercentile(buckets, 99));
+      }
+      else
+	(*cb)(magic, var->name, telemetryGet(id));
+    }
+  }
+
+  typedef struct {
+    const char *name;
+    uint64_t val;
+    bool found;
+  } HSPTelemetryLookup;
+
+  static void lookupCB(void *magic, const char *name, uint64_t val) {
+    HSPTelemetryLookup *lookup = (HSPTelemetryLookup *)magic;
+    if(my_strequal((char *)name, (char *)lookup->name)) {
+      lookup->val = val;
+      lookup->found = YES;
+    }
+  }
+
+  bool telemetryGetByName(const char *name, uint64_t *val) {
+    HSPTelemetryLookup lookup = { .name = name };
+    telemetryWalk(lookupCB, &lookup);
+    if(lookup.found)
+      *val = lookup.val;
+    return lookup.found;
+  }
+
+  /*_________________---------------------------__________________
+    _________________     timed locks           __________________
+    -----------------___________________________------------------
+    An uncontended acquire is a trylock plus one clock read.  Only
+    when the trylock fails do we time the wait.
+  */
+
+  static uint64_t lockClock_nS(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+  }
+
+  HSPTimedLock *timedLockNew(const char *name) {
+    HSPTimedLock *lk = (HSPTimedLock *)my_calloc(sizeof(HSPTimedLock));
+    pthread_mutex_init(&lk->mutex, NULL);
+    char vname[128];
+    snprintf(vname, sizeof(vname), "lock_%s_acquired", name);
+    lk->t_acquired = telemetryRegister(vname, HSPTELEMETRY_COUNTER);
+    snprintf(vname, sizeof(vname), "lock_%s_contended", name);
+    lk->t_contended = telemetryRegister(vname, HSPTELEMETRY_COUNTER);
+    snprintf(vname, sizeof(vname), "lock_%s_wait_nS", name);
+    lk->t_wait = telemetryRegister(vname, HSPTELEMETRY_HISTOGRAM);
+    snprintf(vname, sizeof(vname), "lock_%s_hold_nS", name);
+    lk->t_hold = telemetryRegister(vname, HSPTELEMETRY_HISTOGRAM);
+    return lk;
+  }
+
+  int timedLockAcquire(HSPTimedLock *lk) {
+    if(pthread_mutex_trylock(&lk->mutex) == 0)
+      lk->acquired_nS = lockClock_nS();
+    else {
+      uint64_t start_nS = lockClock_nS();
+      lockOrDie(&lk->mutex);
+      lk->acquired_nS = lockClock_nS();
+      HSP_TELEMETRY_INC(lk->t_contended);
+      telemetryObserve(lk->t_wait, lk->acquired_nS - start_nS);
+    }
+    HSP_TELEMETRY_INC(lk->t_acquired);
+    return YES;
+  }
+
+  int timedLockRelease(HSPTimedLock *lk) {
+    uint64_t held_nS = lockClock_nS() - lk->acquired_nS;
+    releaseOrDie(&lk->mutex);
+    telemetryObserve(lk->t_hold, held_nS);
+    return YES;
+  }
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
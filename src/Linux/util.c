@@ -7,6 +7,7 @@ extern "C" {
 #endif
 
 #include "util.h"
+#include <spawn.h> // for posix_spawn()
 
   static int debugLevel = 0;
 
@@ -1042,6 +1043,38 @@ extern "C" {
     return digits;
   }
 
+  /*_________________---------------------------__________________
+    _________________     parseCpuList          __________________
+    -----------------___________________________------------------
+    Kernel cpulist format, as in /sys/devices/system/node/node0/cpulist
+    or taskset -c,  e.g. "0-3,8,10-11".  Returns NO if the list is
+    malformed or empty.
+  */
+
+  bool parseCpuList(char *str, cpu_set_t *cpus)
+  {
+    CPU_ZERO(cpus);
+    char *p = str;
+    while(p && *p && *p != '\n') {
+      char *end;
+      long lo = strtol(p, &end, 10);
+      if(end == p) return NO;
+      long hi = lo;
+      if(*end == '-') {
+	p = end + 1;
+	hi = strtol(p, &end, 10);
+	if(end == p) return NO;
+      }
+      if(lo < 0 || hi < lo || hi >= CPU_SETSIZE) return NO;
+      for(long cpu = lo; cpu <= hi; cpu++)
+	CPU_SET(cpu, cpus);
+      p = end;
+      if(*p == ',') p++;
+      else if(*p && *p != '\n') return NO;
+    }
+    return (CPU_COUNT(cpus) > 0);
+  }
+
   /*_________________---------------------------__________________
     _________________     my_usleep             __________________
     -----------------___________________________------------------
@@ -1065,6 +1098,34 @@ extern "C" {
     }
   }
 
+  /*_________________---------------------------__________________
+    _________________     UTSpawn               __________________
+    -----------------___________________________------------------
+    Start cmd with stdout and stderr redirected to the given fds
+    (which may be the same fd). Uses posix_spawn() rather than fork()
+    because glibc implements it with clone(CLONE_VM|CLONE_VFORK), so
+    there is no copy of the page tables - and after mlockall() the
+    copy would be of a fully-resident address space. The fds should
+    have been opened with O_CLOEXEC so that only the dup2'd copies
+    survive into the child.  Returns the child pid, or -1 on error.
+  */
+
+  pid_t UTSpawn(char **cmd, int outFd, int errFd)
+  {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, outFd, 1);
+    posix_spawn_file_actions_adddup2(&actions, errFd, 2);
+    pid_t cpid = -1;
+    int err = posix_spawn(&cpid, cmd[0], &actions, NULL, cmd, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if(err != 0) {
+      myLog(LOG_ERR, "posix_spawn(%s,...) failed : errno=%d (%s)", cmd[0], err, strerror(err));
+      return -1;
+    }
+    return cpid;
+  }
+
   /*_________________---------------------------__________________
     _________________     myExec                __________________
     -----------------___________________________------------------
@@ -1078,50 +1139,37 @@ extern "C" {
     int ans = YES;
     int pfd[2];
     pid_t cpid;
-    if(pipe(pfd) == -1) {
+    if(pipe2(pfd, O_CLOEXEC) == -1) {
       myLog(LOG_ERR, "pipe() failed : %s", strerror(errno));
       exit(EXIT_FAILURE);
     }
-    if((cpid = fork()) == -1) {
-      myLog(LOG_ERR, "fork() failed : %s", strerror(errno));
-      exit(EXIT_FAILURE);
+    // By merging stdout and stderr we make it easier to read the data back
+    // but it does mean the caller has to be able to tell the difference between
+    // the expected lines of stdout and an error message. See EVBusExec() for a
+    // more thorough treatment.
+    cpid = UTSpawn(cmd, pfd[1], pfd[1]);
+    while(close(pfd[1]) == -1 && errno == EINTR); // close write-end
+    if(cpid == -1) {
+      while(close(pfd[0]) == -1 && errno == EINTR);
+      return NO;
     }
-    if(cpid == 0) {
-      // in child
-      while(close(pfd[0]) == -1 && errno == EINTR);   // close read-end
-      while(dup2(pfd[1], 1) == -1 && errno == EINTR); // stdout -> write-end
-      while(dup2(pfd[1], 2) == -1 && errno == EINTR); // stderr -> write-end
-      while(close(pfd[1]) == -1 && errno == EINTR); // clean up
-      // By merging stdout and stderr we make it easier to read the data back
-      // but it does mean the caller has to be able to tell the difference between
-      // the expected lines of stdout and an error message. See EVBusExec() for a
-      // more thorough treatment.
-      if(execv(cmd[0], cmd) == -1) {
-	myLog(LOG_ERR, "execv(%s,...) failed : errno=%d (%s)", cmd[0], errno, strerror(errno));
-	exit(EXIT_FAILURE);
-      }
+    // read from read-end
+    FILE *ovs;
+    if((ovs = fdopen(pfd[0], "r")) == NULL) {
+      myLog(LOG_ERR, "fdopen() failed : %s", strerror(errno));
+      exit(EXIT_FAILURE);
     }
-    else {
-      // in parent
-      while(close(pfd[1]) == -1 && errno == EINTR); // close write-end
-      // read from read-end
-      FILE *ovs;
-      if((ovs = fdopen(pfd[0], "r")) == NULL) {
-	myLog(LOG_ERR, "fdopen() failed : %s", strerror(errno));
-	exit(EXIT_FAILURE);
-      }
-      while(fgets(line, lineLen, ovs)) {
-	myDebug(2, "myExec input> <%s>", line);
-	if((*lineCB)(magic, line) == NO) {
-	  myDebug(2, "myExec callback returned NO");
-	  ans = NO;
-	  break;
-	}
+    while(fgets(line, lineLen, ovs)) {
+      myDebug(2, "myExec input> <%s>", line);
+      if((*lineCB)(magic, line) == NO) {
+	myDebug(2, "myExec callback returned NO");
+	ans = NO;
+	break;
       }
-      fclose(ovs);
-      // block here until child is done.
-      waitpid(cpid, pstatus, 0);
     }
+    fclose(ovs);
+    // block here until child is done.
+    waitpid(cpid, pstatus, 0);
     return ans;
   }
 
@@ -1152,9 +1200,16 @@ extern "C" {
     return (my_strequal(ad1->deviceName, ad2->deviceName));
   }
 
+  static adaptorFreeHookFn_t adaptorFreeHook = NULL;
+
+  void adaptorSetFreeHook(adaptorFreeHookFn_t fn) {
+    adaptorFreeHook = fn;
+  }
+
   void adaptorFree(SFLAdaptor *ad)
   {
     if(ad) {
+      if(adaptorFreeHook && ad->userData) (*adaptorFreeHook)(ad);
       if(ad->deviceName) my_free(ad->deviceName);
       if(ad->userData) my_free(ad->userData);
       my_free(ad);
@@ -1683,6 +1738,24 @@ static uint32_t hashSearch(UTHash *oh, void *obj, void **found) {
     oh->dbins = 0;
    }
 
+  // Unsynchronized copy of the same entries (not the objects themselves).
+  // Deleted bins are dropped on the way, so the copy is as compact as it
+  // can be for read-only use.
+  UTHash *UTHashCopy(UTHash *oh) {
+    UTHash *copy = (UTHash *)my_calloc(sizeof(UTHash));
+    SEMLOCK_DO(oh->sync) {
+      copy->options = (oh->options & ~UTHASH_SYNC);
+      copy->f_offset = oh->f_offset;
+      copy->f_len = oh->f_len;
+      copy->cap = oh->cap;
+      copy->bins = my_calloc(UTHASH_BYTES(copy));
+      for(uint32_t ii = 0; ii < oh->cap; ii++)
+	if(oh->bins[ii] && oh->bins[ii] != UTHASH_DBIN)
+	  hashAdd(copy, oh->bins[ii]);
+    }
+    return copy;
+  }
+
   uint32_t UTHashN(UTHash *oh) {
     return oh->entries;
   }
@@ -24,6 +24,7 @@ extern "C" {
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sched.h> // for cpu_set_t
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h> // for PRIu64 etc.
 
@@ -67,6 +68,7 @@ extern "C" {
   bool isZeroUUID(char *uuid);
 
   int printSpeed(const uint64_t speed, char *buf, int bufLen);
+  bool parseCpuList(char *str, cpu_set_t *cpus);
 
   // logger
   void myLogv(int syslogType, char *fmt, va_list args);
@@ -220,11 +222,16 @@ extern "C" {
   // calling execve()
   typedef int (*UTExecCB)(void *magic, char *line);
   int myExec(void *magic, char **cmd, UTExecCB lineCB, char *line, size_t lineLen, int *pstatus);
+  pid_t UTSpawn(char **cmd, int outFd, int errFd);
 
   // SFLAdaptor
   SFLAdaptor *adaptorNew(char *dev, u_char *macBytes, size_t userDataSize, uint32_t ifIndex);
   int adaptorEqual(SFLAdaptor *ad1, SFLAdaptor *ad2);
   void adaptorFree(SFLAdaptor *ad);
+  // called by adaptorFree() before the userData is freed,  so that
+  // anything hanging off it can be freed too
+  typedef void (*adaptorFreeHookFn_t)(SFLAdaptor *ad);
+  void adaptorSetFreeHook(adaptorFreeHookFn_t fn);
 
   // SFLAdaptorList
   SFLAdaptorList *adaptorListNew(void);
@@ -286,6 +293,7 @@ extern "C" {
   void *UTHashDel(UTHash *oh, void *obj);
   void *UTHashDelKey(UTHash *oh, void *obj);
   void UTHashReset(UTHash *oh);
+  UTHash *UTHashCopy(UTHash *oh);
    uint32_t UTHashN(UTHash *oh);
 
 #define UTHASH_DBIN (void *)-1
@@ -0,0 +1,532 @@
+/* This software is distributed under the following license:
+ * http://sflow.net/license.html
+ */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "util_http.h"
+
+  static void readHTTP(EVMod *mod, EVSocket *sock, void *magic);
+  static void schedule(UTHTTPClient *client);
+
+  /*_________________---------------------------__________________
+    _________________    request new/free       __________________
+    -----------------___________________________------------------
+  */
+
+  UTHTTPRequest *UTHTTPRequestNew(char *method, char *path, UTHTTPCB cb, void *magic) {
+    UTHTTPRequest *req = (UTHTTPRequest *)my_calloc(sizeof(UTHTTPRequest));
+    req->method = my_strdup(method);
+    req->path = my_strdup(path);
+    req->cb = cb;
+    req->magic = magic;
+    req->body = UTStrBuf_new();
+    return req;
+  }
+
+  void UTHTTPRequestContent(UTHTTPRequest *req, char *contentType, char *content) {
+    setStr(&req->contentType, contentType);
+    if(req->content == NULL)
+      req->content = UTStrBuf_new();
+    UTStrBuf_reset(req->content);
+    UTStrBuf_append(req->content, content);
+  }
+
+  void UTHTTPRequestFree(UTHTTPRequest *req) {
+    my_free(req->method);
+    my_free(req->path);
+    setStr(&req->contentType, NULL);
+    if(req->content) UTStrBuf_free(req->content);
+    UTStrBuf_free(req->body);
+    my_free(req);
+  }
+
+  /*_________________---------------------------__________________
+    _________________    client new             __________________
+    -----------------___________________________------------------
+  */
+
+  UTHTTPClient *UTHTTPClientNew(EVMod *mod, EVBus *bus, char *sockPath, char *host, uint32_t maxConns, uint32_t maxPipeline) {
+    UTHTTPClient *client = (UTHTTPClient *)my_calloc(sizeof(UTHTTPClient));
+    client->module = mod;
+    client->bus = bus;
+    client->sockPath = my_strdup(sockPath);
+    client->host = my_strdup(host);
+    client->maxConns = maxConns ?: 1;
+    client->maxPipeline = maxPipeline ?: 1;
+    client->conns = UTArrayNew(UTARRAY_DFLT);
+    client->dead = UTArrayNew(UTARRAY_DFLT);
+    return client;
+  }
+
+  uint32_t UTHTTPClientOutstanding(UTHTTPClient *client) {
+    uint32_t n = client->nPending;
+    UTHTTPConn *conn;
+    UTARRAY_WALK(client->conns, conn)
+      n += conn->nInFlight;
+    return n;
+  }
+
+  /*_________________---------------------------__________________
+    _________________    connections            __________________
+    -----------------___________________________------------------
+    Connections are never freed while the client is busy (i.e. while
+    we are somewhere below readHTTP or UTHTTPSend) because a callback
+    may reset the client out from under a loop that is still looking
+    at the connection.  Instead they are marked dead, moved to
+    client->dead and freed by clientLeave().
+  */
+
+  static void clientEnter(UTHTTPClient *client) {
+    client->busy++;
+  }
+
+  static void clientLeave(UTHTTPClient *client) {
+    if(--client->busy == 0) {
+      UTHTTPConn *conn;
+      UTARRAY_WALK(client->dead, conn) {
+	UTHTTPRequest *req, *nx;
+	for(req = conn->inFlight.head; req; ) {
+	  nx = req->next;
+	  UTHTTPRequestFree(req);
+	  req = nx;
+	}
+	UTStrBuf_free(conn->rx);
+	my_free(conn);
+      }
+      UTArrayReset(client->dead);
+    }
+  }
+
+  static UTHTTPConn *connOpen(UTHTTPClient *client, bool dedicated) {
+    int fd = UTUnixDomainSocket(client->sockPath);
+    myDebug(1, "UTHTTP connect(%s) fd==%d", client->sockPath, fd);
+    if(fd < 0)
+      return NULL;
+    UTHTTPConn *conn = (UTHTTPConn *)my_calloc(sizeof(UTHTTPConn));
+    conn->client = client;
+    conn->dedicated = dedicated;
+    conn->rx = UTStrBuf_new();
+    conn->sock = EVBusAddSocket(client->module, client->bus, fd, readHTTP, conn);
+    UTArrayAdd(client->conns, conn);
+    client->connects++;
+    return conn;
+  }
+
+  static void connKill(UTHTTPConn *conn) {
+    UTHTTPClient *client = conn->client;
+    if(conn->sock) {
+      EVSocketClose(client->module, conn->sock);
+      conn->sock = NULL;
+    }
+    conn->dead = YES;
+    UTArrayDel(client->conns, conn);
+    UTArrayAdd(client->dead, conn);
+  }
+
+  // Close a connection that failed or that the server is done with.
+  // Requests that never saw a byte of their response go back to the
+  // front of the queue (once) - they may have been written just as the
+  // server timed out an idle keep-alive connection.  The rest fail.
+  static void connClose(UTHTTPConn *conn) {
+    UTHTTPClient *client = conn->client;
+    UTQ(UTHTTPRequest) retryQ = { NULL, NULL };
+    UTQ(UTHTTPRequest) failQ = { NULL, NULL };
+    UTHTTPRequest *req;
+    while(!UTQ_EMPTY(conn->inFlight)) {
+      UTQ_REMOVE_HEAD(conn->inFlight, req);
+      if(req->gotResponse
+	 || req->retries >= UTHTTP_MAX_RETRIES) {
+	UTQ_ADD_TAIL(failQ, req);
+      }
+      else {
+	req->retries++;
+	UTQ_ADD_TAIL(retryQ, req);
+	client->nPending++;
+      }
+    }
+    conn->nInFlight = 0;
+    connKill(conn);
+    // retries go ahead of anything already waiting
+    while(!UTQ_EMPTY(client->pending)) {
+      UTQ_REMOVE_HEAD(client->pending, req);
+      UTQ_ADD_TAIL(retryQ, req);
+    }
+    client->pending.head = retryQ.head;
+    client->pending.tail = retryQ.tail;
+    // and now it is safe to tell the caller about the failures
+    uint32_t resets = client->resets;
+    while(!UTQ_EMPTY(failQ)) {
+      UTQ_REMOVE_HEAD(failQ, req);
+      if(client->resets == resets)
+	(*req->cb)(client->module, req, UTHTTP_ERR);
+      UTHTTPRequestFree(req);
+    }
+  }
+
+  static bool connWrite(UTHTTPConn *conn, UTHTTPRequest *req) {
+    UTHTTPClient *client = conn->client;
+    UTStrBuf *msg = UTStrBuf_new();
+    UTStrBuf_printf(msg, "%s %s HTTP/1.1\r\nHost: %s\r\n", req->method, req->path, client->host);
+    if(req->content)
+      UTStrBuf_printf(msg, "Content-Type: %s\r\nContent-Length: %u\r\n",
+		      req->contentType ?: "application/json",
+		      UTSTRBUF_LEN(req->content));
+    UTStrBuf_append(msg, "\r\n");
+    if(req->content)
+      UTStrBuf_append_n(msg, UTSTRBUF_STR(req->content), UTSTRBUF_LEN(req->content));
+    myDebug(1, "UTHTTP fd=%d (inFlight=%u) %s %s", conn->sock->fd, conn->nInFlight, req->method, req->path);
+    char *p = UTSTRBUF_STR(msg);
+    size_t len = UTSTRBUF_LEN(msg);
+    bool ok = YES;
+    while(len) {
+      ssize_t cc = write(conn->sock->fd, p, len);
+      if(cc < 0) {
+	if(errno == EINTR) continue;
+	myLog(LOG_ERR, "UTHTTP write(%s %s) failed: %s", req->method, req->path, strerror(errno));
+	ok = NO;
+	break;
+      }
+      p += cc;
+      len -= cc;
+    }
+    UTStrBuf_free(msg);
+    client->requests++;
+    return ok;
+  }
+
+  /*_________________---------------------------__________________
+    _________________    scheduler              __________________
+    -----------------___________________________------------------
+    Spread requests over up to maxConns shared connections, pipelining
+    up to maxPipeline deep on each.  A new connection is only opened
+    when every existing one already has something in flight.
+  */
+
+  static UTHTTPConn *pickConn(UTHTTPClient *client, bool *mayOpen) {
+    UTHTTPConn *conn, *best = NULL;
+    uint32_t nShared = 0;
+    UTARRAY_WALK(client->conns, conn) {
+      if(conn->dedicated)
+	continue;
+      nShared++;
+      if(conn->keepAlive == NO
+	 && conn->nInFlight)
+	continue; // server will close it after this response
+      if(conn->nInFlight >= client->maxPipeline)
+	continue;
+      if(best == NULL
+	 || conn->nInFlight < best->nInFlight)
+	best = conn;
+    }
+    *mayOpen = (nShared < client->maxConns);
+    return best;
+  }
+
+  static void failPending(UTHTTPClient *client, EnumUTHTTPStatus status) {
+    UTQ(UTHTTPRequest) failQ = { client->pending.head, client->pending.tail };
+    UTQ_CLEAR(client->pending);
+    client->nPending = 0;
+    uint32_t resets = client->resets;
+    UTHTTPRequest *req;
+    while(!UTQ_EMPTY(failQ)) {
+      UTQ_REMOVE_HEAD(failQ, req);
+      if(client->resets == resets)
+	(*req->cb)(client->module, req, status);
+      UTHTTPRequestFree(req);
+    }
+  }
+
+  static void schedule(UTHTTPClient *client) {
+    while(!UTQ_EMPTY(client->pending)) {
+      UTHTTPRequest *req = UTQ_HEAD(client->pending);
+      bool mayOpen = YES;
+      UTHTTPConn *conn = req->streaming ? NULL : pickConn(client, &mayOpen);
+      if(conn
+	 && conn->nInFlight
+	 && mayOpen)
+	conn = NULL; // prefer a fresh connection to pipelining
+      if(conn == NULL) {
+	if(!mayOpen)
+	  return; // all connections busy
+	conn = connOpen(client, req->streaming);
+	if(conn == NULL) {
+	  // server is not there - no point trying the rest
+	  failPending(client, UTHTTP_NOSOCKET);
+	  return;
+	}
+      }
+      UTQ_REMOVE(client->pending, req);
+      client->nPending--;
+      UTQ_ADD_TAIL(conn->inFlight, req);
+      conn->nInFlight++;
+      if(conn->nInFlight == 1) {
+	// connection was idle - start with a clean parser
+	conn->state = UTHTTP_RX_STATUS;
+	conn->keepAlive = YES;
+      }
+      if(!connWrite(conn, req))
+	connClose(conn);
+    }
+  }
+
+  void UTHTTPSend(UTHTTPClient *client, UTHTTPRequest *req) {
+    clientEnter(client);
+    UTQ_ADD_TAIL(client->pending, req);
+    client->nPending++;
+    schedule(client);
+    clientLeave(client);
+  }
+
+  void UTHTTPClientReset(UTHTTPClient *client) {
+    myDebug(1, "UTHTTP reset(%s)", client->sockPath);
+    clientEnter(client);
+    client->resets++;
+    UTHTTPRequest *req, *nx;
+    for(req = client->pending.head; req; ) {
+      nx = req->next;
+      UTHTTPRequestFree(req);
+      req = nx;
+    }
+    UTQ_CLEAR(client->pending);
+    client->nPending = 0;
+    UTHTTPConn *conn;
+    UTARRAY_WALK(client->conns, conn) {
+      if(conn->sock) {
+	EVSocketClose(client->module, conn->sock);
+	conn->sock = NULL;
+      }
+      conn->dead = YES;
+      UTArrayAdd(client->dead, conn);
+    }
+    UTArrayReset(client->conns);
+    clientLeave(client);
+  }
+
+  /*_________________---------------------------__________________
+    _________________    response parser        __________________
+    -----------------___________________________------------------
+  */
+
+  // returns NO if the connection is no longer usable
+  static bool responseDone(UTHTTPConn *conn) {
+    UTHTTPClient *client = conn->client;
+    UTHTTPRequest *req;
+    UTQ_REMOVE_HEAD(conn->inFlight, req);
+    conn->nInFlight--;
+    conn->state = UTHTTP_RX_STATUS;
+    if(conn->nInFlight == 0)
+      conn->dedicated = NO; // finished streaming - can be shared now
+    (*req->cb)(client->module, req, UTHTTP_DONE);
+    UTHTTPRequestFree(req);
+    if(conn->dead)
+      return NO;
+    if(!conn->keepAlive) {
+      connClose(conn);
+      return NO;
+    }
+    return YES;
+  }
+
+  static bool headersDone(UTHTTPConn *conn, UTHTTPRequest *req) {
+    if(req->httpStatus >= 100
+       && req->httpStatus < 200) {
+      // interim response (e.g. 100 Continue) - the real one follows
+      conn->state = UTHTTP_RX_STATUS;
+      return YES;
+    }
+    if(conn->chunked) {
+      conn->state = UTHTTP_RX_CHUNK_SIZE;
+      return YES;
+    }
+    if(req->httpStatus == 204
+       || req->httpStatus == 304
+       || conn->contentLength == 0)
+      return responseDone(conn);
+    if(conn->contentLength > 0) {
+      conn->remaining = conn->contentLength;
+      conn->state = UTHTTP_RX_BODY_LENGTH;
+      return YES;
+    }
+    // no framing - body runs until the server closes
+    conn->keepAlive = NO;
+    conn->state = UTHTTP_RX_BODY_EOF;
+    return YES;
+  }
+
+  static void parseHeader(UTHTTPConn *conn, char *line) {
+    char *val = strchr(line, ':');
+    if(val == NULL)
+      return;
+    *val++ = '\0';
+    while(*val == ' ' || *val == '\t') val++;
+    if(!strcasecmp(line, "Content-Length"))
+      conn->contentLength = strtoll(val, NULL, 10);
+    else if(!strcasecmp(line, "Transfer-Encoding"))
+      conn->chunked = (strcasestr(val, "chunked") != NULL);
+    else if(!strcasecmp(line, "Connection")) {
+      if(strcasestr(val, "close"))
+	conn->keepAlive = NO;
+      else if(strcasestr(val, "keep-alive"))
+	conn->keepAlive = YES;
+    }
+  }
+
+  static bool parseLine(UTHTTPConn *conn, UTHTTPRequest *req, char *line, size_t len) {
+    switch(conn->state) {
+
+    case UTHTTP_RX_STATUS: {
+      if(len == 0)
+	return YES; // tolerate stray CRLF between responses
+      int major=0, minor=0, code=0;
+      if(sscanf(line, "HTTP/%d.%d %d", &major, &minor, &code) != 3) {
+	myDebug(1, "UTHTTP bad status line <%s> for %s %s", line, req->method, req->path);
+	connClose(conn);
+	return NO;
+      }
+      req->httpStatus = code;
+      conn->keepAlive = (major > 1 || (major == 1 && minor >= 1));
+      conn->chunked = NO;
+      conn->contentLength = -1;
+      conn->state = UTHTTP_RX_HEADERS;
+      return YES;
+    }
+
+    case UTHTTP_RX_HEADERS:
+      if(len == 0)
+	return headersDone(conn, req);
+      parseHeader(conn, line);
+      return YES;
+
+    case UTHTTP_RX_CHUNK_SIZE: {
+      char *endp = NULL;
+      conn->remaining = strtoull(line, &endp, 16); // hex, maybe ";ext"
+      if(endp == line) {
+	myDebug(1, "UTHTTP bad chunk size <%s> for %s %s", line, req->method, req->path);
+	connClose(conn);
+	return NO;
+      }
+      conn->state = conn->remaining
+	? UTHTTP_RX_CHUNK_DATA
+	: UTHTTP_RX_TRAILERS;
+      return YES;
+    }
+
+    case UTHTTP_RX_CHUNK_END:
+      if(len != 0) {
+	myDebug(1, "UTHTTP missing chunk terminator for %s %s", req->method, req->path);
+	connClose(conn);
+	return NO;
+      }
+      conn->state = UTHTTP_RX_CHUNK_SIZE;
+      return YES;
+
+    case UTHTTP_RX_TRAILERS:
+      if(len == 0)
+	return responseDone(conn);
+      return YES; // ignore trailers
+
+    default:
+      return YES;
+    }
+  }
+
+  // returns NO if the connection is no longer usable
+  static bool connParse(UTHTTPConn *conn) {
+    UTHTTPClient *client = conn->client;
+    for(;;) {
+      char *buf = UTSTRBUF_STR(conn->rx) + conn->rxOff;
+      size_t avail = UTSTRBUF_LEN(conn->rx) - conn->rxOff;
+      if(avail == 0)
+	return YES;
+      UTHTTPRequest *req = UTQ_HEAD(conn->inFlight);
+      if(req == NULL) {
+	myDebug(1, "UTHTTP unsolicited data from %s", client->sockPath);
+	connClose(conn);
+	return NO;
+      }
+      req->gotResponse = YES;
+      switch(conn->state) {
+
+      case UTHTTP_RX_BODY_EOF:
+	UTStrBuf_append_n(req->body, buf, avail);
+	conn->rxOff += avail;
+	break;
+
+      case UTHTTP_RX_BODY_LENGTH:
+      case UTHTTP_RX_CHUNK_DATA: {
+	size_t take = (avail < conn->remaining) ? avail : conn->remaining;
+	UTStrBuf_append_n(req->body, buf, take);
+	conn->rxOff += take;
+	conn->remaining -= take;
+	if(conn->remaining)
+	  break;
+	if(conn->state == UTHTTP_RX_BODY_LENGTH) {
+	  if(!responseDone(conn))
+	    return NO;
+	}
+	else {
+	  conn->state = UTHTTP_RX_CHUNK_END;
+	  if(req->streaming) {
+	    (*req->cb)(client->module, req, UTHTTP_CHUNK);
+	    if(conn->dead)
+	      return NO;
+	    UTStrBuf_reset(req->body);
+	  }
+	}
+	break;
+      }
+
+      default: {
+	char *eol = memchr(buf, '\n', avail);
+	if(eol == NULL)
+	  return YES; // need more
+	size_t len = eol - buf;
+	conn->rxOff += len + 1;
+	if(len && buf[len-1] == '\r')
+	  len--;
+	buf[len] = '\0';
+	if(!parseLine(conn, req, buf, len))
+	  return NO;
+      }
+      }
+    }
+  }
+
+  static void readHTTP(EVMod *mod, EVSocket *sock, void *magic) {
+    UTHTTPConn *conn = (UTHTTPConn *)magic;
+    UTHTTPClient *client = conn->client;
+    clientEnter(client);
+    UTStrBuf_need(conn->rx, UTHTTP_READ_BYTES);
+    ssize_t cc;
+    while((cc = read(sock->fd, UTSTRBUF_STR(conn->rx) + UTSTRBUF_LEN(conn->rx), UTHTTP_READ_BYTES)) < 0
+	  && errno == EINTR);
+    if(cc <= 0) {
+      if(cc < 0)
+	myLog(LOG_ERR, "UTHTTP read(%s) failed: %s", client->sockPath, strerror(errno));
+      else if(conn->state == UTHTTP_RX_BODY_EOF
+	      && conn->nInFlight) {
+	// EOF marks the end of an unframed body
+	conn->keepAlive = NO;
+	responseDone(conn);
+      }
+      if(!conn->dead)
+	connClose(conn);
+    }
+    else {
+      UTSTRBUF_LEN(conn->rx) += cc;
+      if(connParse(conn)) {
+	// compact the buffer, keeping any partial line or chunk
+	UTStrBuf_snip_prefix(conn->rx, conn->rxOff);
+	conn->rxOff = 0;
+      }
+    }
+    schedule(client);
+    clientLeave(client);
+  }
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
@@ -0,0 +1,116 @@
+/* This software is distributed under the following license:
+ * http://sflow.net/license.html
+ */
+
+#ifndef UTIL_HTTP_H
+#define UTIL_HTTP_H 1
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "util.h"
+#include "evbus.h"
+
+  // Minimal asynchronous HTTP/1.1 client for local services that
+  // listen on a unix-domain socket (dockerd, EOS command-api).
+  // Connections are persistent and requests are pipelined onto them,
+  // so a burst of requests costs at most maxConns connects. Responses
+  // are decoded (Content-Length, chunked or read-to-EOF) straight into
+  // req->body.  A "streaming" request gets a connection to itself and
+  // its callback fires once per chunk (e.g. the docker event feed).
+  // All calls must be made from the thread that runs client->bus.
+
+#define UTHTTP_READ_BYTES 65536
+#define UTHTTP_MAX_RETRIES 1
+
+  typedef enum {
+    UTHTTP_CHUNK=0,  // streaming request: req->body holds one chunk
+    UTHTTP_DONE,     // complete response in req->body
+    UTHTTP_ERR,      // connection lost or protocol error
+    UTHTTP_NOSOCKET  // could not connect to the server
+  } EnumUTHTTPStatus;
+
+  struct _UTHTTPRequest; // fwd decl
+  typedef void (*UTHTTPCB)(EVMod *mod, struct _UTHTTPRequest *req, EnumUTHTTPStatus status);
+
+  typedef struct _UTHTTPRequest {
+    struct _UTHTTPRequest *prev;
+    struct _UTHTTPRequest *next;
+    char *method;
+    char *path;
+    char *contentType;
+    UTStrBuf *content;
+    UTHTTPCB cb;
+    void *magic;
+    bool streaming:1;
+    bool gotResponse:1;
+    uint32_t retries;
+    int httpStatus;
+    UTStrBuf *body;
+  } UTHTTPRequest;
+
+  typedef enum {
+    UTHTTP_RX_STATUS=0,
+    UTHTTP_RX_HEADERS,
+    UTHTTP_RX_BODY_LENGTH,
+    UTHTTP_RX_BODY_EOF,
+    UTHTTP_RX_CHUNK_SIZE,
+    UTHTTP_RX_CHUNK_DATA,
+    UTHTTP_RX_CHUNK_END,
+    UTHTTP_RX_TRAILERS
+  } EnumUTHTTPRxState;
+
+  struct _UTHTTPClient; // fwd decl
+
+  typedef struct _UTHTTPConn {
+    struct _UTHTTPClient *client;
+    EVSocket *sock;
+    UTQ(UTHTTPRequest) inFlight;
+    uint32_t nInFlight;
+    bool dedicated:1;
+    bool dead:1;
+    bool keepAlive:1;
+    bool chunked:1;
+    EnumUTHTTPRxState state;
+    int64_t contentLength;
+    uint64_t remaining;
+    UTStrBuf *rx;
+    size_t rxOff;
+  } UTHTTPConn;
+
+  typedef struct _UTHTTPClient {
+    EVMod *module;
+    EVBus *bus;
+    char *sockPath;
+    char *host;
+    uint32_t maxConns;
+    uint32_t maxPipeline;
+    UTArray *conns;
+    UTArray *dead;
+    UTQ(UTHTTPRequest) pending;
+    uint32_t nPending;
+    uint32_t busy;
+    uint32_t resets;
+    // stats
+    uint64_t connects;
+    uint64_t requests;
+  } UTHTTPClient;
+
+  UTHTTPClient *UTHTTPClientNew(EVMod *mod, EVBus *bus, char *sockPath, char *host, uint32_t maxConns, uint32_t maxPipeline);
+  UTHTTPRequest *UTHTTPRequestNew(char *method, char *path, UTHTTPCB cb, void *magic);
+  void UTHTTPRequestContent(UTHTTPRequest *req, char *contentType, char *content);
+  void UTHTTPRequestFree(UTHTTPRequest *req);
+  // The callback may fire (with UTHTTP_NOSOCKET) before UTHTTPSend returns.
+  // The request is freed by the client after the final callback.
+  void UTHTTPSend(UTHTTPClient *client, UTHTTPRequest *req);
+  // Drop every connection and every queued request without callbacks.
+  // Safe to call from inside a request callback.
+  void UTHTTPClientReset(UTHTTPClient *client);
+  uint32_t UTHTTPClientOutstanding(UTHTTPClient *client);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+#endif /* UTIL_HTTP_H */
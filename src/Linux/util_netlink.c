@@ -129,6 +129,232 @@ extern "C" {
   }
 
 
+  /*_________________---------------------------__________________
+    _________________    UTNLGeneric_open       __________________
+    -----------------___________________________------------------
+    Left blocking so that UTNLGeneric_resolve() can wait for its
+    answer. Set O_NONBLOCK once the group has been joined.
+  */
+
+  int UTNLGeneric_open(void) {
+    int nl_sock = socket(AF_NETLINK, SOCK_RAW, NETLINK_GENERIC);
+    if(nl_sock < 0) {
+      myLog(LOG_ERR, "generic netlink socket open failed: %s", strerror(errno));
+      return -1;
+    }
+
+    // make sure it doesn't get inherited, e.g. when we fork a script
+    int fdFlags = fcntl(nl_sock, F_GETFD);
+    fdFlags |= FD_CLOEXEC;
+    if(fcntl(nl_sock, F_SETFD, fdFlags) < 0) {
+      myLog(LOG_ERR, "generic netlink fcntl(F_SETFD=FD_CLOEXEC) failed: %s", strerror(errno));
+    }
+
+    return nl_sock;
+  }
+
+  /*_________________---------------------------__________________
+    _________________  UTNLGeneric_sendAttrs    __________________
+    -----------------___________________________------------------
+    A generic netlink command with a list of (flat) attributes.
+    A flag attribute has data==NULL and len==0.
+  */
+
+#define UTNL_GENERIC_MAX_MSG 1024
+
+  static int sendGeneric(int sockfd, uint16_t familyId, uint8_t cmd, uint8_t version, UTNLAttr *attrs, int nAttrs, uint32_t seqNo, uint16_t flags) {
+    char buf[UTNL_GENERIC_MAX_MSG] __attribute__ ((aligned (NLMSG_ALIGNTO))) = { 0 };
+    struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+    struct genlmsghdr *ge = (struct genlmsghdr *)NLMSG_DATA(nlh);
+    ge->cmd = cmd;
+    ge->version = version;
+    int len = NLMSG_LENGTH(GENL_HDRLEN);
+    for(int ii = 0; ii < nAttrs; ii++) {
+      int attrLen = NLA_HDRLEN + attrs[ii].len;
+      if(len + NLA_ALIGN(attrLen) > UTNL_GENERIC_MAX_MSG) {
+	errno = EMSGSIZE;
+	return -1;
+      }
+      struct nlattr *na = (struct nlattr *)(buf + len);
+      na->nla_type = attrs[ii].type;
+      na->nla_len = attrLen;
+      if(attrs[ii].len)
+	memcpy((char *)na + NLA_HDRLEN, attrs[ii].data, attrs[ii].len);
+      len += NLA_ALIGN(attrLen);
+    }
+    nlh->nlmsg_len = len;
+    nlh->nlmsg_flags = flags;
+    nlh->nlmsg_type = familyId;
+    nlh->nlmsg_seq = seqNo;
+
+    struct sockaddr_nl sa = { 0 };
+    sa.nl_family = AF_NETLINK;
+    return sendto(sockfd, buf, len, 0, (struct sockaddr *)&sa, sizeof(sa));
+  }
+
+  int UTNLGeneric_sendAttrs(int sockfd, uint16_t familyId, uint8_t cmd, uint8_t version, UTNLAttr *attrs, int nAttrs, uint32_t seqNo) {
+    return sendGeneric(sockfd, familyId, cmd, version, attrs, nAttrs, seqNo, NLM_F_REQUEST);
+  }
+
+  /*_________________---------------------------__________________
+    _________________  UTNLGeneric_transact     __________________
+    -----------------___________________________------------------
+    Send a command and wait for the kernel's ack. Returns 0 on
+    success or the (positive) errno.  Anything else that arrives in
+    the meantime (e.g. multicast traffic) is discarded,  so call it
+    before the socket is made non-blocking and busy.
+  */
+
+  int UTNLGeneric_transact(int sockfd, uint16_t familyId, uint8_t cmd, uint8_t version, UTNLAttr *attrs, int nAttrs) {
+    static uint32_t seqNo = 0;
+    uint32_t mySeq = ++seqNo;
+    if(sendGeneric(sockfd, familyId, cmd, version, attrs, nAttrs, mySeq, NLM_F_REQUEST | NLM_F_ACK) < 0)
+      return errno;
+    uint8_t recv_buf[HSP_READNL_RCV_BUF];
+    for(;;) {
+      int numbytes = recv(sockfd, recv_buf, sizeof(recv_buf), 0);
+      if(numbytes <= 0) {
+	if(numbytes < 0
+	   && errno == ENOBUFS)
+	  continue;
+	return numbytes < 0 ? errno : EIO;
+      }
+      struct nlmsghdr *nlh = (struct nlmsghdr*) recv_buf;
+      for(; NLMSG_OK(nlh, numbytes); nlh = NLMSG_NEXT(nlh, numbytes)) {
+	if(nlh->nlmsg_seq == mySeq
+	   && nlh->nlmsg_type == NLMSG_ERROR) {
+	  struct nlmsgerr *err_msg = (struct nlmsgerr *)NLMSG_DATA(nlh);
+	  return -err_msg->error;
+	}
+      }
+    }
+  }
+
+  /*_________________---------------------------__________________
+    _________________    UTNLGeneric_send       __________________
+    -----------------___________________________------------------
+    A generic netlink command with (at most) one attribute.
+  */
+
+  int UTNLGeneric_send(int sockfd, uint16_t familyId, uint8_t cmd, uint8_t version, uint16_t attrType, void *attr, int attrLen, uint32_t seqNo) {
+    UTNLAttr na = { .type = attrType, .data = attr, .len = attrLen };
+    return UTNLGeneric_sendAttrs(sockfd, familyId, cmd, version, &na, attr ? 1 : 0, seqNo);
+  }
+
+  /*_________________---------------------------__________________
+    _________________    UTNLGeneric_resolve    __________________
+    -----------------___________________________------------------
+    Look up a generic netlink family id (and optionally the id of
+    one of its multicast groups). Blocks for the kernel's reply, so
+    call it before the socket is made non-blocking. Returns the
+    family id, or -1 if the family is not there (kernel module not
+    loaded, or kernel too old).
+  */
+
+  static uint32_t mcGroupId(struct nlattr *groups, char *mcGroupName) {
+    int len = UTNLA_PAYLOAD(groups);
+    for(struct nlattr *grp = UTNLA_DATA(groups); UTNLA_OK(grp, len); grp = UTNLA_NEXT(grp, len)) {
+      char *name = NULL;
+      uint32_t id = 0;
+      int glen = UTNLA_PAYLOAD(grp);
+      for(struct nlattr *ga = UTNLA_DATA(grp); UTNLA_OK(ga, glen); ga = UTNLA_NEXT(ga, glen)) {
+	switch(UTNLA_TYPE(ga)) {
+	case CTRL_ATTR_MCAST_GRP_NAME: name = (char *)UTNLA_DATA(ga); break;
+	case CTRL_ATTR_MCAST_GRP_ID: id = *(uint32_t *)UTNLA_DATA(ga); break;
+	}
+      }
+      if(name
+	 && my_strequal(name, mcGroupName))
+	return id;
+    }
+    return 0;
+  }
+
+  int UTNLGeneric_resolve(int sockfd, char *familyName, char *mcGroupName, uint32_t *p_mcGroupId) {
+    static uint32_t seqNo = 0;
+    uint32_t mySeq = ++seqNo;
+    if(UTNLGeneric_send(sockfd, GENL_ID_CTRL, CTRL_CMD_GETFAMILY, 1, CTRL_ATTR_FAMILY_NAME,
+			familyName, my_strlen(familyName) + 1, mySeq) < 0) {
+      myLog(LOG_ERR, "generic netlink GETFAMILY(%s) send failed: %s", familyName, strerror(errno));
+      return -1;
+    }
+    uint8_t recv_buf[HSP_READNL_RCV_BUF];
+    int numbytes = recv(sockfd, recv_buf, sizeof(recv_buf), 0);
+    if(numbytes <= 0) {
+      myLog(LOG_ERR, "generic netlink GETFAMILY(%s) recv failed: %s", familyName, strerror(errno));
+      return -1;
+    }
+    int familyId = -1;
+    uint32_t groupId = 0;
+    struct nlmsghdr *nlh = (struct nlmsghdr*) recv_buf;
+    for(; NLMSG_OK(nlh, numbytes); nlh = NLMSG_NEXT(nlh, numbytes)) {
+      if(nlh->nlmsg_seq != mySeq)
+	continue;
+      if(nlh->nlmsg_type == NLMSG_ERROR) {
+	struct nlmsgerr *err_msg = (struct nlmsgerr *)NLMSG_DATA(nlh);
+	myLog(LOG_ERR, "generic netlink family %s not found: %s", familyName, strerror(-err_msg->error));
+	return -1;
+      }
+      struct genlmsghdr *genl = (struct genlmsghdr *)NLMSG_DATA(nlh);
+      struct nlattr *attr = (struct nlattr *)((char *)genl + GENL_HDRLEN);
+      int len = nlh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+      for(; UTNLA_OK(attr, len); attr = UTNLA_NEXT(attr, len)) {
+	switch(UTNLA_TYPE(attr)) {
+	case CTRL_ATTR_FAMILY_ID:
+	  familyId = *(uint16_t *)UTNLA_DATA(attr);
+	  break;
+	case CTRL_ATTR_MCAST_GROUPS:
+	  if(mcGroupName)
+	    groupId = mcGroupId(attr, mcGroupName);
+	  break;
+	}
+      }
+    }
+    if(familyId > 0
+       && mcGroupName
+       && groupId == 0) {
+      myLog(LOG_ERR, "generic netlink family %s has no multicast group %s", familyName, mcGroupName);
+      return -1;
+    }
+    if(p_mcGroupId)
+      *p_mcGroupId = groupId;
+    myDebug(1, "generic netlink family %s id=%d group %s=%u",
+	    familyName, familyId, mcGroupName ?: "-", groupId);
+    return familyId;
+  }
+
+  /*_________________---------------------------__________________
+    _________________    UTNLGeneric_join       __________________
+    -----------------___________________________------------------
+  */
+
+  bool UTNLGeneric_join(int sockfd, uint32_t mcGroupId) {
+    if(setsockopt(sockfd, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP, &mcGroupId, sizeof(mcGroupId)) < 0) {
+      myLog(LOG_ERR, "netlink join multicast group %u failed: %s", mcGroupId, strerror(errno));
+      return NO;
+    }
+    return YES;
+  }
+
+  /*_________________---------------------------__________________
+    _________________    UTNL_setRcvBuf         __________________
+    -----------------___________________________------------------
+    Use the FORCE option while we are still root,  so we are not
+    limited by net.core.rmem_max. Returns the size actually granted.
+  */
+
+  int UTNL_setRcvBuf(int sockfd, int bytes) {
+    if(setsockopt(sockfd, SOL_SOCKET, SO_RCVBUFFORCE, &bytes, sizeof(bytes)) < 0
+       && setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes)) < 0) {
+      myLog(LOG_ERR, "netlink setsockopt(SO_RCVBUF=%d) failed: %s", bytes, strerror(errno));
+    }
+    int granted = 0;
+    socklen_t optlen = sizeof(granted);
+    if(getsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &granted, &optlen) < 0)
+      granted = 0;
+    return granted;
+  }
+
 #if defined(__cplusplus)
 } /* extern "C" */
 #endif
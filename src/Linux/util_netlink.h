@@ -19,6 +19,7 @@ extern "C" {
 #include <linux/tcp.h>
 #include <linux/sock_diag.h>
 #include <linux/inet_diag.h>
+#include <linux/genetlink.h>
 #include <arpa/inet.h>
 #include <pwd.h>
 
@@ -50,6 +51,30 @@ extern "C" {
   void UTNLDiag_recv(void *magic, int sockFd, UTNLDiagCB diagCB);
 
   char *UTNLDiag_sockid_print(struct inet_diag_sockid *sockid);
+
+  // generic netlink
+  int UTNLGeneric_open(void);
+  typedef struct _UTNLAttr {
+    uint16_t type;
+    void *data;
+    int len;
+  } UTNLAttr;
+  int UTNLGeneric_sendAttrs(int sockfd, uint16_t familyId, uint8_t cmd, uint8_t version, UTNLAttr *attrs, int nAttrs, uint32_t seqNo);
+  int UTNLGeneric_transact(int sockfd, uint16_t familyId, uint8_t cmd, uint8_t version, UTNLAttr *attrs, int nAttrs);
+  int UTNLGeneric_send(int sockfd, uint16_t familyId, uint8_t cmd, uint8_t version, uint16_t attrType, void *attr, int attrLen, uint32_t seqNo);
+  int UTNLGeneric_resolve(int sockfd, char *familyName, char *mcGroupName, uint32_t *p_mcGroupId);
+  bool UTNLGeneric_join(int sockfd, uint32_t mcGroupId);
+  int UTNL_setRcvBuf(int sockfd, int bytes);
+
+  // netlink attribute walking (struct nlattr)
+#define UTNLA_OK(nla, len) ((len) >= (int)sizeof(struct nlattr) \
+			    && (nla)->nla_len >= sizeof(struct nlattr) \
+			    && (nla)->nla_len <= (len))
+#define UTNLA_NEXT(nla, len) ((len) -= NLA_ALIGN((nla)->nla_len), \
+			      (struct nlattr *)((char *)(nla) + NLA_ALIGN((nla)->nla_len)))
+#define UTNLA_TYPE(nla) ((nla)->nla_type & NLA_TYPE_MASK)
+#define UTNLA_DATA(nla) ((void *)((char *)(nla) + NLA_HDRLEN))
+#define UTNLA_PAYLOAD(nla) ((int)(nla)->nla_len - NLA_HDRLEN)
   
 #if defined(__cplusplus)
 } /* extern "C" */
@@ -364,6 +364,35 @@ typedef struct _SFLExtended_entities {
 } SFLExtended_entities;
 
 #define XDRSIZ_SFLEXTENDED_ENTITIES 16
+
+/* Drop notification records (see discarded_packet below) */
+
+/* Egress queue that the packet was discarded from */
+/* opaque = flow_data; enterprise = 0; format = 1036 */
+typedef struct _SFLExtended_egress_queue {
+  uint32_t queue;
+} SFLExtended_egress_queue;
+
+#define XDRSIZ_SFLEXTENDED_EGRESS_Q 4
+
+/* Function where the packet was discarded (e.g. kernel symbol) */
+/* opaque = flow_data; enterprise = 0; format = 1041 */
+typedef struct _SFLExtended_function {
+  SFLString symbol;
+} SFLExtended_function;
+
+/* Hardware trap that discarded the packet (e.g. devlink trap) */
+/* opaque = flow_data; enterprise = 0; format = 1044 */
+typedef struct _SFLExtended_hw_trap {
+  SFLString group;
+  SFLString trap;
+} SFLExtended_hw_trap;
+
+/* Linux drop reason (enum skb_drop_reason, as a string) */
+/* opaque = flow_data; enterprise = 0; format = 1045 */
+typedef struct _SFLExtended_linux_reason {
+  SFLString reason;
+} SFLExtended_linux_reason;
   
 /* Extended socket information,
    Must be filled in for all application transactions associated with a network socket
@@ -475,6 +504,10 @@ enum SFLFlow_type_tag {
   SFLFLOW_EX_DECAP_INGRESS       = 1028,
   SFLFLOW_EX_VNI_EGRESS          = 1029,
   SFLFLOW_EX_VNI_INGRESS         = 1030,
+  SFLFLOW_EX_EGRESS_Q            = 1036, /* discard: egress queue */
+  SFLFLOW_EX_FUNCTION            = 1041, /* discard: function/symbol */
+  SFLFLOW_EX_HW_TRAP             = 1044, /* discard: hardware trap */
+  SFLFLOW_EX_LINUX_REASON        = 1045, /* discard: linux drop reason */
   SFLFLOW_EX_SOCKET4        = 2100, /* server socket */
   SFLFLOW_EX_SOCKET6        = 2101, /* server socket */
   SFLFLOW_EX_PROXY_SOCKET4  = 2102, /* back-end (client) socket */
@@ -516,6 +549,10 @@ typedef union _SFLFlow_type {
   SFLExtended_socket_ipv6 socket6;
   SFLExtended_TCP_info tcp_info;
   SFLExtended_entities entities;
+  SFLExtended_egress_queue egress_queue;
+  SFLExtended_function function;
+  SFLExtended_hw_trap hw_trap;
+  SFLExtended_linux_reason linux_reason;
 } SFLFlow_type;
 
 typedef struct _SFLFlow_sample_element {
@@ -529,7 +566,8 @@ enum SFL_sample_tag {
   SFLFLOW_SAMPLE = 1,              /* enterprise = 0 : format = 1 */
   SFLCOUNTERS_SAMPLE = 2,          /* enterprise = 0 : format = 2 */
   SFLFLOW_SAMPLE_EXPANDED = 3,     /* enterprise = 0 : format = 3 */
-  SFLCOUNTERS_SAMPLE_EXPANDED = 4  /* enterprise = 0 : format = 4 */
+  SFLCOUNTERS_SAMPLE_EXPANDED = 4, /* enterprise = 0 : format = 4 */
+  SFLEVENT_DISCARDED_PACKET = 5    /* enterprise = 0 : format = 5 */
 };
   
 /* Format of a single flow sample */
@@ -593,6 +631,91 @@ typedef struct _SFLFlow_sample_expanded {
   SFLFlow_sample_element *elements;
 } SFLFlow_sample_expanded;
 
+/* Discarded packet event (always uses the expanded data source) */
+
+enum SFLDrop_reason {
+  /* 0-15 are the ICMP Destination Unreachable codes */
+  SFLDrop_net_unreachable = 0,
+  SFLDrop_host_unreachable = 1,
+  SFLDrop_protocol_unreachable = 2,
+  SFLDrop_port_unreachable = 3,
+  SFLDrop_frag_needed = 4,
+  SFLDrop_src_route_failed = 5,
+  SFLDrop_dst_net_unknown = 6,
+  SFLDrop_dst_host_unknown = 7,
+  SFLDrop_src_host_isolated = 8,
+  SFLDrop_dst_net_prohibited = 9,
+  SFLDrop_dst_host_prohibited = 10,
+  SFLDrop_dst_net_tos_unreachable = 11,
+  SFLDrop_dst_host_tos_unreacheable = 12,
+  SFLDrop_comm_admin_prohibited = 13,
+  SFLDrop_host_precedence_violation = 14,
+  SFLDrop_precedence_cutoff = 15,
+  SFLDrop_unknown = 256,
+  SFLDrop_ttl_exceeded = 257,
+  SFLDrop_acl = 258,
+  SFLDrop_no_buffer_space = 259,
+  SFLDrop_red = 260,
+  SFLDrop_traffic_shaping = 261,
+  SFLDrop_pkt_too_big = 262,
+  SFLDrop_src_mac_is_multicast = 263,
+  SFLDrop_vlan_tag_mismatch = 264,
+  SFLDrop_ingress_vlan_filter = 265,
+  SFLDrop_ingress_spanning_tree_filter = 266,
+  SFLDrop_port_list_is_empty = 267,
+  SFLDrop_port_loopback_filter = 268,
+  SFLDrop_blackhole_route = 269,
+  SFLDrop_non_ip = 270,
+  SFLDrop_uc_dip_over_mc_dmac = 271,
+  SFLDrop_dip_is_loopback_address = 272,
+  SFLDrop_sip_is_mc = 273,
+  SFLDrop_sip_is_loopback_address = 274,
+  SFLDrop_ip_header_corrupted = 275,
+  SFLDrop_ipv4_sip_is_limited_bc = 276,
+  SFLDrop_ipv6_mc_dip_reserved_scope = 277,
+  SFLDrop_ipv6_mc_dip_interface_local_scope = 278,
+  SFLDrop_unresolved_neigh = 279,
+  SFLDrop_mc_reverse_path_forwarding = 280,
+  SFLDrop_non_routable_packet = 281,
+  SFLDrop_decap_error = 282,
+  SFLDrop_overlay_smac_is_mc = 283,
+  SFLDrop_unknown_l2 = 284,
+  SFLDrop_unknown_l3 = 285,
+  SFLDrop_unknown_l3_exception = 286,
+  SFLDrop_unknown_buffer = 287,
+  SFLDrop_unknown_tunnel = 288,
+  SFLDrop_unknown_l4 = 289,
+  SFLDrop_sip_is_unspecified = 290,
+  SFLDrop_mlag_port_isolation = 291,
+  SFLDrop_blackhole_arp_neigh = 292,
+  SFLDrop_src_mac_is_dmac = 293,
+  SFLDrop_dmac_is_reserved = 294,
+  SFLDrop_sip_is_class_e = 295,
+  SFLDrop_mc_dmac_mismatch = 296,
+  SFLDrop_sip_is_dip = 297,
+  SFLDrop_dip_is_local_network = 298,
+  SFLDrop_dip_is_link_local = 299,
+  SFLDrop_overlay_smac_is_dmac = 300,
+  SFLDrop_egress_vlan_filter = 301,
+  SFLDrop_uc_reverse_path_forwarding = 302,
+  SFLDrop_split_horizon = 303
+};
+
+typedef struct _SFLEvent_discarded_packet {
+  /* uint32_t tag;    */         /* SFL_sample_tag -- enterprise = 0 : format = 5 */
+  /* uint32_t length; */
+  uint32_t sequence_number;      /* Incremented with each discard event */
+  uint32_t ds_class;             /* EXPANDED */
+  uint32_t ds_index;             /* EXPANDED */
+  uint32_t drops;                /* Number of discard events that were
+				     not reported (e.g. rate limited) */
+  uint32_t input;                /* ifIndex of input interface, 0 if unknown */
+  uint32_t output;               /* ifIndex of output interface, 0 if unknown */
+  uint32_t reason;               /* enum SFLDrop_reason */
+  uint32_t num_elements;
+  SFLFlow_sample_element *elements;
+} SFLEvent_discarded_packet;
+
 /* Counter types */
 
 /* Generic interface counters - see RFC 1573, 2233 */
@@ -1204,9 +1327,20 @@ enum SFLCounters_type_tag {
   SFLCOUNTERS_APP_WORKERS   = 2206,
   SFLCOUNTERS_HOST_GPU_NVML = (5703 << 12) + 1, /* = 23359489 */
   SFLCOUNTERS_BCM_TABLES    = (4413 << 12) + 3,
+  /* internal: block already XDR-encoded (with tag and length).  Kept
+     outside the sFlow tag space so a zeroed element is never taken
+     for one. */
+  SFLCOUNTERS_ENCODED       = 0xFFFFFFFF,
 };
 
+/* pre-encoded counters block - see sfl_receiver_encodeCountersElement() */
+typedef struct _SFLEncoded_counters {
+  uint32_t *xdr;   /* tag, length and body in network byte order */
+  uint32_t len;    /* bytes, multiple of 4 */
+} SFLEncoded_counters;
+
 typedef union _SFLCounters_type {
+  SFLEncoded_counters encoded;
   SFLIf_counters generic;
   SFLEthernet_counters ethernet;
   SFLTokenring_counters tokenring;
@@ -63,6 +63,7 @@ void sfl_agent_release(SFLAgent *agent)
  
   SFLSampler *sm;
   SFLPoller *pl;
+  SFLNotifier *nt;
   SFLReceiver *rcv;
    /* release and free the samplers */
   for(sm = agent->samplers; sm != NULL; ) {
@@ -80,6 +81,14 @@ void sfl_agent_release(SFLAgent *agent)
   }
   agent->pollers = NULL;
 
+  /* release and free the notifiers */
+  for(nt = agent->notifiers; nt != NULL; ) {
+    SFLNotifier *nextNt = nt->nxt;
+    sflFree(agent, nt);
+    nt = nextNt;
+  }
+  agent->notifiers = NULL;
+
   /* release and free the receivers */
   for( rcv = agent->receivers; rcv != NULL; ) {
     SFLReceiver *nextRcv = rcv->nxt;
@@ -257,6 +266,31 @@ SFLPoller *sfl_agent_addPoller(SFLAgent *agent,
   return newpl;
 }
 
+/*_________________---------------------------__________________
+  _________________   sfl_agent_addNotifier   __________________
+  -----------------___________________________------------------
+*/
+
+SFLNotifier *sfl_agent_addNotifier(SFLAgent *agent, SFLDataSource_instance *pdsi)
+{
+  SFLNotifier *newnt;
+
+  // keep the list sorted
+  SFLNotifier *prev = NULL, *nt = agent->notifiers;
+  for(; nt != NULL; prev = nt, nt = nt->nxt) {
+    int64_t cmp = sfl_dsi_compare(pdsi, &nt->dsi);
+    if(cmp == 0) return nt;  // found - return existing one
+    if(cmp < 0) break;       // insert here
+  }
+  // either we found the insert point, or reached the end of the list...
+  newnt = (SFLNotifier *)sflAlloc(agent, sizeof(SFLNotifier));
+  sfl_notifier_init(newnt, agent, pdsi);
+  if(prev) prev->nxt = newnt;
+  else agent->notifiers = newnt;
+  newnt->nxt = nt;
+  return newnt;
+}
+
 /*_________________---------------------------__________________
   _________________  sfl_agent_removeSampler  __________________
   -----------------___________________________------------------
@@ -287,12 +321,15 @@ int sfl_agent_removeSampler(SFLAgent *agent, SFLDataSource_instance *pdsi)
 
 int sfl_agent_removePoller(SFLAgent *agent, SFLDataSource_instance *pdsi)
 {
-  SFLPoller *prev, *pl;
+  SFLPoller *prev, *pl, *other;
   /* find it, unlink it and free it */
   for(prev = NULL, pl = agent->pollers; pl != NULL; prev = pl, pl = pl->nxt) {
     if(sfl_dsi_compare(pdsi, &pl->dsi) == 0) {
       if(prev == NULL) agent->pollers = pl->nxt;
       else prev->nxt = pl->nxt;
+      /* don't leave others synchronized to a freed poller */
+      for(other = agent->pollers; other != NULL; other = other->nxt)
+	if(other->syncMaster == pl) other->syncMaster = NULL;
       sflFree(agent, pl);
       return 1;
     }
@@ -301,6 +338,27 @@ int sfl_agent_removePoller(SFLAgent *agent, SFLDataSource_instance *pdsi)
   return 0;
 }
 
+/*_________________---------------------------__________________
+  _________________  sfl_agent_removeNotifier __________________
+  -----------------___________________________------------------
+*/
+
+int sfl_agent_removeNotifier(SFLAgent *agent, SFLDataSource_instance *pdsi)
+{
+  SFLNotifier *prev, *nt;
+  /* find it, unlink it and free it */
+  for(prev = NULL, nt = agent->notifiers; nt != NULL; prev = nt, nt = nt->nxt) {
+    if(sfl_dsi_compare(pdsi, &nt->dsi) == 0) {
+      if(prev == NULL) agent->notifiers = nt->nxt;
+      else prev->nxt = nt->nxt;
+      sflFree(agent, nt);
+      return 1;
+    }
+  }
+  /* not found */
+  return 0;
+}
+
 /*_________________--------------------------------__________________
   _________________  sfl_agent_jumpTableAdd        __________________
   -----------------________________________________------------------
@@ -382,6 +440,22 @@ SFLPoller *sfl_agent_getPoller(SFLAgent *agent, SFLDataSource_instance *pdsi)
   return NULL;
 }
 
+/*_________________---------------------------__________________
+  _________________  sfl_agent_getNotifier    __________________
+  -----------------___________________________------------------
+*/
+
+SFLNotifier *sfl_agent_getNotifier(SFLAgent *agent, SFLDataSource_instance *pdsi)
+{
+  SFLNotifier *nt;
+
+  /* find it and return it */
+  for( nt = agent->notifiers; nt != NULL; nt = nt->nxt)
+    if(sfl_dsi_compare(pdsi, &nt->dsi) == 0) return nt;
+  /* not found */
+  return NULL;
+}
+
 /*_________________---------------------------__________________
   _________________  sfl_agent_getReceiver    __________________
   -----------------___________________________------------------
@@ -446,8 +520,9 @@ void sfl_agent_resetReceiver(SFLAgent *agent, SFLReceiver *receiver)
   SFLReceiver *rcv;
   SFLSampler *sm;
   SFLPoller *pl;
+  SFLNotifier *nt;
 
-  /* tell samplers and pollers to stop sending to this receiver */
+  /* tell samplers, pollers and notifiers to stop sending to this receiver */
   /* first get his receiverIndex */
   uint32_t rcvIdx = 0;
   for( rcv = agent->receivers; rcv != NULL; rcv = rcv->nxt) {
@@ -460,6 +535,9 @@ void sfl_agent_resetReceiver(SFLAgent *agent, SFLReceiver *receiver)
       for( pl = agent->pollers; pl != NULL; pl = pl->nxt)
 	if(sfl_poller_get_sFlowCpReceiver(pl) == rcvIdx) sfl_poller_set_sFlowCpReceiver(pl, 0);
 
+      for( nt = agent->notifiers; nt != NULL; nt = nt->nxt)
+	if(sfl_notifier_get_sFlowEsReceiver(nt) == rcvIdx) sfl_notifier_set_sFlowEsReceiver(nt, 0);
+
       break;
     }
   }
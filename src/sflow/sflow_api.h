@@ -118,6 +118,13 @@ typedef struct _SFLReceiver {
 #endif
 } SFLReceiver;
 
+/* random number generator state (PCG32). Each sampler has its own,
+   so that samplers running in different threads do not share one. */
+typedef struct _SFLRandom {
+  uint64_t state;
+  uint64_t inc;
+} SFLRandom;
+
 typedef struct _SFLSampler {
   /* for linked list */
   struct _SFLSampler *nxt;
@@ -133,6 +140,7 @@ typedef struct _SFLSampler {
   void *userData;          /* can be useful to hang something else here */
   /* private fields */
   SFLReceiver *myReceiver;
+  SFLRandom rng;
   uint32_t skip;
   uint32_t samplePool;
   uint32_t flowSampleSeqNo;
@@ -161,12 +169,30 @@ typedef struct _SFLPoller {
   void *magic;             /* ptr to pass back in getCountersFn() */
   void *userData;          /* can be useful to hang something else here */
   getCountersFn_t getCountersFn;
+  uint32_t cost_uS;        /* recent cost of getCountersFn(), if the client measures it */
   /* private fields */
   SFLReceiver *myReceiver;
   time_t countersCountdown;
   uint32_t countersSampleSeqNo;
+  struct _SFLPoller *syncMaster; /* set by sfl_poller_synchronize_polling() */
 } SFLPoller;
 
+/* discarded-packet notifications */
+typedef struct _SFLNotifier {
+  /* for linked list */
+  struct _SFLNotifier *nxt;
+  /* MIB fields */
+  SFLDataSource_instance dsi;
+  uint32_t sFlowEsReceiver;
+  uint32_t sFlowEsMaximumHeaderSize;
+  /* public fields */
+  struct _SFLAgent *agent; /* pointer to my agent */
+  void *userData;          /* can be useful to hang something else here */
+  /* private fields */
+  SFLReceiver *myReceiver;
+  uint32_t eventSeqNo;
+} SFLNotifier;
+
 typedef void *(*allocFn_t)(void *magic,               /* callback to allocate space on heap */
 			   struct _SFLAgent *agent,   /* called with self */
 			   size_t bytes);             /* bytes requested */
@@ -193,6 +219,7 @@ typedef struct _SFLAgent {
   SFLSampler *jumpTable[SFL_HASHTABLE_SIZ]; /* fast lookup table for samplers (by ifIndex) */
   SFLSampler *samplers;   /* the list of samplers */
   SFLPoller  *pollers;    /* the list of samplers */
+  SFLNotifier *notifiers; /* the list of discard notifiers */
   SFLReceiver *receivers; /* the array of receivers */
   time_t bootTime;        /* time when we booted or started */
   time_t now;             /* time now - seconds */
@@ -231,6 +258,9 @@ SFLPoller *sfl_agent_addPoller(SFLAgent *agent,
 			       void *magic, /* ptr to pass back in getCountersFn() */
 			       getCountersFn_t getCountersFn);
 
+/* call this to create discard notifiers */
+SFLNotifier *sfl_agent_addNotifier(SFLAgent *agent, SFLDataSource_instance *pdsi);
+
 /* call this to create receivers */
 SFLReceiver *sfl_agent_addReceiver(SFLAgent *agent);
 
@@ -240,6 +270,9 @@ int sfl_agent_removeSampler(SFLAgent *agent, SFLDataSource_instance *pdsi);
 /* call this to remove pollers */
 int sfl_agent_removePoller(SFLAgent *agent, SFLDataSource_instance *pdsi);
 
+/* call this to remove notifiers */
+int sfl_agent_removeNotifier(SFLAgent *agent, SFLDataSource_instance *pdsi);
+
 /* note: receivers should not be removed. Typically the receivers
    list will be created at init time and never changed */
 
@@ -248,6 +281,7 @@ SFLSampler  *sfl_agent_getSampler(SFLAgent *agent, SFLDataSource_instance *pdsi)
 SFLSampler  *sfl_agent_getNextSampler(SFLAgent *agent, SFLDataSource_instance *pdsi);
 SFLPoller   *sfl_agent_getPoller(SFLAgent *agent, SFLDataSource_instance *pdsi);
 SFLPoller   *sfl_agent_getNextPoller(SFLAgent *agent, SFLDataSource_instance *pdsi);
+SFLNotifier *sfl_agent_getNotifier(SFLAgent *agent, SFLDataSource_instance *pdsi);
 SFLReceiver *sfl_agent_getReceiver(SFLAgent *agent, uint32_t receiverIndex);
 SFLReceiver *sfl_agent_getNextReceiver(SFLAgent *agent, uint32_t receiverIndex);
 
@@ -257,6 +291,12 @@ SFLSampler *sfl_agent_getSamplerByIfIndex(SFLAgent *agent, uint32_t ifIndex);
 /* random number generator - used by sampler and poller */
 uint32_t sfl_random(uint32_t mean);
 void sfl_random_init(uint32_t seed);
+/* reentrant versions, with caller-owned state */
+void sfl_random_seed(SFLRandom *rng, uint64_t seed, uint64_t stream);
+uint32_t sfl_random_next(SFLRandom *rng);
+uint32_t sfl_random_r(SFLRandom *rng, uint32_t lim);
+/* skip count for 1-in-N sampling (geometric distribution, mean N) */
+uint32_t sfl_random_skip(SFLRandom *rng, uint32_t mean);
 
 /* call these functions to GET and SET MIB values */
 
@@ -284,6 +324,11 @@ void     sfl_poller_set_sFlowCpReceiver(SFLPoller *poller, uint32_t sFlowCpRecei
 uint32_t sfl_poller_get_sFlowCpInterval(SFLPoller *poller);
 void     sfl_poller_set_sFlowCpInterval(SFLPoller *poller, uint32_t sFlowCpInterval);
 void     sfl_poller_synchronize_polling(SFLPoller *poller, SFLPoller *master);
+/* notifier */
+uint32_t sfl_notifier_get_sFlowEsReceiver(SFLNotifier *notifier);
+void     sfl_notifier_set_sFlowEsReceiver(SFLNotifier *notifier, uint32_t sFlowEsReceiver);
+uint32_t sfl_notifier_get_sFlowEsMaximumHeaderSize(SFLNotifier *notifier);
+void     sfl_notifier_set_sFlowEsMaximumHeaderSize(SFLNotifier *notifier, uint32_t sFlowEsMaximumHeaderSize);
 
 /* call this to indicate a discontinuity with a counter like samplePool so that the
    sflow collector will ignore the next delta */
@@ -321,6 +366,9 @@ void sfl_sampler_writeFlowSample(SFLSampler *sampler, SFL_FLOW_SAMPLE_TYPE *fs);
 /* call this to push counters samples (usually done in the getCountersFn callback) */
 void sfl_poller_writeCountersSample(SFLPoller *poller, SFL_COUNTERS_SAMPLE_TYPE *cs);
 
+/* call this with each discarded-packet event */
+void sfl_notifier_writeEventDiscardedPacket(SFLNotifier *notifier, SFLEvent_discarded_packet *es);
+
 /* call this to deallocate resources */
 void sfl_agent_release(SFLAgent *agent);
 
@@ -330,6 +378,7 @@ void sfl_agent_release(SFLAgent *agent);
 void sfl_receiver_init(SFLReceiver *receiver, SFLAgent *agent);
 void sfl_sampler_init(SFLSampler *sampler, SFLAgent *agent, SFLDataSource_instance *pdsi);
 void sfl_poller_init(SFLPoller *poller, SFLAgent *agent, SFLDataSource_instance *pdsi, void *magic, getCountersFn_t getCountersFn);
+void sfl_notifier_init(SFLNotifier *notifier, SFLAgent *agent, SFLDataSource_instance *pdsi);
 
 
 void sfl_receiver_tick(SFLReceiver *receiver, time_t now);
@@ -338,6 +387,8 @@ void sfl_sampler_tick(SFLSampler *sampler, time_t now);
 
 int sfl_receiver_writeFlowSample(SFLReceiver *receiver, SFL_FLOW_SAMPLE_TYPE *fs);
 int sfl_receiver_writeCountersSample(SFLReceiver *receiver, SFL_COUNTERS_SAMPLE_TYPE *cs);
+int sfl_receiver_writeEventDiscardedPacket(SFLReceiver *receiver, SFLEvent_discarded_packet *es);
+int sfl_receiver_encodeCountersElement(SFLReceiver *receiver, SFLCounters_sample_element *elem, uint32_t *buf, int bufLen);
 int sfl_receiver_writeEncoded(SFLReceiver *receiver, uint32_t samples, uint32_t *data, int packedSize);
 void sfl_receiver_flush(SFLReceiver *receiver);
 
@@ -0,0 +1,93 @@
+/* This software is distributed under the following license:
+ * http://sflow.net/license.html
+ */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "sflow_api.h"
+
+/*_________________--------------------------__________________
+  _________________   sfl_notifier_init      __________________
+  -----------------__________________________------------------
+*/
+
+void sfl_notifier_init(SFLNotifier *notifier, SFLAgent *agent, SFLDataSource_instance *pdsi)
+{
+  /* copy the dsi in case it points to notifier->dsi, which we are about to clear */
+  SFLDataSource_instance dsi = *pdsi;
+
+  /* preserve the *nxt pointer too, in case we are resetting this notifier and it is
+     already part of the agent's linked list */
+  SFLNotifier *nxtPtr = notifier->nxt;
+
+  /* clear everything */
+  memset(notifier, 0, sizeof(*notifier));
+
+  /* restore the linked list ptr */
+  notifier->nxt = nxtPtr;
+
+  /* now copy in the parameters */
+  notifier->agent = agent;
+  notifier->dsi = dsi; /* structure copy */
+
+  /* set defaults */
+  notifier->sFlowEsMaximumHeaderSize = SFL_DEFAULT_HEADER_SIZE;
+}
+
+/*_________________--------------------------__________________
+  _________________       reset              __________________
+  -----------------__________________________------------------
+*/
+
+static void reset(SFLNotifier *notifier)
+{
+  SFLDataSource_instance dsi = notifier->dsi;
+  sfl_notifier_init(notifier, notifier->agent, &dsi);
+}
+
+/*_________________---------------------------__________________
+  _________________      MIB access           __________________
+  -----------------___________________________------------------
+*/
+uint32_t sfl_notifier_get_sFlowEsReceiver(SFLNotifier *notifier) {
+  return notifier->sFlowEsReceiver;
+}
+
+void sfl_notifier_set_sFlowEsReceiver(SFLNotifier *notifier, uint32_t sFlowEsReceiver) {
+  notifier->sFlowEsReceiver = sFlowEsReceiver;
+  if(sFlowEsReceiver == 0) reset(notifier);
+  else {
+    /* retrieve and cache a direct pointer to my receiver */
+    notifier->myReceiver = sfl_agent_getReceiver(notifier->agent, notifier->sFlowEsReceiver);
+  }
+}
+
+uint32_t sfl_notifier_get_sFlowEsMaximumHeaderSize(SFLNotifier *notifier) {
+  return notifier->sFlowEsMaximumHeaderSize;
+}
+
+void sfl_notifier_set_sFlowEsMaximumHeaderSize(SFLNotifier *notifier, uint32_t sFlowEsMaximumHeaderSize) {
+  notifier->sFlowEsMaximumHeaderSize = sFlowEsMaximumHeaderSize;
+}
+
+/*_________________-----------------------------------------__________________
+  _________________ sfl_notifier_writeEventDiscardedPacket  __________________
+  -----------------_________________________________________------------------
+*/
+
+void sfl_notifier_writeEventDiscardedPacket(SFLNotifier *notifier, SFLEvent_discarded_packet *es)
+{
+  /* fill in the rest of the header fields, and send to the receiver */
+  es->sequence_number = ++notifier->eventSeqNo;
+  es->ds_class = SFL_DS_CLASS(notifier->dsi);
+  es->ds_index = SFL_DS_INDEX(notifier->dsi);
+  /* sent to my receiver */
+  if(notifier->myReceiver) sfl_receiver_writeEventDiscardedPacket(notifier->myReceiver, es);
+}
+
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
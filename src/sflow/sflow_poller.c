@@ -85,6 +85,9 @@ void sfl_poller_synchronize_polling(SFLPoller *poller, SFLPoller *master) {
   if(master->countersCountdown) {
     poller->countersCountdown = master->countersCountdown;
   }
+  /* remember the relationship so that a scheduler moving
+     the master can bring this one along too */
+  poller->syncMaster = (master == poller) ? NULL : master;
 }
 
 /*_________________---------------------------------__________________
@@ -633,6 +633,150 @@ static void putSFP(SFLReceiver *receiver, SFLSFP_counters *sfp) {
 }
  
    
+/*_________________-----------------------------__________________
+  _________________  flowElementEncodingLength  __________________
+  -----------------_____________________________------------------
+  Shared by flow samples and discard events.
+*/
+
+static uint32_t hwTrapEncodingLength(SFLExtended_hw_trap *trap) {
+  return stringEncodingLength(&trap->group) + stringEncodingLength(&trap->trap);
+}
+
+static int flowElementEncodingLength(SFLReceiver *receiver, SFLFlow_sample_element *elem)
+{
+  int elemSiz = 0;
+  switch(elem->tag) {
+  case SFLFLOW_HEADER:
+    elemSiz = 16; /* header_protocol, frame_length, stripped, header_length */
+    elemSiz += ((elem->flowType.header.header_length + 3) / 4) * 4; /* header, rounded up to nearest 4 bytes */
+    break;
+  case SFLFLOW_ETHERNET: elemSiz = sizeof(SFLSampled_ethernet); break;
+  case SFLFLOW_IPV4: elemSiz = sizeof(SFLSampled_ipv4); break;
+  case SFLFLOW_IPV6: elemSiz = sizeof(SFLSampled_ipv6); break;
+  case SFLFLOW_EX_SWITCH: elemSiz = sizeof(SFLExtended_switch); break;
+  case SFLFLOW_EX_ROUTER: elemSiz = routerEncodingLength(&elem->flowType.router); break;
+  case SFLFLOW_EX_GATEWAY: elemSiz = gatewayEncodingLength(&elem->flowType.gateway); break;
+  case SFLFLOW_EX_USER: elemSiz = userEncodingLength(&elem->flowType.user); break;
+  case SFLFLOW_EX_URL: elemSiz = urlEncodingLength(&elem->flowType.url); break;
+  case SFLFLOW_EX_MPLS: elemSiz = mplsEncodingLength(&elem->flowType.mpls); break;
+  case SFLFLOW_EX_NAT: elemSiz = natEncodingLength(&elem->flowType.nat); break;
+  case SFLFLOW_EX_MPLS_TUNNEL: elemSiz = mplsTunnelEncodingLength(&elem->flowType.mpls_tunnel); break;
+  case SFLFLOW_EX_MPLS_VC: elemSiz = mplsVcEncodingLength(&elem->flowType.mpls_vc); break;
+  case SFLFLOW_EX_MPLS_FTN: elemSiz = mplsFtnEncodingLength(&elem->flowType.mpls_ftn); break;
+  case SFLFLOW_EX_MPLS_LDP_FEC: elemSiz = mplsLdpFecEncodingLength(&elem->flowType.mpls_ldp_fec); break;
+  case SFLFLOW_EX_VLAN_TUNNEL: elemSiz = vlanTunnelEncodingLength(&elem->flowType.vlan_tunnel); break;
+	case SFLFLOW_EX_L2_TUNNEL_EGRESS:
+	case SFLFLOW_EX_L2_TUNNEL_INGRESS: elemSiz = sizeof(SFLExtended_l2_tunnel); break;
+	case SFLFLOW_EX_IPV4_TUNNEL_EGRESS:
+	case SFLFLOW_EX_IPV4_TUNNEL_INGRESS: elemSiz = sizeof(SFLExtended_ipv4_tunnel); break;
+	case SFLFLOW_EX_DECAP_EGRESS:
+	case SFLFLOW_EX_DECAP_INGRESS: elemSiz = tunnelDecapEncodingLength(&elem->flowType.tunnel_decap); break;
+	case SFLFLOW_EX_VNI_EGRESS:
+	case SFLFLOW_EX_VNI_INGRESS: elemSiz = tunnelVniEncodingLength(&elem->flowType.tunnel_vni); break;
+  case SFLFLOW_APP: elemSiz = appEncodingLength(&elem->flowType.app); break;
+  case SFLFLOW_APP_CTXT: elemSiz = appContextLength(&elem->flowType.context); break;
+  case SFLFLOW_APP_ACTOR_INIT:
+  case SFLFLOW_APP_ACTOR_TGT: elemSiz = stringEncodingLength(&elem->flowType.actor.actor); break;
+  case SFLFLOW_EX_PROXY_SOCKET4:
+  case SFLFLOW_EX_SOCKET4: elemSiz = XDRSIZ_SFLEXTENDED_SOCKET4;  break;
+  case SFLFLOW_EX_PROXY_SOCKET6:
+  case SFLFLOW_EX_SOCKET6: elemSiz = XDRSIZ_SFLEXTENDED_SOCKET6;  break;
+  case SFLFLOW_EX_TCP_INFO: elemSiz = XDRSIZ_SFLEXTENDED_TCP_INFO;  break;
+  case SFLFLOW_EX_ENTITIES: elemSiz = XDRSIZ_SFLEXTENDED_ENTITIES; break;
+  case SFLFLOW_EX_EGRESS_Q: elemSiz = XDRSIZ_SFLEXTENDED_EGRESS_Q; break;
+  case SFLFLOW_EX_FUNCTION: elemSiz = stringEncodingLength(&elem->flowType.function.symbol); break;
+  case SFLFLOW_EX_HW_TRAP: elemSiz = hwTrapEncodingLength(&elem->flowType.hw_trap); break;
+  case SFLFLOW_EX_LINUX_REASON: elemSiz = stringEncodingLength(&elem->flowType.linux_reason.reason); break;
+  default:
+    sflError(receiver, "unexpected packet_data_tag");
+    return -1;
+    break;
+  }
+  return elemSiz;
+}
+
+/*_________________-----------------------------__________________
+  _________________      putFlowElement         __________________
+  -----------------_____________________________------------------
+*/
+
+static int putFlowElement(SFLReceiver *receiver, SFLFlow_sample_element *elem)
+{
+  putNet32(receiver, elem->tag);
+  putNet32(receiver, elem->length); // length cached in flowElementEncodingLength()
+
+  switch(elem->tag) {
+  case SFLFLOW_HEADER:
+    putNet32(receiver, elem->flowType.header.header_protocol);
+    putNet32(receiver, elem->flowType.header.frame_length);
+    putNet32(receiver, elem->flowType.header.stripped);
+    putNet32(receiver, elem->flowType.header.header_length);
+    /* the header */
+    memcpy(receiver->sampleCollector.datap, elem->flowType.header.header_bytes, elem->flowType.header.header_length);
+    /* round up to multiple of 4 to preserve alignment */
+    receiver->sampleCollector.datap += ((elem->flowType.header.header_length + 3) / 4);
+    break;
+	case SFLFLOW_ETHERNET: putSampledEthernet(receiver, &elem->flowType.ethernet); break;
+	case SFLFLOW_IPV4: putSampledIPv4(receiver, &elem->flowType.ipv4); break;
+	case SFLFLOW_IPV6: putSampledIPv6(receiver, &elem->flowType.ipv6); break;
+  case SFLFLOW_EX_SWITCH: putSwitch(receiver, &elem->flowType.sw); break;
+  case SFLFLOW_EX_ROUTER: putRouter(receiver, &elem->flowType.router); break;
+  case SFLFLOW_EX_GATEWAY: putGateway(receiver, &elem->flowType.gateway); break;
+  case SFLFLOW_EX_USER: putUser(receiver, &elem->flowType.user); break;
+  case SFLFLOW_EX_URL: putUrl(receiver, &elem->flowType.url); break;
+  case SFLFLOW_EX_MPLS: putMpls(receiver, &elem->flowType.mpls); break;
+  case SFLFLOW_EX_NAT: putNat(receiver, &elem->flowType.nat); break;
+  case SFLFLOW_EX_MPLS_TUNNEL: putMplsTunnel(receiver, &elem->flowType.mpls_tunnel); break;
+  case SFLFLOW_EX_MPLS_VC: putMplsVc(receiver, &elem->flowType.mpls_vc); break;
+  case SFLFLOW_EX_MPLS_FTN: putMplsFtn(receiver, &elem->flowType.mpls_ftn); break;
+  case SFLFLOW_EX_MPLS_LDP_FEC: putMplsLdpFec(receiver, &elem->flowType.mpls_ldp_fec); break;
+  case SFLFLOW_EX_VLAN_TUNNEL: putVlanTunnel(receiver, &elem->flowType.vlan_tunnel); break;
+	case SFLFLOW_EX_L2_TUNNEL_EGRESS: 
+	case SFLFLOW_EX_L2_TUNNEL_INGRESS:
+		putSampledEthernet(receiver, &elem->flowType.tunnel_l2.header);
+		break;
+	case SFLFLOW_EX_IPV4_TUNNEL_EGRESS:
+	case SFLFLOW_EX_IPV4_TUNNEL_INGRESS:
+		putSampledIPv4(receiver, &elem->flowType.tunnel_ipv4.header);
+		break;
+	case SFLFLOW_EX_IPV6_TUNNEL_EGRESS:
+	case SFLFLOW_EX_IPV6_TUNNEL_INGRESS:
+		putSampledIPv6(receiver, &elem->flowType.tunnel_ipv6.header);
+		break;
+	case SFLFLOW_EX_DECAP_EGRESS:
+	case SFLFLOW_EX_DECAP_INGRESS:
+		putNet32(receiver, elem->flowType.tunnel_decap.inner_header_offset);
+		break;
+	case SFLFLOW_EX_VNI_EGRESS:
+	case SFLFLOW_EX_VNI_INGRESS:
+		putNet32(receiver, elem->flowType.tunnel_vni.vni);
+		break;
+  case SFLFLOW_APP: putAPP(receiver, &elem->flowType.app); break;
+  case SFLFLOW_APP_CTXT: putAPPContext(receiver, &elem->flowType.context); break;
+  case SFLFLOW_APP_ACTOR_INIT:
+  case SFLFLOW_APP_ACTOR_TGT: putString(receiver, &elem->flowType.actor.actor); break;
+  case SFLFLOW_EX_PROXY_SOCKET4:
+  case SFLFLOW_EX_SOCKET4: putSocket4(receiver, &elem->flowType.socket4); break;
+  case SFLFLOW_EX_PROXY_SOCKET6:
+  case SFLFLOW_EX_SOCKET6: putSocket6(receiver, &elem->flowType.socket6); break;
+  case SFLFLOW_EX_TCP_INFO: putTCPInfo(receiver, &elem->flowType.tcp_info); break;
+  case SFLFLOW_EX_ENTITIES: putEntities(receiver, &elem->flowType.entities); break;
+  case SFLFLOW_EX_EGRESS_Q: putNet32(receiver, elem->flowType.egress_queue.queue); break;
+  case SFLFLOW_EX_FUNCTION: putString(receiver, &elem->flowType.function.symbol); break;
+  case SFLFLOW_EX_HW_TRAP:
+    putString(receiver, &elem->flowType.hw_trap.group);
+    putString(receiver, &elem->flowType.hw_trap.trap);
+    break;
+  case SFLFLOW_EX_LINUX_REASON: putString(receiver, &elem->flowType.linux_reason.reason); break;
+  default:
+    sflError(receiver, "unexpected packet_data_tag");
+    return -1;
+    break;
+  }
+  return 0;
+}
+
 /*_________________-----------------------------__________________
   _________________      computeFlowSampleSize  __________________
   -----------------_____________________________------------------
@@ -641,7 +785,7 @@ static void putSFP(SFLReceiver *receiver, SFLSFP_counters *sfp) {
 static int computeFlowSampleSize(SFLReceiver *receiver, SFL_FLOW_SAMPLE_TYPE *fs)
 {
   SFLFlow_sample_element *elem;
-  uint32_t elemSiz;
+  int elemSiz;
 #ifdef SFL_USE_32BIT_INDEX
   uint siz = 52; /* tag, length, sequence_number, ds_class, ds_index, sampling_rate,
 		     sample_pool, drops, inputFormat, input, outputFormat, output, number of elements */
@@ -654,50 +798,8 @@ static int computeFlowSampleSize(SFLReceiver *receiver, SFL_FLOW_SAMPLE_TYPE *fs
   for(elem = fs->elements; elem != NULL; elem = elem->nxt) {
     fs->num_elements++;
     siz += 8; /* tag, length */
-    elemSiz = 0;
-    switch(elem->tag) {
-    case SFLFLOW_HEADER:
-      elemSiz = 16; /* header_protocol, frame_length, stripped, header_length */
-      elemSiz += ((elem->flowType.header.header_length + 3) / 4) * 4; /* header, rounded up to nearest 4 bytes */
-      break;
-    case SFLFLOW_ETHERNET: elemSiz = sizeof(SFLSampled_ethernet); break;
-    case SFLFLOW_IPV4: elemSiz = sizeof(SFLSampled_ipv4); break;
-    case SFLFLOW_IPV6: elemSiz = sizeof(SFLSampled_ipv6); break;
-    case SFLFLOW_EX_SWITCH: elemSiz = sizeof(SFLExtended_switch); break;
-    case SFLFLOW_EX_ROUTER: elemSiz = routerEncodingLength(&elem->flowType.router); break;
-    case SFLFLOW_EX_GATEWAY: elemSiz = gatewayEncodingLength(&elem->flowType.gateway); break;
-    case SFLFLOW_EX_USER: elemSiz = userEncodingLength(&elem->flowType.user); break;
-    case SFLFLOW_EX_URL: elemSiz = urlEncodingLength(&elem->flowType.url); break;
-    case SFLFLOW_EX_MPLS: elemSiz = mplsEncodingLength(&elem->flowType.mpls); break;
-    case SFLFLOW_EX_NAT: elemSiz = natEncodingLength(&elem->flowType.nat); break;
-    case SFLFLOW_EX_MPLS_TUNNEL: elemSiz = mplsTunnelEncodingLength(&elem->flowType.mpls_tunnel); break;
-    case SFLFLOW_EX_MPLS_VC: elemSiz = mplsVcEncodingLength(&elem->flowType.mpls_vc); break;
-    case SFLFLOW_EX_MPLS_FTN: elemSiz = mplsFtnEncodingLength(&elem->flowType.mpls_ftn); break;
-    case SFLFLOW_EX_MPLS_LDP_FEC: elemSiz = mplsLdpFecEncodingLength(&elem->flowType.mpls_ldp_fec); break;
-    case SFLFLOW_EX_VLAN_TUNNEL: elemSiz = vlanTunnelEncodingLength(&elem->flowType.vlan_tunnel); break;
-	case SFLFLOW_EX_L2_TUNNEL_EGRESS:
-	case SFLFLOW_EX_L2_TUNNEL_INGRESS: elemSiz = sizeof(SFLExtended_l2_tunnel); break;
-	case SFLFLOW_EX_IPV4_TUNNEL_EGRESS:
-	case SFLFLOW_EX_IPV4_TUNNEL_INGRESS: elemSiz = sizeof(SFLExtended_ipv4_tunnel); break;
-	case SFLFLOW_EX_DECAP_EGRESS:
-	case SFLFLOW_EX_DECAP_INGRESS: elemSiz = tunnelDecapEncodingLength(&elem->flowType.tunnel_decap); break;
-	case SFLFLOW_EX_VNI_EGRESS:
-	case SFLFLOW_EX_VNI_INGRESS: elemSiz = tunnelVniEncodingLength(&elem->flowType.tunnel_vni); break;
-    case SFLFLOW_APP: elemSiz = appEncodingLength(&elem->flowType.app); break;
-    case SFLFLOW_APP_CTXT: elemSiz = appContextLength(&elem->flowType.context); break;
-    case SFLFLOW_APP_ACTOR_INIT:
-    case SFLFLOW_APP_ACTOR_TGT: elemSiz = stringEncodingLength(&elem->flowType.actor.actor); break;
-    case SFLFLOW_EX_PROXY_SOCKET4:
-    case SFLFLOW_EX_SOCKET4: elemSiz = XDRSIZ_SFLEXTENDED_SOCKET4;  break;
-    case SFLFLOW_EX_PROXY_SOCKET6:
-    case SFLFLOW_EX_SOCKET6: elemSiz = XDRSIZ_SFLEXTENDED_SOCKET6;  break;
-    case SFLFLOW_EX_TCP_INFO: elemSiz = XDRSIZ_SFLEXTENDED_TCP_INFO;  break;
-    case SFLFLOW_EX_ENTITIES: elemSiz = XDRSIZ_SFLEXTENDED_ENTITIES; break;
-    default:
-      sflError(receiver, "unexpected packet_data_tag");
+    if((elemSiz = flowElementEncodingLength(receiver, elem)) == -1)
       return -1;
-      break;
-    }
     // cache the element size, and accumulate it into the overall FlowSample size
     elem->length = elemSiz;
     siz += elemSiz;
@@ -767,71 +869,8 @@ int sfl_receiver_writeFlowSample(SFLReceiver *receiver, SFL_FLOW_SAMPLE_TYPE *fs
   putNet32(receiver, fs->num_elements);
 
   for(elem = fs->elements; elem != NULL; elem = elem->nxt) {
-
-    putNet32(receiver, elem->tag);
-    putNet32(receiver, elem->length); // length cached in computeFlowSampleSize()
-
-    switch(elem->tag) {
-    case SFLFLOW_HEADER:
-    putNet32(receiver, elem->flowType.header.header_protocol);
-    putNet32(receiver, elem->flowType.header.frame_length);
-    putNet32(receiver, elem->flowType.header.stripped);
-    putNet32(receiver, elem->flowType.header.header_length);
-    /* the header */
-    memcpy(receiver->sampleCollector.datap, elem->flowType.header.header_bytes, elem->flowType.header.header_length);
-    /* round up to multiple of 4 to preserve alignment */
-    receiver->sampleCollector.datap += ((elem->flowType.header.header_length + 3) / 4);
-      break;
-	case SFLFLOW_ETHERNET: putSampledEthernet(receiver, &elem->flowType.ethernet); break;
-	case SFLFLOW_IPV4: putSampledIPv4(receiver, &elem->flowType.ipv4); break;
-	case SFLFLOW_IPV6: putSampledIPv6(receiver, &elem->flowType.ipv6); break;
-    case SFLFLOW_EX_SWITCH: putSwitch(receiver, &elem->flowType.sw); break;
-    case SFLFLOW_EX_ROUTER: putRouter(receiver, &elem->flowType.router); break;
-    case SFLFLOW_EX_GATEWAY: putGateway(receiver, &elem->flowType.gateway); break;
-    case SFLFLOW_EX_USER: putUser(receiver, &elem->flowType.user); break;
-    case SFLFLOW_EX_URL: putUrl(receiver, &elem->flowType.url); break;
-    case SFLFLOW_EX_MPLS: putMpls(receiver, &elem->flowType.mpls); break;
-    case SFLFLOW_EX_NAT: putNat(receiver, &elem->flowType.nat); break;
-    case SFLFLOW_EX_MPLS_TUNNEL: putMplsTunnel(receiver, &elem->flowType.mpls_tunnel); break;
-    case SFLFLOW_EX_MPLS_VC: putMplsVc(receiver, &elem->flowType.mpls_vc); break;
-    case SFLFLOW_EX_MPLS_FTN: putMplsFtn(receiver, &elem->flowType.mpls_ftn); break;
-    case SFLFLOW_EX_MPLS_LDP_FEC: putMplsLdpFec(receiver, &elem->flowType.mpls_ldp_fec); break;
-    case SFLFLOW_EX_VLAN_TUNNEL: putVlanTunnel(receiver, &elem->flowType.vlan_tunnel); break;
-	case SFLFLOW_EX_L2_TUNNEL_EGRESS: 
-	case SFLFLOW_EX_L2_TUNNEL_INGRESS:
-		putSampledEthernet(receiver, &elem->flowType.tunnel_l2.header);
-		break;
-	case SFLFLOW_EX_IPV4_TUNNEL_EGRESS:
-	case SFLFLOW_EX_IPV4_TUNNEL_INGRESS:
-		putSampledIPv4(receiver, &elem->flowType.tunnel_ipv4.header);
-		break;
-	case SFLFLOW_EX_IPV6_TUNNEL_EGRESS:
-	case SFLFLOW_EX_IPV6_TUNNEL_INGRESS:
-		putSampledIPv6(receiver, &elem->flowType.tunnel_ipv6.header);
-		break;
-	case SFLFLOW_EX_DECAP_EGRESS:
-	case SFLFLOW_EX_DECAP_INGRESS:
-		putNet32(receiver, elem->flowType.tunnel_decap.inner_header_offset);
-		break;
-	case SFLFLOW_EX_VNI_EGRESS:
-	case SFLFLOW_EX_VNI_INGRESS:
-		putNet32(receiver, elem->flowType.tunnel_vni.vni);
-		break;
-    case SFLFLOW_APP: putAPP(receiver, &elem->flowType.app); break;
-    case SFLFLOW_APP_CTXT: putAPPContext(receiver, &elem->flowType.context); break;
-    case SFLFLOW_APP_ACTOR_INIT:
-    case SFLFLOW_APP_ACTOR_TGT: putString(receiver, &elem->flowType.actor.actor); break;
-    case SFLFLOW_EX_PROXY_SOCKET4:
-    case SFLFLOW_EX_SOCKET4: putSocket4(receiver, &elem->flowType.socket4); break;
-    case SFLFLOW_EX_PROXY_SOCKET6:
-    case SFLFLOW_EX_SOCKET6: putSocket6(receiver, &elem->flowType.socket6); break;
-    case SFLFLOW_EX_TCP_INFO: putTCPInfo(receiver, &elem->flowType.tcp_info); break;
-    case SFLFLOW_EX_ENTITIES: putEntities(receiver, &elem->flowType.entities); break;
-    default:
-      sflError(receiver, "unexpected packet_data_tag");
+    if(putFlowElement(receiver, elem) == -1)
       return -1;
-      break;
-    }
   }
 
   // sanity check
@@ -851,6 +890,147 @@ int sfl_receiver_writeFlowSample(SFLReceiver *receiver, SFL_FLOW_SAMPLE_TYPE *fs
   return packedSize;
 }
 
+/*_________________-----------------------------__________________
+  _________________ computeDiscardedPacketSize  __________________
+  -----------------_____________________________------------------
+*/
+
+static int computeDiscardedPacketSize(SFLReceiver *receiver, SFLEvent_discarded_packet *es)
+{
+  SFLFlow_sample_element *elem;
+  int elemSiz;
+  uint32_t siz = 40; /* tag, length, sequence_number, ds_class, ds_index,
+			drops, input, output, reason, number of elements */
+
+  es->num_elements = 0;
+  for(elem = es->elements; elem != NULL; elem = elem->nxt) {
+    es->num_elements++;
+    siz += 8; /* tag, length */
+    if((elemSiz = flowElementEncodingLength(receiver, elem)) == -1)
+      return -1;
+    elem->length = elemSiz;
+    siz += elemSiz;
+  }
+  return siz;
+}
+
+/*_________________-----------------------------------------__________________
+  _________________ sfl_receiver_writeEventDiscardedPacket  __________________
+  -----------------_________________________________________------------------
+*/
+
+int sfl_receiver_writeEventDiscardedPacket(SFLReceiver *receiver, SFLEvent_discarded_packet *es)
+{
+  int packedSize;
+  SFLFlow_sample_element *elem;
+
+  if(es == NULL) return -1;
+  if((packedSize = computeDiscardedPacketSize(receiver, es)) == -1) return -1;
+
+  if(packedSize > (int)(receiver->sFlowRcvrMaximumDatagramSize)) {
+    sflError(receiver, "discarded packet event too big for datagram");
+    return -1;
+  }
+
+  if((receiver->sampleCollector.pktlen + packedSize) >= receiver->sFlowRcvrMaximumDatagramSize)
+    sendSample(receiver);
+
+  receiver->sampleCollector.numSamples++;
+
+  putNet32(receiver, SFLEVENT_DISCARDED_PACKET);
+  putNet32(receiver, packedSize - 8); // don't include tag and len
+  putNet32(receiver, es->sequence_number);
+  putNet32(receiver, es->ds_class);
+  putNet32(receiver, es->ds_index);
+  putNet32(receiver, es->drops);
+  putNet32(receiver, es->input);
+  putNet32(receiver, es->output);
+  putNet32(receiver, es->reason);
+  putNet32(receiver, es->num_elements);
+
+  for(elem = es->elements; elem != NULL; elem = elem->nxt) {
+    if(putFlowElement(receiver, elem) == -1)
+      return -1;
+  }
+
+  // sanity check
+  assert(((u_char *)receiver->sampleCollector.datap
+	  - (u_char *)receiver->sampleCollector.data
+	  - receiver->sampleCollector.pktlen)  == (uint32_t)packedSize);
+
+  // update the pktlen
+  receiver->sampleCollector.pktlen = (uint32_t)((u_char *)receiver->sampleCollector.datap - (u_char *)receiver->sampleCollector.data);
+
+  if((receiver->sampleCollector.pktlen + packedSize) >= receiver->sFlowRcvrMaximumDatagramSize)
+    sendSample(receiver);
+
+  return packedSize;
+}
+
+/*_________________-----------------------------------__________________
+  _________________ countersElementEncodingLength     __________________
+  -----------------___________________________________------------------
+*/
+
+static int countersElementEncodingLength(SFLReceiver *receiver, SFLCounters_sample_element *elem)
+{
+  int elemSiz = 0;
+  /* here we are assuming that the structure fields are not expanded to be 64-bit aligned,
+     because then the sizeof(struct) would be larger than the wire-encoding. */
+  switch(elem->tag) {
+  case SFLCOUNTERS_GENERIC:  elemSiz = sizeof(elem->counterBlock.generic); break;
+  case SFLCOUNTERS_ETHERNET: elemSiz = sizeof(elem->counterBlock.ethernet); break;
+  case SFLCOUNTERS_TOKENRING: elemSiz = sizeof(elem->counterBlock.tokenring); break;
+  case SFLCOUNTERS_VG: elemSiz = sizeof(elem->counterBlock.vg); break;
+  case SFLCOUNTERS_VLAN: elemSiz = sizeof(elem->counterBlock.vlan); break;
+  case SFLCOUNTERS_LACP: elemSiz = XDRSIZ_LACP_COUNTERS; break;
+  case SFLCOUNTERS_SFP: elemSiz = sfpEncodingLength(&elem->counterBlock.sfp); break;
+  case SFLCOUNTERS_PROCESSOR: elemSiz = sizeof(elem->counterBlock.processor);  break;
+  case SFLCOUNTERS_HOST_HID: elemSiz = hostIdEncodingLength(&elem->counterBlock.host_hid);  break;
+  case SFLCOUNTERS_HOST_PAR: elemSiz = 8 /*sizeof(elem->counterBlock.host_par)*/;  break;
+  case SFLCOUNTERS_ADAPTORS: elemSiz = adaptorListEncodingLength(elem->counterBlock.adaptors);  break;
+  case SFLCOUNTERS_HOST_CPU: elemSiz = 80 /*sizeof(elem->counterBlock.host_cpu)*/;  break;
+  case SFLCOUNTERS_HOST_MEM: elemSiz = 72 /*sizeof(elem->counterBlock.host_mem)*/ ;  break;
+  case SFLCOUNTERS_HOST_DSK: elemSiz = 52 /*sizeof(elem->counterBlock.host_dsk)*/;  break;
+  case SFLCOUNTERS_HOST_NIO: elemSiz = 40 /*sizeof(elem->counterBlock.host_nio)*/;  break;
+  case SFLCOUNTERS_HOST_IP: elemSiz = XDRSIZ_IP_COUNTERS;  break;
+  case SFLCOUNTERS_HOST_ICMP: elemSiz = XDRSIZ_ICMP_COUNTERS;  break;
+  case SFLCOUNTERS_HOST_TCP: elemSiz = XDRSIZ_TCP_COUNTERS;  break;
+  case SFLCOUNTERS_HOST_UDP: elemSiz = XDRSIZ_UDP_COUNTERS;  break;
+  case SFLCOUNTERS_HOST_VRT_NODE: elemSiz = 28 /*sizeof(elem->counterBlock.host_vrt_node)*/;  break;
+  case SFLCOUNTERS_HOST_VRT_CPU: elemSiz = 12 /*sizeof(elem->counterBlock.host_vrt_cpu)*/;  break;
+  case SFLCOUNTERS_HOST_VRT_MEM: elemSiz = 16 /*sizeof(elem->counterBlock.host_vrt_mem)*/;  break;
+  case SFLCOUNTERS_HOST_VRT_DSK: elemSiz = 52 /*sizeof(elem->counterBlock.host_vrt_dsk)*/;  break;
+  case SFLCOUNTERS_HOST_VRT_NIO: elemSiz = 40 /*sizeof(elem->counterBlock.host_vrt_nio)*/;  break;
+  case SFLCOUNTERS_HOST_GPU_NVML: elemSiz = 48 /*sizeof(elem->counterBlock.host_gpu_nvml)*/;  break;
+  case SFLCOUNTERS_APP:  elemSiz = appCountersEncodingLength(&elem->counterBlock.app); break;
+  case SFLCOUNTERS_APP_RESOURCES:  elemSiz = appResourcesEncodingLength(&elem->counterBlock.appResources); break;
+  case SFLCOUNTERS_APP_WORKERS:  elemSiz = appWorkersEncodingLength(&elem->counterBlock.appWorkers); break;
+  case SFLCOUNTERS_PORTNAME:  elemSiz = stringEncodingLength(&elem->counterBlock.portName.portName); break;
+  case SFLCOUNTERS_BCM_TABLES: elemSiz = XDRSIZ_BCM_TABLES;  break;
+  case SFLCOUNTERS_ENCODED:
+    if(elem->counterBlock.encoded.xdr == NULL
+       || elem->counterBlock.encoded.len < 8
+       || (elem->counterBlock.encoded.len & 3)) {
+      char errm[128];
+      sprintf(errm, "computeCounterSampleSize(): bad pre-encoded counters length (%u)", elem->counterBlock.encoded.len);
+      sflError(receiver, errm);
+      return -1;
+    }
+    elemSiz = elem->counterBlock.encoded.len - 8; /* tag and length already in the XDR */
+    break;
+  default:
+    {
+      char errm[128];
+      sprintf(errm, "computeCounterSampleSize(): unexpected counters tag (%u)", elem->tag);
+      sflError(receiver, errm);
+      return -1;
+    }
+    break;
+  }
+  return elemSiz;
+}
+
 /*_________________-----------------------------__________________
   _________________ computeCountersSampleSize   __________________
   -----------------_____________________________------------------
@@ -859,7 +1039,7 @@ int sfl_receiver_writeFlowSample(SFLReceiver *receiver, SFL_FLOW_SAMPLE_TYPE *fs
 static int computeCountersSampleSize(SFLReceiver *receiver, SFL_COUNTERS_SAMPLE_TYPE *cs)
 {
   SFLCounters_sample_element *elem;
-  uint32_t elemSiz;
+  int elemSiz;
 
 #ifdef SFL_USE_32BIT_INDEX
   uint siz = 24; /* tag, length, sequence_number, ds_class, ds_index, number of elements */
@@ -871,50 +1051,7 @@ static int computeCountersSampleSize(SFLReceiver *receiver, SFL_COUNTERS_SAMPLE_
   for( elem = cs->elements; elem != NULL; elem = elem->nxt) {
     cs->num_elements++;
     siz += 8; /* tag, length */
-    elemSiz = 0;
-    /* here we are assuming that the structure fields are not expanded to be 64-bit aligned,
-       because then the sizeof(struct) would be larger than the wire-encoding. */
-
-    switch(elem->tag) {
-    case SFLCOUNTERS_GENERIC:  elemSiz = sizeof(elem->counterBlock.generic); break;
-    case SFLCOUNTERS_ETHERNET: elemSiz = sizeof(elem->counterBlock.ethernet); break;
-    case SFLCOUNTERS_TOKENRING: elemSiz = sizeof(elem->counterBlock.tokenring); break;
-    case SFLCOUNTERS_VG: elemSiz = sizeof(elem->counterBlock.vg); break;
-    case SFLCOUNTERS_VLAN: elemSiz = sizeof(elem->counterBlock.vlan); break;
-    case SFLCOUNTERS_LACP: elemSiz = XDRSIZ_LACP_COUNTERS; break;
-    case SFLCOUNTERS_SFP: elemSiz = sfpEncodingLength(&elem->counterBlock.sfp); break;
-    case SFLCOUNTERS_PROCESSOR: elemSiz = sizeof(elem->counterBlock.processor);  break;
-    case SFLCOUNTERS_HOST_HID: elemSiz = hostIdEncodingLength(&elem->counterBlock.host_hid);  break;
-    case SFLCOUNTERS_HOST_PAR: elemSiz = 8 /*sizeof(elem->counterBlock.host_par)*/;  break;
-    case SFLCOUNTERS_ADAPTORS: elemSiz = adaptorListEncodingLength(elem->counterBlock.adaptors);  break;
-    case SFLCOUNTERS_HOST_CPU: elemSiz = 80 /*sizeof(elem->counterBlock.host_cpu)*/;  break;
-    case SFLCOUNTERS_HOST_MEM: elemSiz = 72 /*sizeof(elem->counterBlock.host_mem)*/ ;  break;
-    case SFLCOUNTERS_HOST_DSK: elemSiz = 52 /*sizeof(elem->counterBlock.host_dsk)*/;  break;
-    case SFLCOUNTERS_HOST_NIO: elemSiz = 40 /*sizeof(elem->counterBlock.host_nio)*/;  break;
-    case SFLCOUNTERS_HOST_IP: elemSiz = XDRSIZ_IP_COUNTERS;  break;
-    case SFLCOUNTERS_HOST_ICMP: elemSiz = XDRSIZ_ICMP_COUNTERS;  break;
-    case SFLCOUNTERS_HOST_TCP: elemSiz = XDRSIZ_TCP_COUNTERS;  break;
-    case SFLCOUNTERS_HOST_UDP: elemSiz = XDRSIZ_UDP_COUNTERS;  break;
-    case SFLCOUNTERS_HOST_VRT_NODE: elemSiz = 28 /*sizeof(elem->counterBlock.host_vrt_node)*/;  break;
-    case SFLCOUNTERS_HOST_VRT_CPU: elemSiz = 12 /*sizeof(elem->counterBlock.host_vrt_cpu)*/;  break;
-    case SFLCOUNTERS_HOST_VRT_MEM: elemSiz = 16 /*sizeof(elem->counterBlock.host_vrt_mem)*/;  break;
-    case SFLCOUNTERS_HOST_VRT_DSK: elemSiz = 52 /*sizeof(elem->counterBlock.host_vrt_dsk)*/;  break;
-    case SFLCOUNTERS_HOST_VRT_NIO: elemSiz = 40 /*sizeof(elem->counterBlock.host_vrt_nio)*/;  break;
-    case SFLCOUNTERS_HOST_GPU_NVML: elemSiz = 48 /*sizeof(elem->counterBlock.host_gpu_nvml)*/;  break;
-    case SFLCOUNTERS_APP:  elemSiz = appCountersEncodingLength(&elem->counterBlock.app); break;
-    case SFLCOUNTERS_APP_RESOURCES:  elemSiz = appResourcesEncodingLength(&elem->counterBlock.appResources); break;
-    case SFLCOUNTERS_APP_WORKERS:  elemSiz = appWorkersEncodingLength(&elem->counterBlock.appWorkers); break;
-    case SFLCOUNTERS_PORTNAME:  elemSiz = stringEncodingLength(&elem->counterBlock.portName.portName); break;
-    case SFLCOUNTERS_BCM_TABLES: elemSiz = XDRSIZ_BCM_TABLES;  break;
-    default:
-      {
-	char errm[128];
-	sprintf(errm, "computeCounterSampleSize(): unexpected counters tag (%u)", elem->tag);
-	sflError(receiver, errm);
-	return -1;
-      }
-      break;
-    }
+    if((elemSiz = countersElementEncodingLength(receiver, elem)) == -1) return -1;
     // cache the element size, and accumulate it into the overall FlowSample size
     elem->length = elemSiz;
     siz += elemSiz;
@@ -922,6 +1059,265 @@ static int computeCountersSampleSize(SFLReceiver *receiver, SFL_COUNTERS_SAMPLE_
   return siz;
 }
 
+/*_________________-----------------------------__________________
+  _________________    putCountersElement       __________________
+  -----------------_____________________________------------------
+*/
+
+static int putCountersElement(SFLReceiver *receiver, SFLCounters_sample_element *elem)
+{
+  if(elem->tag == SFLCOUNTERS_ENCODED) {
+    /* pre-encoded block,  complete with its own tag and length */
+    memcpy(receiver->sampleCollector.datap, elem->counterBlock.encoded.xdr, elem->counterBlock.encoded.len);
+    receiver->sampleCollector.datap += (elem->counterBlock.encoded.len + 3) / 4;
+    return 0;
+  }
+
+  putNet32(receiver, elem->tag);
+  putNet32(receiver, elem->length); // length cached in countersElementEncodingLength()
+  
+  switch(elem->tag) {
+  case SFLCOUNTERS_GENERIC:
+    putGenericCounters(receiver, &(elem->counterBlock.generic));
+    break;
+  case SFLCOUNTERS_ETHERNET:
+    // all these counters are 32-bit
+    putNet32_run(receiver, &elem->counterBlock.ethernet, sizeof(elem->counterBlock.ethernet) / 4);
+    break;
+  case SFLCOUNTERS_TOKENRING:
+    // all these counters are 32-bit
+    putNet32_run(receiver, &elem->counterBlock.tokenring, sizeof(elem->counterBlock.tokenring) / 4);
+    break;
+  case SFLCOUNTERS_VG:
+    putNet32(receiver, elem->counterBlock.vg.dot12InHighPriorityFrames);
+    putNet64(receiver, elem->counterBlock.vg.dot12InHighPriorityOctets);
+    putNet32(receiver, elem->counterBlock.vg.dot12InNormPriorityFrames);
+    putNet64(receiver, elem->counterBlock.vg.dot12InNormPriorityOctets);
+    putNet32(receiver, elem->counterBlock.vg.dot12InIPMErrors);
+    putNet32(receiver, elem->counterBlock.vg.dot12InOversizeFrameErrors);
+    putNet32(receiver, elem->counterBlock.vg.dot12InDataErrors);
+    putNet32(receiver, elem->counterBlock.vg.dot12InNullAddressedFrames);
+    putNet32(receiver, elem->counterBlock.vg.dot12OutHighPriorityFrames);
+    putNet64(receiver, elem->counterBlock.vg.dot12OutHighPriorityOctets);
+    putNet32(receiver, elem->counterBlock.vg.dot12TransitionIntoTrainings);
+    putNet64(receiver, elem->counterBlock.vg.dot12HCInHighPriorityOctets);
+    putNet64(receiver, elem->counterBlock.vg.dot12HCInNormPriorityOctets);
+    putNet64(receiver, elem->counterBlock.vg.dot12HCOutHighPriorityOctets);
+    break;
+  case SFLCOUNTERS_VLAN:
+    putNet32(receiver, elem->counterBlock.vlan.vlan_id);
+    putNet64(receiver, elem->counterBlock.vlan.octets);
+    putNet32(receiver, elem->counterBlock.vlan.ucastPkts);
+    putNet32(receiver, elem->counterBlock.vlan.multicastPkts);
+    putNet32(receiver, elem->counterBlock.vlan.broadcastPkts);
+    putNet32(receiver, elem->counterBlock.vlan.discards);
+    break;
+  case SFLCOUNTERS_LACP:
+    putMACAddress(receiver, elem->counterBlock.lacp.actorSystemID);
+    putMACAddress(receiver, elem->counterBlock.lacp.partnerSystemID);
+    putNet32(receiver, elem->counterBlock.lacp.attachedAggID);
+    putNet32(receiver, elem->counterBlock.lacp.portState.all);
+    putNet32(receiver, elem->counterBlock.lacp.LACPDUsRx);
+    putNet32(receiver, elem->counterBlock.lacp.markerPDUsRx);
+    putNet32(receiver, elem->counterBlock.lacp.markerResponsePDUsRx);
+    putNet32(receiver, elem->counterBlock.lacp.unknownRx);
+    putNet32(receiver, elem->counterBlock.lacp.illegalRx);
+    putNet32(receiver, elem->counterBlock.lacp.LACPDUsTx);
+    putNet32(receiver, elem->counterBlock.lacp.markerPDUsTx);
+    putNet32(receiver, elem->counterBlock.lacp.markerResponsePDUsTx);
+    break;
+  case SFLCOUNTERS_SFP:
+    putSFP(receiver, &elem->counterBlock.sfp);
+    break;
+  case SFLCOUNTERS_PROCESSOR:
+    putNet32(receiver, elem->counterBlock.processor.five_sec_cpu);
+    putNet32(receiver, elem->counterBlock.processor.one_min_cpu);
+    putNet32(receiver, elem->counterBlock.processor.five_min_cpu);
+    putNet64(receiver, elem->counterBlock.processor.total_memory);
+    putNet64(receiver, elem->counterBlock.processor.free_memory);
+    break;
+  case SFLCOUNTERS_HOST_HID:
+    putString(receiver, &elem->counterBlock.host_hid.hostname);
+    put128(receiver, elem->counterBlock.host_hid.uuid);
+    putNet32(receiver, elem->counterBlock.host_hid.machine_type);
+    putNet32(receiver, elem->counterBlock.host_hid.os_name);
+    putString(receiver, &elem->counterBlock.host_hid.os_release);
+    break;
+  case SFLCOUNTERS_HOST_PAR:
+    putNet32(receiver, elem->counterBlock.host_par.dsClass);
+    putNet32(receiver, elem->counterBlock.host_par.dsIndex);
+    break;
+  case SFLCOUNTERS_ADAPTORS:
+    putAdaptorList(receiver, elem->counterBlock.adaptors);
+    break;
+  case SFLCOUNTERS_HOST_CPU:
+    putNetFloat(receiver, elem->counterBlock.host_cpu.load_one);
+    putNetFloat(receiver, elem->counterBlock.host_cpu.load_five);
+    putNetFloat(receiver, elem->counterBlock.host_cpu.load_fifteen);
+    putNet32(receiver, elem->counterBlock.host_cpu.proc_run);
+    putNet32(receiver, elem->counterBlock.host_cpu.proc_total);
+    putNet32(receiver, elem->counterBlock.host_cpu.cpu_num);
+    putNet32(receiver, elem->counterBlock.host_cpu.cpu_speed);
+    putNet32(receiver, elem->counterBlock.host_cpu.uptime);
+    putNet32(receiver, elem->counterBlock.host_cpu.cpu_user);
+    putNet32(receiver, elem->counterBlock.host_cpu.cpu_nice);
+    putNet32(receiver, elem->counterBlock.host_cpu.cpu_system);
+    putNet32(receiver, elem->counterBlock.host_cpu.cpu_idle);
+    putNet32(receiver, elem->counterBlock.host_cpu.cpu_wio);
+    putNet32(receiver, elem->counterBlock.host_cpu.cpu_intr);
+    putNet32(receiver, elem->counterBlock.host_cpu.cpu_sintr);
+    putNet32(receiver, elem->counterBlock.host_cpu.interrupts);
+    putNet32(receiver, elem->counterBlock.host_cpu.contexts);
+    putNet32(receiver, elem->counterBlock.host_cpu.cpu_steal);
+    putNet32(receiver, elem->counterBlock.host_cpu.cpu_guest);
+    putNet32(receiver, elem->counterBlock.host_cpu.cpu_guest_nice);
+    break;
+  case SFLCOUNTERS_HOST_MEM:
+    putNet64(receiver, elem->counterBlock.host_mem.mem_total);
+    putNet64(receiver, elem->counterBlock.host_mem.mem_free);
+    putNet64(receiver, elem->counterBlock.host_mem.mem_shared);
+    putNet64(receiver, elem->counterBlock.host_mem.mem_buffers);
+    putNet64(receiver, elem->counterBlock.host_mem.mem_cached);
+    putNet64(receiver, elem->counterBlock.host_mem.swap_total);
+    putNet64(receiver, elem->counterBlock.host_mem.swap_free);
+    putNet32(receiver, elem->counterBlock.host_mem.page_in);
+    putNet32(receiver, elem->counterBlock.host_mem.page_out);
+    putNet32(receiver, elem->counterBlock.host_mem.swap_in);
+    putNet32(receiver, elem->counterBlock.host_mem.swap_out);
+    break;
+  case SFLCOUNTERS_HOST_DSK:
+    putNet64(receiver, elem->counterBlock.host_dsk.disk_total);
+    putNet64(receiver, elem->counterBlock.host_dsk.disk_free);
+    putNet32(receiver, elem->counterBlock.host_dsk.part_max_used);
+    putNet32(receiver, elem->counterBlock.host_dsk.reads);
+    putNet64(receiver, elem->counterBlock.host_dsk.bytes_read);
+    putNet32(receiver, elem->counterBlock.host_dsk.read_time);
+    putNet32(receiver, elem->counterBlock.host_dsk.writes);
+    putNet64(receiver, elem->counterBlock.host_dsk.bytes_written);
+    putNet32(receiver, elem->counterBlock.host_dsk.write_time);
+    break;
+  case SFLCOUNTERS_HOST_NIO:
+    putNet64(receiver, elem->counterBlock.host_nio.bytes_in);
+    putNet32(receiver, elem->counterBlock.host_nio.pkts_in);
+    putNet32(receiver, elem->counterBlock.host_nio.errs_in);
+    putNet32(receiver, elem->counterBlock.host_nio.drops_in);
+    putNet64(receiver, elem->counterBlock.host_nio.bytes_out);
+    putNet32(receiver, elem->counterBlock.host_nio.pkts_out);
+    putNet32(receiver, elem->counterBlock.host_nio.errs_out);
+    putNet32(receiver, elem->counterBlock.host_nio.drops_out);
+    break;
+  case SFLCOUNTERS_HOST_VRT_NODE:
+    putNet32(receiver, elem->counterBlock.host_vrt_node.mhz);
+    putNet32(receiver, elem->counterBlock.host_vrt_node.cpus);
+    putNet64(receiver, elem->counterBlock.host_vrt_node.memory);
+    putNet64(receiver, elem->counterBlock.host_vrt_node.memory_free);
+    putNet32(receiver, elem->counterBlock.host_vrt_node.num_domains);
+    break;
+  case SFLCOUNTERS_HOST_VRT_CPU:
+    putNet32(receiver, elem->counterBlock.host_vrt_cpu.state);
+    putNet32(receiver, elem->counterBlock.host_vrt_cpu.cpuTime);
+    putNet32(receiver, elem->counterBlock.host_vrt_cpu.nrVirtCpu);
+    break;
+  case SFLCOUNTERS_HOST_VRT_MEM:
+    putNet64(receiver, elem->counterBlock.host_vrt_mem.memory);
+    putNet64(receiver, elem->counterBlock.host_vrt_mem.maxMemory);
+    break;
+  case SFLCOUNTERS_HOST_VRT_DSK:
+    putNet64(receiver, elem->counterBlock.host_vrt_dsk.capacity);
+    putNet64(receiver, elem->counterBlock.host_vrt_dsk.allocation);
+    putNet64(receiver, elem->counterBlock.host_vrt_dsk.available);
+    putNet32(receiver, elem->counterBlock.host_vrt_dsk.rd_req);
+    putNet64(receiver, elem->counterBlock.host_vrt_dsk.rd_bytes);
+    putNet32(receiver, elem->counterBlock.host_vrt_dsk.wr_req);
+    putNet64(receiver, elem->counterBlock.host_vrt_dsk.wr_bytes);
+    putNet32(receiver, elem->counterBlock.host_vrt_dsk.errs);
+    break;
+  case SFLCOUNTERS_HOST_VRT_NIO:
+    putNet64(receiver, elem->counterBlock.host_vrt_nio.bytes_in);
+    putNet32(receiver, elem->counterBlock.host_vrt_nio.pkts_in);
+    putNet32(receiver, elem->counterBlock.host_vrt_nio.errs_in);
+    putNet32(receiver, elem->counterBlock.host_vrt_nio.drops_in);
+    putNet64(receiver, elem->counterBlock.host_vrt_nio.bytes_out);
+    putNet32(receiver, elem->counterBlock.host_vrt_nio.pkts_out);
+    putNet32(receiver, elem->counterBlock.host_vrt_nio.errs_out);
+    putNet32(receiver, elem->counterBlock.host_vrt_nio.drops_out);
+    break; 
+  case SFLCOUNTERS_HOST_GPU_NVML:
+    putNet32(receiver, elem->counterBlock.host_gpu_nvml.device_count);
+    putNet32(receiver, elem->counterBlock.host_gpu_nvml.processes);
+    putNet32(receiver, elem->counterBlock.host_gpu_nvml.gpu_time);
+    putNet32(receiver, elem->counterBlock.host_gpu_nvml.mem_time);
+    putNet64(receiver, elem->counterBlock.host_gpu_nvml.mem_total);
+    putNet64(receiver, elem->counterBlock.host_gpu_nvml.mem_free);
+    putNet32(receiver, elem->counterBlock.host_gpu_nvml.ecc_errors);
+    putNet32(receiver, elem->counterBlock.host_gpu_nvml.energy);
+    putNet32(receiver, elem->counterBlock.host_gpu_nvml.temperature);
+    putNet32(receiver, elem->counterBlock.host_gpu_nvml.fan_speed);
+    break;
+
+  case SFLCOUNTERS_HOST_IP:
+    putNet32_run(receiver, &elem->counterBlock.host_ip, XDRSIZ_IP_COUNTERS / 4);
+    break;
+  case SFLCOUNTERS_HOST_ICMP:
+    putNet32_run(receiver, &elem->counterBlock.host_icmp, XDRSIZ_ICMP_COUNTERS / 4);
+    break;
+  case SFLCOUNTERS_HOST_TCP:
+    putNet32_run(receiver, &elem->counterBlock.host_tcp, XDRSIZ_TCP_COUNTERS / 4);
+    break;
+  case SFLCOUNTERS_HOST_UDP:
+    putNet32_run(receiver, &elem->counterBlock.host_udp, XDRSIZ_UDP_COUNTERS / 4);
+    break;
+
+  case SFLCOUNTERS_APP:
+    putString(receiver, &elem->counterBlock.app.application);
+    putNet32(receiver, elem->counterBlock.app.status_OK);
+    putNet32(receiver, elem->counterBlock.app.errors_OTHER);
+    putNet32(receiver, elem->counterBlock.app.errors_TIMEOUT);
+    putNet32(receiver, elem->counterBlock.app.errors_INTERNAL_ERROR);
+    putNet32(receiver, elem->counterBlock.app.errors_BAD_REQUEST);
+    putNet32(receiver, elem->counterBlock.app.errors_FORBIDDEN);
+    putNet32(receiver, elem->counterBlock.app.errors_TOO_LARGE);
+    putNet32(receiver, elem->counterBlock.app.errors_NOT_IMPLEMENTED);
+    putNet32(receiver, elem->counterBlock.app.errors_NOT_FOUND);
+    putNet32(receiver, elem->counterBlock.app.errors_UNAVAILABLE);
+    putNet32(receiver, elem->counterBlock.app.errors_UNAUTHORIZED);
+    break; 
+  case SFLCOUNTERS_APP_RESOURCES:
+    putNet32(receiver, elem->counterBlock.appResources.user_time);
+    putNet32(receiver, elem->counterBlock.appResources.system_time);
+    putNet64(receiver, elem->counterBlock.appResources.mem_used);
+    putNet64(receiver, elem->counterBlock.appResources.mem_max);
+    putNet32(receiver, elem->counterBlock.appResources.fd_open);
+    putNet32(receiver, elem->counterBlock.appResources.fd_max);
+    putNet32(receiver, elem->counterBlock.appResources.conn_open);
+    putNet32(receiver, elem->counterBlock.appResources.conn_max);
+    break;
+  case SFLCOUNTERS_APP_WORKERS:
+    putNet32(receiver, elem->counterBlock.appWorkers.workers_active);
+    putNet32(receiver, elem->counterBlock.appWorkers.workers_idle);
+    putNet32(receiver, elem->counterBlock.appWorkers.workers_max);
+    putNet32(receiver, elem->counterBlock.appWorkers.req_delayed);
+    putNet32(receiver, elem->counterBlock.appWorkers.req_dropped);
+    break;
+  case SFLCOUNTERS_PORTNAME: 
+    putString(receiver, &elem->counterBlock.portName.portName);
+    break;
+  case SFLCOUNTERS_BCM_TABLES:
+    putNet32_run(receiver, &elem->counterBlock.bcm_tables, XDRSIZ_BCM_TABLES / 4);
+    break;
+
+  default:
+    {
+      char errm[128];
+      sprintf(errm, "unexpected counters tag (%u)", elem->tag);
+      sflError(receiver, errm);
+      return -1;
+    }
+    break;
+  }
+  return 0;
+}
+
 /*_________________----------------------------------__________________
   _________________ sfl_receiver_writeCountersSample __________________
   -----------------__________________________________------------------
@@ -969,249 +1365,7 @@ int sfl_receiver_writeCountersSample(SFLReceiver *receiver, SFL_COUNTERS_SAMPLE_
   putNet32(receiver, cs->num_elements);
   
   for(elem = cs->elements; elem != NULL; elem = elem->nxt) {
-    
-    putNet32(receiver, elem->tag);
-    putNet32(receiver, elem->length); // length cached in computeCountersSampleSize()
-    
-    switch(elem->tag) {
-    case SFLCOUNTERS_GENERIC:
-      putGenericCounters(receiver, &(elem->counterBlock.generic));
-      break;
-    case SFLCOUNTERS_ETHERNET:
-      // all these counters are 32-bit
-      putNet32_run(receiver, &elem->counterBlock.ethernet, sizeof(elem->counterBlock.ethernet) / 4);
-      break;
-    case SFLCOUNTERS_TOKENRING:
-      // all these counters are 32-bit
-      putNet32_run(receiver, &elem->counterBlock.tokenring, sizeof(elem->counterBlock.tokenring) / 4);
-      break;
-    case SFLCOUNTERS_VG:
-      putNet32(receiver, elem->counterBlock.vg.dot12InHighPriorityFrames);
-      putNet64(receiver, elem->counterBlock.vg.dot12InHighPriorityOctets);
-      putNet32(receiver, elem->counterBlock.vg.dot12InNormPriorityFrames);
-      putNet64(receiver, elem->counterBlock.vg.dot12InNormPriorityOctets);
-      putNet32(receiver, elem->counterBlock.vg.dot12InIPMErrors);
-      putNet32(receiver, elem->counterBlock.vg.dot12InOversizeFrameErrors);
-      putNet32(receiver, elem->counterBlock.vg.dot12InDataErrors);
-      putNet32(receiver, elem->counterBlock.vg.dot12InNullAddressedFrames);
-      putNet32(receiver, elem->counterBlock.vg.dot12OutHighPriorityFrames);
-      putNet64(receiver, elem->counterBlock.vg.dot12OutHighPriorityOctets);
-      putNet32(receiver, elem->counterBlock.vg.dot12TransitionIntoTrainings);
-      putNet64(receiver, elem->counterBlock.vg.dot12HCInHighPriorityOctets);
-      putNet64(receiver, elem->counterBlock.vg.dot12HCInNormPriorityOctets);
-      putNet64(receiver, elem->counterBlock.vg.dot12HCOutHighPriorityOctets);
-      break;
-    case SFLCOUNTERS_VLAN:
-      putNet32(receiver, elem->counterBlock.vlan.vlan_id);
-      putNet64(receiver, elem->counterBlock.vlan.octets);
-      putNet32(receiver, elem->counterBlock.vlan.ucastPkts);
-      putNet32(receiver, elem->counterBlock.vlan.multicastPkts);
-      putNet32(receiver, elem->counterBlock.vlan.broadcastPkts);
-      putNet32(receiver, elem->counterBlock.vlan.discards);
-      break;
-    case SFLCOUNTERS_LACP:
-      putMACAddress(receiver, elem->counterBlock.lacp.actorSystemID);
-      putMACAddress(receiver, elem->counterBlock.lacp.partnerSystemID);
-      putNet32(receiver, elem->counterBlock.lacp.attachedAggID);
-      putNet32(receiver, elem->counterBlock.lacp.portState.all);
-      putNet32(receiver, elem->counterBlock.lacp.LACPDUsRx);
-      putNet32(receiver, elem->counterBlock.lacp.markerPDUsRx);
-      putNet32(receiver, elem->counterBlock.lacp.markerResponsePDUsRx);
-      putNet32(receiver, elem->counterBlock.lacp.unknownRx);
-      putNet32(receiver, elem->counterBlock.lacp.illegalRx);
-      putNet32(receiver, elem->counterBlock.lacp.LACPDUsTx);
-      putNet32(receiver, elem->counterBlock.lacp.markerPDUsTx);
-      putNet32(receiver, elem->counterBlock.lacp.markerResponsePDUsTx);
-      break;
-    case SFLCOUNTERS_SFP:
-      putSFP(receiver, &elem->counterBlock.sfp);
-      break;
-    case SFLCOUNTERS_PROCESSOR:
-      putNet32(receiver, elem->counterBlock.processor.five_sec_cpu);
-      putNet32(receiver, elem->counterBlock.processor.one_min_cpu);
-      putNet32(receiver, elem->counterBlock.processor.five_min_cpu);
-      putNet64(receiver, elem->counterBlock.processor.total_memory);
-      putNet64(receiver, elem->counterBlock.processor.free_memory);
-      break;
-    case SFLCOUNTERS_HOST_HID:
-      putString(receiver, &elem->counterBlock.host_hid.hostname);
-      put128(receiver, elem->counterBlock.host_hid.uuid);
-      putNet32(receiver, elem->counterBlock.host_hid.machine_type);
-      putNet32(receiver, elem->counterBlock.host_hid.os_name);
-      putString(receiver, &elem->counterBlock.host_hid.os_release);
-      break;
-    case SFLCOUNTERS_HOST_PAR:
-      putNet32(receiver, elem->counterBlock.host_par.dsClass);
-      putNet32(receiver, elem->counterBlock.host_par.dsIndex);
-      break;
-    case SFLCOUNTERS_ADAPTORS:
-      putAdaptorList(receiver, elem->counterBlock.adaptors);
-      break;
-    case SFLCOUNTERS_HOST_CPU:
-      putNetFloat(receiver, elem->counterBlock.host_cpu.load_one);
-      putNetFloat(receiver, elem->counterBlock.host_cpu.load_five);
-      putNetFloat(receiver, elem->counterBlock.host_cpu.load_fifteen);
-      putNet32(receiver, elem->counterBlock.host_cpu.proc_run);
-      putNet32(receiver, elem->counterBlock.host_cpu.proc_total);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_num);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_speed);
-      putNet32(receiver, elem->counterBlock.host_cpu.uptime);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_user);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_nice);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_system);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_idle);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_wio);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_intr);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_sintr);
-      putNet32(receiver, elem->counterBlock.host_cpu.interrupts);
-      putNet32(receiver, elem->counterBlock.host_cpu.contexts);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_steal);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_guest);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_guest_nice);
-      break;
-    case SFLCOUNTERS_HOST_MEM:
-      putNet64(receiver, elem->counterBlock.host_mem.mem_total);
-      putNet64(receiver, elem->counterBlock.host_mem.mem_free);
-      putNet64(receiver, elem->counterBlock.host_mem.mem_shared);
-      putNet64(receiver, elem->counterBlock.host_mem.mem_buffers);
-      putNet64(receiver, elem->counterBlock.host_mem.mem_cached);
-      putNet64(receiver, elem->counterBlock.host_mem.swap_total);
-      putNet64(receiver, elem->counterBlock.host_mem.swap_free);
-      putNet32(receiver, elem->counterBlock.host_mem.page_in);
-      putNet32(receiver, elem->counterBlock.host_mem.page_out);
-      putNet32(receiver, elem->counterBlock.host_mem.swap_in);
-      putNet32(receiver, elem->counterBlock.host_mem.swap_out);
-      break;
-    case SFLCOUNTERS_HOST_DSK:
-      putNet64(receiver, elem->counterBlock.host_dsk.disk_total);
-      putNet64(receiver, elem->counterBlock.host_dsk.disk_free);
-      putNet32(receiver, elem->counterBlock.host_dsk.part_max_used);
-      putNet32(receiver, elem->counterBlock.host_dsk.reads);
-      putNet64(receiver, elem->counterBlock.host_dsk.bytes_read);
-      putNet32(receiver, elem->counterBlock.host_dsk.read_time);
-      putNet32(receiver, elem->counterBlock.host_dsk.writes);
-      putNet64(receiver, elem->counterBlock.host_dsk.bytes_written);
-      putNet32(receiver, elem->counterBlock.host_dsk.write_time);
-      break;
-    case SFLCOUNTERS_HOST_NIO:
-      putNet64(receiver, elem->counterBlock.host_nio.bytes_in);
-      putNet32(receiver, elem->counterBlock.host_nio.pkts_in);
-      putNet32(receiver, elem->counterBlock.host_nio.errs_in);
-      putNet32(receiver, elem->counterBlock.host_nio.drops_in);
-      putNet64(receiver, elem->counterBlock.host_nio.bytes_out);
-      putNet32(receiver, elem->counterBlock.host_nio.pkts_out);
-      putNet32(receiver, elem->counterBlock.host_nio.errs_out);
-      putNet32(receiver, elem->counterBlock.host_nio.drops_out);
-      break;
-    case SFLCOUNTERS_HOST_VRT_NODE:
-      putNet32(receiver, elem->counterBlock.host_vrt_node.mhz);
-      putNet32(receiver, elem->counterBlock.host_vrt_node.cpus);
-      putNet64(receiver, elem->counterBlock.host_vrt_node.memory);
-      putNet64(receiver, elem->counterBlock.host_vrt_node.memory_free);
-      putNet32(receiver, elem->counterBlock.host_vrt_node.num_domains);
-      break;
-    case SFLCOUNTERS_HOST_VRT_CPU:
-      putNet32(receiver, elem->counterBlock.host_vrt_cpu.state);
-      putNet32(receiver, elem->counterBlock.host_vrt_cpu.cpuTime);
-      putNet32(receiver, elem->counterBlock.host_vrt_cpu.nrVirtCpu);
-      break;
-    case SFLCOUNTERS_HOST_VRT_MEM:
-      putNet64(receiver, elem->counterBlock.host_vrt_mem.memory);
-      putNet64(receiver, elem->counterBlock.host_vrt_mem.maxMemory);
-      break;
-    case SFLCOUNTERS_HOST_VRT_DSK:
-      putNet64(receiver, elem->counterBlock.host_vrt_dsk.capacity);
-      putNet64(receiver, elem->counterBlock.host_vrt_dsk.allocation);
-      putNet64(receiver, elem->counterBlock.host_vrt_dsk.available);
-      putNet32(receiver, elem->counterBlock.host_vrt_dsk.rd_req);
-      putNet64(receiver, elem->counterBlock.host_vrt_dsk.rd_bytes);
-      putNet32(receiver, elem->counterBlock.host_vrt_dsk.wr_req);
-      putNet64(receiver, elem->counterBlock.host_vrt_dsk.wr_bytes);
-      putNet32(receiver, elem->counterBlock.host_vrt_dsk.errs);
-      break;
-    case SFLCOUNTERS_HOST_VRT_NIO:
-      putNet64(receiver, elem->counterBlock.host_vrt_nio.bytes_in);
-      putNet32(receiver, elem->counterBlock.host_vrt_nio.pkts_in);
-      putNet32(receiver, elem->counterBlock.host_vrt_nio.errs_in);
-      putNet32(receiver, elem->counterBlock.host_vrt_nio.drops_in);
-      putNet64(receiver, elem->counterBlock.host_vrt_nio.bytes_out);
-      putNet32(receiver, elem->counterBlock.host_vrt_nio.pkts_out);
-      putNet32(receiver, elem->counterBlock.host_vrt_nio.errs_out);
-      putNet32(receiver, elem->counterBlock.host_vrt_nio.drops_out);
-      break; 
-    case SFLCOUNTERS_HOST_GPU_NVML:
-      putNet32(receiver, elem->counterBlock.host_gpu_nvml.device_count);
-      putNet32(receiver, elem->counterBlock.host_gpu_nvml.processes);
-      putNet32(receiver, elem->counterBlock.host_gpu_nvml.gpu_time);
-      putNet32(receiver, elem->counterBlock.host_gpu_nvml.mem_time);
-      putNet64(receiver, elem->counterBlock.host_gpu_nvml.mem_total);
-      putNet64(receiver, elem->counterBlock.host_gpu_nvml.mem_free);
-      putNet32(receiver, elem->counterBlock.host_gpu_nvml.ecc_errors);
-      putNet32(receiver, elem->counterBlock.host_gpu_nvml.energy);
-      putNet32(receiver, elem->counterBlock.host_gpu_nvml.temperature);
-      putNet32(receiver, elem->counterBlock.host_gpu_nvml.fan_speed);
-      break;
-
-    case SFLCOUNTERS_HOST_IP:
-      putNet32_run(receiver, &elem->counterBlock.host_ip, XDRSIZ_IP_COUNTERS / 4);
-      break;
-    case SFLCOUNTERS_HOST_ICMP:
-      putNet32_run(receiver, &elem->counterBlock.host_icmp, XDRSIZ_ICMP_COUNTERS / 4);
-      break;
-    case SFLCOUNTERS_HOST_TCP:
-      putNet32_run(receiver, &elem->counterBlock.host_tcp, XDRSIZ_TCP_COUNTERS / 4);
-      break;
-    case SFLCOUNTERS_HOST_UDP:
-      putNet32_run(receiver, &elem->counterBlock.host_udp, XDRSIZ_UDP_COUNTERS / 4);
-      break;
-
-    case SFLCOUNTERS_APP:
-      putString(receiver, &elem->counterBlock.app.application);
-      putNet32(receiver, elem->counterBlock.app.status_OK);
-      putNet32(receiver, elem->counterBlock.app.errors_OTHER);
-      putNet32(receiver, elem->counterBlock.app.errors_TIMEOUT);
-      putNet32(receiver, elem->counterBlock.app.errors_INTERNAL_ERROR);
-      putNet32(receiver, elem->counterBlock.app.errors_BAD_REQUEST);
-      putNet32(receiver, elem->counterBlock.app.errors_FORBIDDEN);
-      putNet32(receiver, elem->counterBlock.app.errors_TOO_LARGE);
-      putNet32(receiver, elem->counterBlock.app.errors_NOT_IMPLEMENTED);
-      putNet32(receiver, elem->counterBlock.app.errors_NOT_FOUND);
-      putNet32(receiver, elem->counterBlock.app.errors_UNAVAILABLE);
-      putNet32(receiver, elem->counterBlock.app.errors_UNAUTHORIZED);
-      break; 
-    case SFLCOUNTERS_APP_RESOURCES:
-      putNet32(receiver, elem->counterBlock.appResources.user_time);
-      putNet32(receiver, elem->counterBlock.appResources.system_time);
-      putNet64(receiver, elem->counterBlock.appResources.mem_used);
-      putNet64(receiver, elem->counterBlock.appResources.mem_max);
-      putNet32(receiver, elem->counterBlock.appResources.fd_open);
-      putNet32(receiver, elem->counterBlock.appResources.fd_max);
-      putNet32(receiver, elem->counterBlock.appResources.conn_open);
-      putNet32(receiver, elem->counterBlock.appResources.conn_max);
-      break;
-    case SFLCOUNTERS_APP_WORKERS:
-      putNet32(receiver, elem->counterBlock.appWorkers.workers_active);
-      putNet32(receiver, elem->counterBlock.appWorkers.workers_idle);
-      putNet32(receiver, elem->counterBlock.appWorkers.workers_max);
-      putNet32(receiver, elem->counterBlock.appWorkers.req_delayed);
-      putNet32(receiver, elem->counterBlock.appWorkers.req_dropped);
-      break;
-    case SFLCOUNTERS_PORTNAME: 
-      putString(receiver, &elem->counterBlock.portName.portName);
-      break;
-    case SFLCOUNTERS_BCM_TABLES:
-      putNet32_run(receiver, &elem->counterBlock.bcm_tables, XDRSIZ_BCM_TABLES / 4);
-      break;
-
-    default:
-      {
-	char errm[128];
-	sprintf(errm, "unexpected counters tag (%u)", elem->tag);
-	sflError(receiver, errm);
-	return -1;
-      }
-      break;
-    }
+    if(putCountersElement(receiver, elem) == -1) return -1;
   }
   // sanity check
   assert(((u_char *)receiver->sampleCollector.datap
@@ -1223,6 +1377,34 @@ int sfl_receiver_writeCountersSample(SFLReceiver *receiver, SFL_COUNTERS_SAMPLE_
   return packedSize;
 }
 
+/*_________________-----------------------------------__________________
+  _________________ sfl_receiver_encodeCountersElement __________________
+  -----------------___________________________________------------------
+  Encode one counters block (with its tag and length) into buf,  so
+  that it can be sent again later as an SFLCOUNTERS_ENCODED element.
+  Returns the number of bytes written, or -1 if it did not fit. Uses
+  the receiver's XDR cursor,  so call with the same locking as for
+  sfl_receiver_writeCountersSample().
+*/
+
+int sfl_receiver_encodeCountersElement(SFLReceiver *receiver, SFLCounters_sample_element *elem, uint32_t *buf, int bufLen)
+{
+  int elemSiz = countersElementEncodingLength(receiver, elem);
+  if(elemSiz == -1) return -1;
+  if((elemSiz + 8) > bufLen) return -1;
+  elem->length = elemSiz;
+  uint32_t *datap = receiver->sampleCollector.datap;
+  receiver->sampleCollector.datap = buf;
+  int ans = putCountersElement(receiver, elem);
+  if(ans == 0) {
+    // sanity check
+    assert(((u_char *)receiver->sampleCollector.datap - (u_char *)buf) == (elemSiz + 8));
+    ans = elemSiz + 8;
+  }
+  receiver->sampleCollector.datap = datap;
+  return ans;
+}
+
 /*_________________-------------------------------__________________
   _________________ sfl_receiver_writeEncoded     __________________
   -----------------_______________________________------------------
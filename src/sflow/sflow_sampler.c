@@ -7,6 +7,7 @@ extern "C" {
 #endif
 
 #include "sflow_api.h"
+#include <math.h>
 
 
 /*_________________--------------------------__________________
@@ -33,6 +34,11 @@ void sfl_sampler_init(SFLSampler *sampler, SFLAgent *agent, SFLDataSource_instan
   /* now copy in the parameters */
   sampler->agent = agent;
   sampler->dsi = dsi;
+
+  /* give each sampler its own random sequence */
+  sfl_random_seed(&sampler->rng,
+		  sfl_random_next(NULL),
+		  ((uint64_t)SFL_DS_CLASS(dsi) << 32) | SFL_DS_INDEX(dsi));
   
   /* set defaults */
   sfl_sampler_set_sFlowFsMaximumHeaderSize(sampler, SFL_DEFAULT_HEADER_SIZE);
@@ -74,7 +80,7 @@ uint32_t sfl_sampler_get_sFlowFsPacketSamplingRate(SFLSampler *sampler) {
 void sfl_sampler_set_sFlowFsPacketSamplingRate(SFLSampler *sampler, uint32_t sFlowFsPacketSamplingRate) {
   sampler->sFlowFsPacketSamplingRate = sFlowFsPacketSamplingRate;
   // initialize the skip count too
-  sampler->skip = sfl_random(sFlowFsPacketSamplingRate);
+  sampler->skip = sfl_random_skip(&sampler->rng, sFlowFsPacketSamplingRate);
 }
 
 uint32_t sfl_sampler_get_sFlowFsMaximumHeaderSize(SFLSampler *sampler) {
@@ -158,19 +164,77 @@ void sfl_sampler_writeFlowSample(SFLSampler *sampler, SFL_FLOW_SAMPLE_TYPE *fs)
 /*_________________---------------------------__________________
   _________________     sfl_random            __________________
   -----------------___________________________------------------
-  Gerhard's generator
+  PCG32 (www.pcg-random.org).  This replaces Gerhard's generator,
+  which had a period of only 32749 and was shared by every thread.
+  The global generator is now per-thread, and samplers have their
+  own state.
 */
 
-static uint32_t SFLRandom = 1;
+#if defined(_MSC_VER)
+#define SFL_THREAD_LOCAL __declspec(thread)
+#else
+#define SFL_THREAD_LOCAL __thread
+#endif
+
+static uint64_t SFLRandomSeed = 1;
+static SFL_THREAD_LOCAL SFLRandom SFLRandomThread;
+static SFL_THREAD_LOCAL int SFLRandomThreadSeeded;
+
+void sfl_random_seed(SFLRandom *rng, uint64_t seed, uint64_t stream) {
+  rng->state = 0;
+  rng->inc = (stream << 1) | 1;
+  sfl_random_next(rng);
+  rng->state += seed;
+  sfl_random_next(rng);
+}
+
+/* 32 random bits. Pass NULL to use the per-thread generator. */
+uint32_t sfl_random_next(SFLRandom *rng) {
+  uint64_t old;
+  uint32_t xorshifted, rot;
+  if(rng == NULL) {
+    rng = &SFLRandomThread;
+    if(!SFLRandomThreadSeeded) {
+      /* distinct stream for each thread */
+      sfl_random_seed(rng, SFLRandomSeed, (uint64_t)(size_t)rng);
+      SFLRandomThreadSeeded = 1;
+    }
+  }
+  old = rng->state;
+  rng->state = (old * 6364136223846793005ULL) + rng->inc;
+  xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+  rot = (uint32_t)(old >> 59);
+  return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+/* uniform in 1..lim */
+uint32_t sfl_random_r(SFLRandom *rng, uint32_t lim) {
+  if(lim <= 1) return 1;
+  return (uint32_t)(((uint64_t)sfl_random_next(rng) * lim) >> 32) + 1;
+}
+
+/* Number of packets until the next sample, such that each packet is
+   sampled independently with probability 1/mean.  Drawing the whole
+   gap at once means a sub-sampler can let a run of packets go by
+   without consulting the generator for each one. */
+uint32_t sfl_random_skip(SFLRandom *rng, uint32_t mean) {
+  double u, skip;
+  if(mean <= 1) return 1;
+  /* u in (0,1] */
+  u = ((double)sfl_random_next(rng) + 1.0) / 4294967296.0;
+  skip = floor(log(u) / log1p(-1.0 / (double)mean)) + 1.0;
+  if(skip > 4294967295.0) return 0xFFFFFFFF;
+  return (uint32_t)skip;
+}
 
 uint32_t sfl_random(uint32_t lim) {
-  SFLRandom = ((SFLRandom * 32719) + 3) % 32749;
-  return ((SFLRandom % lim) + 1);
-} 
+  return sfl_random_r(NULL, lim);
+}
 
 void sfl_random_init(uint32_t seed) {
-  SFLRandom = seed;
-} 
+  SFLRandomSeed = seed;
+  SFLRandomThreadSeeded = 0;
+}
 
 /*_________________---------------------------__________________
   _________________  sfl_sampler_takeSample   __________________
@@ -184,7 +248,7 @@ int sfl_sampler_takeSample(SFLSampler *sampler)
 
   if(--sampler->skip == 0) {
     /* reached zero. Set the next skip and return true. */
-    sampler->skip = sfl_random((2 * sampler->sFlowFsPacketSamplingRate) - 1);
+    sampler->skip = sfl_random_skip(&sampler->rng, sampler->sFlowFsPacketSamplingRate);
     return 1;
   }
   return 0;
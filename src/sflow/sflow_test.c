@@ -0,0 +1,455 @@
+/* This software is distributed under the following license:
+ * http://sflow.net/license.html
+ */
+
+/* Checks for the sFlow library that can run without a network.
+   Built and run with "make test".  Exits non-zero on failure. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <arpa/inet.h>
+#include "sflow_api.h"
+
+#define SFL_TEST_DRAWS 1000000
+
+static int failures = 0;
+
+static void check(int ok, const char *what, double got, double want) {
+  printf("%s %s (got %.4f, want %.4f)\n", ok ? "ok  " : "FAIL", what, got, want);
+  if(!ok) failures++;
+}
+
+/*_________________---------------------------__________________
+  _________________   sfl_random_skip         __________________
+  -----------------___________________________------------------
+  The skip is geometric with p = 1/mean,  so over many draws the
+  average should be the mean (stddev of the average is about
+  mean/sqrt(draws),  so 1% is a wide margin) and P(skip == 1)
+  should be p to within 5 standard errors of a binomial proportion,
+  which scales with p however large the mean.  The whole shape is
+  checked with a Kolmogorov-Smirnov test against the geometric CDF
+  1 - (1-p)^k.  It must never return 0.
+*/
+
+/* KS critical value for alpha = 0.001 is 1.95/sqrt(n). It is
+   conservative for a discrete distribution,  which only makes a
+   false failure less likely. */
+#define SFL_TEST_KS_COEFF 1.95
+
+static int cmp_uint32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+/* both CDFs step at the integers,  so compare them after each run
+   of equal values */
+static double ksDistance(uint32_t *skips, int n, double p) {
+  qsort(skips, n, sizeof(uint32_t), cmp_uint32);
+  double logq = log1p(-p);
+  double dmax = 0;
+  for(int ii = 0; ii < n; ii++) {
+    if(ii + 1 < n && skips[ii + 1] == skips[ii])
+      continue;
+    double empirical = (double)(ii + 1) / n;
+    double expected = -expm1(skips[ii] * logq);
+    double d = fabs(empirical - expected);
+    if(d > dmax) dmax = d;
+  }
+  return dmax;
+}
+
+static void test_random_skip(uint32_t mean) {
+  SFLRandom rng;
+  sfl_random_seed(&rng, 0x5EED0000 + mean, 54);
+  uint32_t *skips = calloc(SFL_TEST_DRAWS, sizeof(uint32_t));
+  double sum = 0;
+  uint32_t ones = 0;
+  uint32_t zeros = 0;
+  for(int ii = 0; ii < SFL_TEST_DRAWS; ii++) {
+    uint32_t skip = sfl_random_skip(&rng, mean);
+    skips[ii] = skip;
+    sum += skip;
+    if(skip == 0) zeros++;
+    if(skip == 1) ones++;
+  }
+  char what[64];
+  double avg = sum / SFL_TEST_DRAWS;
+  snprintf(what, sizeof(what), "sfl_random_skip(%u) mean", mean);
+  check(fabs(avg - mean) < (0.01 * mean), what, avg, mean);
+  double pOne = (double)ones / SFL_TEST_DRAWS;
+  double p = 1.0 / mean;
+  double stderrOne = sqrt(p * (1.0 - p) / SFL_TEST_DRAWS);
+  snprintf(what, sizeof(what), "sfl_random_skip(%u) P(1)", mean);
+  check(fabs(pOne - p) < (5 * stderrOne), what, pOne, p);
+  snprintf(what, sizeof(what), "sfl_random_skip(%u) never 0", mean);
+  check(zeros == 0, what, zeros, 0);
+  double ks = ksDistance(skips, SFL_TEST_DRAWS, p);
+  double ksCrit = SFL_TEST_KS_COEFF / sqrt(SFL_TEST_DRAWS);
+  snprintf(what, sizeof(what), "sfl_random_skip(%u) KS distance", mean);
+  check(ks < ksCrit, what, ks, ksCrit);
+  free(skips);
+}
+
+static void test_random_skip_degenerate(void) {
+  SFLRandom rng;
+  sfl_random_seed(&rng, 1, 1);
+  check(sfl_random_skip(&rng, 0) == 1, "sfl_random_skip(0) == 1", sfl_random_skip(&rng, 0), 1);
+  check(sfl_random_skip(&rng, 1) == 1, "sfl_random_skip(1) == 1", sfl_random_skip(&rng, 1), 1);
+}
+
+/*_________________---------------------------__________________
+  _________________   test agent              __________________
+  -----------------___________________________------------------
+  An agent whose sendFn keeps the last datagram,  so the encoders
+  can be checked byte for byte.  Errors are counted,  not logged.
+*/
+
+static u_char lastPkt[SFL_MAX_DATAGRAM_SIZE];
+static uint32_t lastPktLen = 0;
+static int agentErrors = 0;
+
+static void *testAlloc(void *magic, SFLAgent *agent, size_t bytes) {
+  return calloc(1, bytes);
+}
+
+static int testFree(void *magic, SFLAgent *agent, void *obj) {
+  free(obj);
+  return 0;
+}
+
+static void testError(void *magic, SFLAgent *agent, char *msg) {
+  agentErrors++;
+}
+
+static void testSend(void *magic, SFLAgent *agent, SFLReceiver *receiver, u_char *pkt, uint32_t pktLen) {
+  memcpy(lastPkt, pkt, pktLen);
+  lastPktLen = pktLen;
+}
+
+static SFLReceiver *testReceiver(SFLAgent *agent) {
+  SFLAddress myIP = { .type = SFLADDRESSTYPE_IP_V4 };
+  myIP.address.ip_v4.addr = htonl(0x7F000001);
+  sfl_agent_init(agent, &myIP, 0, 0, 0, NULL, testAlloc, testFree, testError, testSend);
+  SFLReceiver *receiver = sfl_agent_addReceiver(agent);
+  sfl_receiver_set_sFlowRcvrOwner(receiver, "test");
+  sfl_receiver_set_sFlowRcvrTimeout(receiver, 0xFFFFFFFF);
+  return receiver;
+}
+
+/* sends one counters sample on its own and returns its element bytes */
+static u_char *countersElements(SFLReceiver *receiver, SFLCounters_sample_element *elem, uint32_t *len) {
+  SFL_COUNTERS_SAMPLE_TYPE cs = { 0 };
+  SFLADD_ELEMENT(&cs, elem);
+  lastPktLen = 0;
+  if(sfl_receiver_writeCountersSample(receiver, &cs) == -1)
+    return NULL;
+  sfl_receiver_flush(receiver);
+  /* datagram header is 28 bytes with an IPv4 agent address,  and
+     the counters sample header is another 20 */
+  *len = lastPktLen - 48;
+  return lastPkt + 48;
+}
+
+/*_________________---------------------------__________________
+  _________________   encoded counters        __________________
+  -----------------___________________________------------------
+  A block sent pre-encoded must go out exactly as the original,
+  and an element whose tag was never set (or whose pre-encoded
+  length is bad) must be rejected rather than sent malformed.
+*/
+
+static void test_encoded_counters(void) {
+  SFLAgent agent;
+  SFLReceiver *receiver = testReceiver(&agent);
+
+  SFLCounters_sample_element elem = { 0 };
+  elem.tag = SFLCOUNTERS_GENERIC;
+  elem.counterBlock.generic.ifIndex = 7;
+  elem.counterBlock.generic.ifSpeed = 10000000000LL;
+  elem.counterBlock.generic.ifInOctets = 123456789;
+  uint32_t plainLen = 0;
+  u_char *plain = countersElements(receiver, &elem, &plainLen);
+  u_char plainCopy[SFL_MAX_DATAGRAM_SIZE];
+  if(plain)
+    memcpy(plainCopy, plain, plainLen);
+  check(plain != NULL && plainLen == 96, "generic counters block length", plainLen, 96);
+
+  uint32_t xdr[64];
+  int xdrLen = sfl_receiver_encodeCountersElement(receiver, &elem, xdr, sizeof(xdr));
+  check(xdrLen == (int)plainLen, "encodeCountersElement length", xdrLen, plainLen);
+
+  SFLCounters_sample_element enc = { 0 };
+  enc.tag = SFLCOUNTERS_ENCODED;
+  enc.counterBlock.encoded.xdr = xdr;
+  enc.counterBlock.encoded.len = xdrLen;
+  uint32_t encLen = 0;
+  u_char *encoded = countersElements(receiver, &enc, &encLen);
+  check(encoded != NULL
+	&& encLen == plainLen
+	&& memcmp(encoded, plainCopy, plainLen) == 0,
+	"pre-encoded block sent unchanged", encLen, plainLen);
+
+  int errors0 = agentErrors;
+  SFLCounters_sample_element unset = { 0 };
+  uint32_t unsetLen = 0;
+  check(countersElements(receiver, &unset, &unsetLen) == NULL
+	&& agentErrors == errors0 + 1
+	&& lastPktLen == 0,
+	"zeroed element rejected", agentErrors - errors0, 1);
+
+  SFLCounters_sample_element bad = { 0 };
+  bad.tag = SFLCOUNTERS_ENCODED;
+  bad.counterBlock.encoded.xdr = xdr;
+  bad.counterBlock.encoded.len = 4;
+  uint32_t badLen = 0;
+  check(countersElements(receiver, &bad, &badLen) == NULL
+	&& agentErrors == errors0 + 2
+	&& lastPktLen == 0,
+	"short pre-encoded block rejected", agentErrors - errors0, 2);
+  sfl_agent_release(&agent);
+}
+
+/*_________________---------------------------__________________
+  _________________   flow elements           __________________
+  -----------------___________________________------------------
+  Flow samples and discard events share the flow element encoder.
+  Send one of each and walk the datagram back with an XDR reader:
+  every length field must cover exactly the bytes that follow it,
+  num_elements must match the element list,  and the strings and
+  the sampled header must be padded to 4 bytes.
+*/
+
+typedef struct {
+  u_char *p;
+  u_char *end;
+  int overrun;
+} XDRReader;
+
+static uint32_t getNet32(XDRReader *x) {
+  uint32_t val;
+  if(x->p + 4 > x->end) {
+    x->overrun = 1;
+    return 0;
+  }
+  memcpy(&val, x->p, 4);
+  x->p += 4;
+  return ntohl(val);
+}
+
+static int getOpaque(XDRReader *x, const void *want, uint32_t wantLen) {
+  uint32_t len = getNet32(x);
+  uint32_t padded = (len + 3) & ~3;
+  if(x->overrun || x->p + padded > x->end) {
+    x->overrun = 1;
+    return 0;
+  }
+  int ok = (len == wantLen && memcmp(x->p, want, len) == 0);
+  for(uint32_t ii = len; ii < padded; ii++)
+    if(x->p[ii] != 0) ok = 0;
+  x->p += padded;
+  return ok;
+}
+
+static int getString(XDRReader *x, const char *want) {
+  return getOpaque(x, want, strlen(want));
+}
+
+/* opens the datagram and checks it holds one sample of this type,
+   returning a reader bounded by that sample's length */
+static int openSample(XDRReader *x, uint32_t wantTag) {
+  x->p = lastPkt;
+  x->end = lastPkt + lastPktLen;
+  x->overrun = 0;
+  int ok = (getNet32(x) == SFLDATAGRAM_VERSION5
+	    && getNet32(x) == SFLADDRESSTYPE_IP_V4);
+  x->p += 4 + 4 + 4 + 4; /* address, sub-agent, sequence, uptime */
+  ok = ok && getNet32(x) == 1; /* num samples */
+  ok = ok && getNet32(x) == wantTag;
+  uint32_t len = getNet32(x);
+  ok = ok && !x->overrun && x->p + len == x->end;
+  return ok;
+}
+
+/* element header: tag and a length that must reach exactly to the
+   end of its data,  as read by the caller */
+static u_char *elemStart(XDRReader *x, uint32_t wantTag, int *ok) {
+  if(getNet32(x) != wantTag) *ok = 0;
+  uint32_t len = getNet32(x);
+  return x->p + len;
+}
+
+static void elemEnd(XDRReader *x, u_char *end, int *ok) {
+  if(x->overrun || x->p != end) *ok = 0;
+}
+
+#define SFL_TEST_HDR_LEN 14 /* ethernet header, padded to 16 */
+
+static u_char testHdr[SFL_TEST_HDR_LEN] = {
+  0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0x08, 0x00
+};
+
+static void testString(SFLString *str, char *val) {
+  str->str = val;
+  str->len = strlen(val);
+}
+
+static int checkHeaderElem(XDRReader *x) {
+  int ok = 1;
+  u_char *end = elemStart(x, SFLFLOW_HEADER, &ok);
+  ok = ok && getNet32(x) == SFLHEADER_ETHERNET_ISO8023;
+  ok = ok && getNet32(x) == 1500;
+  ok = ok && getNet32(x) == 4;
+  ok = ok && getOpaque(x, testHdr, SFL_TEST_HDR_LEN);
+  elemEnd(x, end, &ok);
+  return ok;
+}
+
+static void test_discard_event(void) {
+  SFLAgent agent;
+  SFLReceiver *receiver = testReceiver(&agent);
+  SFLEvent_discarded_packet es = { 0 };
+  es.sequence_number = 42;
+  es.ds_class = 0;
+  es.ds_index = 3;
+  es.drops = 7;
+  es.input = 3;
+  es.output = 0;
+  es.reason = SFLDrop_unknown_l3;
+  SFLFlow_sample_element hdr = { 0 }, q = { 0 }, fn = { 0 }, trap = { 0 }, why = { 0 };
+  hdr.tag = SFLFLOW_HEADER;
+  hdr.flowType.header.header_protocol = SFLHEADER_ETHERNET_ISO8023;
+  hdr.flowType.header.frame_length = 1500;
+  hdr.flowType.header.stripped = 4;
+  hdr.flowType.header.header_length = SFL_TEST_HDR_LEN;
+  hdr.flowType.header.header_bytes = testHdr;
+  q.tag = SFLFLOW_EX_EGRESS_Q;
+  q.flowType.egress_queue.queue = 5;
+  fn.tag = SFLFLOW_EX_FUNCTION;
+  testString(&fn.flowType.function.symbol, "ip_rcv_core"); /* 11, padded to 12 */
+  trap.tag = SFLFLOW_EX_HW_TRAP;
+  testString(&trap.flowType.hw_trap.group, "l3_drops");
+  testString(&trap.flowType.hw_trap.trap, "blackhole_route");
+  why.tag = SFLFLOW_EX_LINUX_REASON;
+  testString(&why.flowType.linux_reason.reason, "NO_SOCKET");
+  /* SFLADD_ELEMENT prepends,  so add them in reverse */
+  SFLADD_ELEMENT(&es, &why);
+  SFLADD_ELEMENT(&es, &trap);
+  SFLADD_ELEMENT(&es, &fn);
+  SFLADD_ELEMENT(&es, &q);
+  SFLADD_ELEMENT(&es, &hdr);
+  es.num_elements = 99; /* must be recounted */
+  lastPktLen = 0;
+  int size = sfl_receiver_writeEventDiscardedPacket(receiver, &es);
+  sfl_receiver_flush(receiver);
+  /* 40 + (8+32) + (8+4) + (8+16) + (8+12+20) + (8+16) */
+  check(size == 180, "discard event encoded size", size, 180);
+  check(lastPktLen == 28 + 180, "discard event datagram length", lastPktLen, 28 + 180);
+
+  XDRReader x;
+  check(openSample(&x, SFLEVENT_DISCARDED_PACKET), "discard event sample tag and length", 0, 0);
+  int ok = (getNet32(&x) == 42
+	    && getNet32(&x) == 0
+	    && getNet32(&x) == 3
+	    && getNet32(&x) == 7
+	    && getNet32(&x) == 3
+	    && getNet32(&x) == 0
+	    && getNet32(&x) == SFLDrop_unknown_l3);
+  check(ok, "discard event fixed fields", ok, 1);
+  uint32_t nelem = getNet32(&x);
+  check(nelem == 5, "discard event num_elements", nelem, 5);
+  check(checkHeaderElem(&x), "discard event header element", 0, 0);
+  u_char *end = elemStart(&x, SFLFLOW_EX_EGRESS_Q, &ok);
+  ok = ok && getNet32(&x) == 5;
+  elemEnd(&x, end, &ok);
+  check(ok, "discard event egress queue element", ok, 1);
+  end = elemStart(&x, SFLFLOW_EX_FUNCTION, &ok);
+  ok = ok && getString(&x, "ip_rcv_core");
+  elemEnd(&x, end, &ok);
+  check(ok, "discard event function element", ok, 1);
+  end = elemStart(&x, SFLFLOW_EX_HW_TRAP, &ok);
+  ok = ok && getString(&x, "l3_drops") && getString(&x, "blackhole_route");
+  elemEnd(&x, end, &ok);
+  check(ok, "discard event hw trap element", ok, 1);
+  end = elemStart(&x, SFLFLOW_EX_LINUX_REASON, &ok);
+  ok = ok && getString(&x, "NO_SOCKET");
+  elemEnd(&x, end, &ok);
+  check(ok, "discard event linux reason element", ok, 1);
+  check(!x.overrun && x.p == x.end, "discard event ends with its last element", x.end - x.p, 0);
+  sfl_agent_release(&agent);
+}
+
+static void test_flow_sample(void) {
+  SFLAgent agent;
+  SFLReceiver *receiver = testReceiver(&agent);
+  SFL_FLOW_SAMPLE_TYPE fs = { 0 };
+  fs.sequence_number = 9;
+#ifdef SFL_USE_32BIT_INDEX
+  fs.ds_index = 3;
+#else
+  fs.source_id = 3;
+#endif
+  fs.sampling_rate = 400;
+  fs.sample_pool = 4000;
+  fs.input = 3;
+  fs.output = 4;
+  SFLFlow_sample_element hdr = { 0 }, fn = { 0 };
+  hdr.tag = SFLFLOW_HEADER;
+  hdr.flowType.header.header_protocol = SFLHEADER_ETHERNET_ISO8023;
+  hdr.flowType.header.frame_length = 1500;
+  hdr.flowType.header.stripped = 4;
+  hdr.flowType.header.header_length = SFL_TEST_HDR_LEN;
+  hdr.flowType.header.header_bytes = testHdr;
+  fn.tag = SFLFLOW_EX_FUNCTION;
+  testString(&fn.flowType.function.symbol, "ip_rcv_core");
+  SFLADD_ELEMENT(&fs, &fn);
+  SFLADD_ELEMENT(&fs, &hdr);
+  lastPktLen = 0;
+  int size = sfl_receiver_writeFlowSample(receiver, &fs);
+  sfl_receiver_flush(receiver);
+#ifdef SFL_USE_32BIT_INDEX
+  int want = 52 + 40 + 24;
+  uint32_t wantTag = SFLFLOW_SAMPLE_EXPANDED;
+#else
+  int want = 40 + 40 + 24;
+  uint32_t wantTag = SFLFLOW_SAMPLE;
+#endif
+  check(size == want, "flow sample encoded size", size, want);
+  XDRReader x;
+  check(openSample(&x, wantTag), "flow sample tag and length", 0, 0);
+  int ok = (getNet32(&x) == 9);
+#ifdef SFL_USE_32BIT_INDEX
+  ok = ok && getNet32(&x) == 0 && getNet32(&x) == 3;
+#else
+  ok = ok && getNet32(&x) == 3;
+#endif
+  ok = ok && getNet32(&x) == 400 && getNet32(&x) == 4000 && getNet32(&x) == 0;
+#ifdef SFL_USE_32BIT_INDEX
+  ok = ok && getNet32(&x) == 0 && getNet32(&x) == 3 && getNet32(&x) == 0 && getNet32(&x) == 4;
+#else
+  ok = ok && getNet32(&x) == 3 && getNet32(&x) == 4;
+#endif
+  check(ok, "flow sample fixed fields", ok, 1);
+  uint32_t nelem = getNet32(&x);
+  check(nelem == 2, "flow sample num_elements", nelem, 2);
+  check(checkHeaderElem(&x), "flow sample header element", 0, 0);
+  u_char *end = elemStart(&x, SFLFLOW_EX_FUNCTION, &ok);
+  ok = ok && getString(&x, "ip_rcv_core");
+  elemEnd(&x, end, &ok);
+  check(ok, "flow sample function element", ok, 1);
+  check(!x.overrun && x.p == x.end, "flow sample ends with its last element", x.end - x.p, 0);
+  sfl_agent_release(&agent);
+}
+
+int main(int argc, char *argv[]) {
+  test_random_skip_degenerate();
+  uint32_t means[] = { 2, 10, 400, 65536, 1048576 };
+  for(int ii = 0; ii < (sizeof(means) / sizeof(means[0])); ii++)
+    test_random_skip(means[ii]);
+  test_encoded_counters();
+  test_discard_event();
+  test_flow_sample();
+  printf("%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}